@@ -0,0 +1,158 @@
+#if !defined(_RADIOLIB_BENCHMARK_H)
+#define _RADIOLIB_BENCHMARK_H
+
+// timing loop and CSV output shared by all benchmark executables, include it in exactly one file of each
+// results are printed as CSV with the columns given by BENCHMARK_CSV_HEADER:
+// benchmark name, number of iterations, nanoseconds, heap allocations and CPU cycles per operation,
+// bytes processed per operation and CPU cycles per byte (the last two are 0 for operations without a length)
+// CPU cycles are read from the performance counters when the kernel allows it, otherwise from the time stamp
+// counter on x86 (which counts at a fixed reference frequency), and are 0 on platforms that have neither
+
+#include "../../src/TypeDef.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <new>
+#include <chrono>
+
+#if defined(__linux__)
+  #include <linux/perf_event.h>
+  #include <sys/syscall.h>
+  #include <unistd.h>
+#endif
+#if defined(__x86_64__) || defined(__i386__)
+  #include <x86intrin.h>
+#endif
+
+// minimum time to spend on each benchmark
+#if !defined(BENCHMARK_MIN_TIME_NS)
+  #define BENCHMARK_MIN_TIME_NS                                 (200000000ULL)
+#endif
+
+#define BENCHMARK_CSV_HEADER "benchmark,iterations,ns_per_op,allocs_per_op,cycles_per_op,bytes_per_op,cycles_per_byte\n"
+
+// only benchmarks whose name contains this string are run, all of them if NULL
+static const char* benchmarkFilter = NULL;
+
+// keeps the compiler from optimizing away results
+static volatile uint32_t sink = 0;
+
+// count all heap allocations, including those made by the library
+static size_t numAllocs = 0;
+
+void* operator new(size_t size) {
+  numAllocs++;
+  void* ptr = malloc(size ? size : 1);
+  if(!ptr) {
+    throw std::bad_alloc();
+  }
+  return(ptr);
+}
+
+void* operator new[](size_t size) {
+  return(operator new(size));
+}
+
+void operator delete(void* ptr) noexcept {
+  free(ptr);
+}
+
+void operator delete[](void* ptr) noexcept {
+  free(ptr);
+}
+
+void operator delete(void* ptr, size_t size) noexcept {
+  (void)size;
+  free(ptr);
+}
+
+void operator delete[](void* ptr, size_t size) noexcept {
+  (void)size;
+  free(ptr);
+}
+
+// CPU cycle counter, the performance counter file is opened on the first use
+static int cyclesFd = -2;
+
+static uint64_t readCycles() {
+#if defined(__linux__)
+  if(cyclesFd == -2) {
+    struct perf_event_attr attr;
+    memset(&attr, 0, sizeof(attr));
+    attr.type = PERF_TYPE_HARDWARE;
+    attr.size = sizeof(attr);
+    attr.config = PERF_COUNT_HW_CPU_CYCLES;
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+    cyclesFd = (int)syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0);
+  }
+  uint64_t cycles = 0;
+  if((cyclesFd >= 0) && (read(cyclesFd, &cycles, sizeof(cycles)) == sizeof(cycles))) {
+    return(cycles);
+  }
+#endif
+#if defined(__x86_64__) || defined(__i386__)
+  return(__rdtsc());
+#else
+  return(0);
+#endif
+}
+
+// parse the arguments, print the CSV header, and the source of the cycle counts to stderr
+static void benchmarkBegin(int argc, char** argv) {
+  if(argc > 1) {
+    benchmarkFilter = argv[1];
+  }
+  readCycles();
+#if defined(__x86_64__) || defined(__i386__)
+  fprintf(stderr, "cycles: %s\n", (cyclesFd >= 0) ? "cpu" : "tsc");
+#else
+  fprintf(stderr, "cycles: %s\n", (cyclesFd >= 0) ? "cpu" : "none");
+#endif
+  printf(BENCHMARK_CSV_HEADER);
+}
+
+// run the operation repeatedly until the minimum time has passed, then print the results
+// len is the number of bytes processed by one operation, or 0 if it does not have a length
+template<typename F>
+static void run(const char* name, size_t len, F op) {
+  if(benchmarkFilter && !strstr(name, benchmarkFilter)) {
+    return;
+  }
+
+  // warm-up, also generates any lookup tables
+  op();
+
+  uint64_t iters = 1;
+  while(true) {
+    size_t allocsStart = numAllocs;
+    uint64_t cyclesStart = readCycles();
+    auto start = std::chrono::steady_clock::now();
+    for(uint64_t i = 0; i < iters; i++) {
+      op();
+    }
+    uint64_t elapsed = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count();
+    uint64_t cycles = readCycles() - cyclesStart;
+    size_t allocs = numAllocs - allocsStart;
+
+    if(elapsed >= BENCHMARK_MIN_TIME_NS) {
+      double cyclesPerOp = (double)cycles / iters;
+      printf("%s,%llu,%.2f,%.2f,%.1f,%lu,%.2f\n", name, (unsigned long long)iters, (double)elapsed / iters,
+        (double)allocs / iters, cyclesPerOp, (unsigned long)len, len ? cyclesPerOp / len : 0);
+      fflush(stdout);
+      return;
+    }
+
+    // aim for the minimum time, but at most 10 times as many iterations as in this round
+    uint64_t next = elapsed ? (iters * BENCHMARK_MIN_TIME_NS * 11) / (10 * elapsed) : iters * 10;
+    iters = RADIOLIB_MAX(iters + 1, RADIOLIB_MIN(next, iters * 10));
+  }
+}
+
+template<typename F>
+static void run(const char* name, F op) {
+  run(name, 0, op);
+}
+
+#endif
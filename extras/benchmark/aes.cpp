@@ -0,0 +1,65 @@
+// this is a host benchmark of RadioLibAES128 encryption modes
+// it is built once for every available RADIOLIB_AES128_BACKEND (see CMakeLists.txt)
+// results are printed as CSV, see Benchmark.h
+// an optional argument can be used to only run benchmarks whose name contains the given string
+
+#include "../../src/utils/Cryptography.h"
+
+// minimum time to spend on each benchmark, there are many of them
+#define BENCHMARK_MIN_TIME_NS                                   (100000000ULL)
+
+#include "Benchmark.h"
+
+#if defined(RADIOLIB_AES128_HW_X86)
+  #define BACKEND_NAME "hw"
+#elif (RADIOLIB_AES128_BACKEND == RADIOLIB_AES128_BACKEND_TTABLE)
+  #define BACKEND_NAME "ttable"
+#else
+  #define BACKEND_NAME "compact"
+#endif
+
+// key from NIST SP800-38A appendix F, the known-answer tests are in extras/test/unit/test_aes.cpp
+static uint8_t key[RADIOLIB_AES128_KEY_SIZE] = {
+  0x2b, 0x7e, 0x15, 0x16, 0x28, 0xae, 0xd2, 0xa6, 0xab, 0xf7, 0x15, 0x88, 0x09, 0xcf, 0x4f, 0x3c
+};
+
+// the entry point for the program
+int main(int argc, char** argv) {
+  benchmarkBegin(argc, argv);
+
+  static uint8_t data[1024];
+  static uint8_t out[1024];
+  for(size_t i = 0; i < sizeof(data); i++) {
+    data[i] = (uint8_t)(i * 37 + 11);
+  }
+
+  uint8_t ctr[RADIOLIB_AES128_BLOCK_SIZE] = { 0 };
+  RadioLibAES128 aes;
+  aes.init(key);
+
+  static const size_t lengths[] = { 16, 64, 256, 1024 };
+  for(size_t l = 0; l < sizeof(lengths) / sizeof(lengths[0]); l++) {
+    size_t len = lengths[l];
+    char name[64];
+
+    snprintf(name, sizeof(name), "aes128/%s/ecb/%luB", BACKEND_NAME, (unsigned long)len);
+    run(name, len, [&]() {
+      aes.encryptECB(data, len, out);
+      sink = out[0];
+    });
+
+    snprintf(name, sizeof(name), "aes128/%s/cmac/%luB", BACKEND_NAME, (unsigned long)len);
+    run(name, len, [&]() {
+      aes.generateCMAC(data, len, out);
+      sink = out[0];
+    });
+
+    snprintf(name, sizeof(name), "aes128/%s/ctr/%luB", BACKEND_NAME, (unsigned long)len);
+    run(name, len, [&]() {
+      aes.initCTR(ctr);
+      aes.updateCTR(data, len, out);
+      sink = out[0];
+    });
+  }
+  return(0);
+}
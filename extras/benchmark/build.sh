@@ -0,0 +1,8 @@
+#!/bin/bash
+
+set -e
+mkdir -p build
+cd build
+cmake -DCMAKE_BUILD_TYPE=Release ..
+make -j4
+cd ..
@@ -0,0 +1,68 @@
+// this is a host benchmark of RadioLibCRC over a range of buffer lengths
+// it is built once for every RADIOLIB_CRC_TABLE configuration (see CMakeLists.txt),
+// so that the bitwise, byte-wise and slice-by-N calculations can be compared
+// results are printed as CSV, see Benchmark.h, the correctness is checked by extras/test/unit/test_crc.cpp
+// an optional argument can be used to only run benchmarks whose name contains the given string
+
+#include "../../src/utils/CRC.h"
+
+// minimum time to spend on each benchmark, there are many of them
+#define BENCHMARK_MIN_TIME_NS                                   (100000000ULL)
+
+#include "Benchmark.h"
+
+// CRC configurations to sweep
+struct CrcConfig_t {
+  const char* name;
+  uint8_t size;
+  uint32_t poly;
+  uint32_t init;
+  uint32_t out;
+  bool ref;
+};
+
+static const CrcConfig_t configs[] = {
+  { "crc8",        8,  0x07,       0x00,       0x00,       false },
+  { "crc16/ccitt", 16, 0x1021,     0xFFFF,     0xFFFF,     false },
+  { "crc16/x25",   16, 0x1021,     0xFFFF,     0xFFFF,     true  },
+  { "crc32",       32, 0x04C11DB7, 0xFFFFFFFF, 0xFFFFFFFF, true  },
+};
+
+static const size_t lengths[] = { 8, 16, 32, 64, 128, 256, 1024, 4096 };
+
+// the entry point for the program
+int main(int argc, char** argv) {
+  benchmarkBegin(argc, argv);
+
+  // pseudo-random data, so that the branch predictor cannot learn the bit pattern
+  static uint8_t data[4096];
+  uint32_t x = 0x12345678;
+  for(size_t i = 0; i < sizeof(data); i++) {
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    data[i] = (uint8_t)x;
+  }
+
+  RadioLibCRC crc;
+  for(size_t c = 0; c < sizeof(configs) / sizeof(configs[0]); c++) {
+    const CrcConfig_t* cfg = &configs[c];
+    crc.size = cfg->size;
+    crc.poly = cfg->poly;
+    crc.init = cfg->init;
+    crc.out = cfg->out;
+    crc.refIn = cfg->ref;
+    crc.refOut = cfg->ref;
+
+    for(size_t l = 0; l < sizeof(lengths) / sizeof(lengths[0]); l++) {
+      size_t len = lengths[l];
+
+      char name[64];
+      snprintf(name, sizeof(name), "%s/table%d/%luB", cfg->name, RADIOLIB_CRC_TABLE, (unsigned long)len);
+      run(name, len, [&]() {
+        sink = crc.checksum(data, len);
+      });
+    }
+  }
+  return(0);
+}
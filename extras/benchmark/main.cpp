@@ -0,0 +1,352 @@
+// this is a host micro-benchmark for RadioLib utilities and protocol encoders
+// it does not need any radio hardware, all hardware access is replaced by dummy implementations
+// the timing loop and the CSV columns are shared with the other benchmarks, see Benchmark.h
+// an optional argument can be used to only run benchmarks whose name contains the given string
+
+#include <RadioLib.h>
+
+#include "Benchmark.h"
+
+#include <string.h>
+
+// HAL that does nothing, there is no hardware to talk to
+class BenchmarkHal : public RadioLibHal {
+  public:
+    BenchmarkHal() : RadioLibHal(0, 1, 0, 1, 2, 3) {}
+
+    void pinMode(uint32_t pin, uint32_t mode) override { (void)pin; (void)mode; }
+    void digitalWrite(uint32_t pin, uint32_t value) override { (void)pin; (void)value; }
+    uint32_t digitalRead(uint32_t pin) override { (void)pin; return(0); }
+    void attachInterrupt(uint32_t num, void (*cb)(void), uint32_t mode) override { (void)num; (void)cb; (void)mode; }
+    void detachInterrupt(uint32_t num) override { (void)num; }
+    void delay(RadioLibTime_t ms) override { (void)ms; }
+    void delayMicroseconds(RadioLibTime_t us) override { (void)us; }
+    RadioLibTime_t millis() override { return(this->micros() / 1000); }
+    RadioLibTime_t micros() override {
+      static auto start = std::chrono::steady_clock::now();
+      return(std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start).count());
+    }
+    long pulseIn(uint32_t pin, uint32_t state, RadioLibTime_t timeout) override { (void)pin; (void)state; (void)timeout; return(0); }
+    void spiBegin() override {}
+    void spiBeginTransaction() override {}
+    void spiTransfer(uint8_t* out, size_t len, uint8_t* in) override { (void)out; memset(in, 0x00, len); }
+    void spiEndTransaction() override {}
+    void spiEnd() override {}
+};
+
+// physical layer that discards transmitted data and "receives" a preset packet
+class BenchmarkPhy : public PhysicalLayer {
+  public:
+    const uint8_t* rxData = NULL;
+    size_t rxLen = 0;
+
+    explicit BenchmarkPhy(Module* mod) : PhysicalLayer(1, 255), mod(mod) {}
+
+    Module* getMod() override { return(this->mod); }
+    int16_t transmit(const uint8_t* data, size_t len, uint8_t addr = 0) override { (void)data; (void)len; (void)addr; return(RADIOLIB_ERR_NONE); }
+    int16_t readData(uint8_t* data, size_t len) override { memcpy(data, this->rxData, RADIOLIB_MIN(len, this->rxLen)); return(RADIOLIB_ERR_NONE); }
+    size_t getPacketLength(bool update = true) override { (void)update; return(this->rxLen); }
+    int16_t standby() override { return(RADIOLIB_ERR_NONE); }
+    int16_t checkOutputPower(int8_t power, int8_t* clipped) override { if(clipped) { *clipped = power; } return(RADIOLIB_ERR_NONE); }
+    int16_t checkDataRate(DataRate_t dr) override { (void)dr; return(RADIOLIB_ERR_NONE); }
+    int16_t getModem(ModemType_t* modem) override { *modem = ModemType_t::RADIOLIB_MODEM_LORA; return(RADIOLIB_ERR_NONE); }
+    int16_t setFrequencyDeviation(float freqDev) override { (void)freqDev; return(RADIOLIB_ERR_NONE); }
+    int16_t setDataShaping(uint8_t sh) override { (void)sh; return(RADIOLIB_ERR_NONE); }
+    int16_t setEncoding(uint8_t encoding) override { (void)encoding; return(RADIOLIB_ERR_NONE); }
+
+  private:
+    Module* mod;
+};
+
+static BenchmarkHal hal;
+static Module mod(&hal, 1, 2, 3);
+static BenchmarkPhy phy(&mod);
+
+static void benchmarkUtils() {
+  uint8_t key[RADIOLIB_AES128_KEY_SIZE] = {
+    0x2B, 0x7E, 0x15, 0x16, 0x28, 0xAE, 0xD2, 0xA6, 0xAB, 0xF7, 0x15, 0x88, 0x09, 0xCF, 0x4F, 0x3C
+  };
+  uint8_t data[256];
+  uint8_t out[512];
+  for(size_t i = 0; i < sizeof(data); i++) {
+    data[i] = (uint8_t)(i * 37 + 11);
+  }
+
+  run("crc/ccitt/256B", 256, [&]() {
+    RadioLibCRCInstance.size = 16;
+    RadioLibCRCInstance.poly = RADIOLIB_CRC_CCITT_POLY;
+    RadioLibCRCInstance.init = RADIOLIB_CRC_CCITT_INIT;
+    RadioLibCRCInstance.out = RADIOLIB_CRC_CCITT_OUT;
+    RadioLibCRCInstance.refIn = false;
+    RadioLibCRCInstance.refOut = false;
+    sink = RadioLibCRCInstance.checksum(data, sizeof(data));
+  });
+
+  run("aes128/ecb/256B", 256, [&]() {
+    RadioLibAES128Instance.init(key);
+    RadioLibAES128Instance.encryptECB(data, sizeof(data), out);
+    sink = out[0];
+  });
+
+  run("aes128/cmac/64B", 64, [&]() {
+    RadioLibAES128Instance.init(key);
+    RadioLibAES128Instance.generateCMAC(data, 64, out);
+    sink = out[0];
+  });
+
+  RadioLibBCHInstance.begin(RADIOLIB_PAGER_BCH_N, RADIOLIB_PAGER_BCH_K, RADIOLIB_PAGER_BCH_PRIMITIVE_POLY);
+  uint32_t dataWord = 0x12345;
+  run("bch/encode", [&]() {
+    sink = RadioLibBCHInstance.encode(dataWord++ & 0x1FFFFF);
+  });
+
+  uint32_t codeWord = RadioLibBCHInstance.encode(0x12345);
+  run("bch/decode/0err", [&]() {
+    uint32_t cw = codeWord;
+    sink = RadioLibBCHInstance.decode(&cw);
+  });
+
+  run("bch/decode/1err", [&]() {
+    uint32_t cw = codeWord ^ 0x00100000UL;
+    sink = RadioLibBCHInstance.decode(&cw);
+  });
+
+  run("bch/decode/2err", [&]() {
+    uint32_t cw = codeWord ^ 0x00100004UL;
+    sink = RadioLibBCHInstance.decode(&cw);
+  });
+
+  size_t bits = 0;
+  run("convcode/encode/r3/32B", 32, [&]() {
+    RadioLibConvCodeInstance.begin(3);
+    RadioLibConvCodeInstance.encode(data, 8*32, out, &bits);
+    sink = out[0];
+  });
+
+  RadioLibConvCodeInstance.begin(3);
+  uint8_t coded[128];
+  size_t codedBits = 0;
+  RadioLibConvCodeInstance.encode(data, 8*32, coded, &codedBits);
+  run("convcode/decode/r3/32B", 32, [&]() {
+    RadioLibConvCodeInstance.decode(coded, codedBits, out, &bits);
+    sink = out[0];
+  });
+
+  // soft decisions with full confidence, the decoder does the same work regardless of the values
+  int8_t codedSoft[8*sizeof(coded)];
+  for(size_t i = 0; i < codedBits; i++) {
+    codedSoft[i] = ((coded[i / 8] >> (7 - i % 8)) & 0x01) ? 127 : -127;
+  }
+  run("convcode/decodesoft/r3/32B", 32, [&]() {
+    RadioLibConvCodeInstance.decodeSoft(codedSoft, codedBits, out, &bits);
+    sink = out[0];
+  });
+
+  RadioLibGolayInstance.begin();
+  uint16_t golayData = 0;
+  run("golay/encode", [&]() {
+    sink = RadioLibGolayInstance.encode(golayData++ & 0x0FFF);
+  });
+
+  run("golay/decode/0err", [&]() {
+    uint32_t cw = RadioLibGolayInstance.encode(0xABC);
+    sink = RadioLibGolayInstance.decode(&cw);
+  });
+
+  run("golay/decode/3err", [&]() {
+    uint32_t cw = RadioLibGolayInstance.encode(0xABC) ^ 0x00400201UL;
+    sink = RadioLibGolayInstance.decode(&cw);
+  });
+
+  // 22-byte Horus Binary v1 packet, the frame is decoded with 3 bit errors
+  uint8_t horus[64];
+  run("horus/encode/22B", 22, [&]() {
+    FSK4Client::encodeHorus(data, 22, horus);
+    sink = horus[2];
+  });
+
+  FSK4Client::encodeHorus(data, 22, horus);
+  horus[5] ^= 0x10;
+  horus[20] ^= 0x01;
+  horus[40] ^= 0x80;
+  run("horus/decode/22B/3err", 22, [&]() {
+    FSK4Client::decodeHorus(horus, out, 22);
+    sink = out[0];
+  });
+
+  RadioLibReedSolomonInstance.begin(32);
+  run("rs/encode/223B", 223, [&]() {
+    RadioLibReedSolomonInstance.encode(data, 223, &out[223]);
+    sink = out[223];
+  });
+
+  memcpy(out, data, 223);
+  RadioLibReedSolomonInstance.encode(data, 223, &out[223]);
+  uint8_t block[RADIOLIB_RS_MAX_N];
+  run("rs/decode/223B/8err", 223, [&]() {
+    memcpy(block, out, 255);
+    for(size_t i = 0; i < 8; i++) {
+      block[i*31] ^= 0x5A;
+    }
+    sink = RadioLibReedSolomonInstance.decode(block, 255);
+  });
+
+  // random bit errors at BER of 0.3 %, the decoder usually has to correct 5 to 10 bytes
+  static uint8_t noisy[16][RADIOLIB_RS_MAX_N];
+  uint32_t rng = 1;
+  for(size_t b = 0; b < 16; b++) {
+    memcpy(noisy[b], out, 255);
+    for(size_t i = 0; i < 8*255; i++) {
+      rng = rng * 1664525UL + 1013904223UL;
+      if(rng < 12884902UL) {
+        noisy[b][i / 8] ^= 0x80 >> (i % 8);
+      }
+    }
+  }
+  size_t noisyIdx = 0;
+  run("rs/decode/223B/ber3e-3", 223, [&]() {
+    memcpy(block, noisy[noisyIdx++ % 16], 255);
+    sink = RadioLibReedSolomonInstance.decode(block, 255);
+  });
+
+  // whiten a copy, so that the shared input data stay the same for the other benchmarks
+  run("whitening/pn9/256B", 256, [&]() {
+    memcpy(out, data, sizeof(data));
+    sink = rlb_whiten_pn9(out, sizeof(data));
+  });
+
+  run("scramble/256B", 256, [&]() {
+    memcpy(out, data, sizeof(data));
+    sink = rlb_scramble(out, sizeof(data), 0x7FFF);
+  });
+
+  run("manchester/encode/256B", 256, [&]() {
+    rlb_manchester_encode(data, out, sizeof(data));
+    sink = out[0];
+  });
+
+  uint8_t encoded[2*sizeof(data)];
+  rlb_manchester_encode(data, encoded, sizeof(data));
+  run("manchester/decode/256B", 256, [&]() {
+    sink = rlb_manchester_decode(encoded, out, sizeof(encoded));
+  });
+
+  run("nrzi/encode/256B", 256, [&]() {
+    memcpy(out, data, sizeof(data));
+    sink = rlb_nrzi_encode(out, sizeof(data));
+  });
+
+  run("nrzi/decode/256B", 256, [&]() {
+    memcpy(out, data, sizeof(data));
+    sink = rlb_nrzi_decode(out, sizeof(data));
+  });
+
+  uint32_t reflectIn = 0x12345678;
+  run("reflect/32b", [&]() {
+    sink = rlb_reflect(reflectIn++, 32);
+  });
+
+  run("ita2/encode", [&]() {
+    ITA2String str("HELLO WORLD 1234567890");
+    uint8_t* arr = str.byteArr();
+    sink = arr[0];
+    delete[] arr;
+  });
+}
+
+static void benchmarkLoRaWAN() {
+  uint8_t nwkSKey[RADIOLIB_AES128_KEY_SIZE] = {
+    0x15, 0xB1, 0xD0, 0xEF, 0xA4, 0x63, 0xDF, 0xBE, 0x3D, 0x11, 0x18, 0x1E, 0x1E, 0xC7, 0xDA, 0x85
+  };
+  uint8_t appSKey[RADIOLIB_AES128_KEY_SIZE] = {
+    0xD7, 0x2C, 0x78, 0x75, 0x8C, 0xDC, 0xCA, 0xBF, 0x55, 0xEE, 0x4A, 0x77, 0x8D, 0x16, 0xEF, 0x67
+  };
+  uint32_t devAddr = 0x260BDE80;
+
+  LoRaWANNode node(&phy, &EU868);
+  node.beginABP(devAddr, NULL, NULL, nwkSKey, appSKey);
+  node.activateABP();
+
+  uint8_t payload[32];
+  for(size_t i = 0; i < sizeof(payload); i++) {
+    payload[i] = (uint8_t)i;
+  }
+
+  // uplink message, including the space reserved for MIC calculation blocks
+  uint8_t uplink[RADIOLIB_LORAWAN_FRAME_LEN(sizeof(payload), 0)];
+  run("lorawan/uplink/32B", 32, [&]() {
+    node.composeUplink(payload, sizeof(payload), uplink, 1, false);
+    node.micUplink(uplink, sizeof(uplink));
+    sink = uplink[sizeof(uplink) - 1];
+  });
+
+  // build a downlink for the node, same layout as uplink with the MIC blocks at the start
+  uint8_t downlink[RADIOLIB_LORAWAN_FRAME_LEN(sizeof(payload), 0)] = { 0 };
+  size_t downlinkLen = sizeof(downlink);
+  uint32_t fCnt = 1;
+  downlink[RADIOLIB_LORAWAN_FHDR_LEN_START_OFFS] = RADIOLIB_LORAWAN_MHDR_MTYPE_UNCONF_DATA_DOWN | RADIOLIB_LORAWAN_MHDR_MAJOR_R1;
+  LoRaWANNode::hton<uint32_t>(&downlink[RADIOLIB_LORAWAN_FHDR_DEV_ADDR_POS], devAddr);
+  LoRaWANNode::hton<uint16_t>(&downlink[RADIOLIB_LORAWAN_FHDR_FCNT_POS], (uint16_t)fCnt);
+  downlink[RADIOLIB_LORAWAN_FHDR_FPORT_POS(0)] = 1;
+  node.processAES(payload, sizeof(payload), appSKey, &downlink[RADIOLIB_LORAWAN_FRAME_PAYLOAD_POS(0)], devAddr, fCnt, RADIOLIB_LORAWAN_DOWNLINK, 0x00, true);
+  downlink[RADIOLIB_LORAWAN_BLOCK_MAGIC_POS] = RADIOLIB_LORAWAN_MIC_BLOCK_MAGIC;
+  downlink[RADIOLIB_LORAWAN_BLOCK_DIR_POS] = RADIOLIB_LORAWAN_DOWNLINK;
+  LoRaWANNode::hton<uint32_t>(&downlink[RADIOLIB_LORAWAN_BLOCK_DEV_ADDR_POS], devAddr);
+  LoRaWANNode::hton<uint32_t>(&downlink[RADIOLIB_LORAWAN_BLOCK_FCNT_POS], fCnt);
+  downlink[RADIOLIB_LORAWAN_MIC_BLOCK_LEN_POS] = downlinkLen - RADIOLIB_LORAWAN_FHDR_LEN_START_OFFS - sizeof(uint32_t);
+  uint8_t cmac[RADIOLIB_AES128_BLOCK_SIZE];
+  RadioLibAES128Instance.init(nwkSKey);
+  RadioLibAES128Instance.generateCMAC(downlink, downlinkLen - sizeof(uint32_t), cmac);
+  memcpy(&downlink[downlinkLen - sizeof(uint32_t)], cmac, sizeof(uint32_t));
+
+  // the radio only delivers the frame itself, without the MIC blocks
+  phy.rxData = &downlink[RADIOLIB_LORAWAN_FHDR_LEN_START_OFFS];
+  phy.rxLen = downlinkLen - RADIOLIB_LORAWAN_FHDR_LEN_START_OFFS;
+
+  uint8_t data[RADIOLIB_SX126X_MAX_PACKET_LENGTH];
+  size_t len = 0;
+  int16_t state = node.parseDownlink(data, &len);
+  if((state != RADIOLIB_ERR_NONE) || (len != sizeof(payload)) || memcmp(data, payload, len)) {
+    printf("# lorawan/downlink setup failed, code %d\n", state);
+    return;
+  }
+
+  run("lorawan/downlink/32B", 32, [&]() {
+    // reset the frame counter so that the same frame is accepted again
+    node.aFCntDown = 0;
+    sink = node.parseDownlink(data, &len);
+  });
+}
+
+static void benchmarkAX25() {
+  AX25Client ax25(&phy);
+  ax25.begin("N7LEM");
+  run("ax25/frame/32B", 32, [&]() {
+    sink = ax25.transmit("Hello World! This is AX.25 test.", "NJ7P");
+  });
+}
+
+static void benchmarkSX126x() {
+  SX1262 radio(&mod);
+  uint8_t payload[32];
+  for(size_t i = 0; i < sizeof(payload); i++) {
+    payload[i] = (uint8_t)i;
+  }
+  uint8_t out[RADIOLIB_SX126X_MAX_PACKET_LENGTH];
+  size_t outLen = 0;
+  size_t outBits = 0;
+  size_t outHops = 0;
+  run("sx126x/lrfhss/32B", 32, [&]() {
+    sink = radio.buildLRFHSSPacket(payload, sizeof(payload), out, &outLen, &outBits, &outHops);
+  });
+}
+
+// the entry point for the program
+int main(int argc, char** argv) {
+  benchmarkBegin(argc, argv);
+  benchmarkUtils();
+  benchmarkLoRaWAN();
+  benchmarkAX25();
+  benchmarkSX126x();
+  return(0);
+}
@@ -0,0 +1,446 @@
+#include "NetworkServer.h"
+
+#include <math.h>
+#include <string.h>
+
+// length of the payload of uplink MAC commands, indexed by CID
+static const uint8_t macLenUp[] = { 0, 1, 0, 1, 0, 1, 2, 1, 0, 0, 1, 1, 0, 0, 0, 1 };
+
+// number of transmissions based on the packet loss (rows: <5 %, <10 %, <30 %, more) and the current number (columns)
+static const uint8_t adrNbTrans[4][3] = { { 1, 1, 2 }, { 1, 2, 3 }, { 2, 3, 3 }, { 3, 3, 3 } };
+
+// LoRaWAN fields are little endian
+static uint64_t getLe(const uint8_t* buff, size_t len) {
+  uint64_t val = 0;
+  for(size_t i = 0; i < len; i++) {
+    val |= (uint64_t)buff[i] << 8*i;
+  }
+  return(val);
+}
+
+static void putLe(uint8_t* buff, uint64_t val, size_t len) {
+  for(size_t i = 0; i < len; i++) {
+    buff[i] = (uint8_t)(val >> 8*i);
+  }
+}
+
+// in EU868, DR0 to DR5 are SF12 to SF7 at 125 kHz
+static uint8_t sfToDr(uint8_t sf) {
+  return(12 - sf);
+}
+
+SimNetworkServer::SimNetworkServer(Simulator* sim, SimGateway* gateway) : sim(sim), gateway(gateway) {}
+
+void SimNetworkServer::addDevice(uint64_t devEUI, uint64_t joinEUI, const uint8_t* appKey) {
+  Device dev = {};
+  dev.devEUI = devEUI;
+  dev.joinEUI = joinEUI;
+  memcpy(dev.appKey, appKey, RADIOLIB_AES128_KEY_SIZE);
+  this->devices[devEUI] = dev;
+}
+
+SimDeviceStats_t SimNetworkServer::getStats(uint64_t devEUI) const {
+  auto it = this->devices.find(devEUI);
+  if(it == this->devices.end()) {
+    return(SimDeviceStats_t());
+  }
+  return(it->second.stats);
+}
+
+void SimNetworkServer::setRelayed(uint64_t devEUI, bool relayed) {
+  auto it = this->devices.find(devEUI);
+  if(it != this->devices.end()) {
+    it->second.relayed = relayed;
+  }
+}
+
+void SimNetworkServer::onUplink(const SimTransmission& tx, float rssi, float snr) {
+  (void)rssi;
+  if(tx.data.empty()) {
+    return;
+  }
+
+  switch(tx.data[0] & RADIOLIB_LORAWAN_MHDR_MTYPE_MASK) {
+    case(RADIOLIB_LORAWAN_MHDR_MTYPE_JOIN_REQUEST):
+      this->handleJoinRequest(tx);
+      break;
+    case(RADIOLIB_LORAWAN_MHDR_MTYPE_UNCONF_DATA_UP):
+    case(RADIOLIB_LORAWAN_MHDR_MTYPE_CONF_DATA_UP):
+      this->handleDataUplink(tx, snr);
+      break;
+    default:
+      break;
+  }
+}
+
+void SimNetworkServer::handleJoinRequest(const SimTransmission& tx) {
+  // MHDR | JoinEUI | DevEUI | DevNonce | MIC
+  const uint8_t* msg = tx.data.data();
+  if(tx.data.size() != 23) {
+    return;
+  }
+  uint64_t joinEUI = getLe(&msg[1], 8);
+  uint64_t devEUI = getLe(&msg[9], 8);
+  uint16_t devNonce = (uint16_t)getLe(&msg[17], 2);
+
+  auto it = this->devices.find(devEUI);
+  if((it == this->devices.end()) || (it->second.joinEUI != joinEUI)) {
+    return;
+  }
+  Device& dev = it->second;
+  if(this->calculateMIC(dev.appKey, NULL, 0, msg, 19) != getLe(&msg[19], 4)) {
+    return;
+  }
+
+  // DevNonce is a counter, old values are replays
+  if((dev.stats.numJoinAccepts > 0) && (devNonce <= dev.devNonce)) {
+    return;
+  }
+  dev.devNonce = devNonce;
+  dev.joinNonce++;
+  if(!dev.devAddr) {
+    dev.devAddr = SIM_NS_DEV_ADDR_PREFIX | this->nextAddr++;
+    this->addresses[dev.devAddr] = devEUI;
+  }
+
+  // MHDR | JoinNonce | NetID | DevAddr | DLSettings | RxDelay | MIC, Rx2 datarate is DR0 and Rx1 has no offset
+  uint8_t accept[17] = { 0 };
+  accept[0] = RADIOLIB_LORAWAN_MHDR_MTYPE_JOIN_ACCEPT | RADIOLIB_LORAWAN_MHDR_MAJOR_R1;
+  putLe(&accept[1], dev.joinNonce, 3);
+  putLe(&accept[4], SIM_NS_NET_ID, 3);
+  putLe(&accept[7], dev.devAddr, 4);
+  accept[11] = sfToDr(SIM_NS_RX2_SF);
+  accept[12] = SIM_NS_RX1_DELAY_US / 1000000UL;
+  putLe(&accept[13], this->calculateMIC(dev.appKey, NULL, 0, accept, 13), 4);
+
+  // derive the session keys
+  uint8_t block[RADIOLIB_AES128_BLOCK_SIZE] = { 0 };
+  putLe(&block[1], dev.joinNonce, 3);
+  putLe(&block[4], SIM_NS_NET_ID, 3);
+  putLe(&block[7], devNonce, 2);
+  this->aes.init(dev.appKey);
+  block[0] = RADIOLIB_LORAWAN_JOIN_ACCEPT_F_NWK_S_INT_KEY;
+  this->aes.encryptECB(block, RADIOLIB_AES128_BLOCK_SIZE, dev.nwkSKey);
+  block[0] = RADIOLIB_LORAWAN_JOIN_ACCEPT_APP_S_KEY;
+  this->aes.encryptECB(block, RADIOLIB_AES128_BLOCK_SIZE, dev.appSKey);
+
+  // the device decrypts the JoinAccept with an encryption, so the server has to encrypt it with a decryption
+  std::vector<uint8_t> frame(sizeof(accept));
+  frame[0] = accept[0];
+  this->aes.decryptECB(&accept[1], sizeof(accept) - 1, &frame[1]);
+
+  // new session
+  dev.joined = true;
+  dev.fCntUpValid = false;
+  dev.fCntUp = 0;
+  dev.fCntDown = 0;
+  dev.dr = sfToDr(tx.sf);
+  dev.txSteps = 0;
+  dev.nbTrans = 1;
+  dev.adrPending = false;
+  dev.snrHistory.clear();
+  dev.stats.numJoinAccepts++;
+
+  this->sendDownlink(dev, tx, SIM_NS_JOIN_ACCEPT_DELAY_US, frame);
+}
+
+void SimNetworkServer::handleDataUplink(const SimTransmission& tx, float snr) {
+  // MHDR | DevAddr | FCtrl | FCnt | FOpts | [FPort | FRMPayload] | MIC
+  const uint8_t* msg = tx.data.data();
+  size_t len = tx.data.size();
+  if(len < 12) {
+    return;
+  }
+  auto addr = this->addresses.find((uint32_t)getLe(&msg[1], 4));
+  if(addr == this->addresses.end()) {
+    return;
+  }
+  Device& dev = this->devices[addr->second];
+  uint8_t fCtrl = msg[5];
+  uint8_t fOptsLen = fCtrl & 0x0F;
+  if(!dev.joined || (len < (size_t)(12 + fOptsLen))) {
+    return;
+  }
+
+  // devices behind a relay only listen in the RxR window, so only the forwarded copies of their uplinks are handled
+  if(dev.relayed && !this->relayDownlink) {
+    return;
+  }
+
+  // restore the upper 16 bits of the frame counter
+  uint32_t fCnt = (uint32_t)getLe(&msg[6], 2);
+  if(dev.fCntUpValid) {
+    fCnt |= dev.fCntUp & 0xFFFF0000UL;
+    if(fCnt < dev.fCntUp) {
+      fCnt += 0x10000UL;
+    }
+  }
+
+  uint8_t block[RADIOLIB_AES128_BLOCK_SIZE] = { 0 };
+  block[RADIOLIB_LORAWAN_BLOCK_MAGIC_POS] = RADIOLIB_LORAWAN_MIC_BLOCK_MAGIC;
+  block[RADIOLIB_LORAWAN_BLOCK_DIR_POS] = RADIOLIB_LORAWAN_UPLINK;
+  putLe(&block[RADIOLIB_LORAWAN_BLOCK_DEV_ADDR_POS], dev.devAddr, 4);
+  putLe(&block[RADIOLIB_LORAWAN_BLOCK_FCNT_POS], fCnt, 4);
+  block[RADIOLIB_AES128_BLOCK_SIZE - 1] = len - sizeof(uint32_t);
+  if(this->calculateMIC(dev.nwkSKey, block, sizeof(block), msg, len - sizeof(uint32_t)) != getLe(&msg[len - sizeof(uint32_t)], 4)) {
+    return;
+  }
+
+  bool confirmed = ((msg[0] & RADIOLIB_LORAWAN_MHDR_MTYPE_MASK) == RADIOLIB_LORAWAN_MHDR_MTYPE_CONF_DATA_UP);
+  dev.dr = sfToDr(tx.sf);
+
+  uint8_t fOptsDown[15];
+  size_t fOptsDownLen = 0;
+
+  // the same frame counter means this is a retransmission, the MAC commands were already answered
+  if(dev.fCntUpValid && (fCnt == dev.fCntUp)) {
+    dev.stats.numDuplicates++;
+    if(!dev.snrHistory.empty() && (dev.snrHistory.back().first == fCnt)) {
+      dev.snrHistory.back().second = RADIOLIB_MAX(dev.snrHistory.back().second, snr);
+    }
+
+    // for a confirmed uplink, this means the acknowledgement was lost
+    if(confirmed) {
+      this->sendDownlink(dev, tx, SIM_NS_RX1_DELAY_US, this->buildDownlink(dev, fCtrl, true, fOptsDown, 0));
+    }
+    return;
+  } else if(dev.fCntUpValid && (fCnt < dev.fCntUp)) {
+    return;
+  }
+  dev.fCntUpValid = true;
+  dev.fCntUp = fCnt;
+  dev.stats.numUplinks++;
+  dev.snrHistory.push_back({ fCnt, snr });
+  if(dev.snrHistory.size() > SIM_NS_ADR_HISTORY_LEN) {
+    dev.snrHistory.erase(dev.snrHistory.begin());
+  }
+
+  // MAC commands are either in FOpts, or in the payload on FPort 0
+  std::vector<uint8_t> mac(&msg[8], &msg[8 + fOptsLen]);
+  size_t payLen = len - 12 - fOptsLen;
+  if((payLen > 1) && (msg[8 + fOptsLen] == RADIOLIB_LORAWAN_FPORT_MAC_COMMAND)) {
+    mac.assign(&msg[9 + fOptsLen], &msg[len - sizeof(uint32_t)]);
+    this->cryptPayload(dev.nwkSKey, dev.devAddr, fCnt, RADIOLIB_LORAWAN_UPLINK, mac.data(), mac.size());
+  }
+
+  // an acknowledgement or ADRACKReq must be answered even without any MAC commands
+  bool reply = confirmed || (fCtrl & RADIOLIB_LORAWAN_FCTRL_ADR_ACK_REQ);
+
+  // uplinks of other devices forwarded by a relay, their downlinks are sent back through the relay
+  std::vector<uint8_t> relayed;
+  if((payLen > 1) && (msg[8 + fOptsLen] == RADIOLIB_LORAWAN_FPORT_TS011)) {
+    std::vector<uint8_t> forwarded(&msg[9 + fOptsLen], &msg[len - sizeof(uint32_t)]);
+    this->cryptPayload(dev.nwkSKey, dev.devAddr, fCnt, RADIOLIB_LORAWAN_UPLINK, forwarded.data(), forwarded.size());
+    this->handleRelayedUplink(dev, tx, forwarded, &relayed);
+    reply |= !relayed.empty();
+  }
+  for(size_t i = 0; i < mac.size();) {
+    uint8_t cid = mac[i++];
+    if((cid >= sizeof(macLenUp)) || (i + macLenUp[cid] > mac.size())) {
+      // the rest can not be parsed
+      break;
+    }
+    switch(cid) {
+      case(RADIOLIB_LORAWAN_MAC_LINK_CHECK): {
+        // margin above the demodulation floor, and the number of gateways
+        float margin = RADIOLIB_MAX(snr - simDemodFloor(tx.sf), 0.0f);
+        fOptsDown[fOptsDownLen++] = cid;
+        fOptsDown[fOptsDownLen++] = (uint8_t)RADIOLIB_MIN(margin, 254.0f);
+        fOptsDown[fOptsDownLen++] = 1;
+        reply = true;
+      } break;
+
+      case(RADIOLIB_LORAWAN_MAC_DEVICE_TIME): {
+        // network time at the end of the uplink, seconds and 1/256 fractions since GPS epoch
+        uint64_t t = (uint64_t)SIM_NS_GPS_EPOCH_OFFSET * 1000000ULL + tx.end;
+        fOptsDown[fOptsDownLen++] = cid;
+        putLe(&fOptsDown[fOptsDownLen], t / 1000000ULL, 4);
+        fOptsDown[fOptsDownLen + 4] = (uint8_t)(((t % 1000000ULL) * 256) / 1000000ULL);
+        fOptsDownLen += 5;
+        reply = true;
+      } break;
+
+      case(RADIOLIB_LORAWAN_MAC_LINK_ADR): {
+        // the change is only applied once the device accepted all of it
+        if(dev.adrPending && ((mac[i] & 0x07) == 0x07)) {
+          dev.dr = dev.adrDr;
+          dev.txSteps = dev.adrTxSteps;
+          dev.nbTrans = dev.adrNbTrans;
+          dev.snrHistory.clear();
+        }
+        dev.adrPending = false;
+      } break;
+
+      case(RADIOLIB_LORAWAN_MAC_RX_PARAM_SETUP):
+      case(RADIOLIB_LORAWAN_MAC_RX_TIMING_SETUP):
+      case(RADIOLIB_LORAWAN_MAC_DL_CHANNEL):
+        // these answers are repeated by the device until it receives any downlink
+        reply = true;
+        break;
+
+      default:
+        break;
+    }
+    i += macLenUp[cid];
+  }
+
+  if(this->adrEnabled && (fCtrl & RADIOLIB_LORAWAN_FCTRL_ADR_ENABLED) && !dev.adrPending) {
+    reply |= this->runAdr(dev, fOptsDown, &fOptsDownLen);
+  }
+
+  if(reply && relayed.empty()) {
+    this->sendDownlink(dev, tx, SIM_NS_RX1_DELAY_US, this->buildDownlink(dev, fCtrl, confirmed, fOptsDown, fOptsDownLen));
+  } else if(reply) {
+    this->sendDownlink(dev, tx, SIM_NS_RX1_DELAY_US, 
+                       this->buildDownlink(dev, fCtrl, confirmed, fOptsDown, fOptsDownLen, RADIOLIB_LORAWAN_FPORT_TS011, &relayed));
+  }
+}
+
+void SimNetworkServer::handleRelayedUplink(Device& relay, const SimTransmission& tx, std::vector<uint8_t>& payload, std::vector<uint8_t>* downlink) {
+  // UplinkMetadata | Frequency | PHYPayload of the end device, only data uplinks can be forwarded
+  if(payload.size() < RADIOLIB_LORAWAN_RELAY_METADATA_LEN + RADIOLIB_LORAWAN_RELAY_PHY_PAYLOAD_MIN_LEN) {
+    return;
+  }
+  uint8_t mType = payload[RADIOLIB_LORAWAN_RELAY_METADATA_LEN] & RADIOLIB_LORAWAN_MHDR_MTYPE_MASK;
+  if((mType != RADIOLIB_LORAWAN_MHDR_MTYPE_UNCONF_DATA_UP) && (mType != RADIOLIB_LORAWAN_MHDR_MTYPE_CONF_DATA_UP)) {
+    return;
+  }
+  relay.stats.numForwarded++;
+
+  // the uplink as the relay received it: datarate (bits 0-3) and SNR + 20 (bits 4-8) of the metadata, and its frequency
+  uint32_t metadata = (uint32_t)getLe(&payload[0], 3);
+  SimTransmission up = tx;
+  up.sf = 12 - (metadata & 0x0F);
+  up.freq = getLe(&payload[3], 3) / 10000.0;
+  up.data.assign(payload.begin() + RADIOLIB_LORAWAN_RELAY_METADATA_LEN, payload.end());
+  float snr = (float)((metadata >> 4) & 0x1F) - 20;
+
+  this->relayDownlink = downlink;
+  this->handleDataUplink(up, snr);
+  this->relayDownlink = NULL;
+}
+
+bool SimNetworkServer::runAdr(Device& dev, uint8_t* fOpts, size_t* fOptsLen) {
+  if(dev.snrHistory.size() < SIM_NS_ADR_HISTORY_LEN) {
+    return(false);
+  }
+
+  // each 3 dB of margin above the installation margin allows one step of higher datarate or lower Tx power
+  float snrMax = dev.snrHistory[0].second;
+  for(const auto& entry : dev.snrHistory) {
+    snrMax = RADIOLIB_MAX(snrMax, entry.second);
+  }
+  int nStep = (int)floorf((snrMax - simDemodFloor(12 - dev.dr) - SIM_NS_ADR_MARGIN_DB) / 3.0f);
+  uint8_t dr = dev.dr;
+  uint8_t txSteps = dev.txSteps;
+  while((nStep > 0) && (dr < SIM_NS_ADR_DR_MAX)) {
+    dr++;
+    nStep--;
+  }
+  while((nStep > 0) && (txSteps < SIM_NS_ADR_TX_POWER_STEPS_MAX)) {
+    txSteps++;
+    nStep--;
+  }
+  while((nStep < 0) && (txSteps > 0)) {
+    txSteps--;
+    nStep++;
+  }
+
+  // packet loss from the gaps in the frame counters
+  uint32_t expected = dev.snrHistory.back().first - dev.snrHistory.front().first + 1;
+  float loss = 100.0f * (1.0f - (float)dev.snrHistory.size() / expected);
+  size_t row = (loss < 5) ? 0 : ((loss < 10) ? 1 : ((loss < 30) ? 2 : 3));
+  uint8_t nbTrans = adrNbTrans[row][RADIOLIB_MIN(dev.nbTrans, 3) - 1];
+
+  if((dr == dev.dr) && (txSteps == dev.txSteps) && (nbTrans == dev.nbTrans)) {
+    return(false);
+  }
+
+  // LinkADRReq with the three default channels enabled
+  fOpts[(*fOptsLen)++] = RADIOLIB_LORAWAN_MAC_LINK_ADR;
+  fOpts[(*fOptsLen)++] = (dr << 4) | txSteps;
+  fOpts[(*fOptsLen)++] = 0x07;
+  fOpts[(*fOptsLen)++] = 0x00;
+  fOpts[(*fOptsLen)++] = nbTrans;
+  dev.adrPending = true;
+  dev.adrDr = dr;
+  dev.adrTxSteps = txSteps;
+  dev.adrNbTrans = nbTrans;
+  dev.stats.numLinkAdrReqs++;
+  return(true);
+}
+
+std::vector<uint8_t> SimNetworkServer::buildDownlink(Device& dev, uint8_t fCtrlUp, bool ack, const uint8_t* fOpts, size_t fOptsLen, 
+                                                     uint8_t fPort, const std::vector<uint8_t>* payload) {
+  // MHDR | DevAddr | FCtrl | FCnt | FOpts | [FPort | FRMPayload] | MIC, only network payloads are sent
+  std::vector<uint8_t> frame(12 + fOptsLen + (payload ? 1 + payload->size() : 0));
+  frame[0] = RADIOLIB_LORAWAN_MHDR_MTYPE_UNCONF_DATA_DOWN | RADIOLIB_LORAWAN_MHDR_MAJOR_R1;
+  putLe(&frame[1], dev.devAddr, 4);
+  frame[5] = (fCtrlUp & RADIOLIB_LORAWAN_FCTRL_ADR_ENABLED) | (ack ? RADIOLIB_LORAWAN_FCTRL_ACK : 0) | fOptsLen;
+  putLe(&frame[6], dev.fCntDown, 2);
+  memcpy(&frame[8], fOpts, fOptsLen);
+  if(payload) {
+    frame[8 + fOptsLen] = fPort;
+    memcpy(&frame[9 + fOptsLen], payload->data(), payload->size());
+    this->cryptPayload(dev.nwkSKey, dev.devAddr, dev.fCntDown, RADIOLIB_LORAWAN_DOWNLINK, &frame[9 + fOptsLen], payload->size());
+  }
+
+  uint8_t block[RADIOLIB_AES128_BLOCK_SIZE] = { 0 };
+  block[RADIOLIB_LORAWAN_BLOCK_MAGIC_POS] = RADIOLIB_LORAWAN_MIC_BLOCK_MAGIC;
+  block[RADIOLIB_LORAWAN_BLOCK_DIR_POS] = RADIOLIB_LORAWAN_DOWNLINK;
+  putLe(&block[RADIOLIB_LORAWAN_BLOCK_DEV_ADDR_POS], dev.devAddr, 4);
+  putLe(&block[RADIOLIB_LORAWAN_BLOCK_FCNT_POS], dev.fCntDown, 4);
+  block[RADIOLIB_AES128_BLOCK_SIZE - 1] = frame.size() - sizeof(uint32_t);
+  putLe(&frame[frame.size() - sizeof(uint32_t)], this->calculateMIC(dev.nwkSKey, block, sizeof(block), frame.data(), frame.size() - sizeof(uint32_t)), 4);
+
+  dev.fCntDown++;
+  return(frame);
+}
+
+void SimNetworkServer::sendDownlink(Device& dev, const SimTransmission& up, RadioLibTime_t delay, const std::vector<uint8_t>& frame) {
+  // downlinks of devices behind a relay are sent with the downlink to the relay
+  if(this->relayDownlink) {
+    *this->relayDownlink = frame;
+    dev.stats.numDownlinks++;
+    dev.stats.numRelayedDownlinks++;
+    return;
+  }
+
+  // Rx1 on the uplink channel and datarate, Rx2 one second later
+  if(this->gateway->scheduleDownlink(up.end + delay, up.freq, up.sf, up.bw, frame) ||
+     this->gateway->scheduleDownlink(up.end + delay + 1000000UL, SIM_NS_RX2_FREQ, SIM_NS_RX2_SF, 125.0, frame)) {
+    dev.stats.numDownlinks++;
+    return;
+  }
+  dev.stats.numDownlinksDropped++;
+}
+
+uint32_t SimNetworkServer::calculateMIC(uint8_t* key, const uint8_t* hdr, size_t hdrLen, const uint8_t* msg, size_t len) {
+  uint8_t cmac[RADIOLIB_AES128_BLOCK_SIZE];
+  this->aes.init(key);
+  this->aes.initCMAC();
+  if(hdr) {
+    this->aes.updateCMAC(hdr, hdrLen);
+  }
+  this->aes.updateCMAC(msg, len);
+  this->aes.finishCMAC(cmac);
+  return((uint32_t)getLe(cmac, 4));
+}
+
+void SimNetworkServer::cryptPayload(uint8_t* key, uint32_t devAddr, uint32_t fCnt, uint8_t dir, uint8_t* buff, size_t len) {
+  // XOR with the key stream of the A blocks, counting from 1
+  uint8_t block[RADIOLIB_AES128_BLOCK_SIZE] = { 0 };
+  uint8_t stream[RADIOLIB_AES128_BLOCK_SIZE];
+  block[RADIOLIB_LORAWAN_BLOCK_MAGIC_POS] = RADIOLIB_LORAWAN_ENC_BLOCK_MAGIC;
+  block[RADIOLIB_LORAWAN_BLOCK_DIR_POS] = dir;
+  putLe(&block[RADIOLIB_LORAWAN_BLOCK_DEV_ADDR_POS], devAddr, 4);
+  putLe(&block[RADIOLIB_LORAWAN_BLOCK_FCNT_POS], fCnt, 4);
+  this->aes.init(key);
+  for(size_t i = 0; i < len; i += RADIOLIB_AES128_BLOCK_SIZE) {
+    block[RADIOLIB_AES128_BLOCK_SIZE - 1] = (uint8_t)(i / RADIOLIB_AES128_BLOCK_SIZE + 1);
+    this->aes.encryptECB(block, RADIOLIB_AES128_BLOCK_SIZE, stream);
+    for(size_t j = 0; (j < RADIOLIB_AES128_BLOCK_SIZE) && (i + j < len); j++) {
+      buff[i + j] ^= stream[j];
+    }
+  }
+}
@@ -0,0 +1,154 @@
+#if !defined(_RADIOLIB_SIM_NETWORK_SERVER_H)
+#define _RADIOLIB_SIM_NETWORK_SERVER_H
+
+#include "SimRadio.h"
+
+#include <map>
+
+// network server parameters
+#define SIM_NS_NET_ID                                           (0x000013)
+#define SIM_NS_DEV_ADDR_PREFIX                                  (0x26000000UL)
+#define SIM_NS_RX1_DELAY_US                                     (1000000UL)
+#define SIM_NS_JOIN_ACCEPT_DELAY_US                             (5000000UL)
+#define SIM_NS_RX2_FREQ                                         (869.525)
+#define SIM_NS_RX2_SF                                           (12)
+
+// network-side ADR, the same algorithm as the Semtech/ChirpStack default
+#define SIM_NS_ADR_HISTORY_LEN                                  (20)
+#define SIM_NS_ADR_MARGIN_DB                                    (10)
+#define SIM_NS_ADR_DR_MAX                                       (5)
+#define SIM_NS_ADR_TX_POWER_STEPS_MAX                           (7)
+
+// offset between simulation time and GPS time, used for DeviceTimeAns
+#define SIM_NS_GPS_EPOCH_OFFSET                                 (1400000000UL)
+
+/*!
+  \struct SimDeviceStats_t
+  \brief Statistics of a single device, as seen by the network server.
+*/
+struct SimDeviceStats_t {
+  /*! \brief Number of JoinAccepts sent */
+  uint32_t numJoinAccepts;
+
+  /*! \brief Number of unique uplinks received */
+  uint32_t numUplinks;
+
+  /*! \brief Number of repeated uplinks received (retransmissions with the same frame counter) */
+  uint32_t numDuplicates;
+
+  /*! \brief Number of downlinks sent */
+  uint32_t numDownlinks;
+
+  /*! \brief Number of downlinks that could not be sent, because the gateway was busy in both Rx windows */
+  uint32_t numDownlinksDropped;
+
+  /*! \brief Number of LinkADRReq commands sent */
+  uint32_t numLinkAdrReqs;
+
+  /*! \brief Number of downlinks sent through a relay, included in numDownlinks */
+  uint32_t numRelayedDownlinks;
+
+  /*! \brief Number of uplinks of other devices forwarded by this device as a relay */
+  uint32_t numForwarded;
+};
+
+/*!
+  \class SimNetworkServer
+  \brief Minimal LoRaWAN 1.0.4 network and join server for the simulated network (EU868, OTAA, class A).
+  Answers JoinRequests, acknowledges confirmed uplinks, answers LinkCheckReq and DeviceTimeReq,
+  and optionally controls the datarate, Tx power and number of transmissions of devices with ADR.
+  Downlinks are sent in Rx1, or in Rx2 if the gateway is already busy during Rx1.
+  Uplinks forwarded by a relay on FPort 226 are handled as uplinks of the end device,
+  and its downlinks are sent to the relay on FPort 226, which sends them in the RxR window of the end device.
+*/
+class SimNetworkServer {
+  public:
+    SimNetworkServer(Simulator* sim, SimGateway* gateway);
+
+    /*! \brief Whether to control devices that have ADR enabled */
+    bool adrEnabled = true;
+
+    /*!
+      \brief Register a device for OTAA.
+      \param devEUI Device EUI.
+      \param joinEUI Join EUI.
+      \param appKey Application root key.
+    */
+    void addDevice(uint64_t devEUI, uint64_t joinEUI, const uint8_t* appKey);
+
+    /*!
+      \brief Get the statistics of a device.
+      \param devEUI Device EUI.
+      \returns Device statistics.
+    */
+    SimDeviceStats_t getStats(uint64_t devEUI) const;
+
+    /*!
+      \brief Set whether a device sends its uplinks through a relay. Its uplinks received directly by the gateway are ignored,
+      as it only listens for downlinks in the RxR window.
+      \param devEUI Device EUI.
+      \param relayed Whether the device uses a relay.
+    */
+    void setRelayed(uint64_t devEUI, bool relayed);
+
+    /*!
+      \brief Process an uplink received by the gateway.
+      \param tx The transmission.
+      \param rssi Received power in dBm.
+      \param snr Signal-to-noise ratio in dB.
+    */
+    void onUplink(const SimTransmission& tx, float rssi, float snr);
+
+  private:
+    struct Device {
+      uint64_t devEUI;
+      uint64_t joinEUI;
+      uint8_t appKey[RADIOLIB_AES128_KEY_SIZE];
+      SimDeviceStats_t stats;
+      bool relayed;
+
+      // session
+      bool joined;
+      uint16_t devNonce;
+      uint32_t joinNonce;
+      uint32_t devAddr;
+      uint8_t nwkSKey[RADIOLIB_AES128_KEY_SIZE];
+      uint8_t appSKey[RADIOLIB_AES128_KEY_SIZE];
+      bool fCntUpValid;
+      uint32_t fCntUp;
+      uint32_t fCntDown;
+
+      // ADR state, and the pending change that was not yet acknowledged by LinkADRAns
+      uint8_t dr;
+      uint8_t txSteps;
+      uint8_t nbTrans;
+      bool adrPending;
+      uint8_t adrDr;
+      uint8_t adrTxSteps;
+      uint8_t adrNbTrans;
+      std::vector<std::pair<uint32_t, float>> snrHistory;   // frame counter and best SNR of the latest uplinks
+    };
+
+    Simulator* sim;
+    SimGateway* gateway;
+    RadioLibAES128 aes;
+    std::map<uint64_t, Device> devices;
+    std::map<uint32_t, uint64_t> addresses;
+    uint32_t nextAddr = 1;
+
+    // while an uplink forwarded by a relay is handled, the downlink of the end device is saved here instead of sent
+    std::vector<uint8_t>* relayDownlink = NULL;
+
+    void handleJoinRequest(const SimTransmission& tx);
+    void handleDataUplink(const SimTransmission& tx, float snr);
+    void handleRelayedUplink(Device& relay, const SimTransmission& tx, std::vector<uint8_t>& payload, std::vector<uint8_t>* downlink);
+    bool runAdr(Device& dev, uint8_t* fOpts, size_t* fOptsLen);
+    std::vector<uint8_t> buildDownlink(Device& dev, uint8_t fCtrlUp, bool ack, const uint8_t* fOpts, size_t fOptsLen, 
+                                       uint8_t fPort = 0, const std::vector<uint8_t>* payload = NULL);
+    void sendDownlink(Device& dev, const SimTransmission& up, RadioLibTime_t delay, const std::vector<uint8_t>& frame);
+
+    uint32_t calculateMIC(uint8_t* key, const uint8_t* hdr, size_t hdrLen, const uint8_t* msg, size_t len);
+    void cryptPayload(uint8_t* key, uint32_t devAddr, uint32_t fCnt, uint8_t dir, uint8_t* buff, size_t len);
+};
+
+#endif
@@ -0,0 +1,545 @@
+#include "SimRadio.h"
+
+#include <math.h>
+#include <string.h>
+
+// how long ended transmissions are kept to check overlaps, must be longer than the longest packet
+#define SIM_HISTORY_US                                          (10000000UL)
+
+float simDemodFloor(uint8_t sf) {
+  // SF7 to SF12, 2.5 dB per step
+  return(-7.5 - 2.5*((float)sf - 7));
+}
+
+RadioLibTime_t simSymbolTime(uint8_t sf, float bw) {
+  return((RadioLibTime_t)(((uint32_t)1 << sf) * 1000.0 / bw));
+}
+
+RadioLibTime_t simTimeOnAir(uint8_t sf, float bw, uint8_t cr, size_t preambleLen, bool crc, size_t len) {
+  // as in the SX127x/SX126x datasheets, low datarate optimization is used for symbols longer than 16 ms
+  double tSym = ((uint32_t)1 << sf) * 1000.0 / bw;
+  int de = (tSym >= 16000.0) ? 1 : 0;
+  int num = 8*(int)len - 4*sf + 28 + (crc ? 16 : 0);
+  int den = 4*(sf - 2*de);
+  int nPayload = 8;
+  if(num > 0) {
+    nPayload += ((num + den - 1) / den) * cr;
+  }
+  return((RadioLibTime_t)((preambleLen + 4.25 + nPayload) * tSym));
+}
+
+static double distance(SimPosition a, SimPosition b) {
+  return(sqrt((a.x - b.x)*(a.x - b.x) + (a.y - b.y)*(a.y - b.y)));
+}
+
+// whether two different transmissions overlap in time, frequency, spreading factor and IQ polarity
+static bool interferes(const SimTransmission& tx, const SimTransmission& other) {
+  if((&other == &tx) || (other.start >= tx.end) || (other.end <= tx.start)) {
+    return(false);
+  }
+  return((fabs(other.freq - tx.freq) <= 0.001) && (other.sf == tx.sf) && (other.iqInverted == tx.iqInverted));
+}
+
+SimChannel::SimChannel(Simulator* sim, const SimChannelConfig_t& cfg, uint32_t seed) : sim(sim), cfg(cfg), rng(seed) {}
+
+void SimChannel::addListener(SimListener* listener) {
+  this->listeners.push_back(listener);
+}
+
+const SimTransmission& SimChannel::transmit(SimTransmission tx, RadioLibTime_t duration) {
+  tx.start = this->sim->now();
+  tx.end = tx.start + duration;
+  this->transmissions.push_back(std::move(tx));
+  auto it = std::prev(this->transmissions.end());
+  this->sim->schedule(it->end, [this, it]() { this->end(it); });
+
+  for(SimListener* listener : this->listeners) {
+    listener->onTransmissionStart(*it);
+  }
+  return(*it);
+}
+
+const std::list<SimTransmission>& SimChannel::getTransmissions() const {
+  return(this->transmissions);
+}
+
+float SimChannel::drawShadowing() {
+  std::normal_distribution<float> dist(0, this->cfg.shadowingSigma);
+  return(dist(this->rng));
+}
+
+float SimChannel::getPower(const SimTransmission& tx, SimPosition pos, float shadowing, float gain) const {
+  double d = RADIOLIB_MAX(distance(tx.pos, pos), 1.0);
+  double pathLoss = this->cfg.pathLossRef + 10.0*this->cfg.exponent*log10(d / this->cfg.distanceRef);
+  return(tx.power + gain - pathLoss - tx.shadowing - shadowing);
+}
+
+bool SimChannel::receive(const SimTransmission& tx, SimPosition pos, float shadowing, float gain, float noiseFigure, float* rssi, float* snr) {
+  std::normal_distribution<float> fading(0, this->cfg.fadingSigma);
+  float power = this->getPower(tx, pos, shadowing, gain) + fading(this->rng);
+  float noise = SIM_NOISE_DENSITY + 10.0*log10(tx.bw * 1000.0) + noiseFigure;
+  *rssi = power;
+  *snr = power - noise;
+  if(*snr < simDemodFloor(tx.sf)) {
+    return(false);
+  }
+
+  // check all other packets on the same frequency and spreading factor that overlap this one
+  for(const std::list<SimTransmission>* list : { &this->history, &this->transmissions }) {
+    for(const SimTransmission& other : *list) {
+      if(!interferes(tx, other)) {
+        continue;
+      }
+      if(power - this->getPower(other, pos, shadowing, gain) < SIM_CAPTURE_THRESHOLD_DB) {
+        return(false);
+      }
+    }
+  }
+  return(true);
+}
+
+bool SimChannel::collided(const SimTransmission& tx) const {
+  for(const std::list<SimTransmission>* list : { &this->history, &this->transmissions }) {
+    for(const SimTransmission& other : *list) {
+      if(interferes(tx, other)) {
+        return(true);
+      }
+    }
+  }
+  return(false);
+}
+
+void SimChannel::end(std::list<SimTransmission>::iterator it) {
+  // move to history first, so that the listeners can still find the overlapping packets
+  this->history.splice(this->history.end(), this->transmissions, it);
+  for(SimListener* listener : this->listeners) {
+    listener->onTransmissionEnd(*it);
+  }
+
+  // forget transmissions that can no longer overlap anything in progress
+  RadioLibTime_t now = this->sim->now();
+  while(!this->history.empty() && (this->history.front().end + SIM_HISTORY_US < now)) {
+    this->history.pop_front();
+  }
+}
+
+SimRadio::SimRadio(Module* mod, Simulator* sim, SimChannel* channel, SimPosition pos, uint32_t seed)
+  : PhysicalLayer(1, 255), pos(pos), mod(mod), sim(sim), channel(channel), rng(seed) {
+  this->shadowing = channel->drawShadowing();
+  for(size_t i = 0; i <= RADIOLIB_IRQ_TIMEOUT; i++) {
+    this->irqMap[i] = 1UL << i;
+  }
+}
+
+void SimRadio::setProcess(SimProcess* proc) {
+  this->proc = proc;
+}
+
+Module* SimRadio::getMod() {
+  return(this->mod);
+}
+
+int16_t SimRadio::sleep() {
+  return(this->standby());
+}
+
+int16_t SimRadio::standby() {
+  this->setState(State::Standby);
+  return(RADIOLIB_ERR_NONE);
+}
+
+int16_t SimRadio::standby(uint8_t mode) {
+  (void)mode;
+  return(this->standby());
+}
+
+int16_t SimRadio::transmit(const uint8_t* data, size_t len, uint8_t addr) {
+  int16_t state = this->startTransmit(data, len, addr);
+  RADIOLIB_ASSERT(state);
+
+  // the packet is done exactly after its time-on-air
+  this->sim->sleepUntil(this->sim->now() + this->getTimeOnAir(len));
+  return(this->finishTransmit());
+}
+
+int16_t SimRadio::startTransmit(const uint8_t* data, size_t len, uint8_t addr) {
+  (void)addr;
+  this->setState(State::Tx);
+  this->irqFlags = 0;
+
+  SimTransmission tx;
+  tx.src = this;
+  tx.pos = this->pos;
+  tx.shadowing = this->shadowing;
+  tx.power = this->power + this->gain;
+  tx.freq = this->freq;
+  tx.sf = this->sf;
+  tx.bw = this->bw;
+  tx.iqInverted = this->iqInverted;
+  tx.preambleLen = this->preambleLen;
+  tx.crc = this->crc;
+  tx.data.assign(data, data + len);
+  const SimTransmission& sent = this->channel->transmit(std::move(tx), this->getTimeOnAir(len));
+
+  // raise the Tx done interrupt at the end, unless the radio was reconfigured in the meantime
+  uint32_t gen = this->gen;
+  this->sim->schedule(sent.end, [this, gen]() {
+    if(gen != this->gen) {
+      return;
+    }
+    this->setState(State::Standby);
+    this->irqFlags |= this->irqMap[RADIOLIB_IRQ_TX_DONE];
+    this->sim->interrupt(this->proc, this->txAction);
+  });
+  return(RADIOLIB_ERR_NONE);
+}
+
+int16_t SimRadio::finishTransmit() {
+  this->irqFlags = 0;
+  return(this->standby());
+}
+
+int16_t SimRadio::startReceive() {
+  return(this->startReceive(0, RADIOLIB_IRQ_RX_DEFAULT_FLAGS, RADIOLIB_IRQ_RX_DEFAULT_MASK, 0));
+}
+
+int16_t SimRadio::startReceive(uint32_t timeout, RadioLibIrqFlags_t irqFlags, RadioLibIrqFlags_t irqMask, size_t len) {
+  (void)irqFlags;
+  (void)irqMask;
+  (void)len;
+  this->setState(State::Rx);
+  this->irqFlags = 0;
+  this->locked = false;
+  this->rxStart = this->sim->now();
+  this->rxTimeout = timeout;
+
+  // single reception with timeout, the receiver stops unless it detected a preamble by then
+  if(timeout) {
+    uint32_t gen = this->gen;
+    this->sim->schedule(this->rxStart + timeout, [this, gen]() {
+      if((gen != this->gen) || this->locked) {
+        return;
+      }
+      this->setState(State::Standby);
+      this->irqFlags |= this->irqMap[RADIOLIB_IRQ_TIMEOUT];
+    });
+  }
+
+  // packets that started just before the receiver was enabled can still be detected
+  for(const SimTransmission& tx : this->channel->getTransmissions()) {
+    this->tryLock(tx);
+  }
+  return(RADIOLIB_ERR_NONE);
+}
+
+// blocking reception has to be woken up by the Rx done interrupt, even if the owner did not set an action
+static void simRadioWake(void) {}
+
+int16_t SimRadio::receive(uint8_t* data, size_t len) {
+  // the single reception is extended as long as a packet is being received
+  void (*action)(void) = this->rxAction;
+  this->rxAction = simRadioWake;
+  int16_t state = this->startReceive(SIM_RX_TIMEOUT_SYMBOLS * simSymbolTime(this->sf, this->bw), 
+                                     RADIOLIB_IRQ_RX_DEFAULT_FLAGS, RADIOLIB_IRQ_RX_DEFAULT_MASK, 0);
+  uint32_t done = this->irqMap[RADIOLIB_IRQ_RX_DONE] | this->irqMap[RADIOLIB_IRQ_TIMEOUT];
+  while((state == RADIOLIB_ERR_NONE) && !(this->irqFlags & done)) {
+    RadioLibTime_t t = this->locked ? this->sim->now() + this->getTimeOnAir(255) : this->rxStart + this->rxTimeout;
+    this->sim->sleepUntil(t, true);
+  }
+  this->rxAction = action;
+  RADIOLIB_ASSERT(state);
+
+  if(this->irqFlags & this->irqMap[RADIOLIB_IRQ_TIMEOUT]) {
+    this->irqFlags = 0;
+    return(RADIOLIB_ERR_RX_TIMEOUT);
+  }
+  return(this->readData(data, len));
+}
+
+int16_t SimRadio::readData(uint8_t* data, size_t len) {
+  memcpy(data, this->rxData.data(), RADIOLIB_MIN(len, this->rxData.size()));
+  this->irqFlags = 0;
+  if(this->rxCrcError) {
+    return(RADIOLIB_ERR_CRC_MISMATCH);
+  }
+  return(RADIOLIB_ERR_NONE);
+}
+
+int16_t SimRadio::scanChannel() {
+  // LoRa activity in the configured channel is detected if it is strong enough and lasts for the whole detection
+  this->setState(State::Rx);
+  RadioLibTime_t tEnd = this->sim->now() + SIM_CAD_SYMBOLS * simSymbolTime(this->sf, this->bw);
+  bool detected = false;
+  float noise = SIM_NOISE_DENSITY + 10.0*log10(this->bw * 1000.0) + this->noiseFigure;
+  for(const SimTransmission& tx : this->channel->getTransmissions()) {
+    if((tx.src != this) && (fabs(tx.freq - this->freq) <= 0.001) && (tx.sf == this->sf) && (tx.bw == this->bw) && 
+       (tx.iqInverted == this->iqInverted) && (tx.end >= tEnd) &&
+       (this->channel->getPower(tx, this->pos, this->shadowing, this->gain) - noise >= simDemodFloor(tx.sf))) {
+      detected = true;
+      break;
+    }
+  }
+  this->sim->sleepUntil(tEnd);
+  this->setState(State::Standby);
+  return(detected ? RADIOLIB_PREAMBLE_DETECTED : RADIOLIB_CHANNEL_FREE);
+}
+
+int16_t SimRadio::setFrequency(float freq) {
+  this->freq = freq;
+  return(RADIOLIB_ERR_NONE);
+}
+
+int16_t SimRadio::invertIQ(bool enable) {
+  this->iqInverted = enable;
+  return(RADIOLIB_ERR_NONE);
+}
+
+int16_t SimRadio::setPayloadCRC(bool enable) {
+  this->crc = enable;
+  return(RADIOLIB_ERR_NONE);
+}
+
+int16_t SimRadio::setOutputPower(int8_t power) {
+  int16_t state = this->checkOutputPower(power, NULL);
+  RADIOLIB_ASSERT(state);
+  this->power = power;
+  return(RADIOLIB_ERR_NONE);
+}
+
+int16_t SimRadio::checkOutputPower(int8_t power, int8_t* clipped) {
+  // same range as SX126x with high-power PA
+  if(clipped) {
+    *clipped = RADIOLIB_MAX(-9, RADIOLIB_MIN(22, power));
+  }
+  RADIOLIB_CHECK_RANGE(power, -9, 22, RADIOLIB_ERR_INVALID_OUTPUT_POWER);
+  return(RADIOLIB_ERR_NONE);
+}
+
+int16_t SimRadio::setSyncWord(uint8_t* sync, size_t len) {
+  (void)sync;
+  (void)len;
+  return(RADIOLIB_ERR_NONE);
+}
+
+int16_t SimRadio::setPreambleLength(size_t len) {
+  this->preambleLen = len;
+  return(RADIOLIB_ERR_NONE);
+}
+
+int16_t SimRadio::setDataRate(DataRate_t dr) {
+  int16_t state = this->checkDataRate(dr);
+  RADIOLIB_ASSERT(state);
+  this->sf = dr.lora.spreadingFactor;
+  this->bw = dr.lora.bandwidth;
+  this->cr = dr.lora.codingRate;
+  return(RADIOLIB_ERR_NONE);
+}
+
+int16_t SimRadio::checkDataRate(DataRate_t dr) {
+  RADIOLIB_CHECK_RANGE(dr.lora.spreadingFactor, 7, 12, RADIOLIB_ERR_INVALID_SPREADING_FACTOR);
+  if((dr.lora.bandwidth != 125.0f) && (dr.lora.bandwidth != 250.0f) && (dr.lora.bandwidth != 500.0f)) {
+    return(RADIOLIB_ERR_INVALID_BANDWIDTH);
+  }
+  return(RADIOLIB_ERR_NONE);
+}
+
+size_t SimRadio::getPacketLength(bool update) {
+  (void)update;
+  return(this->rxData.size());
+}
+
+float SimRadio::getRSSI() {
+  return(this->rxRssi);
+}
+
+float SimRadio::getSNR() {
+  return(this->rxSnr);
+}
+
+RadioLibTime_t SimRadio::getTimeOnAir(size_t len) {
+  return(simTimeOnAir(this->sf, this->bw, this->cr, this->preambleLen, this->crc, len));
+}
+
+RadioLibTime_t SimRadio::calculateRxTimeout(RadioLibTime_t timeoutUs) {
+  // the timeout is passed to startReceive in microseconds
+  return(timeoutUs);
+}
+
+uint32_t SimRadio::getIrqFlags() {
+  return(this->irqFlags);
+}
+
+int16_t SimRadio::setIrqFlags(uint32_t irq) {
+  (void)irq;
+  return(RADIOLIB_ERR_NONE);
+}
+
+int16_t SimRadio::clearIrqFlags(uint32_t irq) {
+  this->irqFlags &= ~irq;
+  return(RADIOLIB_ERR_NONE);
+}
+
+uint8_t SimRadio::randomByte() {
+  return((uint8_t)this->rng());
+}
+
+void SimRadio::setPacketReceivedAction(void (*func)(void)) {
+  this->rxAction = func;
+}
+
+void SimRadio::clearPacketReceivedAction() {
+  this->rxAction = NULL;
+}
+
+void SimRadio::setPacketSentAction(void (*func)(void)) {
+  this->txAction = func;
+}
+
+void SimRadio::clearPacketSentAction() {
+  this->txAction = NULL;
+}
+
+int16_t SimRadio::setModem(ModemType_t modem) {
+  if(modem != ModemType_t::RADIOLIB_MODEM_LORA) {
+    return(RADIOLIB_ERR_WRONG_MODEM);
+  }
+  return(RADIOLIB_ERR_NONE);
+}
+
+int16_t SimRadio::getModem(ModemType_t* modem) {
+  *modem = ModemType_t::RADIOLIB_MODEM_LORA;
+  return(RADIOLIB_ERR_NONE);
+}
+
+void SimRadio::onTransmissionStart(const SimTransmission& tx) {
+  this->tryLock(tx);
+}
+
+void SimRadio::setState(State newState) {
+  // account the time spent in the previous state
+  RadioLibTime_t now = this->sim->now();
+  if(this->state == State::Tx) {
+    this->txTime += now - this->stateStart;
+  } else if(this->state == State::Rx) {
+    this->rxTime += now - this->stateStart;
+  }
+  this->state = newState;
+  this->stateStart = now;
+  this->gen++;
+}
+
+void SimRadio::tryLock(const SimTransmission& tx) {
+  if((this->state != State::Rx) || this->locked || (tx.src == this)) {
+    return;
+  }
+  if((fabs(tx.freq - this->freq) > 0.001) || (tx.sf != this->sf) || (tx.bw != this->bw) || (tx.iqInverted != this->iqInverted)) {
+    return;
+  }
+
+  // enough of the preamble must be left, and the receiver must stay on until it is detected
+  RadioLibTime_t now = this->sim->now();
+  RadioLibTime_t tSym = simSymbolTime(tx.sf, tx.bw);
+  size_t numDetect = RADIOLIB_MIN(tx.preambleLen, (size_t)SIM_PREAMBLE_DETECT_SYMBOLS);
+  if(tx.start + (tx.preambleLen - numDetect) * tSym < now) {
+    return;
+  }
+  if(this->rxTimeout && (this->rxStart + this->rxTimeout < tx.start + numDetect * tSym)) {
+    return;
+  }
+
+  // the preamble is only detected if the packet is strong enough, fading is left for the end of the packet
+  float noise = SIM_NOISE_DENSITY + 10.0*log10(tx.bw * 1000.0) + this->noiseFigure;
+  if(this->channel->getPower(tx, this->pos, this->shadowing, this->gain) - noise < simDemodFloor(tx.sf)) {
+    return;
+  }
+  this->locked = true;
+
+  // at the end of the packet, check whether it survived, a corrupted packet is still received
+  uint32_t gen = this->gen;
+  const SimTransmission* txPtr = &tx;
+  this->sim->schedule(tx.end, [this, gen, txPtr]() {
+    if(gen != this->gen) {
+      return;
+    }
+    bool ok = this->channel->receive(*txPtr, this->pos, this->shadowing, this->gain, this->noiseFigure, &this->rxRssi, &this->rxSnr);
+    this->rxData = txPtr->data;
+    if(!ok && !this->rxData.empty()) {
+      this->rxData[this->rxData.size() / 2] ^= 0xFF;
+    }
+    this->rxCrcError = !ok && txPtr->crc;
+
+    // in continuous mode, the receiver keeps listening for the next packet
+    if(this->rxTimeout) {
+      this->setState(State::Standby);
+    } else {
+      this->locked = false;
+    }
+    this->irqFlags |= this->irqMap[RADIOLIB_IRQ_RX_DONE];
+    this->sim->interrupt(this->proc, this->rxAction);
+  });
+}
+
+SimGateway::SimGateway(Simulator* sim, SimChannel* channel, SimPosition pos) : pos(pos), sim(sim), channel(channel) {}
+
+bool SimGateway::scheduleDownlink(RadioLibTime_t t, float freq, uint8_t sf, float bw, const std::vector<uint8_t>& data) {
+  // LoRaWAN downlinks have 8 preamble symbols, no payload CRC and coding rate 4/5
+  RadioLibTime_t toa = simTimeOnAir(sf, bw, 5, 8, false, data.size());
+  while(!this->busy.empty() && (this->busy.front().second + SIM_HISTORY_US < this->sim->now())) {
+    this->busy.pop_front();
+  }
+  for(const auto& slot : this->busy) {
+    if((t < slot.second) && (t + toa > slot.first)) {
+      return(false);
+    }
+  }
+  this->busy.push_back({ t, t + toa });
+
+  SimTransmission tx;
+  tx.src = this;
+  tx.pos = this->pos;
+  tx.shadowing = 0;
+  tx.power = this->txPower + this->gain;
+  tx.freq = freq;
+  tx.sf = sf;
+  tx.bw = bw;
+  tx.iqInverted = true;
+  tx.preambleLen = 8;
+  tx.crc = false;
+  tx.data = data;
+  this->sim->schedule(t, [this, tx, toa]() {
+    this->channel->transmit(tx, toa);
+    this->numDownlinks++;
+    this->txTime += toa;
+  });
+  return(true);
+}
+
+void SimGateway::onTransmissionEnd(const SimTransmission& tx) {
+  // only uplinks are received
+  if(tx.iqInverted || (tx.src == this)) {
+    return;
+  }
+
+  this->numUplinkTransmissions++;
+  if(this->channel->collided(tx)) {
+    this->numUplinksCollided++;
+  }
+
+  // the gateway can not receive while it is transmitting
+  for(const auto& slot : this->busy) {
+    if((tx.start < slot.second) && (tx.end > slot.first) && (slot.first <= this->sim->now())) {
+      this->numUplinksHalfDuplex++;
+      return;
+    }
+  }
+
+  float rssi = 0;
+  float snr = 0;
+  if(!this->channel->receive(tx, this->pos, 0, this->gain, this->noiseFigure, &rssi, &snr)) {
+    return;
+  }
+  this->numUplinks++;
+  if(this->onUplink) {
+    this->onUplink(tx, rssi, snr);
+  }
+}
@@ -0,0 +1,402 @@
+#if !defined(_RADIOLIB_SIM_RADIO_H)
+#define _RADIOLIB_SIM_RADIO_H
+
+#include "Simulator.h"
+
+#include <list>
+#include <random>
+
+// thermal noise density in dBm/Hz
+#define SIM_NOISE_DENSITY                                       (-174.0)
+
+// minimum number of preamble symbols a receiver needs to detect a LoRa packet
+#define SIM_PREAMBLE_DETECT_SYMBOLS                             (5)
+
+// a packet survives an overlapping packet with the same spreading factor if it is at least this much stronger
+#define SIM_CAPTURE_THRESHOLD_DB                                (6.0)
+
+// channel activity detection takes this many symbols, same as the SX126x default
+#define SIM_CAD_SYMBOLS                                         (2)
+
+// timeout of blocking reception in symbols, same as SX126x::receive
+#define SIM_RX_TIMEOUT_SYMBOLS                                  (100)
+
+/*!
+  \brief Get the lowest SNR at which a LoRa packet can still be demodulated (SX127x/SX126x datasheet values).
+  \param sf Spreading factor.
+  \returns SNR in dB.
+*/
+float simDemodFloor(uint8_t sf);
+
+/*!
+  \brief Get the duration of a LoRa symbol.
+  \param sf Spreading factor.
+  \param bw Bandwidth in kHz.
+  \returns Symbol duration in microseconds.
+*/
+RadioLibTime_t simSymbolTime(uint8_t sf, float bw);
+
+/*!
+  \brief Calculate the time-on-air of a LoRa packet with explicit header.
+  \param sf Spreading factor.
+  \param bw Bandwidth in kHz.
+  \param cr Coding rate denominator, 5 to 8.
+  \param preambleLen Number of preamble symbols.
+  \param crc Whether the payload CRC is enabled.
+  \param len Payload length in bytes.
+  \returns Time-on-air in microseconds.
+*/
+RadioLibTime_t simTimeOnAir(uint8_t sf, float bw, uint8_t cr, size_t preambleLen, bool crc, size_t len);
+
+/*!
+  \struct SimPosition
+  \brief Position in the simulated area, in meters.
+*/
+struct SimPosition {
+  double x;
+  double y;
+};
+
+/*!
+  \struct SimTransmission
+  \brief A single LoRa packet on the simulated channel.
+*/
+struct SimTransmission {
+  /*! \brief Transmitter, used to skip own transmissions */
+  const void* src;
+
+  /*! \brief Transmitter position */
+  SimPosition pos;
+
+  /*! \brief Shadowing of the transmitter location in dB, applied to all of its links */
+  float shadowing;
+
+  /*! \brief Effective radiated power in dBm */
+  float power;
+
+  /*! \brief Carrier frequency in MHz */
+  float freq;
+
+  /*! \brief Spreading factor */
+  uint8_t sf;
+
+  /*! \brief Bandwidth in kHz */
+  float bw;
+
+  /*! \brief Whether the packet was sent with inverted IQ (i.e. a LoRaWAN downlink) */
+  bool iqInverted;
+
+  /*! \brief Number of preamble symbols */
+  size_t preambleLen;
+
+  /*! \brief Whether the payload CRC is included, without it corrupted packets can not be detected by the receiver */
+  bool crc;
+
+  /*! \brief Start and end of the transmission in microseconds */
+  RadioLibTime_t start;
+  RadioLibTime_t end;
+
+  /*! \brief Packet payload */
+  std::vector<uint8_t> data;
+};
+
+/*!
+  \class SimListener
+  \brief Interface of everything that receives from the simulated channel.
+*/
+class SimListener {
+  public:
+    virtual ~SimListener() = default;
+
+    /*!
+      \brief Called when a transmission starts.
+      \param tx The transmission.
+    */
+    virtual void onTransmissionStart(const SimTransmission& tx) { (void)tx; }
+
+    /*!
+      \brief Called when a transmission ends.
+      \param tx The transmission.
+    */
+    virtual void onTransmissionEnd(const SimTransmission& tx) { (void)tx; }
+};
+
+/*!
+  \struct SimChannelConfig_t
+  \brief Propagation model of the simulated channel. The path loss follows the log-distance model,
+  the defaults correspond to the Okumura-Hata model for 868 MHz in a small city, with a gateway at 30 m.
+*/
+struct SimChannelConfig_t {
+  /*! \brief Path loss at the reference distance in dB */
+  double pathLossRef = 126.0;
+
+  /*! \brief Reference distance in m */
+  double distanceRef = 1000.0;
+
+  /*! \brief Path loss exponent */
+  double exponent = 3.52;
+
+  /*! \brief Standard deviation of the shadowing of a location in dB, the same for all packets from that location */
+  double shadowingSigma = 4.0;
+
+  /*! \brief Standard deviation of the fading of each packet in dB */
+  double fadingSigma = 2.0;
+};
+
+/*!
+  \class SimChannel
+  \brief Shared radio channel. Packets are lost when the SNR is below the demodulation floor,
+  or when they overlap with another packet with the same frequency, spreading factor and IQ polarity
+  that is not at least SIM_CAPTURE_THRESHOLD_DB weaker. Other spreading factors are considered orthogonal.
+*/
+class SimChannel {
+  public:
+    SimChannel(Simulator* sim, const SimChannelConfig_t& cfg, uint32_t seed);
+
+    /*!
+      \brief Add a listener, it will be notified about the start and end of all transmissions.
+      \param listener Listener to add.
+    */
+    void addListener(SimListener* listener);
+
+    /*!
+      \brief Start a transmission right now. All listeners are notified immediately, and again when it ends.
+      \param tx Transmission parameters, start and end times are set from the duration.
+      \param duration Time-on-air in microseconds.
+      \returns Reference to the transmission, valid until it ended.
+    */
+    const SimTransmission& transmit(SimTransmission tx, RadioLibTime_t duration);
+
+    /*!
+      \brief Get the transmissions that have not ended yet.
+      \returns List of transmissions.
+    */
+    const std::list<SimTransmission>& getTransmissions() const;
+
+    /*!
+      \brief Draw the shadowing of a new location.
+      \returns Shadowing in dB.
+    */
+    float drawShadowing();
+
+    /*!
+      \brief Calculate the received power of a transmission, without fading.
+      \param tx The transmission.
+      \param pos Receiver position.
+      \param shadowing Shadowing of the receiver location in dB.
+      \param gain Receiver antenna gain in dBi.
+      \returns Received power in dBm.
+    */
+    float getPower(const SimTransmission& tx, SimPosition pos, float shadowing, float gain) const;
+
+    /*!
+      \brief Check whether a transmission can be received, taking fading and all overlapping transmissions into account.
+      Overlapping transmissions are only known completely once the transmission has ended.
+      \param tx The transmission.
+      \param pos Receiver position.
+      \param shadowing Shadowing of the receiver location in dB.
+      \param gain Receiver antenna gain in dBi.
+      \param noiseFigure Receiver noise figure in dB.
+      \param rssi Received power in dBm.
+      \param snr Signal-to-noise ratio in dB.
+      \returns Whether the transmission can be demodulated.
+    */
+    bool receive(const SimTransmission& tx, SimPosition pos, float shadowing, float gain, float noiseFigure, float* rssi, float* snr);
+
+    /*!
+      \brief Check whether another transmission with the same frequency, spreading factor and IQ polarity
+      overlaps a transmission, regardless of whether either of them could still be received.
+      Overlapping transmissions are only known completely once the transmission has ended.
+      \param tx The transmission.
+      \returns Whether the transmission collided.
+    */
+    bool collided(const SimTransmission& tx) const;
+
+  private:
+    Simulator* sim;
+    SimChannelConfig_t cfg;
+    std::mt19937 rng;
+    std::vector<SimListener*> listeners;
+
+    // transmissions in progress, and those that ended recently - they may still have overlapped another one
+    std::list<SimTransmission> transmissions;
+    std::list<SimTransmission> history;
+
+    void end(std::list<SimTransmission>::iterator it);
+};
+
+/*!
+  \class SimRadio
+  \brief Emulated LoRa radio on the simulated channel. Implements the parts of PhysicalLayer used by LoRaWAN,
+  interrupts are delivered to the process that owns the radio.
+*/
+class SimRadio : public PhysicalLayer, public SimListener {
+  public:
+    SimRadio(Module* mod, Simulator* sim, SimChannel* channel, SimPosition pos, uint32_t seed);
+
+    /*!
+      \brief Set the process to which interrupts of this radio are delivered.
+      \param proc Owner process.
+    */
+    void setProcess(SimProcess* proc);
+
+    /*! \brief Position of the radio */
+    SimPosition pos;
+
+    /*! \brief Shadowing of the radio location in dB */
+    float shadowing;
+
+    /*! \brief Antenna gain in dBi */
+    float gain = 0;
+
+    /*! \brief Noise figure in dB */
+    float noiseFigure = 6;
+
+    /*! \brief Total time spent transmitting in microseconds */
+    RadioLibTime_t txTime = 0;
+
+    /*! \brief Total time spent receiving in microseconds */
+    RadioLibTime_t rxTime = 0;
+
+    Module* getMod() override;
+    int16_t sleep() override;
+    int16_t standby() override;
+    int16_t standby(uint8_t mode) override;
+    int16_t transmit(const uint8_t* data, size_t len, uint8_t addr = 0) override;
+    int16_t startTransmit(const uint8_t* data, size_t len, uint8_t addr = 0) override;
+    int16_t finishTransmit() override;
+    int16_t startReceive() override;
+    int16_t startReceive(uint32_t timeout, RadioLibIrqFlags_t irqFlags, RadioLibIrqFlags_t irqMask, size_t len) override;
+    int16_t receive(uint8_t* data, size_t len) override;
+    int16_t readData(uint8_t* data, size_t len) override;
+    int16_t scanChannel() override;
+    int16_t setFrequency(float freq) override;
+    int16_t invertIQ(bool enable) override;
+    int16_t setPayloadCRC(bool enable) override;
+    int16_t setOutputPower(int8_t power) override;
+    int16_t checkOutputPower(int8_t power, int8_t* clipped) override;
+    int16_t setSyncWord(uint8_t* sync, size_t len) override;
+    int16_t setPreambleLength(size_t len) override;
+    int16_t setDataRate(DataRate_t dr) override;
+    int16_t checkDataRate(DataRate_t dr) override;
+    size_t getPacketLength(bool update = true) override;
+    float getRSSI() override;
+    float getSNR() override;
+    RadioLibTime_t getTimeOnAir(size_t len) override;
+    RadioLibTime_t calculateRxTimeout(RadioLibTime_t timeoutUs) override;
+    uint32_t getIrqFlags() override;
+    int16_t setIrqFlags(uint32_t irq) override;
+    int16_t clearIrqFlags(uint32_t irq) override;
+    uint8_t randomByte() override;
+    void setPacketReceivedAction(void (*func)(void)) override;
+    void clearPacketReceivedAction() override;
+    void setPacketSentAction(void (*func)(void)) override;
+    void clearPacketSentAction() override;
+    int16_t setModem(ModemType_t modem) override;
+    int16_t getModem(ModemType_t* modem) override;
+
+    void onTransmissionStart(const SimTransmission& tx) override;
+
+  private:
+    enum class State { Standby, Tx, Rx };
+
+    Module* mod;
+    Simulator* sim;
+    SimChannel* channel;
+    SimProcess* proc = NULL;
+    std::mt19937 rng;
+
+    // radio configuration
+    float freq = 868.1;
+    uint8_t sf = 7;
+    float bw = 125.0;
+    uint8_t cr = 5;
+    bool iqInverted = false;
+    bool crc = true;
+    int8_t power = 14;
+    size_t preambleLen = 8;
+
+    State state = State::Standby;
+    RadioLibTime_t stateStart = 0;
+    uint32_t irqFlags = 0;
+    uint32_t gen = 0;             // incremented on every state change to cancel pending radio events
+    bool locked = false;          // whether the receiver detected a preamble
+    RadioLibTime_t rxStart = 0;
+    RadioLibTime_t rxTimeout = 0;
+    void (*rxAction)(void) = NULL;
+    void (*txAction)(void) = NULL;
+
+    // last received packet
+    std::vector<uint8_t> rxData;
+    bool rxCrcError = false;
+    float rxRssi = 0;
+    float rxSnr = 0;
+
+    void setState(State newState);
+    void tryLock(const SimTransmission& tx);
+};
+
+/*!
+  \class SimGateway
+  \brief Gateway of the simulated network, receives on all frequencies and spreading factors at once.
+  Half-duplex: uplinks that overlap a downlink of the gateway are lost.
+*/
+class SimGateway : public SimListener {
+  public:
+    SimGateway(Simulator* sim, SimChannel* channel, SimPosition pos);
+
+    /*! \brief Position of the gateway */
+    SimPosition pos;
+
+    /*! \brief Antenna gain in dBi */
+    float gain = 6;
+
+    /*! \brief Noise figure in dB */
+    float noiseFigure = 3;
+
+    /*! \brief Conducted Tx power in dBm */
+    float txPower = 27;
+
+    /*! \brief Called for every uplink that was received */
+    std::function<void(const SimTransmission& tx, float rssi, float snr)> onUplink;
+
+    /*!
+      \brief Schedule a downlink.
+      \param t Start of the transmission in microseconds.
+      \param freq Frequency in MHz.
+      \param sf Spreading factor.
+      \param bw Bandwidth in kHz.
+      \param data Packet to send.
+      \returns Whether the downlink was scheduled, false if the gateway is already busy at that time.
+    */
+    bool scheduleDownlink(RadioLibTime_t t, float freq, uint8_t sf, float bw, const std::vector<uint8_t>& data);
+
+    /*! \brief Number of uplinks received */
+    uint32_t numUplinks = 0;
+
+    /*! \brief Number of uplink transmissions, whether they were received or not */
+    uint32_t numUplinkTransmissions = 0;
+
+    /*! \brief Number of uplink transmissions that overlapped another one, see SimChannel::collided */
+    uint32_t numUplinksCollided = 0;
+
+    /*! \brief Number of uplinks lost because the gateway was transmitting */
+    uint32_t numUplinksHalfDuplex = 0;
+
+    /*! \brief Number of downlinks sent */
+    uint32_t numDownlinks = 0;
+
+    /*! \brief Total time spent transmitting in microseconds */
+    RadioLibTime_t txTime = 0;
+
+    void onTransmissionEnd(const SimTransmission& tx) override;
+
+  private:
+    Simulator* sim;
+    SimChannel* channel;
+
+    // start and end times of scheduled and past downlinks
+    std::list<std::pair<RadioLibTime_t, RadioLibTime_t>> busy;
+};
+
+#endif
@@ -0,0 +1,222 @@
+#include "Simulator.h"
+
+#include <string.h>
+
+// process running in the current thread
+static thread_local SimProcess* currentProc = NULL;
+
+Simulator::~Simulator() {
+  // processes that were never run to the end of the simulation still have to be stopped
+  this->stopping = true;
+  for(auto& proc : this->procs) {
+    if(!proc->finished) {
+      this->resume(proc.get());
+    }
+    if(proc->thread.joinable()) {
+      proc->thread.join();
+    }
+  }
+}
+
+RadioLibTime_t Simulator::now() const {
+  return(this->time);
+}
+
+void Simulator::schedule(RadioLibTime_t t, std::function<void()> fn) {
+  this->events.push({ RADIOLIB_MAX(t, this->time), this->seq++, NULL, 0, std::move(fn) });
+}
+
+SimProcess* Simulator::spawn(RadioLibTime_t t, std::function<void()> fn) {
+  this->procs.push_back(std::make_unique<SimProcess>());
+  SimProcess* proc = this->procs.back().get();
+  proc->thread = std::thread([this, proc, fn]() {
+    // wait for the first turn
+    {
+      std::unique_lock<std::mutex> lock(this->mtx);
+      proc->cv.wait(lock, [proc] { return(proc->turn); });
+    }
+
+    currentProc = proc;
+    if(!this->stopping) {
+      try {
+        fn();
+      } catch(const SimStop&) {
+        // the simulation ended while the process was waiting
+      }
+    }
+
+    // hand the control back for the last time
+    std::unique_lock<std::mutex> lock(this->mtx);
+    proc->finished = true;
+    proc->turn = false;
+    this->cv.notify_one();
+  });
+  this->wake(proc, t);
+  return(proc);
+}
+
+SimProcess* Simulator::current() {
+  return(currentProc);
+}
+
+void Simulator::interrupt(SimProcess* proc, void (*isr)(void)) {
+  if(!proc || proc->finished || !isr) {
+    return;
+  }
+
+  // the interrupt is handled the next time the process runs, which is right now
+  proc->pending.push_back(isr);
+  this->wake(proc, this->time);
+}
+
+void Simulator::sleepUntil(RadioLibTime_t t, bool wakeOnInterrupt) {
+  SimProcess* proc = currentProc;
+  if(!proc) {
+    return;
+  }
+
+  while(true) {
+    this->wake(proc, t);
+    this->park(proc);
+
+    // run the interrupt service routines that were delivered while the process was waiting
+    bool interrupted = !proc->pending.empty();
+    while(!proc->pending.empty()) {
+      void (*isr)(void) = proc->pending.front();
+      proc->pending.erase(proc->pending.begin());
+      isr();
+    }
+
+    if((this->time >= t) || (interrupted && wakeOnInterrupt)) {
+      return;
+    }
+  }
+}
+
+void Simulator::run(RadioLibTime_t duration) {
+  while(!this->events.empty()) {
+    if(this->events.top().t > duration) {
+      break;
+    }
+    Event ev = this->events.top();
+    this->events.pop();
+    this->time = ev.t;
+
+    if(!ev.proc) {
+      ev.fn();
+      continue;
+    }
+
+    // only the latest wake-up of a process is valid, the others were superseded by an interrupt or another sleep
+    if((ev.gen == ev.proc->gen) && !ev.proc->finished) {
+      this->resume(ev.proc);
+    }
+  }
+  this->time = duration;
+
+  // unwind all processes, so that their results can be collected safely
+  this->stopping = true;
+  for(auto& proc : this->procs) {
+    if(!proc->finished) {
+      this->resume(proc.get());
+    }
+    proc->thread.join();
+  }
+}
+
+void Simulator::wake(SimProcess* proc, RadioLibTime_t t) {
+  this->events.push({ RADIOLIB_MAX(t, this->time), this->seq++, proc, ++proc->gen, nullptr });
+}
+
+void Simulator::resume(SimProcess* proc) {
+  // pass the control to the process and wait until it is handed back
+  std::unique_lock<std::mutex> lock(this->mtx);
+  proc->turn = true;
+  proc->cv.notify_one();
+  this->cv.wait(lock, [proc] { return(!proc->turn); });
+}
+
+void Simulator::park(SimProcess* proc) {
+  // pass the control back to the simulator and wait for the next turn
+  std::unique_lock<std::mutex> lock(this->mtx);
+  proc->turn = false;
+  this->cv.notify_one();
+  proc->cv.wait(lock, [proc] { return(proc->turn); });
+  if(this->stopping) {
+    throw SimStop();
+  }
+}
+
+SimHal::SimHal(Simulator* sim, double drift) : RadioLibHal(0, 1, 0, 1, 2, 3), sim(sim), drift(drift) {}
+
+void SimHal::pinMode(uint32_t pin, uint32_t mode) {
+  (void)pin;
+  (void)mode;
+}
+
+void SimHal::digitalWrite(uint32_t pin, uint32_t value) {
+  (void)pin;
+  (void)value;
+}
+
+uint32_t SimHal::digitalRead(uint32_t pin) {
+  (void)pin;
+  return(0);
+}
+
+void SimHal::attachInterrupt(uint32_t num, void (*cb)(void), uint32_t mode) {
+  (void)num;
+  (void)cb;
+  (void)mode;
+}
+
+void SimHal::detachInterrupt(uint32_t num) {
+  (void)num;
+}
+
+void SimHal::delay(RadioLibTime_t ms) {
+  this->sim->sleepUntil(this->sim->now() + this->toVirtual(ms * 1000));
+}
+
+void SimHal::delayMicroseconds(RadioLibTime_t us) {
+  this->sim->sleepUntil(this->sim->now() + this->toVirtual(us));
+}
+
+RadioLibTime_t SimHal::millis() {
+  return(this->micros() / 1000);
+}
+
+RadioLibTime_t SimHal::micros() {
+  // the host clock is the virtual time, scaled by its error
+  return((RadioLibTime_t)((double)this->sim->now() * (1.0 + this->drift / 1e6)));
+}
+
+long SimHal::pulseIn(uint32_t pin, uint32_t state, RadioLibTime_t timeout) {
+  (void)pin;
+  (void)state;
+  (void)timeout;
+  return(0);
+}
+
+void SimHal::spiBegin() {}
+
+void SimHal::spiBeginTransaction() {}
+
+void SimHal::spiTransfer(uint8_t* out, size_t len, uint8_t* in) {
+  (void)out;
+  memset(in, 0x00, len);
+}
+
+void SimHal::spiEndTransaction() {}
+
+void SimHal::spiEnd() {}
+
+void SimHal::yield() {
+  // polling loops are resumed as soon as an interrupt arrives, or after a while to check their timeouts
+  this->sim->sleepUntil(this->sim->now() + SIM_YIELD_QUANTUM_US, true);
+}
+
+RadioLibTime_t SimHal::toVirtual(RadioLibTime_t us) const {
+  // duration measured by the host clock, converted to virtual time
+  return((RadioLibTime_t)((double)us / (1.0 + this->drift / 1e6)));
+}
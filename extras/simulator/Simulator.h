@@ -0,0 +1,160 @@
+#if !defined(_RADIOLIB_SIMULATOR_H)
+#define _RADIOLIB_SIMULATOR_H
+
+#include <RadioLib.h>
+
+#include <condition_variable>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <queue>
+#include <thread>
+#include <vector>
+
+// longest time a process waits in yield() before it is resumed, even if there was no interrupt
+#define SIM_YIELD_QUANTUM_US                                    (10000)
+
+// thrown in the threads of simulated processes to unwind them once the simulation ends
+struct SimStop {};
+
+/*!
+  \class SimProcess
+  \brief A simulated process, e.g. the firmware of a single end device. Each process runs in its own thread,
+  but only one thread runs at any time - processes hand the control back to the simulator whenever they wait.
+*/
+class SimProcess {
+  friend class Simulator;
+
+  private:
+    std::thread thread;
+    std::condition_variable cv;
+    bool turn = false;          // whether this process currently runs
+    bool finished = false;      // whether the process function returned
+    uint32_t gen = 0;           // generation of the latest wake-up, older wake-ups are ignored
+    std::vector<void (*)(void)> pending;  // interrupt service routines to run in this process
+};
+
+/*!
+  \class Simulator
+  \brief Deterministic discrete-event simulator with virtual time. Events are executed in the order of their time,
+  events scheduled for the same time are executed in the order they were scheduled.
+*/
+class Simulator {
+  public:
+    ~Simulator();
+
+    /*!
+      \brief Get the current virtual time.
+      \returns Time since the start of the simulation in microseconds.
+    */
+    RadioLibTime_t now() const;
+
+    /*!
+      \brief Schedule an event, it will be executed by the simulator itself (i.e. not in any of the processes).
+      \param t Time at which to execute the event, in microseconds.
+      \param fn Event to execute.
+    */
+    void schedule(RadioLibTime_t t, std::function<void()> fn);
+
+    /*!
+      \brief Start a new process.
+      \param t Time at which to start the process, in microseconds.
+      \param fn Process function.
+      \returns Pointer to the new process.
+    */
+    SimProcess* spawn(RadioLibTime_t t, std::function<void()> fn);
+
+    /*!
+      \brief Get the process that is currently running.
+      \returns Pointer to the process, or NULL when called from a simulator event.
+    */
+    static SimProcess* current();
+
+    /*!
+      \brief Deliver an interrupt to a process. The interrupt service routine runs in the thread of the process,
+      as soon as possible, even if the process is waiting.
+      \param proc Process to interrupt.
+      \param isr Interrupt service routine.
+    */
+    void interrupt(SimProcess* proc, void (*isr)(void));
+
+    /*!
+      \brief Suspend the current process until a given time. Must only be called from a process.
+      \param t Time at which to resume, in microseconds.
+      \param wakeOnInterrupt Whether to also resume early, after an interrupt service routine was run.
+    */
+    void sleepUntil(RadioLibTime_t t, bool wakeOnInterrupt = false);
+
+    /*!
+      \brief Run the simulation. Once finished, all processes are stopped.
+      \param duration Time until which to run the simulation, in microseconds.
+    */
+    void run(RadioLibTime_t duration);
+
+  private:
+    struct Event {
+      RadioLibTime_t t;
+      uint64_t seq;
+      SimProcess* proc;   // process to resume, or NULL for simulator events
+      uint32_t gen;
+      std::function<void()> fn;
+
+      bool operator>(const Event& e) const {
+        return((this->t > e.t) || ((this->t == e.t) && (this->seq > e.seq)));
+      }
+    };
+
+    std::priority_queue<Event, std::vector<Event>, std::greater<Event>> events;
+    std::vector<std::unique_ptr<SimProcess>> procs;
+    RadioLibTime_t time = 0;
+    uint64_t seq = 0;
+    bool stopping = false;
+
+    // all hand-overs between the threads are synchronized on this mutex
+    std::mutex mtx;
+    std::condition_variable cv;
+
+    void wake(SimProcess* proc, RadioLibTime_t t);
+    void resume(SimProcess* proc);
+    void park(SimProcess* proc);
+};
+
+/*!
+  \class SimHal
+  \brief Hardware abstraction layer of simulated end devices, all timing is based on the virtual time.
+  Waiting hands the control back to the simulator, so it must only be used from processes.
+*/
+class SimHal : public RadioLibHal {
+  public:
+    /*!
+      \brief Default constructor.
+      \param sim Simulator that provides the virtual time.
+      \param drift Error of the host clock in ppm, positive values make the host clock run fast.
+    */
+    explicit SimHal(Simulator* sim, double drift = 0);
+
+    void pinMode(uint32_t pin, uint32_t mode) override;
+    void digitalWrite(uint32_t pin, uint32_t value) override;
+    uint32_t digitalRead(uint32_t pin) override;
+    void attachInterrupt(uint32_t num, void (*cb)(void), uint32_t mode) override;
+    void detachInterrupt(uint32_t num) override;
+    void delay(RadioLibTime_t ms) override;
+    void delayMicroseconds(RadioLibTime_t us) override;
+    RadioLibTime_t millis() override;
+    RadioLibTime_t micros() override;
+    long pulseIn(uint32_t pin, uint32_t state, RadioLibTime_t timeout) override;
+    void spiBegin() override;
+    void spiBeginTransaction() override;
+    void spiTransfer(uint8_t* out, size_t len, uint8_t* in) override;
+    void spiEndTransaction() override;
+    void spiEnd() override;
+    void yield() override;
+
+  private:
+    Simulator* sim;
+    double drift;
+
+    RadioLibTime_t toVirtual(RadioLibTime_t us) const;
+};
+
+#endif
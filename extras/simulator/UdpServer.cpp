@@ -0,0 +1,247 @@
+#include "UdpServer.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+
+#include <arpa/inet.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <unistd.h>
+
+// length of the downlinks sent by the server, the requested timestamp followed by padding
+#define SIM_UDP_SERVER_DOWNLINK_LEN                             (12)
+
+static const char base64Table[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+
+// find value of a key in a JSON object, same as the packet forwarder does it
+static const char* jsonFind(const char* json, const char* key) {
+  size_t keyLen = strlen(key);
+  const char* ptr = json;
+  while((ptr = strchr(ptr, '"')) != NULL) {
+    ptr++;
+    if((strncmp(ptr, key, keyLen) == 0) && (ptr[keyLen] == '"') && (ptr[keyLen + 1] == ':')) {
+      return(&ptr[keyLen + 2]);
+    }
+  }
+  return(NULL);
+}
+
+static size_t base64Decode(const char* in, uint8_t* out, size_t maxLen) {
+  size_t len = 0;
+  uint32_t block = 0;
+  uint8_t numBits = 0;
+  for(; (*in != '\0') && (*in != '"') && (*in != '=') && (len < maxLen); in++) {
+    const char* sym = strchr(base64Table, *in);
+    if(!sym) {
+      return(0);
+    }
+    block = (block << 6) | (uint32_t)(sym - base64Table);
+    numBits += 6;
+    if(numBits >= 8) {
+      numBits -= 8;
+      out[len++] = (uint8_t)(block >> numBits);
+    }
+  }
+  return(len);
+}
+
+static std::string base64Encode(const uint8_t* in, size_t len) {
+  std::string out;
+  for(size_t i = 0; i < len; i += 3) {
+    uint32_t block = (uint32_t)in[i] << 16;
+    block |= (i + 1 < len) ? (uint32_t)in[i + 1] << 8 : 0;
+    block |= (i + 2 < len) ? (uint32_t)in[i + 2] : 0;
+    out += base64Table[(block >> 18) & 0x3F];
+    out += base64Table[(block >> 12) & 0x3F];
+    out += (i + 1 < len) ? base64Table[(block >> 6) & 0x3F] : '=';
+    out += (i + 2 < len) ? base64Table[block & 0x3F] : '=';
+  }
+  return(out);
+}
+
+// copy a JSON value up to the next delimiter
+static std::string jsonValue(const char* ptr) {
+  std::string val;
+  for(; *ptr && (*ptr != ',') && (*ptr != '}'); ptr++) {
+    val += *ptr;
+  }
+  return(val);
+}
+
+SimUdpServer::SimUdpServer(float downlinkRatio, uint32_t downlinkDelay) : downlinkRatio(downlinkRatio), downlinkDelay(downlinkDelay) {}
+
+SimUdpServer::~SimUdpServer() {
+  this->stop();
+}
+
+bool SimUdpServer::start() {
+  this->sock = socket(AF_INET, SOCK_DGRAM, 0);
+  if(this->sock < 0) {
+    return(false);
+  }
+
+  // bind to an ephemeral port on localhost only
+  struct sockaddr_in addr = {};
+  addr.sin_family = AF_INET;
+  addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+  addr.sin_port = 0;
+  socklen_t addrLen = sizeof(addr);
+  if((bind(this->sock, (struct sockaddr*)&addr, sizeof(addr)) < 0) ||
+     (getsockname(this->sock, (struct sockaddr*)&addr, &addrLen) < 0)) {
+    close(this->sock);
+    this->sock = -1;
+    return(false);
+  }
+  this->port = ntohs(addr.sin_port);
+
+  // wake up periodically to check whether the server should stop
+  struct timeval tv = { 0, SIM_UDP_SERVER_POLL_MS * 1000 };
+  setsockopt(this->sock, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+
+  this->running = true;
+  this->thread = std::thread([this]() { this->run(); });
+  return(true);
+}
+
+void SimUdpServer::stop() {
+  this->running = false;
+  if(this->thread.joinable()) {
+    this->thread.join();
+  }
+  if(this->sock >= 0) {
+    close(this->sock);
+    this->sock = -1;
+  }
+}
+
+uint16_t SimUdpServer::getPort() const {
+  return(this->port);
+}
+
+SimUdpServerStats_t SimUdpServer::getStats() {
+  std::lock_guard<std::mutex> lock(this->mtx);
+  return(this->stats);
+}
+
+uint32_t SimUdpServer::getNumRxpk(uint8_t rfch) {
+  std::lock_guard<std::mutex> lock(this->mtx);
+  return((rfch < this->rxpkPerRfch.size()) ? this->rxpkPerRfch[rfch] : 0);
+}
+
+void SimUdpServer::run() {
+  uint8_t buff[SIM_UDP_SERVER_BUFF_LEN + 1];
+  while(this->running) {
+    struct sockaddr_in addr = {};
+    socklen_t addrLen = sizeof(addr);
+    ssize_t len = recvfrom(this->sock, buff, SIM_UDP_SERVER_BUFF_LEN, 0, (struct sockaddr*)&addr, &addrLen);
+    if(len < 0) {
+      continue;
+    }
+
+    // version | token | identifier | gateway EUI
+    std::lock_guard<std::mutex> lock(this->mtx);
+    if((len < RADIOLIB_PACKET_FORWARDER_HEADER_LEN) || (buff[0] != RADIOLIB_PACKET_FORWARDER_PROTOCOL_VERSION)) {
+      this->stats.numInvalid++;
+      continue;
+    }
+    buff[len] = '\0';
+
+    switch(buff[3]) {
+      case(RADIOLIB_PACKET_FORWARDER_PUSH_DATA):
+        this->stats.numPushData++;
+        this->handlePushData(buff, len);
+        this->sendAck(&addr, buff, RADIOLIB_PACKET_FORWARDER_PUSH_ACK);
+        break;
+
+      case(RADIOLIB_PACKET_FORWARDER_PULL_DATA):
+        this->stats.numPullData++;
+        this->pullAddr = addr;
+        this->pullAddrValid = true;
+        this->sendAck(&addr, buff, RADIOLIB_PACKET_FORWARDER_PULL_ACK);
+        break;
+
+      case(RADIOLIB_PACKET_FORWARDER_TX_ACK): {
+        const char* error = jsonFind((const char*)&buff[RADIOLIB_PACKET_FORWARDER_HEADER_LEN + RADIOLIB_PACKET_FORWARDER_EUI_LEN], "error");
+        if(error && (strncmp(error, "\"NONE\"", 6) == 0)) {
+          this->stats.numTxAckOk++;
+        } else {
+          this->stats.numTxAckError++;
+        }
+      } break;
+
+      default:
+        this->stats.numInvalid++;
+        break;
+    }
+  }
+}
+
+void SimUdpServer::handlePushData(const uint8_t* data, size_t len) {
+  const char* json = (const char*)&data[RADIOLIB_PACKET_FORWARDER_HEADER_LEN + RADIOLIB_PACKET_FORWARDER_EUI_LEN];
+  if(len < RADIOLIB_PACKET_FORWARDER_HEADER_LEN + RADIOLIB_PACKET_FORWARDER_EUI_LEN) {
+    this->stats.numInvalid++;
+    return;
+  }
+
+  // rxpk objects are flat, so each one ends at the next closing brace
+  const char* rxpk = jsonFind(json, "rxpk");
+  if(!rxpk) {
+    return;
+  }
+  for(const char* obj = strchr(rxpk, '{'); obj; obj = strchr(obj, '{')) {
+    std::string pkt(obj, strcspn(obj, "}") + 1);
+    obj += pkt.size();
+    const char* rfch = jsonFind(pkt.c_str(), "rfch");
+    if(!jsonFind(pkt.c_str(), "tmst") || !rfch || !jsonFind(pkt.c_str(), "data")) {
+      this->stats.numInvalid++;
+      continue;
+    }
+    this->stats.numRxpk++;
+    size_t idx = strtoul(rfch, NULL, 10);
+    if(idx >= this->rxpkPerRfch.size()) {
+      this->rxpkPerRfch.resize(idx + 1);
+    }
+    this->rxpkPerRfch[idx]++;
+    this->sendDownlink(pkt.c_str());
+  }
+}
+
+void SimUdpServer::sendDownlink(const char* rxpk) {
+  // the payload is random, so its first byte decides whether this uplink gets a downlink
+  uint8_t payload[1];
+  if(!this->pullAddrValid || (base64Decode(&jsonFind(rxpk, "data")[1], payload, 1) != 1) ||
+     (payload[0] >= this->downlinkRatio * 256)) {
+    return;
+  }
+
+  // the downlink starts a fixed delay after the end of the uplink, in the same channel
+  uint32_t tmst = (uint32_t)strtoul(jsonFind(rxpk, "tmst"), NULL, 10) + this->downlinkDelay;
+  uint8_t dn[SIM_UDP_SERVER_DOWNLINK_LEN] = { 0 };
+  memcpy(dn, &tmst, sizeof(tmst));
+  std::string datr = jsonFind(rxpk, "datr") ? jsonValue(jsonFind(rxpk, "datr")) : "\"SF7BW125\"";
+  char json[SIM_UDP_SERVER_BUFF_LEN];
+  int jsonLen = snprintf(json, sizeof(json),
+    "{\"txpk\":{\"imme\":false,\"tmst\":%lu,\"freq\":%s,\"rfch\":%s,\"powe\":14,\"modu\":\"LORA\","
+    "\"datr\":%s,\"codr\":\"4/5\",\"ipol\":true,\"ncrc\":true,\"size\":%u,\"data\":\"%s\"}}",
+    (unsigned long)tmst, jsonValue(jsonFind(rxpk, "freq")).c_str(), jsonValue(jsonFind(rxpk, "rfch")).c_str(),
+    datr.c_str(), (unsigned int)sizeof(dn), base64Encode(dn, sizeof(dn)).c_str());
+
+  // PULL_RESP has no gateway EUI
+  uint8_t buff[SIM_UDP_SERVER_BUFF_LEN];
+  buff[0] = RADIOLIB_PACKET_FORWARDER_PROTOCOL_VERSION;
+  buff[1] = (uint8_t)(this->token >> 8);
+  buff[2] = (uint8_t)this->token;
+  buff[3] = RADIOLIB_PACKET_FORWARDER_PULL_RESP;
+  this->token++;
+  memcpy(&buff[RADIOLIB_PACKET_FORWARDER_HEADER_LEN], json, jsonLen);
+  sendto(this->sock, buff, RADIOLIB_PACKET_FORWARDER_HEADER_LEN + jsonLen, 0, (struct sockaddr*)&this->pullAddr, sizeof(this->pullAddr));
+  this->stats.numPullResp++;
+}
+
+void SimUdpServer::sendAck(const struct sockaddr_in* addr, const uint8_t* req, uint8_t id) {
+  // acknowledgements repeat the token of the request
+  uint8_t ack[RADIOLIB_PACKET_FORWARDER_HEADER_LEN] = { RADIOLIB_PACKET_FORWARDER_PROTOCOL_VERSION, req[1], req[2], id };
+  sendto(this->sock, ack, sizeof(ack), 0, (const struct sockaddr*)addr, sizeof(*addr));
+}
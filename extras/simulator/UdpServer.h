@@ -0,0 +1,118 @@
+#if !defined(_RADIOLIB_SIM_UDP_SERVER_H)
+#define _RADIOLIB_SIM_UDP_SERVER_H
+
+#include <RadioLib.h>
+
+#include <atomic>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include <netinet/in.h>
+
+// receive timeout of the server socket, the server checks whether it should stop this often
+#define SIM_UDP_SERVER_POLL_MS                                  (100)
+
+// maximum length of a datagram
+#define SIM_UDP_SERVER_BUFF_LEN                                 (2048)
+
+/*!
+  \struct SimUdpServerStats_t
+  \brief Statistics of the server stand-in.
+*/
+struct SimUdpServerStats_t {
+  /*! \brief Number of PUSH_DATA datagrams received */
+  uint32_t numPushData;
+
+  /*! \brief Number of rxpk objects received */
+  uint32_t numRxpk;
+
+  /*! \brief Number of PULL_DATA datagrams received */
+  uint32_t numPullData;
+
+  /*! \brief Number of PULL_RESP datagrams sent */
+  uint32_t numPullResp;
+
+  /*! \brief Number of TX_ACK datagrams without an error */
+  uint32_t numTxAckOk;
+
+  /*! \brief Number of TX_ACK datagrams reporting an error (e.g. TOO_LATE) */
+  uint32_t numTxAckError;
+
+  /*! \brief Number of malformed datagrams */
+  uint32_t numInvalid;
+};
+
+/*!
+  \class SimUdpServer
+  \brief Stand-in for a network server speaking the Semtech UDP protocol, listening on localhost.
+  Acknowledges PUSH_DATA and PULL_DATA, counts received packets per RF chain, and answers a configurable
+  fraction of the uplinks with a downlink (PULL_RESP) in the same channel, one second after the uplink.
+  The first 4 bytes of each downlink carry the requested timestamp, so that the actual transmission
+  time can be checked on the channel. The PULL_RESP is always sent before the PUSH_ACK of the uplink.
+*/
+class SimUdpServer {
+  public:
+    /*!
+      \brief Default constructor.
+      \param downlinkRatio Fraction of uplinks that are answered with a downlink, 0 to 1.
+      \param downlinkDelay Delay between the end of the uplink and the downlink in microseconds.
+    */
+    SimUdpServer(float downlinkRatio = 0, uint32_t downlinkDelay = 1000000UL);
+
+    ~SimUdpServer();
+
+    /*!
+      \brief Open the socket on an ephemeral localhost port and start the server thread.
+      \returns Whether the server was started.
+    */
+    bool start();
+
+    /*!
+      \brief Stop the server thread and close the socket.
+    */
+    void stop();
+
+    /*!
+      \brief Get the port the server is listening on.
+      \returns UDP port number.
+    */
+    uint16_t getPort() const;
+
+    /*!
+      \brief Get the server statistics.
+      \returns Statistics.
+    */
+    SimUdpServerStats_t getStats();
+
+    /*!
+      \brief Get the number of packets received on an RF chain.
+      \param rfch RF chain index.
+      \returns Number of packets.
+    */
+    uint32_t getNumRxpk(uint8_t rfch);
+
+  private:
+    float downlinkRatio;
+    uint32_t downlinkDelay;
+    int sock = -1;
+    uint16_t port = 0;
+    std::thread thread;
+    std::atomic<bool> running { false };
+
+    // address to send downlinks to, learned from PULL_DATA
+    struct sockaddr_in pullAddr = {};
+    bool pullAddrValid = false;
+
+    std::mutex mtx;
+    SimUdpServerStats_t stats = {};
+    std::vector<uint32_t> rxpkPerRfch;
+    uint16_t token = 0;
+
+    void run();
+    void handlePushData(const uint8_t* data, size_t len);
+    void sendDownlink(const char* rxpk);
+    void sendAck(const struct sockaddr_in* addr, const uint8_t* req, uint8_t id);
+};
+
+#endif
@@ -0,0 +1,317 @@
+// this is a host benchmark of the packet forwarder, running an unmodified PacketForwarder with up to four
+// emulated radios, each listening on its own channel, connected to a Semtech UDP server stand-in on localhost
+// devices send uplinks as a Poisson process on every channel, the server answers some of them with a downlink
+// the forwarder runs in virtual time, so that the timestamps and downlink timing are exact, while the UDP
+// round trips are real and measured in wall-clock time; one CSV row is printed for each number of radios
+
+#include <RadioLib.h>
+
+#include "Simulator.h"
+#include "SimRadio.h"
+#include "UdpServer.h"
+
+#include <chrono>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+
+#include <arpa/inet.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <unistd.h>
+
+#define SIM_FWD_GATEWAY_EUI                                     (0xAA555A0000000000ULL)
+
+// channels of the forwarder radios, one per radio
+static const float channels[RADIOLIB_PACKET_FORWARDER_MAX_RADIOS] = { 868.1, 868.3, 868.5, 867.1 };
+
+// the forwarder polls the server for downlinks this often, in seconds
+#define SIM_FWD_PULL_PERIOD                                     (10)
+
+// how long the gateway waits for an acknowledgement from the server, in milliseconds
+#define SIM_FWD_ACK_TIMEOUT_MS                                  (1000)
+
+struct SimFwdConfig_t {
+  size_t minRadios = 1;
+  size_t maxRadios = RADIOLIB_PACKET_FORWARDER_MAX_RADIOS;
+  double rate = 1.0;
+  double radius = 1000;
+  uint8_t sf = 7;
+  float downlinkRatio = 0.1;
+  RadioLibTime_t poll = 1000;
+  RadioLibTime_t duration = 300;
+  uint32_t seed = 1;
+};
+
+// downlink timing, measured on the channel against the timestamp requested by the server
+struct SimFwdTiming : public SimListener {
+  uint32_t numDownlinks = 0;
+  int32_t errMax = 0;
+  int64_t errSum = 0;
+
+  void onTransmissionStart(const SimTransmission& tx) override {
+    if(!tx.iqInverted || (tx.data.size() < sizeof(uint32_t))) {
+      return;
+    }
+    uint32_t requested;
+    memcpy(&requested, tx.data.data(), sizeof(requested));
+    int32_t err = (int32_t)((uint32_t)tx.start - requested);
+    this->numDownlinks++;
+    this->errSum += err;
+    if(abs(err) > abs(this->errMax)) {
+      this->errMax = err;
+    }
+  }
+};
+
+// the send callback of the forwarder takes no context, so the gateway socket is global
+static int gwSock = -1;
+static uint32_t gwPendingAcks = 0;
+static uint32_t gwAckTimeouts = 0;
+static uint32_t gwDatagrams = 0;
+
+static void gwSend(const uint8_t* data, size_t len) {
+  if((data[3] == RADIOLIB_PACKET_FORWARDER_PUSH_DATA) || (data[3] == RADIOLIB_PACKET_FORWARDER_PULL_DATA)) {
+    gwPendingAcks++;
+  }
+  if(send(gwSock, data, len, 0) == (ssize_t)len) {
+    gwDatagrams++;
+  }
+}
+
+// pass everything the server sent to the forwarder, until all requests were acknowledged
+static void gwDrain(PacketForwarder* fwd) {
+  uint8_t buff[SIM_UDP_SERVER_BUFF_LEN];
+  while(gwPendingAcks > 0) {
+    ssize_t len = recv(gwSock, buff, sizeof(buff), 0);
+    if(len < 0) {
+      gwAckTimeouts += gwPendingAcks;
+      gwPendingAcks = 0;
+      return;
+    }
+    gwDatagrams++;
+    if((len >= RADIOLIB_PACKET_FORWARDER_HEADER_LEN) &&
+       ((buff[3] == RADIOLIB_PACKET_FORWARDER_PUSH_ACK) || (buff[3] == RADIOLIB_PACKET_FORWARDER_PULL_ACK))) {
+      gwPendingAcks--;
+    }
+    fwd->handleDatagram(buff, len);
+  }
+}
+
+static bool gwConnect(uint16_t port) {
+  gwSock = socket(AF_INET, SOCK_DGRAM, 0);
+  if(gwSock < 0) {
+    return(false);
+  }
+  struct sockaddr_in addr = {};
+  addr.sin_family = AF_INET;
+  addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+  addr.sin_port = htons(port);
+  struct timeval tv = { SIM_FWD_ACK_TIMEOUT_MS / 1000, (SIM_FWD_ACK_TIMEOUT_MS % 1000) * 1000 };
+  setsockopt(gwSock, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+  if(connect(gwSock, (struct sockaddr*)&addr, sizeof(addr)) < 0) {
+    close(gwSock);
+    gwSock = -1;
+    return(false);
+  }
+  gwPendingAcks = 0;
+  gwAckTimeouts = 0;
+  gwDatagrams = 0;
+  return(true);
+}
+
+static void usage(const char* name) {
+  fprintf(stderr, "Usage: %s [options]\n", name);
+  fprintf(stderr, "  --radios N       number of forwarder radios, or 0 to run 1 to %d (default 0)\n", RADIOLIB_PACKET_FORWARDER_MAX_RADIOS);
+  fprintf(stderr, "  --rate R         mean uplink rate per channel in packets per second (default 1)\n");
+  fprintf(stderr, "  --radius M       devices are placed uniformly in a disc of this radius in meters (default 1000)\n");
+  fprintf(stderr, "  --sf N           spreading factor of all channels (default 7)\n");
+  fprintf(stderr, "  --downlinks F    fraction of uplinks answered with a downlink by the server (default 0.1)\n");
+  fprintf(stderr, "  --poll US        forwarder polling period in microseconds (default 1000)\n");
+  fprintf(stderr, "  --duration S     simulated time in seconds, at most 4000 (default 300)\n");
+  fprintf(stderr, "  --seed N         random seed (default 1)\n");
+}
+
+static bool parseArgs(int argc, char** argv, SimFwdConfig_t* cfg) {
+  for(int i = 1; i < argc; i++) {
+    std::string arg = argv[i];
+
+    // all options have a value
+    if(i + 1 >= argc) {
+      return(false);
+    }
+    const char* val = argv[++i];
+    if(arg == "--radios") {
+      size_t num = strtoul(val, NULL, 0);
+      cfg->minRadios = num ? num : 1;
+      cfg->maxRadios = num ? num : RADIOLIB_PACKET_FORWARDER_MAX_RADIOS;
+    } else if(arg == "--rate") {
+      cfg->rate = strtod(val, NULL);
+    } else if(arg == "--radius") {
+      cfg->radius = strtod(val, NULL);
+    } else if(arg == "--sf") {
+      cfg->sf = strtoul(val, NULL, 0);
+    } else if(arg == "--downlinks") {
+      cfg->downlinkRatio = strtof(val, NULL);
+    } else if(arg == "--poll") {
+      cfg->poll = strtoull(val, NULL, 0);
+    } else if(arg == "--duration") {
+      cfg->duration = strtoull(val, NULL, 0);
+    } else if(arg == "--seed") {
+      cfg->seed = strtoul(val, NULL, 0);
+    } else {
+      return(false);
+    }
+  }
+
+  // timestamps are 32-bit microseconds and wrap after about 71 minutes
+  return((cfg->maxRadios <= RADIOLIB_PACKET_FORWARDER_MAX_RADIOS) && (cfg->rate > 0) && (cfg->poll > 0) &&
+         (cfg->duration > 0) && (cfg->duration <= 4000) && (cfg->sf >= 7) && (cfg->sf <= 12));
+}
+
+// forwarder firmware: poll the radios and the server, and keep the downlink path open
+static void runForwarder(Simulator* sim, PacketForwarder* fwd, const SimFwdConfig_t* cfg) {
+  RadioLibTime_t nextPull = 0;
+  while(true) {
+    if(sim->now() >= nextPull) {
+      fwd->pullData();
+      nextPull = sim->now() + SIM_FWD_PULL_PERIOD * 1000000ULL;
+    }
+    fwd->update();
+    gwDrain(fwd);
+
+    // received packets wake the forwarder up right away, downlinks that are due are only started on the next poll
+    sim->sleepUntil(sim->now() + cfg->poll, true);
+  }
+}
+
+// uplinks of a channel, the devices have no process of their own and just transmit at random times
+static void scheduleUplink(Simulator* sim, SimChannel* channel, const SimFwdConfig_t* cfg, float freq, std::mt19937* rng, uint32_t* numOffered) {
+  std::exponential_distribution<double> interval(cfg->rate);
+  RadioLibTime_t t = sim->now() + (RadioLibTime_t)(interval(*rng) * 1e6);
+  sim->schedule(t, [sim, channel, cfg, freq, rng, numOffered]() {
+    std::uniform_real_distribution<double> uniform(0, 1);
+    std::uniform_int_distribution<int> byte(0, 255);
+    std::uniform_int_distribution<size_t> length(12, 51);
+    SimTransmission tx;
+    tx.src = NULL;
+    double distance = cfg->radius * sqrt(uniform(*rng));
+    double angle = 2 * M_PI * uniform(*rng);
+    tx.pos = { distance * cos(angle), distance * sin(angle) };
+    tx.shadowing = channel->drawShadowing();
+    tx.power = 14;
+    tx.freq = freq;
+    tx.sf = cfg->sf;
+    tx.bw = 125.0;
+    tx.iqInverted = false;
+    tx.preambleLen = RADIOLIB_PACKET_FORWARDER_PREAMBLE_LEN;
+    tx.crc = true;
+    tx.data.resize(length(*rng));
+    for(uint8_t& b : tx.data) {
+      b = (uint8_t)byte(*rng);
+    }
+    RadioLibTime_t toa = simTimeOnAir(tx.sf, tx.bw, 5, tx.preambleLen, tx.crc, tx.data.size());
+    channel->transmit(std::move(tx), toa);
+    (*numOffered)++;
+    scheduleUplink(sim, channel, cfg, freq, rng, numOffered);
+  });
+}
+
+// run the benchmark with a number of radios
+static bool benchmark(const SimFwdConfig_t& cfg, size_t numRadios) {
+  SimUdpServer server(cfg.downlinkRatio);
+  if(!server.start() || !gwConnect(server.getPort())) {
+    fprintf(stderr, "Failed to open the UDP sockets\n");
+    return(false);
+  }
+
+  Simulator sim;
+  SimChannelConfig_t channelCfg;
+  SimChannel channel(&sim, channelCfg, cfg.seed);
+  SimFwdTiming timing;
+  channel.addListener(&timing);
+
+  // all radios of the gateway share one host clock, and the location of its antenna
+  SimHal hal(&sim);
+  std::vector<std::unique_ptr<Module>> mods;
+  std::vector<std::unique_ptr<SimRadio>> radios;
+  PacketForwarder fwd(SIM_FWD_GATEWAY_EUI, gwSend);
+  for(size_t i = 0; i < numRadios; i++) {
+    mods.push_back(std::make_unique<Module>(&hal, RADIOLIB_NC, RADIOLIB_NC, RADIOLIB_NC));
+    radios.push_back(std::make_unique<SimRadio>(mods.back().get(), &sim, &channel, SimPosition{ 0, 0 }, cfg.seed + i + 1));
+    SimRadio* radio = radios.back().get();
+    radio->gain = 6;
+    radio->noiseFigure = 3;
+    radio->shadowing = 0;
+    channel.addListener(radio);
+  }
+
+  // the forwarder has to be set up from its own process, that is where the interrupts are delivered
+  SimProcess* proc = sim.spawn(0, [&sim, &fwd, &radios, &cfg]() {
+    for(size_t i = 0; i < radios.size(); i++) {
+      if(fwd.addRadio(radios[i].get(), channels[i], cfg.sf, 125.0) != RADIOLIB_ERR_NONE) {
+        return;
+      }
+    }
+    runForwarder(&sim, &fwd, &cfg);
+  });
+  for(auto& radio : radios) {
+    radio->setProcess(proc);
+  }
+
+  std::vector<std::mt19937> rngs;
+  for(size_t i = 0; i < numRadios; i++) {
+    rngs.emplace_back(cfg.seed * RADIOLIB_PACKET_FORWARDER_MAX_RADIOS + i);
+  }
+  std::vector<uint32_t> offered(numRadios, 0);
+  for(size_t i = 0; i < numRadios; i++) {
+    scheduleUplink(&sim, &channel, &cfg, channels[i], &rngs[i], &offered[i]);
+  }
+
+  auto start = std::chrono::steady_clock::now();
+  sim.run(cfg.duration * 1000000ULL);
+  auto wall = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start).count();
+
+  // one more request, once it is acknowledged the server has processed everything sent before it
+  fwd.pullData();
+  gwDrain(&fwd);
+  close(gwSock);
+  gwSock = -1;
+  server.stop();
+
+  PacketForwarderStats_t stats = fwd.getStats();
+  SimUdpServerStats_t srvStats = server.getStats();
+  uint32_t totalOffered = 0;
+  for(size_t i = 0; i < numRadios; i++) {
+    totalOffered += offered[i];
+    fprintf(stderr, "[%zu radios] RF chain %zu: %u offered, %u received by server\n", numRadios, i, offered[i], server.getNumRxpk(i));
+  }
+  fprintf(stderr, "[%zu radios] %u datagrams, %u acknowledgements timed out, %u TX_ACK errors\n",
+    numRadios, gwDatagrams, gwAckTimeouts, srvStats.numTxAckError);
+
+  printf("%zu,%u,%u,%u,%.2f,%u,%u,%u,%u,%u,%u,%lu,%u,%d,%.1f,%.1f,%.0f\n",
+    numRadios, totalOffered, stats.rxOk, srvStats.numRxpk, (double)srvStats.numRxpk / cfg.duration, stats.rxBad, stats.ackUp,
+    srvStats.numPullResp, stats.dnTx, stats.dnRejected, srvStats.numTxAckOk, (unsigned long)stats.dnLateMax,
+    timing.numDownlinks, timing.errMax, timing.numDownlinks ? (double)timing.errSum / timing.numDownlinks : 0,
+    wall / 1e3, wall ? gwDatagrams * 1e6 / wall : 0);
+  return(true);
+}
+
+int main(int argc, char** argv) {
+  SimFwdConfig_t cfg;
+  if(!parseArgs(argc, argv, &cfg)) {
+    usage(argv[0]);
+    return(1);
+  }
+
+  printf("radios,offered,forwarded,server_rxpk,server_rxpk_per_s,rx_bad,push_acks,downlinks_requested,downlinks_sent,"
+         "downlinks_rejected,tx_ack_ok,dn_late_max_us,downlinks_on_air,dn_err_max_us,dn_err_mean_us,wall_ms,datagrams_per_wall_s\n");
+  for(size_t num = cfg.minRadios; num <= cfg.maxRadios; num++) {
+    if(!benchmark(cfg, num)) {
+      return(1);
+    }
+  }
+  return(0);
+}
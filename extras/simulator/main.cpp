@@ -0,0 +1,466 @@
+// this is a host simulator of a LoRaWAN network, running unmodified LoRaWANNode instances on emulated radios
+// all nodes share one channel model with path loss, shadowing, fading and collisions, and are served by a single
+// gateway and a minimal network server; the simulation runs in virtual time, so a day of traffic takes seconds
+// per-node results are printed as CSV, totals of the gateway and network server are printed to stderr
+// the uplink control policies (fixed datarate, network ADR, device-side adaptive uplink) and the uplink
+// schedules (random times, slots of network time) can be compared by running the same scenario once for each of them
+// optionally, the devices are placed around a relay and send their uplinks through it after joining
+// the airtime per reading can be compared with and without aggregating several readings into one uplink
+
+#include <RadioLib.h>
+
+#include "Simulator.h"
+#include "SimRadio.h"
+#include "NetworkServer.h"
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+
+// all devices share the same JoinEUI, DevEUIs are assigned sequentially
+#define SIM_JOIN_EUI                                            (0x0000000000000000ULL)
+#define SIM_DEV_EUI_BASE                                        (0x70B3D57ED0000000ULL)
+
+// devices retry a failed join after a random time in this range, in seconds
+#define SIM_JOIN_BACKOFF_MIN                                    (10)
+#define SIM_JOIN_BACKOFF_MAX                                    (60)
+
+// with slotted uplinks, the network time is requested again after this many uplinks
+#define SIM_TIME_SYNC_UPLINKS                                   (24)
+
+// devices behind a relay use the fastest datarate and the lowest Tx power, as the relay is close,
+// the RxR delay leaves room for a forwarded uplink down to DR0
+#define SIM_RELAY_DR                                            (5)
+#define SIM_RELAY_TX_POWER                                      (2)
+#define SIM_RELAY_RXR_DELAY_MS                                  (8000)
+
+// after an error, the relay listens again after this time, in seconds
+#define SIM_RELAY_ERROR_BACKOFF                                 (1)
+
+// aggregated readings are sent on this FPort as records of this type
+#define SIM_AGGR_FPORT                                          (1)
+#define SIM_AGGR_RECORD_TYPE                                    (0x01)
+
+// how the uplink datarate, Tx power and number of transmissions are controlled
+enum class SimPolicy {
+  Fixed,      // join datarate, maximum power, single transmission
+  Adr,        // network-side ADR
+  Adaptive,   // device-side adaptive uplink, see LoRaWANNode::setAdaptiveUplink
+};
+
+static const char* policyNames[] = { "fixed", "adr", "adaptive" };
+
+// when the uplinks are sent
+enum class SimSchedule {
+  Aloha,      // random times, once per period on average, or once in the window of each period
+  Slotted,    // network time slots, see LoRaWANNode::scheduleTransmissionSlot
+};
+
+static const char* scheduleNames[] = { "aloha", "slotted" };
+
+struct SimConfig_t {
+  size_t numNodes = 100;
+  double radius = 5000;
+  RadioLibTime_t period = 600;
+  size_t payloadLen = 12;
+  RadioLibTime_t duration = 86400;
+  uint32_t seed = 1;
+  bool confirmed = false;
+  std::vector<SimPolicy> policies = { SimPolicy::Adr };
+  std::vector<SimSchedule> schedules = { SimSchedule::Aloha };
+  uint32_t window = 0;
+  uint8_t margin = RADIOLIB_LORAWAN_ADAPTIVE_MARGIN_DEFAULT;
+  double clockDrift = 0;
+  double relayDistance = 0;
+  std::vector<uint8_t> aggregate = { 0 };
+};
+
+struct SimNode {
+  uint64_t devEUI;
+  uint8_t appKey[RADIOLIB_AES128_KEY_SIZE];
+  double distance;
+  double drift;
+  std::unique_ptr<SimHal> hal;
+  std::unique_ptr<Module> mod;
+  std::unique_ptr<SimRadio> radio;
+  std::unique_ptr<LoRaWANNode> node;
+  RadioLibTime_t joinTime = 0;
+  uint32_t numRelayNoAck = 0;
+  uint32_t numReadings = 0;
+};
+
+// AppKey of the first device, the others are derived from it - JoinAccepts carry no DevEUI,
+// so devices that share an AppKey would also accept each other's JoinAccept
+static const uint8_t appKeyBase[RADIOLIB_AES128_KEY_SIZE] = {
+  0x2B, 0x7E, 0x15, 0x16, 0x28, 0xAE, 0xD2, 0xA6, 0xAB, 0xF7, 0x15, 0x88, 0x09, 0xCF, 0x4F, 0x3C
+};
+
+static void usage(const char* name) {
+  fprintf(stderr, "Usage: %s [options]\n", name);
+  fprintf(stderr, "  --nodes N        number of devices (default 100)\n");
+  fprintf(stderr, "  --radius M       devices are placed uniformly in a disc of this radius in meters (default 5000)\n");
+  fprintf(stderr, "  --period S       mean uplink period in seconds (default 600)\n");
+  fprintf(stderr, "  --length N       application payload length in bytes (default 12)\n");
+  fprintf(stderr, "  --duration S     simulated time in seconds (default 86400)\n");
+  fprintf(stderr, "  --seed N         random seed (default 1)\n");
+  fprintf(stderr, "  --confirmed      send confirmed uplinks\n");
+  fprintf(stderr, "  --policy P       uplink control: fixed, adr, adaptive, or all to compare them (default adr)\n");
+  fprintf(stderr, "  --margin D       link margin target of the adaptive policy in dB (default %d)\n", RADIOLIB_LORAWAN_ADAPTIVE_MARGIN_DEFAULT);
+  fprintf(stderr, "  --clock-drift P  host clock error of each device is drawn uniformly from +/- P ppm (default 0)\n");
+  fprintf(stderr, "  --schedule S     uplink times: aloha, slotted, or all to compare them (default aloha)\n");
+  fprintf(stderr, "  --window S       uplinks are sent in a window of this many seconds at the start of each period (default 0, whole period)\n");
+  fprintf(stderr, "  --relay M        place a relay this many meters from the gateway, the devices are placed around it\n");
+  fprintf(stderr, "                   and send their uplinks through it after joining (default 0, no relay)\n");
+  fprintf(stderr, "  --aggregate N    also run the scenario with N readings aggregated into one unconfirmed uplink (default 0, none)\n");
+}
+
+static bool parseArgs(int argc, char** argv, SimConfig_t* cfg) {
+  for(int i = 1; i < argc; i++) {
+    std::string arg = argv[i];
+    if(arg == "--confirmed") {
+      cfg->confirmed = true;
+      continue;
+    }
+
+    // all other options have a value
+    if(i + 1 >= argc) {
+      return(false);
+    }
+    const char* val = argv[++i];
+    if(arg == "--nodes") {
+      cfg->numNodes = strtoul(val, NULL, 0);
+    } else if(arg == "--radius") {
+      cfg->radius = strtod(val, NULL);
+    } else if(arg == "--period") {
+      cfg->period = strtoull(val, NULL, 0);
+    } else if(arg == "--length") {
+      cfg->payloadLen = strtoul(val, NULL, 0);
+    } else if(arg == "--duration") {
+      cfg->duration = strtoull(val, NULL, 0);
+    } else if(arg == "--seed") {
+      cfg->seed = strtoul(val, NULL, 0);
+    } else if(arg == "--policy") {
+      cfg->policies.clear();
+      for(size_t p = 0; p < sizeof(policyNames) / sizeof(policyNames[0]); p++) {
+        if(!strcmp(val, policyNames[p]) || !strcmp(val, "all")) {
+          cfg->policies.push_back((SimPolicy)p);
+        }
+      }
+      if(cfg->policies.empty()) {
+        return(false);
+      }
+    } else if(arg == "--schedule") {
+      cfg->schedules.clear();
+      for(size_t s = 0; s < sizeof(scheduleNames) / sizeof(scheduleNames[0]); s++) {
+        if(!strcmp(val, scheduleNames[s]) || !strcmp(val, "all")) {
+          cfg->schedules.push_back((SimSchedule)s);
+        }
+      }
+      if(cfg->schedules.empty()) {
+        return(false);
+      }
+    } else if(arg == "--window") {
+      cfg->window = strtoul(val, NULL, 0);
+    } else if(arg == "--margin") {
+      cfg->margin = strtoul(val, NULL, 0);
+    } else if(arg == "--clock-drift") {
+      cfg->clockDrift = strtod(val, NULL);
+    } else if(arg == "--relay") {
+      cfg->relayDistance = strtod(val, NULL);
+    } else if(arg == "--aggregate") {
+      unsigned long num = strtoul(val, NULL, 0);
+      if((num < 1) || (num > 0xFF)) {
+        return(false);
+      }
+      cfg->aggregate = { 0, (uint8_t)num };
+    } else {
+      return(false);
+    }
+  }
+  return((cfg->numNodes > 0) && (cfg->period > 0) && (cfg->payloadLen > 0) && (cfg->window <= cfg->period));
+}
+
+// join with the uplink policy, starting at the fastest datarate and stepping down after each failed attempt
+static void join(Simulator* sim, SimNode* n, const SimConfig_t* cfg, SimPolicy policy, std::mt19937& rng) {
+  std::uniform_int_distribution<RadioLibTime_t> backoff(SIM_JOIN_BACKOFF_MIN * 1000000ULL, SIM_JOIN_BACKOFF_MAX * 1000000ULL);
+  LoRaWANNode& node = *n->node;
+  node.beginOTAA(SIM_JOIN_EUI, n->devEUI, NULL, n->appKey);
+  node.setADR(policy == SimPolicy::Adr);
+  node.setAdaptiveUplink(policy == SimPolicy::Adaptive, cfg->margin);
+
+  uint8_t dr = 5;
+  while(node.activateOTAA(dr) != RADIOLIB_LORAWAN_NEW_SESSION) {
+    if(dr > 0) {
+      dr--;
+    }
+    sim->sleepUntil(sim->now() + backoff(rng));
+  }
+  n->joinTime = sim->now();
+}
+
+// relay firmware: join, then forward the uplinks of the devices around it
+static void runRelay(Simulator* sim, SimNode* n, const SimConfig_t* cfg, SimPolicy policy, uint32_t seed) {
+  std::mt19937 rng(seed);
+  join(sim, n, cfg, policy, rng);
+
+  // at a low datarate, the forwarded uplink and the downlink for it may not fit before the RxR window
+  int16_t state = n->node->beginRelay(SIM_RELAY_RXR_DELAY_MS);
+  if(state != RADIOLIB_ERR_NONE) {
+    fprintf(stderr, "relay could not be started (%d)\n", state);
+    return;
+  }
+  while(true) {
+    if(n->node->relayListen() < RADIOLIB_ERR_NONE) {
+      sim->sleepUntil(sim->now() + SIM_RELAY_ERROR_BACKOFF * 1000000ULL);
+    }
+  }
+}
+
+// device firmware: join, then send periodic uplinks with random jitter, or in network time slots
+// with a relay, the device is switched to send through it after joining
+// with aggregation, each reading is a record, and an uplink is sent once every numAggregate readings
+static void runNode(Simulator* sim, SimNode* n, const SimConfig_t* cfg, SimPolicy policy, SimSchedule schedule, uint8_t numAggregate,
+                    uint32_t seed, SimNode* relay, SimNetworkServer* server) {
+  std::mt19937 rng(seed);
+  std::uniform_int_distribution<RadioLibTime_t> jitter(0, cfg->period * 1000000ULL);
+  std::uniform_int_distribution<RadioLibTime_t> inWindow(0, cfg->window * 1000000ULL);
+  std::uniform_int_distribution<int> byte(0, 255);
+
+  LoRaWANNode& node = *n->node;
+  join(sim, n, cfg, policy, rng);
+
+  // the network provisions the relay with the key of the device, and the device with the relay settings
+  if(relay) {
+    uint8_t rootWorSKey[RADIOLIB_AES128_KEY_SIZE];
+    node.getRootWorSKey(rootWorSKey);
+    relay->node->addRelayDevice(node.getDevAddr(), rootWorSKey);
+    server->setRelayed(n->devEUI, true);
+    node.setADR(false);
+    node.setAdaptiveUplink(false);
+    node.setDatarate(SIM_RELAY_DR);
+    node.setTxPower(SIM_RELAY_TX_POWER);
+    node.setRelayMode(true, SIM_RELAY_RXR_DELAY_MS);
+  }
+
+  uint8_t aggrBuff[RADIOLIB_LORAWAN_AGGR_NUM_PORTS * 0xFF];
+  if(numAggregate) {
+    node.beginAggregation(aggrBuff, sizeof(aggrBuff));
+  }
+
+  // uplinks are spread uniformly over the period, then repeated with a jitter of +/- half a period,
+  // or sent at a random time in the window at the start of each period
+  // slotted uplinks use the same random times until the first DeviceTimeAns arrived
+  std::vector<uint8_t> payload(cfg->payloadLen);
+  RadioLibTime_t periodUs = cfg->period * 1000000ULL;
+  RadioLibTime_t next = cfg->window ? (sim->now() / periodUs + 1) * periodUs + inWindow(rng) : sim->now() + jitter(rng);
+  uint32_t numUplinks = 0;
+  while(true) {
+    // readings that are only buffered are taken at random times, only the uplinks are slotted
+    bool sending = !numAggregate || ((n->numReadings + 1) % numAggregate == 0);
+    bool slotted = (schedule == SimSchedule::Slotted) && sending && (node.scheduleTransmissionSlot(cfg->period, cfg->window) == RADIOLIB_ERR_NONE);
+    if(!slotted) {
+      sim->sleepUntil(next);
+      RadioLibTime_t wait = node.timeUntilUplink();
+      if(wait > 0) {
+        n->hal->delay(wait);
+      }
+    }
+    if((schedule == SimSchedule::Slotted) && (!slotted || (numUplinks % SIM_TIME_SYNC_UPLINKS == 0))) {
+      node.sendMacCommandReq(RADIOLIB_LORAWAN_MAC_DEVICE_TIME);
+    }
+    for(uint8_t& b : payload) {
+      b = (uint8_t)byte(rng);
+    }
+    int16_t state = RADIOLIB_ERR_NONE;
+    n->numReadings++;
+    if(!numAggregate) {
+      state = node.sendReceive(payload.data(), payload.size(), 1, cfg->confirmed);
+    } else {
+      // a record that does not fit into the uplink at the current datarate sends the buffered ones first
+      state = node.aggregate(SIM_AGGR_FPORT, SIM_AGGR_RECORD_TYPE, payload.data(), payload.size());
+      if((state >= RADIOLIB_ERR_NONE) && sending) {
+        state = node.flushAggregated();
+      }
+    }
+    if(state == RADIOLIB_ERR_RELAY_NO_ACK) {
+      n->numRelayNoAck++;
+    }
+    numUplinks++;
+    if(cfg->window) {
+      next = (sim->now() / periodUs + 1) * periodUs + inWindow(rng);
+    } else {
+      next = RADIOLIB_MAX(next + periodUs / 2 + jitter(rng), sim->now());
+    }
+  }
+}
+
+// run the scenario with a single policy, schedule and aggregation, the same seed always places the devices in the same way
+static void simulate(const SimConfig_t& cfg, SimPolicy policy, SimSchedule schedule, uint8_t numAggregate) {
+  Simulator sim;
+  SimChannelConfig_t channelCfg;
+  SimChannel channel(&sim, channelCfg, cfg.seed);
+  SimGateway gateway(&sim, &channel, { 0, 0 });
+  SimNetworkServer server(&sim, &gateway);
+  server.adrEnabled = (policy == SimPolicy::Adr);
+  gateway.onUplink = [&server](const SimTransmission& tx, float rssi, float snr) { server.onUplink(tx, rssi, snr); };
+  channel.addListener(&gateway);
+
+  // the device with the next index after the end devices, registered at the network server like them
+  auto makeNode = [&](size_t i, SimPosition pos, double drift) {
+    auto n = std::make_unique<SimNode>();
+    n->devEUI = SIM_DEV_EUI_BASE + i;
+    memcpy(n->appKey, appKeyBase, sizeof(appKeyBase));
+    for(size_t j = 0; j < sizeof(uint32_t); j++) {
+      n->appKey[j] ^= (uint8_t)(i >> 8*j);
+    }
+    n->distance = sqrt(pos.x*pos.x + pos.y*pos.y);
+    n->drift = drift;
+    n->hal = std::make_unique<SimHal>(&sim, n->drift);
+    n->mod = std::make_unique<Module>(n->hal.get(), RADIOLIB_NC, RADIOLIB_NC, RADIOLIB_NC);
+    n->radio = std::make_unique<SimRadio>(n->mod.get(), &sim, &channel, pos, cfg.seed + i + 1);
+    n->node = std::make_unique<LoRaWANNode>(n->radio.get(), &EU868);
+    channel.addListener(n->radio.get());
+    server.addDevice(n->devEUI, SIM_JOIN_EUI, n->appKey);
+    return(n);
+  };
+
+  // the relay is powered on first, it does not use the random generator so that the devices are placed the same way
+  std::unique_ptr<SimNode> relay;
+  SimPosition center = { cfg.relayDistance, 0 };
+  if(cfg.relayDistance > 0) {
+    relay = makeNode(cfg.numNodes, center, 0);
+    SimNode* ptr = relay.get();
+    uint32_t seed = cfg.seed + cfg.numNodes;
+    SimProcess* proc = sim.spawn(0, [&sim, ptr, &cfg, policy, seed]() {
+      runRelay(&sim, ptr, &cfg, policy, seed);
+    });
+    relay->radio->setProcess(proc);
+  }
+
+  // place the devices uniformly in a disc around the gateway, or around the relay
+  std::mt19937 rng(cfg.seed);
+  std::uniform_real_distribution<double> uniform(0, 1);
+  std::vector<std::unique_ptr<SimNode>> nodes;
+  for(size_t i = 0; i < cfg.numNodes; i++) {
+    double dist = cfg.radius * sqrt(uniform(rng));
+    double angle = 2 * M_PI * uniform(rng);
+    double drift = cfg.clockDrift * (2 * uniform(rng) - 1);
+    auto n = makeNode(i, SimPosition{ center.x + dist * cos(angle), center.y + dist * sin(angle) }, drift);
+
+    // devices are powered on at random times during the first minute
+    SimNode* ptr = n.get();
+    SimNode* relayPtr = relay.get();
+    SimNetworkServer* serverPtr = &server;
+    uint32_t seed = rng();
+    SimProcess* proc = sim.spawn((RadioLibTime_t)(uniform(rng) * 60000000.0), [&sim, ptr, &cfg, policy, schedule, numAggregate, seed, relayPtr, serverPtr]() {
+      runNode(&sim, ptr, &cfg, policy, schedule, numAggregate, seed, relayPtr, serverPtr);
+    });
+    n->radio->setProcess(proc);
+    nodes.push_back(std::move(n));
+  }
+
+  sim.run(cfg.duration * 1000000ULL);
+
+  const char* policyName = policyNames[(int)policy];
+  const char* scheduleName = scheduleNames[(int)schedule];
+  uint32_t totalUplinks = 0;
+  uint32_t totalTransmissions = 0;
+  RadioLibTime_t totalAirtime = 0;
+  uint64_t totalRxOn = 0;
+  uint64_t totalRadioRx = 0;
+  uint32_t totalRxCount = 0;
+  uint32_t totalReceived = 0;
+  uint32_t totalJoined = 0;
+  uint32_t totalDownlinks = 0;
+  uint32_t totalNsDownlinks = 0;
+  uint32_t totalRelayNoAck = 0;
+  uint32_t totalReadings = 0;
+
+  // the relay is listed after the devices, but not included in their totals
+  for(size_t i = 0; i < nodes.size() + (relay ? 1 : 0); i++) {
+    SimNode* n = (i < nodes.size()) ? nodes[i].get() : relay.get();
+    LoRaWANStats_t stats = n->node->getStats();
+    SimDeviceStats_t nsStats = server.getStats(n->devEUI);
+    std::string drHistory;
+    for(uint8_t j = 0; j < stats.drHistoryLen; j++) {
+      drHistory += (j ? " " : "") + std::to_string(stats.drHistory[j]);
+    }
+    float pdr = stats.numUplinks ? (float)nsStats.numUplinks / stats.numUplinks : 0;
+
+    // Rx-on time per Rx window sequence, as measured by the device and by the emulated radio
+    uint32_t numRx = stats.numTransmissions + stats.numJoinRequests;
+    RadioLibTime_t radioRx = numRx ? n->radio->rxTime / numRx : 0;
+    printf("%s,%s,%zu,%.0f,%u,%.1f,%u,%u,%u,%lu,%u,%u,%u,%.3f,%u,%u,%s,%u,%.1f,%lu,%lu,%.0f,%u,%u,%u,%u\n",
+      policyName, scheduleName, i, n->distance, stats.numJoinRequests, n->joinTime / 1e6,
+      stats.numUplinks, stats.numTransmissions, stats.numTransmissions - stats.numUplinks,
+      (unsigned long)stats.airtime, stats.numDownlinks, nsStats.numUplinks, nsStats.numDuplicates, pdr,
+      nsStats.numLinkAdrReqs, stats.numDrChanges, drHistory.c_str(),
+      nsStats.numDownlinks, n->drift, (unsigned long)n->node->getAverageRxOnTime(), (unsigned long)radioRx, n->radio->txTime / 1e3,
+      n->numRelayNoAck, nsStats.numForwarded, numAggregate, n->numReadings);
+    if(n == relay.get()) {
+      continue;
+    }
+    totalUplinks += stats.numUplinks;
+    totalTransmissions += stats.numTransmissions;
+    totalAirtime += stats.airtime;
+    totalReceived += nsStats.numUplinks;
+    totalJoined += n->node->isActivated() ? 1 : 0;
+    totalRxOn += n->node->getAverageRxOnTime() * numRx;
+    totalRadioRx += n->radio->rxTime;
+    totalRxCount += numRx;
+    // frames of other devices are received in the shared RxR channel as well, only count accepted downlinks
+    totalDownlinks += stats.numDownlinks - stats.numDownlinksForeign - stats.numDownlinksFCntInvalid - stats.numDownlinksMicInvalid;
+    totalNsDownlinks += nsStats.numRelayedDownlinks;
+    totalRelayNoAck += n->numRelayNoAck;
+    totalReadings += n->numReadings;
+  }
+
+  std::string label = std::string(policyName) + "/" + scheduleName;
+  if(numAggregate) {
+    label += "/aggregate " + std::to_string(numAggregate);
+  }
+  const char* name = label.c_str();
+  fprintf(stderr, "[%s] joined: %u/%zu\n", name, totalJoined, nodes.size());
+  fprintf(stderr, "[%s] uplinks: %u sent, %u received (PDR %.3f), %.2f transmissions per uplink\n", name,
+    totalUplinks, totalReceived, totalUplinks ? (float)totalReceived / totalUplinks : 0,
+    totalUplinks ? (float)totalTransmissions / totalUplinks : 0);
+  fprintf(stderr, "[%s] airtime: %.1f s total, %.1f ms per received uplink\n", name,
+    totalAirtime / 1e3, totalReceived ? (float)totalAirtime / totalReceived : 0);
+  fprintf(stderr, "[%s] readings: %u taken, %.1f ms airtime per reading\n", name,
+    totalReadings, totalReadings ? (float)totalAirtime / totalReadings : 0);
+  fprintf(stderr, "[%s] gateway: %u received, %u lost to half-duplex, %u downlinks, %.1f s airtime\n", name,
+    gateway.numUplinks, gateway.numUplinksHalfDuplex, gateway.numDownlinks, gateway.txTime / 1e6);
+  fprintf(stderr, "[%s] collisions: %u of %u uplink transmissions overlapped another one (%.1f %%)\n", name,
+    gateway.numUplinksCollided, gateway.numUplinkTransmissions,
+    gateway.numUplinkTransmissions ? 100.0 * gateway.numUplinksCollided / gateway.numUplinkTransmissions : 0);
+  if(totalRxCount) {
+    fprintf(stderr, "[%s] Rx-on per uplink: %.2f ms device, %.2f ms radio\n", name, totalRxOn / 1e3 / totalRxCount, totalRadioRx / 1e3 / totalRxCount);
+  }
+  if(relay) {
+    LoRaWANStats_t stats = relay->node->getStats();
+    fprintf(stderr, "[%s] relay: %u uplinks forwarded, %u of %u downlinks received in RxR, %u uplinks not sent without WOR ACK, %.1f s airtime\n",
+      name, server.getStats(relay->devEUI).numForwarded, totalDownlinks, totalNsDownlinks, totalRelayNoAck, stats.airtime / 1e3);
+  }
+}
+
+int main(int argc, char** argv) {
+  SimConfig_t cfg;
+  if(!parseArgs(argc, argv, &cfg)) {
+    usage(argv[0]);
+    return(1);
+  }
+
+  printf("policy,schedule,node,distance_m,join_requests,join_time_s,uplinks,transmissions,retries,airtime_ms,downlinks,ns_uplinks,ns_duplicates,pdr,"
+         "link_adr_reqs,dr_changes,dr_history,ns_downlinks,clock_drift_ppm,rx_on_us,radio_rx_us,radio_tx_ms,relay_no_ack,ns_forwarded,"
+         "aggregate,readings\n");
+  for(SimPolicy policy : cfg.policies) {
+    for(SimSchedule schedule : cfg.schedules) {
+      for(uint8_t numAggregate : cfg.aggregate) {
+        simulate(cfg, policy, schedule, numAggregate);
+      }
+    }
+  }
+  return(0);
+}
@@ -0,0 +1,47 @@
+#if !defined(_RADIOLIB_TEST_UTILS_H)
+#define _RADIOLIB_TEST_UTILS_H
+
+// minimal helpers for the host unit tests, no test framework is needed
+// each test is a separate executable, which returns the number of failed checks
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdio.h>
+
+static int testFailures = 0;
+
+// check a condition, print the location and message if it does not hold
+#define TEST_CHECK(COND, ...) do { \
+    if(!(COND)) { \
+      testFailures++; \
+      printf("%s:%d: check failed: %s: ", __FILE__, __LINE__, #COND); \
+      printf(__VA_ARGS__); \
+      printf("\n"); \
+    } \
+  } while(0)
+
+// print the summary of the test, returns the value to return from main
+static inline int testResult(const char* name) {
+  printf("%s: %s (%d failed checks)\n", name, testFailures ? "FAILED" : "passed", testFailures);
+  return(testFailures ? 1 : 0);
+}
+
+// deterministic pseudo-random generator, so that the results do not depend on the standard library
+static uint32_t rngState = 1;
+static inline uint32_t rng() {
+  rngState ^= rngState << 13;
+  rngState ^= rngState >> 17;
+  rngState ^= rngState << 5;
+  return(rngState);
+}
+
+// bits of a buffer, most significant bit of each byte first
+static inline uint8_t getBit(const uint8_t* buff, size_t i) {
+  return((buff[i / 8] >> (7 - i % 8)) & 0x01);
+}
+
+static inline void setBit(uint8_t* buff, size_t i, uint8_t bit) {
+  buff[i / 8] = (buff[i / 8] & ~(0x80 >> (i % 8))) | (bit ? (0x80 >> (i % 8)) : 0);
+}
+
+#endif
@@ -0,0 +1,9 @@
+#!/bin/bash
+
+set -e
+mkdir -p build
+cd build
+cmake ..
+make -j4
+ctest --output-on-failure
+cd ..
@@ -0,0 +1,137 @@
+// AES-128 known-answer tests from FIPS-197 appendix C.1, SP800-38A appendix F and RFC4493 section 4
+// built once for every available RADIOLIB_AES128_BACKEND (see CMakeLists.txt)
+
+#include "../../../src/utils/Cryptography.h"
+
+#include <string.h>
+
+#include "TestUtils.h"
+
+#if defined(RADIOLIB_AES128_HW_X86)
+  #define TEST_AES_BACKEND_NAME "hw"
+#elif (RADIOLIB_AES128_BACKEND == RADIOLIB_AES128_BACKEND_TTABLE)
+  #define TEST_AES_BACKEND_NAME "ttable"
+#else
+  #define TEST_AES_BACKEND_NAME "compact"
+#endif
+
+// key and plaintext from NIST SP800-38A appendix F, also used by RFC4493
+static const char* kKey = "2b7e151628aed2a6abf7158809cf4f3c";
+static const char* kPlain = "6bc1bee22e409f96e93d7e117393172aae2d8a571e03ac9c9eb76fac45af8e51"
+                            "30c81c46a35ce411e5fbc1191a0a52eff69f2445df4f9b17ad2b417be66c3710";
+
+static size_t parseHex(const char* hex, uint8_t* out) {
+  size_t len = strlen(hex) / 2;
+  for(size_t i = 0; i < len; i++) {
+    unsigned int b = 0;
+    sscanf(&hex[2*i], "%2x", &b);
+    out[i] = (uint8_t)b;
+  }
+  return(len);
+}
+
+static bool matches(const uint8_t* res, const char* expected) {
+  uint8_t exp[64];
+  size_t len = parseHex(expected, exp);
+  return(memcmp(res, exp, len) == 0);
+}
+
+static void testBlock() {
+  RadioLibAES128 aes;
+  uint8_t key[RADIOLIB_AES128_KEY_SIZE];
+  uint8_t plain[64];
+  uint8_t out[64];
+  uint8_t dec[64];
+
+  // FIPS-197 C.1
+  parseHex("000102030405060708090a0b0c0d0e0f", key);
+  parseHex("00112233445566778899aabbccddeeff", plain);
+  aes.init(key);
+  aes.encryptECB(plain, 16, out);
+  TEST_CHECK(matches(out, "69c4e0d86a7b0430d8cdb78070b4c55a"), "FIPS-197 encryption");
+  aes.decryptECB(out, 16, dec);
+  TEST_CHECK(matches(dec, "00112233445566778899aabbccddeeff"), "FIPS-197 decryption");
+
+  // SP800-38A F.1.1 ECB-AES128.Encrypt, and decryption back to the plaintext
+  parseHex(kKey, key);
+  parseHex(kPlain, plain);
+  aes.init(key);
+  aes.encryptECB(plain, 64, out);
+  TEST_CHECK(matches(out, "3ad77bb40d7a3660a89ecaf32466ef97f5d3d58503b9699de785895a96fdbaaf"
+                          "43b1cd7f598ece23881b00e3ed0306887b0c785e27e8ad3f8223207104725dd4"), "SP800-38A ECB encryption");
+  aes.decryptECB(out, 64, dec);
+  TEST_CHECK(matches(dec, kPlain), "SP800-38A ECB decryption");
+}
+
+static void testCmac() {
+  RadioLibAES128 aes;
+  uint8_t key[RADIOLIB_AES128_KEY_SIZE];
+  uint8_t plain[64];
+  uint8_t out[RADIOLIB_AES128_BLOCK_SIZE];
+  parseHex(kKey, key);
+  parseHex(kPlain, plain);
+  aes.init(key);
+
+  // RFC4493 examples 1 to 4
+  static const size_t cmacLens[] = { 0, 16, 40, 64 };
+  static const char* cmacs[] = {
+    "bb1d6929e95937287fa37d129b756746",
+    "070a16b46b4d4144f79bdd9dd04a287c",
+    "dfa66747de9ae63030ca32611497c827",
+    "51f0bebf7e3b9d92fc49741779363cfe",
+  };
+  for(size_t i = 0; i < 4; i++) {
+    aes.generateCMAC(plain, cmacLens[i], out);
+    TEST_CHECK(matches(out, cmacs[i]), "RFC4493 example %u", (unsigned int)(i + 1));
+    TEST_CHECK(aes.verifyCMAC(plain, cmacLens[i], out), "RFC4493 example %u verification", (unsigned int)(i + 1));
+    out[RADIOLIB_AES128_BLOCK_SIZE - 1] ^= 0x01;
+    TEST_CHECK(!aes.verifyCMAC(plain, cmacLens[i], out), "RFC4493 example %u with corrupted tag", (unsigned int)(i + 1));
+
+    // incremental calculation in uneven parts must give the same result
+    for(size_t part = 1; part <= 17; part++) {
+      aes.initCMAC();
+      for(size_t pos = 0; pos < cmacLens[i]; pos += part) {
+        aes.updateCMAC(&plain[pos], RADIOLIB_MIN(part, cmacLens[i] - pos));
+      }
+      aes.finishCMAC(out);
+      TEST_CHECK(matches(out, cmacs[i]), "RFC4493 example %u in parts of %u bytes", (unsigned int)(i + 1), (unsigned int)part);
+    }
+  }
+}
+
+static void testCtr() {
+  RadioLibAES128 aes;
+  uint8_t key[RADIOLIB_AES128_KEY_SIZE];
+  uint8_t plain[64];
+  uint8_t out[64];
+  uint8_t ctr[RADIOLIB_AES128_BLOCK_SIZE];
+  parseHex(kKey, key);
+  parseHex(kPlain, plain);
+  parseHex("f0f1f2f3f4f5f6f7f8f9fafbfcfdfeff", ctr);
+  aes.init(key);
+
+  // SP800-38A F.5.1 CTR-AES128.Encrypt, whole and processed in uneven parts
+  const char* expected = "874d6191b620e3261bef6864990db6ce9806f66b7970fdff8617187bb9fffdff"
+                         "5ae4df3edbd5d35e5b4f09020db03eab1e031dda2fbe03d1792170a0f3009cee";
+  aes.initCTR(ctr);
+  aes.updateCTR(plain, 64, out);
+  TEST_CHECK(matches(out, expected), "SP800-38A CTR encryption");
+
+  aes.initCTR(ctr);
+  aes.updateCTR(plain, 5, out);
+  aes.updateCTR(&plain[5], 30, &out[5]);
+  aes.updateCTR(&plain[35], 29, &out[35]);
+  TEST_CHECK(matches(out, expected), "SP800-38A CTR encryption in parts");
+
+  // decryption is the same operation
+  aes.initCTR(ctr);
+  aes.updateCTR(out, 64, out);
+  TEST_CHECK(matches(out, kPlain), "SP800-38A CTR decryption");
+}
+
+int main() {
+  testBlock();
+  testCmac();
+  testCtr();
+  return(testResult("test_aes (" TEST_AES_BACKEND_NAME ")"));
+}
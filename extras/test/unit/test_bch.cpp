@@ -0,0 +1,65 @@
+// BCH(31, 21) code as used by POCSAG, checked against a bit-serial reference encoder
+
+#include <RadioLib.h>
+
+#include "TestUtils.h"
+
+// POCSAG generator polynomial x^10 + x^9 + x^8 + x^6 + x^5 + x^3 + 1
+#define TEST_BCH_GENERATOR                                      (0x769)
+
+// reference encoder - long division one bit at a time, check bits and even parity are appended below the data
+static uint32_t referenceEncode(uint32_t data) {
+  uint32_t rem = data << 10;
+  for(int8_t i = 30; i >= 10; i--) {
+    if(rem & ((uint32_t)1 << i)) {
+      rem ^= (uint32_t)TEST_BCH_GENERATOR << (i - 10);
+    }
+  }
+  uint32_t cw = (data << 11) | (rem << 1);
+  uint32_t parity = 0;
+  for(uint8_t i = 0; i < 32; i++) {
+    parity ^= (cw >> i) & 0x01;
+  }
+  return(cw | parity);
+}
+
+int main() {
+  RadioLibBCH bch;
+  bch.begin(RADIOLIB_PAGER_BCH_N, RADIOLIB_PAGER_BCH_K, RADIOLIB_PAGER_BCH_PRIMITIVE_POLY);
+
+  // POCSAG idle code word is a valid code word
+  TEST_CHECK(bch.encode(0x7A89C197UL & 0xFFFFF800UL) == 0x7A89C197UL, "idle code word");
+
+  // all data words, the bits below the data must not affect the result
+  size_t mismatches = 0;
+  for(uint32_t data = 0; data < ((uint32_t)1 << 21); data++) {
+    uint32_t cw = bch.encode((data << 11) | (data & 0x7FF));
+    if(cw != referenceEncode(data)) {
+      mismatches++;
+    }
+  }
+  TEST_CHECK(mismatches == 0, "%lu of 2^21 code words differ from the reference", (unsigned long)mismatches);
+
+  // all single and double errors in a sample of code words are corrected
+  size_t uncorrected = 0;
+  for(uint32_t data = 0; data < ((uint32_t)1 << 21); data += 4099) {
+    uint32_t cw = referenceEncode(data);
+    for(uint8_t a = 0; a < 32; a++) {
+      for(uint8_t b = a; b < 32; b++) {
+        uint32_t rx = cw ^ ((uint32_t)1 << a) ^ ((a == b) ? 0 : ((uint32_t)1 << b));
+        int8_t numErrors = bch.decode(&rx);
+        if((rx != cw) || (numErrors != ((a == b) ? 1 : 2))) {
+          uncorrected++;
+        }
+      }
+    }
+
+    uint32_t rx = cw;
+    if((bch.decode(&rx) != 0) || (rx != cw)) {
+      uncorrected++;
+    }
+  }
+  TEST_CHECK(uncorrected == 0, "%lu error patterns not corrected", (unsigned long)uncorrected);
+
+  return(testResult("bch"));
+}
@@ -0,0 +1,178 @@
+// line coding kernels (whitening, scrambling, Manchester, NRZI) and bit reflection,
+// checked against straightforward bit-serial references
+
+#include <RadioLib.h>
+
+#include <string.h>
+
+#include "TestUtils.h"
+
+#define TEST_CODING_MAX_LEN                                     (64)
+
+static size_t randomBuffer(uint8_t* buff) {
+  size_t len = rng() % (TEST_CODING_MAX_LEN + 1);
+  for(size_t i = 0; i < len; i++) {
+    buff[i] = (uint8_t)rng();
+  }
+  return(len);
+}
+
+// PN9 generator one bit at a time, output is the lowest bit, least significant bit of each byte first
+static uint16_t referencePn9(uint8_t* buff, size_t len, uint16_t state) {
+  for(size_t i = 0; i < 8*len; i++) {
+    uint16_t out = state & 0x01;
+    buff[i / 8] ^= out << (i % 8);
+    state = (state >> 1) | ((out ^ ((state >> 5) & 0x01)) << 8);
+  }
+  return(state);
+}
+
+// x^15 + x^14 + 1 additive scrambler one bit at a time, least significant bit of each byte first
+static uint16_t referenceScramble(uint8_t* buff, size_t len, uint16_t state) {
+  for(size_t i = 0; i < 8*len; i++) {
+    uint16_t out = (state ^ (state >> 1)) & 0x01;
+    buff[i / 8] ^= out << (i % 8);
+    state = (state >> 1) | (out << 14);
+  }
+  return(state);
+}
+
+static void testWhitening() {
+  // start of the PN9 sequence with the default seed, as documented for CC1101
+  static const uint8_t pn9Start[] = { 0xFF, 0xE1, 0x1D, 0x9A, 0xED, 0x85, 0x33, 0x24 };
+  uint8_t buff[TEST_CODING_MAX_LEN] = { 0 };
+  rlb_whiten_pn9(buff, sizeof(pn9Start));
+  TEST_CHECK(memcmp(buff, pn9Start, sizeof(pn9Start)) == 0, "PN9 sequence start");
+
+  size_t failed = 0;
+  for(size_t t = 0; t < 2000; t++) {
+    uint8_t ref[TEST_CODING_MAX_LEN];
+    size_t len = randomBuffer(buff);
+    memcpy(ref, buff, len);
+    uint16_t seed = rng() & 0x01FF;
+
+    // whitening in two parts must continue the same sequence
+    size_t split = len ? rng() % (len + 1) : 0;
+    uint16_t state = rlb_whiten_pn9(buff, split, seed);
+    state = rlb_whiten_pn9(&buff[split], len - split, state);
+    uint16_t refState = referencePn9(ref, len, seed);
+    failed += (memcmp(buff, ref, len) != 0) || (state != refState);
+
+    len = randomBuffer(buff);
+    memcpy(ref, buff, len);
+    seed = rng() & 0x7FFF;
+    split = len ? rng() % (len + 1) : 0;
+    state = rlb_scramble(buff, split, seed);
+    state = rlb_scramble(&buff[split], len - split, state);
+    refState = referenceScramble(ref, len, seed);
+    failed += (memcmp(buff, ref, len) != 0) || (state != refState);
+  }
+  TEST_CHECK(failed == 0, "%lu buffers differ from the whitening references", (unsigned long)failed);
+}
+
+static void testManchester() {
+  size_t failed = 0;
+  for(size_t t = 0; t < 2000; t++) {
+    uint8_t in[TEST_CODING_MAX_LEN];
+    uint8_t out[2*TEST_CODING_MAX_LEN];
+    uint8_t ref[2*TEST_CODING_MAX_LEN];
+    size_t len = randomBuffer(in);
+    bool invert = t & 0x01;
+
+    // G. E. Thomas convention encodes 1 as 10 and 0 as 01, inverted convention the other way around
+    for(size_t i = 0; i < 8*len; i++) {
+      uint8_t bit = getBit(in, i) ^ (invert ? 1 : 0);
+      setBit(ref, 2*i, bit);
+      setBit(ref, 2*i + 1, !bit);
+    }
+    rlb_manchester_encode(in, out, len, invert);
+    failed += (memcmp(out, ref, 2*len) != 0);
+
+    // in place encoding
+    uint8_t inPlace[2*TEST_CODING_MAX_LEN];
+    memcpy(inPlace, in, len);
+    rlb_manchester_encode(inPlace, inPlace, len, invert);
+    failed += (memcmp(inPlace, ref, 2*len) != 0);
+
+    // decoding with random symbol errors, invalid pairs decode as their first bit and are counted
+    size_t numInvalid = 0;
+    uint8_t dec[TEST_CODING_MAX_LEN];
+    uint8_t refDec[TEST_CODING_MAX_LEN];
+    for(size_t i = 0; i < 16*len; i++) {
+      if((rng() % 16) == 0) {
+        ref[i / 8] ^= 0x80 >> (i % 8);
+      }
+    }
+    for(size_t i = 0; i < 8*len; i++) {
+      uint8_t first = getBit(ref, 2*i);
+      numInvalid += (first == getBit(ref, 2*i + 1));
+      setBit(refDec, i, first ^ (invert ? 1 : 0));
+    }
+    size_t res = rlb_manchester_decode(ref, dec, 2*len, invert);
+    failed += (memcmp(dec, refDec, len) != 0) || (res != numInvalid);
+  }
+  TEST_CHECK(failed == 0, "%lu buffers differ from the Manchester reference", (unsigned long)failed);
+}
+
+static void testNrzi() {
+  size_t failed = 0;
+  for(size_t t = 0; t < 2000; t++) {
+    uint8_t buff[TEST_CODING_MAX_LEN];
+    uint8_t orig[TEST_CODING_MAX_LEN];
+    uint8_t ref[TEST_CODING_MAX_LEN];
+    size_t len = randomBuffer(buff);
+    memcpy(orig, buff, len);
+    uint8_t levelStart = rng() & 0x01;
+    bool invert = (t >> 1) & 0x01;
+
+    // logical 0 changes the line level, logical 1 keeps it, inverted convention the other way around
+    uint8_t refLevel = levelStart;
+    for(size_t i = 0; i < 8*len; i++) {
+      uint8_t change = getBit(orig, i) ^ (invert ? 1 : 0) ^ 1;
+      refLevel ^= change;
+      setBit(ref, i, refLevel);
+    }
+
+    // encoding in two parts must continue from the last line level
+    size_t split = len ? rng() % (len + 1) : 0;
+    uint8_t level = rlb_nrzi_encode(buff, split, levelStart, invert);
+    level = rlb_nrzi_encode(&buff[split], len - split, level, invert);
+    failed += (memcmp(buff, ref, len) != 0) || (len && (level != refLevel));
+
+    level = rlb_nrzi_decode(buff, split, levelStart, invert);
+    rlb_nrzi_decode(&buff[split], len - split, level, invert);
+    failed += (memcmp(buff, orig, len) != 0);
+  }
+  TEST_CHECK(failed == 0, "%lu buffers differ from the NRZI reference", (unsigned long)failed);
+}
+
+static void testReflect() {
+  size_t failed = 0;
+  for(uint16_t i = 0; i < 256; i++) {
+    uint8_t ref = 0;
+    for(uint8_t b = 0; b < 8; b++) {
+      ref |= ((i >> b) & 0x01) << (7 - b);
+    }
+    failed += (rlb_reflect8((uint8_t)i) != ref);
+    failed += (rlb_reflect(i, 8) != ref);
+  }
+
+  for(size_t t = 0; t < 10000; t++) {
+    uint8_t bits = 1 + (t % 32);
+    uint32_t in = rng() & ((uint32_t)0xFFFFFFFF >> (32 - bits));
+    uint32_t ref = 0;
+    for(uint8_t b = 0; b < bits; b++) {
+      ref |= ((in >> b) & 0x01) << (bits - 1 - b);
+    }
+    failed += (rlb_reflect(in, bits) != ref);
+  }
+  TEST_CHECK(failed == 0, "%lu values differ from the reflection reference", (unsigned long)failed);
+}
+
+int main() {
+  testWhitening();
+  testManchester();
+  testNrzi();
+  testReflect();
+  return(testResult("coding"));
+}
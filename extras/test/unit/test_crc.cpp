@@ -0,0 +1,134 @@
+// CRC calculation of any size from 1 to 32 bits, checked against a bit-serial reference
+// built once for every RADIOLIB_CRC_TABLE configuration (see CMakeLists.txt), so that the bitwise,
+// byte-wise and slice-by-N calculations are all covered, including incremental updates over split buffers
+
+#include "../../../src/utils/CRC.h"
+
+#include <string.h>
+
+#include "TestUtils.h"
+
+// longer than RADIOLIB_CRC_TABLE_MIN_LEN, so that the lookup tables are used as well
+#define TEST_CRC_MAX_LEN                                        (300)
+#define TEST_CRC_CONFIGS                                        (500)
+
+// bit-serial reference: input bits LSB first when reflected, final XOR applied before the output reflection
+static uint32_t reference(const RadioLibCRC* cfg, const uint8_t* buff, size_t len) {
+  uint32_t mask = (uint32_t)0xFFFFFFFF >> (32 - cfg->size);
+  uint32_t crc = cfg->init & mask;
+  for(size_t i = 0; i < len; i++) {
+    for(uint8_t b = 0; b < 8; b++) {
+      uint32_t bit = cfg->refIn ? (buff[i] >> b) & 0x01 : (buff[i] >> (7 - b)) & 0x01;
+      uint32_t fb = ((crc >> (cfg->size - 1)) & 0x01) ^ bit;
+      crc = (crc << 1) & mask;
+      if(fb) {
+        crc ^= cfg->poly;
+      }
+    }
+  }
+  crc = (crc ^ cfg->out) & mask;
+  if(cfg->refOut) {
+    uint32_t ref = 0;
+    for(uint8_t b = 0; b < cfg->size; b++) {
+      ref |= ((crc >> b) & 0x01) << (cfg->size - 1 - b);
+    }
+    crc = ref;
+  }
+  return(crc);
+}
+
+// well-known check values over the ASCII string "123456789"
+static void testCheckValues() {
+  const uint8_t check[] = { '1', '2', '3', '4', '5', '6', '7', '8', '9' };
+  RadioLibCRC crc;
+
+  crc.size = 8;
+  crc.poly = 0x07;
+  crc.init = 0x00;
+  crc.out = 0x00;
+  TEST_CHECK(crc.checksum(check, sizeof(check)) == 0xF4, "CRC-8");
+
+  crc.size = 16;
+  crc.poly = RADIOLIB_CRC_CCITT_POLY;
+  crc.init = 0xFFFF;
+  crc.out = 0x0000;
+  TEST_CHECK(crc.checksum(check, sizeof(check)) == 0x29B1, "CRC-16/CCITT-FALSE");
+
+  crc.refIn = true;
+  crc.refOut = true;
+  crc.init = 0x0000;
+  TEST_CHECK(crc.checksum(check, sizeof(check)) == 0x2189, "CRC-16/KERMIT");
+
+  crc.size = 32;
+  crc.poly = 0x04C11DB7;
+  crc.init = 0xFFFFFFFF;
+  crc.out = 0xFFFFFFFF;
+  TEST_CHECK(crc.checksum(check, sizeof(check)) == 0xCBF43926, "CRC-32");
+
+  crc.size = 5;
+  crc.poly = 0x05;
+  crc.init = 0x1F;
+  crc.out = 0x1F;
+  TEST_CHECK(crc.checksum(check, sizeof(check)) == 0x19, "CRC-5/USB");
+}
+
+// random configurations, all reflection combinations, whole buffers and buffers split at random points
+static void testRandom() {
+  static uint8_t data[TEST_CRC_MAX_LEN];
+  for(size_t i = 0; i < sizeof(data); i++) {
+    data[i] = (uint8_t)rng();
+  }
+
+  // one instance for everything, so that the lookup tables are regenerated whenever the configuration changes
+  RadioLibCRC crc;
+  size_t mismatches = 0;
+  size_t splitMismatches = 0;
+  for(size_t c = 0; c < TEST_CRC_CONFIGS; c++) {
+    crc.size = 1 + rng() % 32;
+    uint32_t mask = (uint32_t)0xFFFFFFFF >> (32 - crc.size);
+    crc.poly = (rng() & mask) | 0x01;
+    crc.init = rng() & mask;
+    crc.out = rng() & mask;
+
+    for(uint8_t ref = 0; ref < 4; ref++) {
+      crc.refIn = ref & 0x01;
+      crc.refOut = ref & 0x02;
+
+      // short buffers before and after the tables were generated, and long ones
+      size_t lens[] = { rng() % 16, TEST_CRC_MAX_LEN, rng() % 16, rng() % (TEST_CRC_MAX_LEN + 1) };
+      for(size_t len : lens) {
+        uint32_t expected = reference(&crc, data, len);
+        if(crc.checksum(data, len) != expected) {
+          mismatches++;
+          printf("size %u, poly 0x%08lX, init 0x%08lX, out 0x%08lX, refIn %d, refOut %d, %u bytes\n",
+            crc.size, (unsigned long)crc.poly, (unsigned long)crc.init, (unsigned long)crc.out,
+            crc.refIn, crc.refOut, (unsigned int)len);
+        }
+
+        // the same data in three parts of random length
+        size_t split1 = rng() % (len + 1);
+        size_t split2 = split1 + rng() % (len - split1 + 1);
+        uint32_t running = crc.update(crc.init, data, split1);
+        running = crc.update(running, &data[split1], split2 - split1);
+        running = crc.update(running, &data[split2], len - split2);
+        if(crc.finish(running) != expected) {
+          splitMismatches++;
+          printf("size %u, poly 0x%08lX, refIn %d, refOut %d, %u bytes split at %u and %u\n",
+            crc.size, (unsigned long)crc.poly, crc.refIn, crc.refOut,
+            (unsigned int)len, (unsigned int)split1, (unsigned int)split2);
+        }
+      }
+    }
+  }
+  TEST_CHECK(mismatches == 0, "%u checksums do not match the reference", (unsigned int)mismatches);
+  TEST_CHECK(splitMismatches == 0, "%u split updates do not match the reference", (unsigned int)splitMismatches);
+}
+
+int main() {
+  testCheckValues();
+  testRandom();
+
+  char name[32];
+  snprintf(name, sizeof(name), "test_crc (table %d)", RADIOLIB_CRC_TABLE);
+  return(testResult(name));
+}
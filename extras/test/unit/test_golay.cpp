@@ -0,0 +1,126 @@
+// Golay(23, 12) and extended Golay(24, 12) error correction, and Horus Binary framing
+
+#include <RadioLib.h>
+
+#include <string.h>
+
+#include "TestUtils.h"
+
+// every error pattern of up to 3 bits must be corrected
+static void testGolayExhaustive(bool ext) {
+  RadioLibGolay golay;
+  golay.begin(ext);
+  uint8_t numBits = ext ? 24 : 23;
+  size_t failed = 0;
+  size_t undetected = 0;
+  for(uint16_t data = 0; data < 4096; data++) {
+    uint32_t cw = golay.encode(data);
+    // systematic code, the data word is above the 11 check bits, the extended code adds parity on top
+    if(((cw >> 11) & 0x0FFF) != data) {
+      failed++;
+      continue;
+    }
+
+    // the decoder only looks at the syndrome, so all error patterns are only tried on a sample of the data words
+    if(data % 13) {
+      continue;
+    }
+
+    // no error, then all single, double and triple errors
+    for(uint8_t a = 0; a <= numBits; a++) {
+      for(uint8_t b = a + 1; b <= numBits + 1; b++) {
+        for(uint8_t c = b + 1; c <= numBits + 2; c++) {
+          // positions beyond the code word do not add an error
+          uint32_t err = 0;
+          err |= (a < numBits) ? ((uint32_t)1 << a) : 0;
+          err |= (b < numBits) ? ((uint32_t)1 << b) : 0;
+          err |= (c < numBits) ? ((uint32_t)1 << c) : 0;
+          if(((a >= numBits) && (b != numBits + 1)) || ((b >= numBits) && (c != numBits + 2))) {
+            // skip duplicates of patterns with fewer errors
+            continue;
+          }
+
+          uint32_t rx = cw ^ err;
+          int8_t numErrors = golay.decode(&rx);
+          if((rx != cw) || (numErrors != (int8_t)rlb_popcount(err))) {
+            failed++;
+          }
+        }
+      }
+    }
+
+    // the extended code also detects 4 errors
+    if(ext) {
+      for(uint8_t i = 0; i < 16; i++) {
+        uint32_t err = 0;
+        while(rlb_popcount(err) < 4) {
+          err |= (uint32_t)1 << (rng() % 24);
+        }
+        uint32_t rx = cw ^ err;
+        if((golay.decode(&rx) >= 0) || (rx != (cw ^ err))) {
+          undetected++;
+        }
+      }
+    }
+  }
+  TEST_CHECK(failed == 0, "%s: %lu error patterns not corrected", ext ? "Golay(24, 12)" : "Golay(23, 12)", (unsigned long)failed);
+  TEST_CHECK(undetected == 0, "Golay(24, 12): %lu 4-bit errors not detected", (unsigned long)undetected);
+}
+
+// Horus Binary v1 example packet, and the frame generated by the reference Horus modem
+static const uint8_t horusPayload[] = {
+  0x00, 0x00, 0x00, 0x01, 0x17, 0x2D, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0xD2, 0x04,
+  0x63, 0x01, 0x0A, 0xFF, 0x27, 0x80,
+};
+
+static const uint8_t horusFrame[] = {
+  0x24, 0x24, 0x48, 0x2F, 0x12, 0x16, 0x08, 0x15, 0xC1, 0x49, 0xB2, 0x06, 0xFC, 0x92, 0xEB, 0x93,
+  0xD7, 0xEE, 0x5D, 0x35, 0xA0, 0x91, 0xDA, 0x8D, 0x5F, 0x85, 0x6B, 0x63, 0x03, 0x6B, 0x60, 0xEA,
+  0xFE, 0x55, 0x9D, 0xF1, 0xAB, 0xE5, 0x5E, 0xDB, 0x7C, 0xDB, 0x21, 0x5A, 0x19,
+};
+
+static void testHorus() {
+  uint8_t frame[160];
+  uint8_t payload[64];
+
+  // byte-for-byte match with the reference frame, and back
+  TEST_CHECK(FSK4Client::getHorusFrameLen(sizeof(horusPayload)) == sizeof(horusFrame), "frame length");
+  TEST_CHECK(FSK4Client::encodeHorus(horusPayload, sizeof(horusPayload), frame) == RADIOLIB_ERR_NONE, "encode");
+  TEST_CHECK(memcmp(frame, horusFrame, sizeof(horusFrame)) == 0, "frame differs from the reference");
+  size_t numErrors = 1;
+  TEST_CHECK(FSK4Client::decodeHorus(horusFrame, payload, sizeof(horusPayload), &numErrors) == RADIOLIB_ERR_NONE, "decode");
+  TEST_CHECK(memcmp(payload, horusPayload, sizeof(horusPayload)) == 0, "decoded payload differs");
+  TEST_CHECK(numErrors == 0, "%lu errors in the reference frame", (unsigned long)numErrors);
+
+  // round trip with random payloads, up to 3 bit errors anywhere after the unique word are always correctable,
+  // since the interleaver is a permutation and the scrambler does not spread errors
+  size_t failed = 0;
+  for(size_t t = 0; t < 2000; t++) {
+    size_t len = 1 + rng() % 60;
+    uint8_t in[64];
+    for(size_t i = 0; i < len; i++) {
+      in[i] = (uint8_t)rng();
+    }
+    FSK4Client::encodeHorus(in, len, frame);
+    size_t frameLen = FSK4Client::getHorusFrameLen(len);
+    size_t numFlipped = t % 4;
+    for(size_t k = 0; k < numFlipped; k++) {
+      size_t bit = 16 + (rng() % ((frameLen - 2) * 8));
+      frame[bit / 8] ^= 0x80 >> (bit % 8);
+    }
+
+    memset(payload, 0, sizeof(payload));
+    int16_t state = FSK4Client::decodeHorus(frame, payload, len, &numErrors);
+    if((state != RADIOLIB_ERR_NONE) || (memcmp(payload, in, len) != 0) || (numErrors > numFlipped)) {
+      failed++;
+    }
+  }
+  TEST_CHECK(failed == 0, "%lu of 2000 frames failed the round trip", (unsigned long)failed);
+}
+
+int main() {
+  testGolayExhaustive(false);
+  testGolayExhaustive(true);
+  testHorus();
+  return(testResult("golay"));
+}
@@ -0,0 +1,156 @@
+// Reed-Solomon code over GF(2^8), encoding checked by evaluating the code words at the generator roots,
+// decoding checked with random errors within the correction capacity
+
+#include <RadioLib.h>
+
+#include <string.h>
+
+#include "TestUtils.h"
+
+// reference GF(2^8) multiplication, bit by bit with the primitive polynomial 0x11D
+static uint8_t gfMul(uint8_t a, uint8_t b) {
+  uint8_t res = 0;
+  while(b) {
+    if(b & 0x01) {
+      res ^= a;
+    }
+    a = (a & 0x80) ? ((a << 1) ^ 0x1D) : (a << 1);
+    b >>= 1;
+  }
+  return(res);
+}
+
+static uint8_t gfPow2(uint16_t power) {
+  uint8_t res = 1;
+  for(uint16_t i = 0; i < power % 255; i++) {
+    res = gfMul(res, 2);
+  }
+  return(res);
+}
+
+// a valid code word evaluates to zero at every root of the generator polynomial
+static bool isCodeWord(const uint8_t* block, size_t len, uint8_t nsym, uint8_t fcr) {
+  for(uint8_t i = 0; i < nsym; i++) {
+    uint8_t root = gfPow2(fcr + i);
+    uint8_t val = 0;
+    for(size_t j = 0; j < len; j++) {
+      val = gfMul(val, root) ^ block[j];
+    }
+    if(val) {
+      return(false);
+    }
+  }
+  return(true);
+}
+
+static void testCode(uint8_t nsym, uint8_t fcr) {
+  RadioLibReedSolomon rs;
+  TEST_CHECK(rs.begin(nsym, fcr) == RADIOLIB_ERR_NONE, "begin(%d, %d)", nsym, fcr);
+
+  size_t notCodeWord = 0;
+  size_t failed = 0;
+  size_t wrongCount = 0;
+  for(size_t t = 0; t < 500; t++) {
+    // random shortened code word, including the full length
+    size_t dataLen = (t == 0) ? (RADIOLIB_RS_MAX_N - nsym) : (1 + rng() % (RADIOLIB_RS_MAX_N - nsym));
+    size_t len = dataLen + nsym;
+    uint8_t block[RADIOLIB_RS_MAX_N];
+    uint8_t orig[RADIOLIB_RS_MAX_N];
+    for(size_t i = 0; i < dataLen; i++) {
+      block[i] = (uint8_t)rng();
+    }
+    rs.encode(block, dataLen, &block[dataLen]);
+    memcpy(orig, block, len);
+    if(!isCodeWord(block, len, nsym, fcr)) {
+      notCodeWord++;
+    }
+
+    // corrupt up to nsym/2 distinct bytes, cycling through the number of errors
+    size_t numCorrupted = RADIOLIB_MIN(t % (nsym/2 + 1), len);
+    size_t corrupted = 0;
+    while(corrupted < numCorrupted) {
+      size_t pos = rng() % len;
+      if(block[pos] == orig[pos]) {
+        block[pos] ^= 1 + rng() % 255;
+        corrupted++;
+      }
+    }
+
+    uint8_t numErrors = 0xFF;
+    int16_t state = rs.decode(block, len, &numErrors);
+    if((state != RADIOLIB_ERR_NONE) || (memcmp(block, orig, len) != 0)) {
+      failed++;
+    } else if(numErrors != numCorrupted) {
+      wrongCount++;
+    }
+  }
+  TEST_CHECK(notCodeWord == 0, "nsym %d fcr %d: %lu invalid code words", nsym, fcr, (unsigned long)notCodeWord);
+  TEST_CHECK(failed == 0, "nsym %d fcr %d: %lu blocks not corrected", nsym, fcr, (unsigned long)failed);
+  TEST_CHECK(wrongCount == 0, "nsym %d fcr %d: %lu wrong error counts", nsym, fcr, (unsigned long)wrongCount);
+}
+
+int main() {
+  // RS(255, 223) with the common first roots, and a few other parity lengths
+  testCode(32, 0);
+  testCode(32, 1);
+  testCode(32, 112);
+  testCode(2, 0);
+  testCode(8, 1);
+  testCode(16, 0);
+  testCode(RADIOLIB_RS_MAX_PARITY, 0);
+
+  // invalid configuration and length
+  RadioLibReedSolomon rs;
+  TEST_CHECK(rs.begin(0) != RADIOLIB_ERR_NONE, "zero parity bytes accepted");
+  TEST_CHECK(rs.begin(RADIOLIB_RS_MAX_PARITY + 1) != RADIOLIB_ERR_NONE, "too many parity bytes accepted");
+  uint8_t block[RADIOLIB_RS_MAX_N + 1] = { 0 };
+  rs.begin(32);
+  TEST_CHECK(rs.encode(block, RADIOLIB_RS_MAX_N - 31, &block[RADIOLIB_RS_MAX_N - 31]) == RADIOLIB_ERR_PACKET_TOO_LONG, "too long block accepted");
+
+  // beyond the capacity, the decoder must not claim success with data that differ from the original
+  rs.begin(32);
+  size_t miscorrected = 0;
+  for(size_t t = 0; t < 500; t++) {
+    uint8_t orig[RADIOLIB_RS_MAX_N];
+    for(size_t i = 0; i < 223; i++) {
+      block[i] = (uint8_t)rng();
+    }
+    rs.encode(block, 223, &block[223]);
+    memcpy(orig, block, RADIOLIB_RS_MAX_N);
+    for(size_t e = 0; e < 20; e++) {
+      block[rng() % RADIOLIB_RS_MAX_N] ^= 1 + rng() % 255;
+    }
+    if((rs.decode(block, RADIOLIB_RS_MAX_N) == RADIOLIB_ERR_NONE) && (memcmp(block, orig, RADIOLIB_RS_MAX_N) != 0)) {
+      miscorrected++;
+    }
+  }
+  TEST_CHECK(miscorrected == 0, "%lu blocks with 20 corrupted bytes miscorrected", (unsigned long)miscorrected);
+
+  // random bit errors - with up to 16 corrupted bytes RS(255, 223) recovers blocks which would be lost without it
+  for(double ber = 1e-3; ber < 3e-2; ber *= 3) {
+    size_t rawOk = 0;
+    size_t rsOk = 0;
+    for(size_t t = 0; t < 1000; t++) {
+      uint8_t orig[RADIOLIB_RS_MAX_N];
+      for(size_t i = 0; i < 223; i++) {
+        block[i] = (uint8_t)rng();
+      }
+      rs.encode(block, 223, &block[223]);
+      memcpy(orig, block, RADIOLIB_RS_MAX_N);
+      for(size_t i = 0; i < 8*RADIOLIB_RS_MAX_N; i++) {
+        if(rng() < ber * 4294967296.0) {
+          block[i / 8] ^= 0x80 >> (i % 8);
+        }
+      }
+      rawOk += (memcmp(block, orig, 223) == 0);
+      rsOk += ((rs.decode(block, RADIOLIB_RS_MAX_N) == RADIOLIB_ERR_NONE) && (memcmp(block, orig, 223) == 0));
+    }
+    printf("BER %.4f: %4lu of 1000 blocks received without RS, %4lu with RS(255, 223)\n", ber, (unsigned long)rawOk, (unsigned long)rsOk);
+    TEST_CHECK(rsOk >= rawOk, "BER %f: RS made it worse", ber);
+    if(ber < 4e-3) {
+      TEST_CHECK(rsOk >= 990, "BER %f: only %lu blocks recovered", ber, (unsigned long)rsOk);
+    }
+  }
+
+  return(testResult("rs"));
+}
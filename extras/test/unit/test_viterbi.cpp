@@ -0,0 +1,146 @@
+// Viterbi decoding of the convolutional code, bit error rate over binary symmetric and Gaussian channels
+
+#include <RadioLib.h>
+
+#include <math.h>
+#include <string.h>
+
+#include "TestUtils.h"
+
+// payload length in bits, followed by zero tail bits that return the encoder to the initial state
+#define TEST_VITERBI_DATA_BITS                                  (480)
+#define TEST_VITERBI_TOTAL_BITS                                 (512)
+#define TEST_VITERBI_FRAMES                                     (200)
+
+static double rngUniform() {
+  return((rng() + 0.5) / 4294967296.0);
+}
+
+static double rngGauss() {
+  return(sqrt(-2.0 * log(rngUniform())) * cos(2.0 * M_PI * rngUniform()));
+}
+
+static size_t countErrors(const uint8_t* a, const uint8_t* b) {
+  size_t errs = 0;
+  for(size_t i = 0; i < TEST_VITERBI_DATA_BITS; i++) {
+    errs += getBit(a, i) ^ getBit(b, i);
+  }
+  return(errs);
+}
+
+// encode a random frame, returns the number of encoded bits
+static size_t encodeFrame(RadioLibConvCode* conv, uint8_t rate, uint8_t* data, uint8_t* enc) {
+  memset(data, 0, TEST_VITERBI_TOTAL_BITS / 8);
+  for(size_t i = 0; i < TEST_VITERBI_DATA_BITS / 8; i++) {
+    data[i] = (uint8_t)rng();
+  }
+  memset(enc, 0, 3 * TEST_VITERBI_TOTAL_BITS / 8);
+  size_t bits = 0;
+  conv->begin(rate);
+  conv->encode(data, TEST_VITERBI_TOTAL_BITS, enc, &bits);
+  return(bits);
+}
+
+// hard decisions over a binary symmetric channel with bit error probability p
+static double berHard(uint8_t rate, double p) {
+  RadioLibConvCode conv;
+  uint8_t data[TEST_VITERBI_TOTAL_BITS / 8];
+  uint8_t enc[3 * TEST_VITERBI_TOTAL_BITS / 8];
+  uint8_t dec[TEST_VITERBI_TOTAL_BITS / 8];
+  size_t errs = 0;
+  for(size_t f = 0; f < TEST_VITERBI_FRAMES; f++) {
+    size_t bits = encodeFrame(&conv, rate, data, enc);
+    for(size_t i = 0; i < bits; i++) {
+      if(rngUniform() < p) {
+        enc[i / 8] ^= 0x80 >> (i % 8);
+      }
+    }
+    size_t decBits = 0;
+    conv.decode(enc, bits, dec, &decBits);
+    TEST_CHECK(decBits == TEST_VITERBI_TOTAL_BITS, "decoded %lu bits", (unsigned long)decBits);
+    errs += countErrors(data, dec);
+  }
+  return((double)errs / (TEST_VITERBI_FRAMES * TEST_VITERBI_DATA_BITS));
+}
+
+// BPSK over Gaussian channel at the given Eb/N0, decoded with soft and hard decisions
+static void berGauss(uint8_t rate, double ebN0dB, double* soft, double* hard) {
+  RadioLibConvCode conv;
+  uint8_t data[TEST_VITERBI_TOTAL_BITS / 8];
+  uint8_t enc[3 * TEST_VITERBI_TOTAL_BITS / 8];
+  uint8_t hardBits[3 * TEST_VITERBI_TOTAL_BITS / 8];
+  int8_t softBits[3 * TEST_VITERBI_TOTAL_BITS];
+  uint8_t dec[TEST_VITERBI_TOTAL_BITS / 8];
+  double sigma = sqrt(rate / (2.0 * pow(10.0, ebN0dB / 10.0)));
+  size_t errsSoft = 0;
+  size_t errsHard = 0;
+  for(size_t f = 0; f < TEST_VITERBI_FRAMES; f++) {
+    size_t bits = encodeFrame(&conv, rate, data, enc);
+    memset(hardBits, 0, sizeof(hardBits));
+    for(size_t i = 0; i < bits; i++) {
+      double x = (getBit(enc, i) ? 1.0 : -1.0) + sigma * rngGauss();
+      double v = RADIOLIB_MAX(-127.0, RADIOLIB_MIN(127.0, 40.0 * x));
+      softBits[i] = (int8_t)v;
+      if(x > 0) {
+        hardBits[i / 8] |= 0x80 >> (i % 8);
+      }
+    }
+    conv.decodeSoft(softBits, bits, dec);
+    errsSoft += countErrors(data, dec);
+    conv.decode(hardBits, bits, dec);
+    errsHard += countErrors(data, dec);
+  }
+  *soft = (double)errsSoft / (TEST_VITERBI_FRAMES * TEST_VITERBI_DATA_BITS);
+  *hard = (double)errsHard / (TEST_VITERBI_FRAMES * TEST_VITERBI_DATA_BITS);
+}
+
+int main() {
+  for(uint8_t rate = 2; rate <= 3; rate++) {
+    // error-free channel must decode exactly
+    double ber = berHard(rate, 0.0);
+    TEST_CHECK(ber == 0.0, "rate 1/%d error-free BER %f", rate, ber);
+
+    // a single error anywhere in the frame is always corrected
+    RadioLibConvCode conv;
+    uint8_t data[TEST_VITERBI_TOTAL_BITS / 8];
+    uint8_t enc[3 * TEST_VITERBI_TOTAL_BITS / 8];
+    uint8_t dec[TEST_VITERBI_TOTAL_BITS / 8];
+    size_t bits = encodeFrame(&conv, rate, data, enc);
+    size_t uncorrected = 0;
+    for(size_t i = 0; i < bits; i++) {
+      enc[i / 8] ^= 0x80 >> (i % 8);
+      conv.decode(enc, bits, dec);
+      uncorrected += (countErrors(data, dec) != 0);
+      enc[i / 8] ^= 0x80 >> (i % 8);
+    }
+    TEST_CHECK(uncorrected == 0, "rate 1/%d single errors not corrected at %lu positions", rate, (unsigned long)uncorrected);
+  }
+
+  // binary symmetric channel, hard decisions
+  double ber = berHard(2, 0.02);
+  TEST_CHECK(ber < 1e-3, "rate 1/2 BSC p = 0.02 BER %f", ber);
+  ber = berHard(3, 0.05);
+  TEST_CHECK(ber < 1e-3, "rate 1/3 BSC p = 0.05 BER %f", ber);
+
+  // Gaussian channel - soft decisions must beat both hard decisions and uncoded BPSK
+  for(uint8_t rate = 2; rate <= 3; rate++) {
+    for(double ebN0dB = 1.0; ebN0dB <= 3.0; ebN0dB += 1.0) {
+      double soft = 0;
+      double hard = 0;
+      berGauss(rate, ebN0dB, &soft, &hard);
+      double uncoded = 0.5 * erfc(sqrt(pow(10.0, ebN0dB / 10.0)));
+      printf("rate 1/%d Eb/N0 %.0f dB: soft BER %.5f, hard BER %.5f, uncoded BER %.5f\n", rate, ebN0dB, soft, hard, uncoded);
+      TEST_CHECK(soft < hard, "rate 1/%d Eb/N0 %.0f dB soft decisions do not help", rate, ebN0dB);
+      if(ebN0dB >= 2.0) {
+        TEST_CHECK(soft < uncoded / 2, "rate 1/%d Eb/N0 %.0f dB no coding gain", rate, ebN0dB);
+      }
+    }
+  }
+
+  double soft = 0;
+  double hard = 0;
+  berGauss(2, 3.0, &soft, &hard);
+  TEST_CHECK(soft < 5e-3, "rate 1/2 Eb/N0 3 dB soft BER %f", soft);
+
+  return(testResult("viterbi"));
+}
@@ -114,6 +114,16 @@
   //#define RADIOLIB_CLOCK_DRIFT_MS                         (0)
 #endif
 
+/*
+ * Storage class of the flags set by interrupt service routines in protocols (LoRaWAN, PacketForwarder), shared by all instances.
+ * Can be set to thread_local to run several protocol instances in separate threads, as long as the interrupts
+ * are delivered in the thread that waits for them - e.g. in the host network simulator in extras/simulator.
+ * Note: Empty by default.
+ */
+#if !defined(RADIOLIB_THREAD_LOCAL)
+  #define RADIOLIB_THREAD_LOCAL
+#endif
+
 #if ARDUINO >= 100
   // Arduino build
   #include "Arduino.h"
@@ -445,6 +455,37 @@
   #define RADIOLIB_EXCLUDE_STM32WLX (1)
 #endif
 
+/*
+ * Table-driven CRC calculation, the value sets the number of 256-entry lookup tables RadioLibCRC generates
+ * for the configured CRC. Each table takes 1 kB of RAM.
+ * 0 - bit-by-bit calculation only.
+ * 1 - byte-wise calculation with a single table, several times faster than bit-by-bit.
+ * 4 or 8 - slice-by-4 or slice-by-8, processing 4 or 8 bytes per step, faster still on 32-bit CPUs with cache.
+ * CRCs shorter than 8 bits always use the bit-by-bit calculation.
+ * Note: Disabled by default, as the tables are kept in RAM.
+ */
+#if !defined(RADIOLIB_CRC_TABLE)
+  #define RADIOLIB_CRC_TABLE  (0)
+#endif
+
+/*
+ * AES-128 implementation used by RadioLibAES128 for encryption, one of the following:
+ * RADIOLIB_AES128_BACKEND_COMPACT - byte-oriented implementation, smallest but also slowest.
+ * RADIOLIB_AES128_BACKEND_TTABLE - 32-bit lookup table implementation, several times faster,
+ * but takes additional 1 kB of program storage. The table lookups depend on the key and data,
+ * so on CPUs with data cache, the key may leak through cache timing. Only enable it when that is not a concern.
+ * RADIOLIB_AES128_BACKEND_HW - AES-NI instructions on x86. Only available when compiling for a CPU
+ * that has them (e.g. with -maes), otherwise the compact implementation is used.
+ * Decryption always uses the compact implementation, as none of the protocols need it on the hot path.
+ * Note: Compact implementation is the default.
+ */
+#define RADIOLIB_AES128_BACKEND_COMPACT   (0)
+#define RADIOLIB_AES128_BACKEND_TTABLE    (1)
+#define RADIOLIB_AES128_BACKEND_HW        (2)
+#if !defined(RADIOLIB_AES128_BACKEND)
+  #define RADIOLIB_AES128_BACKEND  (RADIOLIB_AES128_BACKEND_COMPACT)
+#endif
+
 // if verbose assert is enabled, enable basic debug too
 #if RADIOLIB_VERBOSE_ASSERT
   #define RADIOLIB_DEBUG  (1)
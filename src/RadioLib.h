@@ -115,9 +115,11 @@
 #include "protocols/Print/Print.h"
 #include "protocols/BellModem/BellModem.h"
 #include "protocols/LoRaWAN/LoRaWAN.h"
+#include "protocols/PacketForwarder/PacketForwarder.h"
 
 // utilities
 #include "utils/CRC.h"
 #include "utils/Cryptography.h"
+#include "utils/Coding.h"
 
 #endif
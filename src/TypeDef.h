@@ -598,6 +598,41 @@
 */
 #define RADIOLIB_ERR_INVALID_MODE                               (-1121)
 
+/*!
+  \brief The requested LoRaWAN multicast group is not defined.
+*/
+#define RADIOLIB_ERR_MULTICAST_GROUP_UNDEFINED                  (-1122)
+
+/*!
+  \brief The user-provided storage is too small for the requested operation.
+*/
+#define RADIOLIB_ERR_STORAGE_TOO_SMALL                          (-1123)
+
+/*!
+  \brief The relay trust list is full, or the end device is not in the trust list.
+*/
+#define RADIOLIB_ERR_RELAY_DEVICE_UNAVAILABLE                   (-1124)
+
+/*!
+  \brief The network time is not known, no DeviceTimeAns has been received yet.
+*/
+#define RADIOLIB_ERR_NO_NETWORK_TIME                            (-1125)
+
+/*!
+  \brief No free entry is left in the registry of proprietary MAC commands.
+*/
+#define RADIOLIB_ERR_MAC_COMMAND_REGISTRY_FULL                  (-1126)
+
+/*!
+  \brief No aggregation buffer is free for a new FPort, or the record does not fit after sending the buffered ones.
+*/
+#define RADIOLIB_ERR_AGGREGATION_BUFFER_FULL                    (-1127)
+
+/*!
+  \brief The relay did not acknowledge the wake-on-radio frame, so the uplink was not sent.
+*/
+#define RADIOLIB_ERR_RELAY_NO_ACK                               (-1128)
+
 // LR11x0-specific status codes
 
 /*!
@@ -626,6 +661,28 @@
 #define RADIOLIB_ERR_GNSS_SOLVER(X)                             (RADIOLIB_ERR_GNSS_SOLVER_OFFSET - (X))
 #define RADIOLIB_GET_GNSS_SOLVER_ERROR(X)                       (-((X) - RADIOLIB_ERR_GNSS_SOLVER_OFFSET))
 
+// packet forwarder status codes
+
+/*!
+  \brief The requested radio (RF chain) is not available, or too many radios were added.
+*/
+#define RADIOLIB_ERR_FORWARDER_RADIO_UNAVAILABLE                (-1301)
+
+/*!
+  \brief There is no space left in the downlink queue.
+*/
+#define RADIOLIB_ERR_FORWARDER_QUEUE_FULL                       (-1302)
+
+/*!
+  \brief The downlink timestamp has already passed.
+*/
+#define RADIOLIB_ERR_FORWARDER_TOO_LATE                         (-1303)
+
+/*!
+  \brief The downlink timestamp is too far in the future.
+*/
+#define RADIOLIB_ERR_FORWARDER_TOO_EARLY                        (-1304)
+
 /*!
   \}
 */
@@ -1240,6 +1240,10 @@ int16_t LR11x0::setCRC(uint8_t len, uint32_t initial, uint32_t polynomial, bool
   return(state);
 }
 
+int16_t LR11x0::setPayloadCRC(bool enable) {
+  return(this->setCRC(enable ? 2 : 0));
+}
+
 int16_t LR11x0::invertIQ(bool enable) {
   // check active modem
   uint8_t type = RADIOLIB_LR11X0_PACKET_TYPE_NONE;
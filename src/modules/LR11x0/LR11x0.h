@@ -1322,6 +1322,13 @@ class LR11x0: public PhysicalLayer {
     */
     int16_t setCRC(uint8_t len, uint32_t initial = 0x00001D0FUL, uint32_t polynomial = 0x00001021UL, bool inverted = true);
 
+    /*!
+      \brief Enable or disable the payload CRC, using the default 2-byte CRC.
+      \param enable Enable (true) or disable (false) CRC.
+      \returns \ref status_codes
+    */
+    int16_t setPayloadCRC(bool enable) override;
+
     /*!
       \brief Enable/disable inversion of the I and Q signals
       \param enable QI inversion enabled (true) or disabled (false);
@@ -1434,6 +1434,10 @@ int16_t SX126x::setCRC(uint8_t len, uint16_t initial, uint16_t polynomial, bool
   return(RADIOLIB_ERR_UNKNOWN);
 }
 
+int16_t SX126x::setPayloadCRC(bool enable) {
+  return(this->setCRC(enable ? 2 : 0));
+}
+
 int16_t SX126x::setWhitening(bool enabled, uint16_t initial) {
   // check active modem
   if(getPacketType() != RADIOLIB_SX126X_PACKET_TYPE_GFSK) {
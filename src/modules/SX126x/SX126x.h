@@ -1148,6 +1148,18 @@ class SX126x: public PhysicalLayer {
     */
     int16_t setCRC(uint8_t len, uint16_t initial = 0x1D0F, uint16_t polynomial = 0x1021, bool inverted = true);
 
+    /*!
+      \brief Enable or disable the payload CRC, using the default 2-byte CRC.
+      \param enable Enable (true) or disable (false) CRC.
+      \returns \ref status_codes
+    */
+    int16_t setPayloadCRC(bool enable)
+    #if RADIOLIB_EXCLUDE_SX126X_PHYSICAL_LAYER
+    ;
+    #else
+    override;
+    #endif
+
     /*!
       \brief Sets FSK whitening parameters.
       \param enabled True = Whitening enabled
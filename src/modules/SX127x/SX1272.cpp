@@ -473,6 +473,10 @@ int16_t SX1272::setCRC(bool enable, bool mode) {
   }
 }
 
+int16_t SX1272::setPayloadCRC(bool enable) {
+  return(this->setCRC(enable));
+}
+
 int16_t SX1272::forceLDRO(bool enable) {
   if(getActiveModem() != RADIOLIB_SX127X_LORA) {
     return(RADIOLIB_ERR_WRONG_MODEM);
@@ -285,6 +285,13 @@ class SX1278: public SX127x {
     */
     int16_t setCRC(bool enable, bool mode = false);
 
+    /*!
+      \brief Enable or disable the payload CRC, using the default CCITT CRC.
+      \param enable Enable (true) or disable (false) CRC.
+      \returns \ref status_codes
+    */
+    int16_t setPayloadCRC(bool enable) override;
+
     /*!
       \brief Forces LoRa low data rate optimization. Only available in LoRa mode. After calling this method,
       LDRO will always be set to the provided value, regardless of symbol length.
@@ -1192,6 +1192,10 @@ int16_t SX128x::setCRC(uint8_t len, uint32_t initial, uint16_t polynomial) {
   return(RADIOLIB_ERR_UNKNOWN);
 }
 
+int16_t SX128x::setPayloadCRC(bool enable) {
+  return(this->setCRC(enable ? 2 : 0));
+}
+
 int16_t SX128x::setWhitening(bool enabled) {
   // check active modem
   uint8_t modem = getPacketType();
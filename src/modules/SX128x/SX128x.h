@@ -750,6 +750,13 @@ class SX128x: public PhysicalLayer {
     */
     int16_t setCRC(uint8_t len, uint32_t initial = 0x1D0F, uint16_t polynomial = 0x1021);
 
+    /*!
+      \brief Enable or disable the payload CRC, using the default 2-byte CRC.
+      \param enable Enable (true) or disable (false) CRC.
+      \returns \ref status_codes
+    */
+    int16_t setPayloadCRC(bool enable) override;
+
     /*!
       \brief Sets whitening parameters, not available for LoRa or FLRC modem.
       \param enabled Set to true to enable whitening.
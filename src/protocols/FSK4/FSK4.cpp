@@ -1,5 +1,6 @@
 #include "FSK4.h"
 #include <math.h>
+#include <string.h>
 #if !RADIOLIB_EXCLUDE_FSK4
 
 FSK4Client::FSK4Client(PhysicalLayer* phy) {
@@ -54,7 +55,45 @@ int16_t FSK4Client::setCorrection(int16_t offsets[], float length) {
   return(RADIOLIB_ERR_NONE);
 }
 
+int16_t FSK4Client::setFraming(uint8_t framing) {
+  if((framing != RADIOLIB_FSK4_FRAMING_NONE) && (framing != RADIOLIB_FSK4_FRAMING_HORUS)) {
+    return(RADIOLIB_ERR_INVALID_ENCODING);
+  }
+  this->framing = framing;
+  return(RADIOLIB_ERR_NONE);
+}
+
 size_t FSK4Client::write(uint8_t* buff, size_t len) {
+  if(this->framing == RADIOLIB_FSK4_FRAMING_HORUS) {
+    if(!buff) {
+      return(0);
+    }
+
+    // the frame and the code words before interleaving share one buffer
+    size_t frameLen = FSK4Client::getHorusFrameLen(len);
+    size_t codedLen = frameLen - RADIOLIB_FSK4_HORUS_UNIQUE_WORD_LEN;
+    #if RADIOLIB_STATIC_ONLY
+      if(frameLen + codedLen > RADIOLIB_STATIC_ARRAY_SIZE) {
+        return(0);
+      }
+      uint8_t frame[RADIOLIB_STATIC_ARRAY_SIZE];
+    #else
+      uint8_t* frame = new uint8_t[frameLen + codedLen];
+      if(!frame) {
+        return(0);
+      }
+    #endif
+    FSK4Client::encodeHorus(buff, len, frame, &frame[frameLen]);
+    for(size_t i = 0; i < frameLen; i++) {
+      FSK4Client::write(frame[i]);
+    }
+    FSK4Client::standby();
+    #if !RADIOLIB_STATIC_ONLY
+      delete[] frame;
+    #endif
+    return(len);
+  }
+
   size_t n = 0;
   for(size_t i = 0; i < len; i++) {
     n += FSK4Client::write(buff[i]);
@@ -107,6 +146,168 @@ int16_t FSK4Client::standby() {
   return(phyLayer->standby());
 }
 
+size_t FSK4Client::getHorusFrameLen(size_t len) {
+  // each 12 bits of payload get 11 check bits
+  size_t numBits = len*8;
+  size_t numCodeWords = (numBits + RADIOLIB_GOLAY_K - 1) / RADIOLIB_GOLAY_K;
+  numBits += RADIOLIB_FSK4_HORUS_UNIQUE_WORD_LEN*8 + numCodeWords*(RADIOLIB_GOLAY_N - RADIOLIB_GOLAY_K);
+  return((numBits + 7) / 8);
+}
+
+int16_t FSK4Client::encodeHorus(const uint8_t* in, size_t len, uint8_t* out) {
+  if(!in || !out) {
+    return(RADIOLIB_ERR_UNKNOWN);
+  }
+
+  size_t codedLen = FSK4Client::getHorusFrameLen(len) - RADIOLIB_FSK4_HORUS_UNIQUE_WORD_LEN;
+  #if RADIOLIB_STATIC_ONLY
+    if(codedLen > RADIOLIB_STATIC_ARRAY_SIZE) {
+      return(RADIOLIB_ERR_PACKET_TOO_LONG);
+    }
+    uint8_t coded[RADIOLIB_STATIC_ARRAY_SIZE];
+  #else
+    uint8_t* coded = new uint8_t[codedLen];
+    RADIOLIB_ASSERT_PTR(coded);
+  #endif
+  FSK4Client::encodeHorus(in, len, out, coded);
+
+  #if !RADIOLIB_STATIC_ONLY
+    delete[] coded;
+  #endif
+  return(RADIOLIB_ERR_NONE);
+}
+
+void FSK4Client::encodeHorus(const uint8_t* in, size_t len, uint8_t* out, uint8_t* coded) {
+  // the unique word is neither interleaved nor scrambled
+  size_t codedLen = FSK4Client::getHorusFrameLen(len) - RADIOLIB_FSK4_HORUS_UNIQUE_WORD_LEN;
+  memset(coded, 0x00, codedLen);
+  memcpy(coded, in, len);
+
+  // payload is followed by the check bits of all code words
+  RadioLibGolayInstance.begin();
+  uint8_t* parity = &coded[len];
+  size_t numBits = len*8;
+  size_t parityPos = 0;
+  for(size_t pos = 0; pos < numBits; pos += RADIOLIB_GOLAY_K) {
+    uint16_t dataword = 0;
+    size_t numDataBits = RADIOLIB_MIN(numBits - pos, (size_t)RADIOLIB_GOLAY_K);
+    for(size_t i = 0; i < numDataBits; i++) {
+      dataword = (dataword << 1) | GET_BIT_IN_ARRAY_LSB(in, pos + i);
+    }
+
+    // the last partial data word is shifted by one bit only, as done by the reference implementation
+    if(numDataBits < RADIOLIB_GOLAY_K) {
+      dataword <<= 1;
+    }
+
+    uint32_t codeword = RadioLibGolayInstance.encode(dataword);
+    for(int8_t i = RADIOLIB_GOLAY_N - RADIOLIB_GOLAY_K - 1; i >= 0; i--) {
+      if(codeword & ((uint32_t)1 << i)) {
+        SET_BIT_IN_ARRAY_LSB(parity, parityPos);
+      }
+      parityPos++;
+    }
+  }
+
+  out[0] = RADIOLIB_FSK4_HORUS_UNIQUE_WORD;
+  out[1] = RADIOLIB_FSK4_HORUS_UNIQUE_WORD;
+  rlb_interleave(coded, &out[RADIOLIB_FSK4_HORUS_UNIQUE_WORD_LEN], codedLen, FSK4Client::getHorusInterleaver(codedLen*8));
+  rlb_scramble(&out[RADIOLIB_FSK4_HORUS_UNIQUE_WORD_LEN], codedLen, RADIOLIB_FSK4_HORUS_SCRAMBLER_SEED);
+}
+
+int16_t FSK4Client::decodeHorus(const uint8_t* in, uint8_t* out, size_t len, size_t* numErrors) {
+  if(!in || !out) {
+    return(RADIOLIB_ERR_UNKNOWN);
+  }
+
+  // undo scrambling and interleaving
+  size_t codedLen = FSK4Client::getHorusFrameLen(len) - RADIOLIB_FSK4_HORUS_UNIQUE_WORD_LEN;
+  #if RADIOLIB_STATIC_ONLY
+    if(codedLen > RADIOLIB_STATIC_ARRAY_SIZE) {
+      return(RADIOLIB_ERR_PACKET_TOO_LONG);
+    }
+    uint8_t scrambled[RADIOLIB_STATIC_ARRAY_SIZE];
+    uint8_t coded[RADIOLIB_STATIC_ARRAY_SIZE];
+  #else
+    uint8_t* scrambled = new uint8_t[codedLen];
+    RADIOLIB_ASSERT_PTR(scrambled);
+    uint8_t* coded = new uint8_t[codedLen];
+    if(!coded) {
+      delete[] scrambled;
+      return(RADIOLIB_ERR_MEMORY_ALLOCATION_FAILED);
+    }
+  #endif
+  memcpy(scrambled, &in[RADIOLIB_FSK4_HORUS_UNIQUE_WORD_LEN], codedLen);
+  rlb_scramble(scrambled, codedLen, RADIOLIB_FSK4_HORUS_SCRAMBLER_SEED);
+  rlb_interleave(scrambled, coded, codedLen, FSK4Client::getHorusInterleaver(codedLen*8), true);
+
+  // correct the code words one by one
+  RadioLibGolayInstance.begin();
+  memset(out, 0x00, len);
+  const uint8_t* parity = &coded[len];
+  size_t numBits = len*8;
+  size_t parityPos = 0;
+  size_t errs = 0;
+  for(size_t pos = 0; pos < numBits; pos += RADIOLIB_GOLAY_K) {
+    uint32_t codeword = 0;
+    size_t numDataBits = RADIOLIB_MIN(numBits - pos, (size_t)RADIOLIB_GOLAY_K);
+    for(size_t i = 0; i < numDataBits; i++) {
+      codeword = (codeword << 1) | GET_BIT_IN_ARRAY_LSB(coded, pos + i);
+    }
+    if(numDataBits < RADIOLIB_GOLAY_K) {
+      codeword <<= 1;
+    }
+    for(uint8_t i = 0; i < RADIOLIB_GOLAY_N - RADIOLIB_GOLAY_K; i++) {
+      codeword = (codeword << 1) | GET_BIT_IN_ARRAY_LSB(parity, parityPos);
+      parityPos++;
+    }
+
+    int8_t corrected = RadioLibGolayInstance.decode(&codeword);
+    if(corrected > 0) {
+      errs += corrected;
+    }
+
+    // write back the data bits
+    uint16_t dataword = codeword >> (RADIOLIB_GOLAY_N - RADIOLIB_GOLAY_K);
+    if(numDataBits < RADIOLIB_GOLAY_K) {
+      dataword >>= 1;
+    }
+    for(size_t i = 0; i < numDataBits; i++) {
+      if(dataword & ((uint16_t)1 << (numDataBits - 1 - i))) {
+        SET_BIT_IN_ARRAY_LSB(out, pos + i);
+      }
+    }
+  }
+
+  #if !RADIOLIB_STATIC_ONLY
+    delete[] scrambled;
+    delete[] coded;
+  #endif
+
+  if(numErrors) {
+    *numErrors = errs;
+  }
+  return(RADIOLIB_ERR_NONE);
+}
+
+uint32_t FSK4Client::getHorusInterleaver(size_t numBits) {
+  for(uint32_t b = numBits - 1; b > 2; b--) {
+    bool prime = true;
+    for(uint32_t d = 2; d*d <= b; d++) {
+      if(b % d == 0) {
+        prime = false;
+        break;
+      }
+    }
+
+    // a prime that does not divide the number of bits is always coprime with it
+    if(prime && (numBits % b)) {
+      return(b);
+    }
+  }
+  return(1);
+}
+
 int32_t FSK4Client::getRawShift(int32_t shift) {
   // calculate module carrier frequency resolution
   int32_t step = round(phyLayer->getFreqStep());
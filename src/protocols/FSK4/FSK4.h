@@ -7,6 +7,17 @@
 
 #include "../PhysicalLayer/PhysicalLayer.h"
 #include "../AFSK/AFSK.h"
+#include "../../utils/FEC.h"
+#include "../../utils/Coding.h"
+
+// framing modes
+#define RADIOLIB_FSK4_FRAMING_NONE                              (0)
+#define RADIOLIB_FSK4_FRAMING_HORUS                             (1)
+
+// Horus Binary framing
+#define RADIOLIB_FSK4_HORUS_UNIQUE_WORD                         (0x24)
+#define RADIOLIB_FSK4_HORUS_UNIQUE_WORD_LEN                     (2)
+#define RADIOLIB_FSK4_HORUS_SCRAMBLER_SEED                      (0x4A80)
 
 /*!
   \class FSK4Client
@@ -53,11 +64,20 @@ class FSK4Client {
     */
     int16_t setCorrection(int16_t offsets[4], float length = 1.0f);
 
+    /*!
+      \brief Set framing applied to data transmitted by write(buff, len). Single bytes are always sent as they are.
+      \param framing Framing mode, one of RADIOLIB_FSK4_FRAMING_NONE (default)
+      or RADIOLIB_FSK4_FRAMING_HORUS (Horus Binary, see encodeHorus).
+      \returns \ref status_codes
+    */
+    int16_t setFraming(uint8_t framing);
+
     /*!
       \brief Transmit binary data.
       \param buff Buffer to transmit.
       \param len Number of bytes to transmit.
-      \returns Number of transmitted bytes.
+      \returns Number of transmitted bytes. When framing is enabled, this is the number of payload bytes,
+      or 0 if the frame could not be created.
     */
     size_t write(uint8_t* buff, size_t len);
 
@@ -74,6 +94,33 @@ class FSK4Client {
     */
     int16_t standby();
 
+    /*!
+      \brief Get length of Horus Binary frame for a given payload length.
+      \param len Payload length in bytes.
+      \returns Frame length in bytes, including the unique word.
+    */
+    static size_t getHorusFrameLen(size_t len);
+
+    /*!
+      \brief Create Horus Binary frame. The payload is protected by Golay(23, 12) code with all check bits
+      following the payload, then interleaved and scrambled. The unique word is prepended, preamble is not.
+      \param in Payload, e.g. 22 bytes of Horus Binary v1 packet including its checksum.
+      \param len Payload length in bytes.
+      \param out Buffer to save the frame into, must be at least getHorusFrameLen(len) bytes long.
+      \returns \ref status_codes
+    */
+    static int16_t encodeHorus(const uint8_t* in, size_t len, uint8_t* out);
+
+    /*!
+      \brief Decode Horus Binary frame and correct bit errors.
+      \param in Frame, including the unique word.
+      \param out Buffer to save the payload into.
+      \param len Payload length in bytes, the frame must be getHorusFrameLen(len) bytes long.
+      \param numErrors Pointer to a variable to save the number of corrected bit errors. Ignored if set to NULL.
+      \returns \ref status_codes
+    */
+    static int16_t decodeHorus(const uint8_t* in, uint8_t* out, size_t len, size_t* numErrors = NULL);
+
 #if !RADIOLIB_GODMODE
   private:
 #endif
@@ -87,9 +134,16 @@ class FSK4Client {
     RadioLibTime_t bitDuration = 0;
     uint32_t tones[4] = { 0 };
     uint32_t tonesHz[4] = { 0 };
+    uint8_t framing = RADIOLIB_FSK4_FRAMING_NONE;
 
     void tone(uint8_t i);
 
+    // interleaver multiplier for Horus Binary frame, largest prime smaller than the number of interleaved bits
+    static uint32_t getHorusInterleaver(size_t numBits);
+
+    // encode Horus Binary frame using a caller-provided buffer for the code words before interleaving
+    static void encodeHorus(const uint8_t* in, size_t len, uint8_t* out, uint8_t* coded);
+
     int16_t transmitDirect(uint32_t freq = 0, uint32_t freqHz = 0);
     int32_t getRawShift(int32_t shift);
 };
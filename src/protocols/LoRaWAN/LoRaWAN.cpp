@@ -1,4 +1,5 @@
 #include "LoRaWAN.h"
+#include "../../utils/CRC.h"
 #include <string.h>
 #if defined(ESP_PLATFORM)
 #include "esp_attr.h"
@@ -15,6 +16,20 @@ LoRaWANNode::LoRaWANNode(PhysicalLayer* phy, const LoRaWANBand_t* band, uint8_t
   this->dwellTimeEnabledUp = this->dwellTimeUp != 0;
   this->dwellTimeEnabledDn = this->dwellTimeDn != 0;
   memset(this->channelPlan, 0, sizeof(this->channelPlan));
+  memset(this->mcGroups, 0, sizeof(this->mcGroups));
+  memset(this->relayDevices, 0, sizeof(this->relayDevices));
+  memset(this->aggrPorts, 0, sizeof(this->aggrPorts));
+  memset(this->customMacCommands, 0, sizeof(this->customMacCommands));
+  memset(&this->fragSession, 0, sizeof(this->fragSession));
+  memset(this->airtimeLedger, 0, sizeof(this->airtimeLedger));
+  this->resetStats();
+}
+
+LoRaWANNode::~LoRaWANNode() {
+  this->clearFragSession();
+  #if !RADIOLIB_STATIC_ONLY
+  delete[] this->journalShadow;
+  #endif
 }
 
 #if defined(RADIOLIB_BUILD_ARDUINO)
@@ -84,6 +99,11 @@ int16_t LoRaWANNode::sendReceive(const uint8_t* dataUp, size_t lenUp, uint8_t fP
     return(RADIOLIB_ERR_NETWORK_NOT_JOINED);
   }
 
+  // device-side adaptive uplink control, only when the network does not control the link
+  if(this->adaptiveEnabled && !this->adrEnabled) {
+    this->adaptUplink();
+  }
+
   // check if the requested payload + fPort are allowed, also given dutycycle
   uint8_t totalLen = lenUp + this->fOptsUpLen;
   state = this->isValidUplink(&totalLen, fPort);
@@ -108,6 +128,17 @@ int16_t LoRaWANNode::sendReceive(const uint8_t* dataUp, size_t lenUp, uint8_t fP
   // reset Time-on-Air as we are starting new uplink sequence
   this->lastToA = 0;
 
+  // under duty cycle limits, the uplink Time-on-Air is needed to find the channel that is available the earliest
+  RadioLibTime_t toa = 0;
+  if(this->dutyCycleEnabled) {
+    state = this->setPhyProperties(&this->channels[RADIOLIB_LORAWAN_UPLINK], 
+                                   RADIOLIB_LORAWAN_UPLINK, 
+                                   this->txPowerMax - 2*this->txPowerSteps);
+    if(state == RADIOLIB_ERR_NONE) {
+      toa = this->phyLayer->getTimeOnAir(uplinkMsgLen - RADIOLIB_LORAWAN_FHDR_LEN_START_OFFS) / 1000;
+    }
+  }
+
   // repeat uplink+downlink up to 'nbTrans' times (ADR)
   uint8_t trans = 0;
   for(; trans < this->nbTrans; trans++) {
@@ -123,7 +154,7 @@ int16_t LoRaWANNode::sendReceive(const uint8_t* dataUp, size_t lenUp, uint8_t fP
 
     do {
       // select a pair of Tx/Rx channels for uplink+downlink
-      this->selectChannels();
+      this->selectChannels(toa);
 
       // generate and set uplink MIC (depends on selected channel)
       this->micUplink(uplinkMsg, uplinkMsgLen);
@@ -144,7 +175,14 @@ int16_t LoRaWANNode::sendReceive(const uint8_t* dataUp, size_t lenUp, uint8_t fP
     }
 
     // handle Rx1 and Rx2 windows - returns window > 0 if a downlink is received
-    state = receiveCommon(RADIOLIB_LORAWAN_DOWNLINK, this->channels, this->rxDelays, 2, this->rxDelayStart);
+    // through a relay, there is only the RxR window on the ACK channel instead
+    if(this->relayUplinks) {
+      const LoRaWANChannel_t rxrChannels[2] = { RADIOLIB_LORAWAN_CHANNEL_NONE, this->band->txAck[0] };
+      const RadioLibTime_t rxrDelays[2] = { 0, this->relayRxrDelay };
+      state = receiveCommon(RADIOLIB_LORAWAN_DOWNLINK, rxrChannels, rxrDelays, 1, this->rxDelayStartUs);
+    } else {
+      state = receiveCommon(RADIOLIB_LORAWAN_DOWNLINK, this->channels, this->rxDelays, 2, this->rxDelayStartUs);
+    }
 
     // RETRANSMIT_TIMEOUT is 2s +/- 1s (RP v1.0.4)
     // must be present after any confirmed frame, so we force this here
@@ -167,6 +205,20 @@ int16_t LoRaWANNode::sendReceive(const uint8_t* dataUp, size_t lenUp, uint8_t fP
   // increase frame counter by one for the next uplink
   this->fCntUp += 1;
 
+  // update the statistics, keeping track of datarate changes (e.g. due to ADR)
+  uint8_t drUp = this->channels[RADIOLIB_LORAWAN_UPLINK].dr;
+  if(this->stats.drHistoryLen > 0) {
+    if(this->stats.drHistory[this->stats.drHistoryLen - 1] != drUp) {
+      this->stats.numDrChanges++;
+    }
+    if(this->stats.drHistoryLen == RADIOLIB_LORAWAN_STATS_DR_HISTORY_LEN) {
+      memmove(&this->stats.drHistory[0], &this->stats.drHistory[1], RADIOLIB_LORAWAN_STATS_DR_HISTORY_LEN - 1);
+      this->stats.drHistoryLen--;
+    }
+  }
+  this->stats.drHistory[this->stats.drHistoryLen++] = drUp;
+  this->stats.numUplinks++;
+
   // the downlink confirmation was acknowledged, so clear the counter value
   this->confFCntDown = RADIOLIB_LORAWAN_FCNT_NONE;
 
@@ -188,7 +240,11 @@ int16_t LoRaWANNode::sendReceive(const uint8_t* dataUp, size_t lenUp, uint8_t fP
   #endif
 
   // if a hardware error occurred, return
+  // the frame counter did change, so save the session (failing to do so is not fatal for the uplink)
   if(state < RADIOLIB_ERR_NONE) {
+    if(this->journalEnabled) {
+      (void)this->saveJournal();
+    }
     return(state);
   }
 
@@ -197,19 +253,46 @@ int16_t LoRaWANNode::sendReceive(const uint8_t* dataUp, size_t lenUp, uint8_t fP
   // if no downlink was received, do an early exit
   if(rxWindow == 0) {
     // check if ADR backoff must occur
-    if(this->adrEnabled) {
+    if(this->adrEnabled || this->adaptiveEnabled) {
       this->adrBackoff();
     }
     // remove only non-persistent MAC commands, the other commands should be re-sent until downlink is received
     LoRaWANNode::clearMacCommands(this->fOptsUp, &this->fOptsUpLen, RADIOLIB_LORAWAN_UPLINK);
+
+    // save the frame counter and any ADR backoff changes
+    if(this->journalEnabled) {
+      (void)this->saveJournal();
+    }
     return(rxWindow);
   }
 
+  this->stats.numDownlinks++;
+
   // a downlink was received, so we can clear the whole MAC uplink buffer
   memset(this->fOptsUp, 0, RADIOLIB_LORAWAN_FHDR_FOPTS_MAX_LEN);
   this->fOptsUpLen = 0;
 
+  // the downlink margin is only a rough estimate of the uplink margin, used in case no LinkCheckAns is received
+  // the downlink is usually received much stronger than the uplink, so the link asymmetry is subtracted
+  int16_t snrMargin = RADIOLIB_LORAWAN_ADAPTIVE_MARGIN_NONE;
+  if(this->adaptiveEnabled) {
+    snrMargin = this->getDownlinkMargin(this->channels[rxWindow == 1 ? RADIOLIB_LORAWAN_DOWNLINK : RADIOLIB_LORAWAN_DIR_RX2].dr);
+    if(snrMargin != RADIOLIB_LORAWAN_ADAPTIVE_MARGIN_NONE) {
+      snrMargin -= this->adaptiveAsymmetry;
+    }
+  }
+
   state = this->parseDownlink(dataDown, lenDown, eventDown);
+
+  if((state == RADIOLIB_ERR_NONE) && (this->adaptiveMargin == RADIOLIB_LORAWAN_ADAPTIVE_MARGIN_NONE)) {
+    this->adaptiveMargin = snrMargin;
+    this->adaptiveGwCnt = 0;
+  }
+
+  // save the downlink frame counters and any MAC state changes
+  if(this->journalEnabled) {
+    (void)this->saveJournal();
+  }
   
   // return an error code, if any, otherwise return Rx window (which is > 0)
   RADIOLIB_ASSERT(state);
@@ -221,6 +304,7 @@ void LoRaWANNode::clearNonces() {
   memset(this->bufferNonces, 0, RADIOLIB_LORAWAN_NONCES_BUF_SIZE);
   this->keyCheckSum = 0;
   this->devNonce = 0;
+  this->rjCount1 = 0;
   this->joinNonce = 0;
   this->isActive = false;
   this->rev = 0;
@@ -268,6 +352,7 @@ int16_t LoRaWANNode::setBufferNonces(const uint8_t* persistentBuffer) {
   memcpy(this->bufferNonces, persistentBuffer, RADIOLIB_LORAWAN_NONCES_BUF_SIZE);
 
   this->devNonce  = LoRaWANNode::ntoh<uint16_t>(&this->bufferNonces[RADIOLIB_LORAWAN_NONCES_DEV_NONCE]);
+  this->rjCount1  = LoRaWANNode::ntoh<uint16_t>(&this->bufferNonces[RADIOLIB_LORAWAN_NONCES_RJ_COUNT1]);
   this->joinNonce = LoRaWANNode::ntoh<uint32_t>(&this->bufferNonces[RADIOLIB_LORAWAN_NONCES_JOIN_NONCE], 3);
 
   // revert to inactive as long as no session is restored
@@ -292,6 +377,10 @@ void LoRaWANNode::clearSession() {
   this->confFCntDown = RADIOLIB_LORAWAN_FCNT_NONE;
   this->adrFCnt = 0;
 
+  // reset the Rejoin-Request state, RJcount1 is kept as it must never repeat
+  this->rjCount0 = 0;
+  this->forceRejoinType = RADIOLIB_LORAWAN_JOIN_REQUEST_TYPE;
+
   // reset number of retransmissions from ADR
   this->nbTrans = 1;
 
@@ -328,31 +417,34 @@ void LoRaWANNode::createSession(uint16_t lwMode, uint8_t initialDr) {
     // on dynamic bands, the first OTAA uplink (JoinRequest) can be any available datarate
     // this is also true for ABP on both dynamic and fixed bands, as there is no JoinRequest
     if(initialDr != RADIOLIB_LORAWAN_DATA_RATE_UNUSED) {
-      uint8_t i = 0; 
-      for(; i < RADIOLIB_LORAWAN_NUM_AVAILABLE_CHANNELS; i++) {
-        if(this->channelPlan[RADIOLIB_LORAWAN_UPLINK][i].enabled) {
-          if(initialDr >= this->channelPlan[RADIOLIB_LORAWAN_UPLINK][i].drMin
-            && initialDr <= this->channelPlan[RADIOLIB_LORAWAN_UPLINK][i].drMax) {
-              drUp = initialDr;
-              break;
-          }
-        }
-      }
-      // if there is no channel that allowed the user-specified datarate, revert to default datarate
-      if(i == RADIOLIB_LORAWAN_NUM_AVAILABLE_CHANNELS) {
+      if(this->isValidDatarate(initialDr)) {
+        drUp = initialDr;
+      } else {
+        // if there is no channel that allowed the user-specified datarate, revert to default datarate
         RADIOLIB_DEBUG_PROTOCOL_PRINTLN("Datarate %d is not valid - using default", initialDr);
         initialDr = RADIOLIB_LORAWAN_DATA_RATE_UNUSED;
       }
     }
   
     // if there is no (channel that allowed the) user-specified datarate, use a default datarate
-    // we use the floor of the average datarate of the first enabled channel
+    // we use the floor of the average datarate of the last enabled channel
     if(initialDr == RADIOLIB_LORAWAN_DATA_RATE_UNUSED) {
-      for(int i = 0; i < RADIOLIB_LORAWAN_NUM_AVAILABLE_CHANNELS; i++) {
-        if(this->channelPlan[RADIOLIB_LORAWAN_UPLINK][i].enabled) {
-          uint8_t drMin = this->channelPlan[RADIOLIB_LORAWAN_UPLINK][i].drMin;
-          uint8_t drMax = this->channelPlan[RADIOLIB_LORAWAN_UPLINK][i].drMax;
-          drUp = (drMin + drMax) / 2;
+      if(this->band->bandType == RADIOLIB_LORAWAN_BAND_DYNAMIC) {
+        for(int i = 0; i < RADIOLIB_LORAWAN_NUM_AVAILABLE_CHANNELS; i++) {
+          if(this->channelPlan[RADIOLIB_LORAWAN_UPLINK][i].enabled) {
+            uint8_t drMin = this->channelPlan[RADIOLIB_LORAWAN_UPLINK][i].drMin;
+            uint8_t drMax = this->channelPlan[RADIOLIB_LORAWAN_UPLINK][i].drMax;
+            drUp = (drMin + drMax) / 2;
+          }
+        }
+      } else {              // RADIOLIB_LORAWAN_BAND_FIXED
+        // all channels in a sub-band share the same datarates
+        LoRaWANChannel_t chnl = RADIOLIB_LORAWAN_CHANNEL_NONE;
+        for(uint8_t i = 0; i < RADIOLIB_LORAWAN_FIXED_NUM_SUBBANDS; i++) {
+          if(this->chMaskFixed[i]) {
+            this->getFixedChannel(8*i, &chnl);
+            drUp = (chnl.drMin + chnl.drMax) / 2;
+          }
         }
       }
     }
@@ -368,13 +460,16 @@ void LoRaWANNode::createSession(uint16_t lwMode, uint8_t initialDr) {
   cid = RADIOLIB_LORAWAN_MAC_DUTY_CYCLE;
   this->getMacLen(cid, &cLen, RADIOLIB_LORAWAN_DOWNLINK);
   uint8_t maxDCyclePower = 0;
-  switch(this->band->dutyCycle) {
-    case(3600):
-      maxDCyclePower = 10;
-      break;
-    case(36000):
-      maxDCyclePower = 7;
-      break;
+  // in bands with duty cycle sub-bands, keep it at 0 so that only the per-sub-band regulatory limits apply
+  if(this->band->numDutyCycleBands == 0) {
+    switch(this->band->dutyCycle) {
+      case(3600):
+        maxDCyclePower = 10;
+        break;
+      case(36000):
+        maxDCyclePower = 7;
+        break;
+    }
   }
   cOcts[0]  = maxDCyclePower;
   (void)execMacCommand(cid, cOcts, cLen);
@@ -440,6 +535,7 @@ uint8_t* LoRaWANNode::getBufferSession() {
   LoRaWANNode::hton<uint32_t>(&this->bufferSession[RADIOLIB_LORAWAN_SESSION_CONF_FCNT_DOWN], this->confFCntDown);
   LoRaWANNode::hton<uint32_t>(&this->bufferSession[RADIOLIB_LORAWAN_SESSION_ADR_FCNT], this->adrFCnt);
   LoRaWANNode::hton<uint32_t>(&this->bufferSession[RADIOLIB_LORAWAN_SESSION_FCNT_UP], this->fCntUp);
+  LoRaWANNode::hton<uint16_t>(&this->bufferSession[RADIOLIB_LORAWAN_SESSION_RJ_COUNT0], this->rjCount0);
 
   // store the enabled channels
   uint64_t chMaskGrp0123 = 0;
@@ -448,15 +544,39 @@ uint8_t* LoRaWANNode::getBufferSession() {
   LoRaWANNode::hton<uint64_t>(&this->bufferSession[RADIOLIB_LORAWAN_SESSION_LINK_ADR] + 1, chMaskGrp0123);
   LoRaWANNode::hton<uint32_t>(&this->bufferSession[RADIOLIB_LORAWAN_SESSION_LINK_ADR] + 9, chMaskGrp45);
 
-  // store the available/unused channels
+  // store the available/unused channels, fixed bands keep them in the otherwise unused channel section
   uint16_t chMask = 0x0000;
   (void)this->getAvailableChannels(&chMask);
   LoRaWANNode::hton<uint16_t>(&this->bufferSession[RADIOLIB_LORAWAN_SESSION_AVAILABLE_CHANNELS], chMask);
+  if(this->band->bandType == RADIOLIB_LORAWAN_BAND_FIXED) {
+    memcpy(&this->bufferSession[RADIOLIB_LORAWAN_SESSION_FIXED_CH_AVAIL], this->chAvailFixed, RADIOLIB_LORAWAN_FIXED_NUM_SUBBANDS);
+  }
 
   // store the current uplink MAC command queue
   memcpy(&this->bufferSession[RADIOLIB_LORAWAN_SESSION_MAC_QUEUE], this->fOptsUp, RADIOLIB_LORAWAN_FHDR_FOPTS_MAX_LEN);
   memcpy(&this->bufferSession[RADIOLIB_LORAWAN_SESSION_MAC_QUEUE_LEN], &this->fOptsUpLen, 1);
 
+  // store the multicast groups, including their frame counters
+  for(uint8_t id = 0; id < RADIOLIB_LORAWAN_NUM_MC_GROUPS; id++) {
+    LoRaWANMulticastGroup_t* group = &this->mcGroups[id];
+    uint8_t* ptr = &this->bufferSession[RADIOLIB_LORAWAN_SESSION_MC_GROUPS + id*RADIOLIB_LORAWAN_SESSION_MC_GROUP_LEN];
+    memset(ptr, 0, RADIOLIB_LORAWAN_SESSION_MC_GROUP_LEN);
+    if(!group->active) {
+      continue;
+    }
+    ptr[RADIOLIB_LORAWAN_MC_GROUP_ACTIVE_POS] = (uint8_t)true;
+    LoRaWANNode::hton<uint32_t>(&ptr[RADIOLIB_LORAWAN_MC_GROUP_ADDR_POS], group->addr);
+    memcpy(&ptr[RADIOLIB_LORAWAN_MC_GROUP_APP_SKEY_POS], group->appSKey, RADIOLIB_AES128_KEY_SIZE);
+    memcpy(&ptr[RADIOLIB_LORAWAN_MC_GROUP_NWK_SKEY_POS], group->nwkSKey, RADIOLIB_AES128_KEY_SIZE);
+    LoRaWANNode::hton<uint32_t>(&ptr[RADIOLIB_LORAWAN_MC_GROUP_FCNT_MIN_POS], group->fCntMin);
+    LoRaWANNode::hton<uint32_t>(&ptr[RADIOLIB_LORAWAN_MC_GROUP_FCNT_MAX_POS], group->fCntMax);
+    LoRaWANNode::hton<uint32_t>(&ptr[RADIOLIB_LORAWAN_MC_GROUP_FCNT_POS], group->fCnt);
+    LoRaWANNode::hton<uint32_t>(&ptr[RADIOLIB_LORAWAN_MC_GROUP_FREQ_POS], group->channel.freq, 3);
+    ptr[RADIOLIB_LORAWAN_MC_GROUP_DR_POS] = group->channel.dr;
+    LoRaWANNode::hton<uint32_t>(&ptr[RADIOLIB_LORAWAN_MC_GROUP_SESSION_TIME_POS], group->sessionTime);
+    ptr[RADIOLIB_LORAWAN_MC_GROUP_SESSION_TIMEOUT_POS] = group->sessionTimeout;
+  }
+
   // generate the signature of the Session buffer, and store it in the last two bytes of the Session buffer
   uint16_t signature = LoRaWANNode::checkSum16(this->bufferSession, RADIOLIB_LORAWAN_SESSION_BUF_SIZE - 2);
   LoRaWANNode::hton<uint16_t>(&this->bufferSession[RADIOLIB_LORAWAN_SESSION_SIGNATURE], signature);
@@ -508,6 +628,7 @@ int16_t LoRaWANNode::setBufferSession(const uint8_t* persistentBuffer) {
   this->confFCntDown = LoRaWANNode::ntoh<uint32_t>(&this->bufferSession[RADIOLIB_LORAWAN_SESSION_CONF_FCNT_DOWN]);
   this->adrFCnt      = LoRaWANNode::ntoh<uint32_t>(&this->bufferSession[RADIOLIB_LORAWAN_SESSION_ADR_FCNT]);
   this->fCntUp       = LoRaWANNode::ntoh<uint32_t>(&this->bufferSession[RADIOLIB_LORAWAN_SESSION_FCNT_UP]);
+  this->rjCount0     = LoRaWANNode::ntoh<uint16_t>(&this->bufferSession[RADIOLIB_LORAWAN_SESSION_RJ_COUNT0]);
   
   // restore the complete MAC state
 
@@ -527,14 +648,15 @@ int16_t LoRaWANNode::setBufferSession(const uint8_t* persistentBuffer) {
     // all-zero buffer used for checking if MAC commands are set
     uint8_t bufferZeroes[RADIOLIB_LORAWAN_MAX_MAC_COMMAND_LEN_DOWN] = { 0 };
 
-    // restore the session channels
+    // restore the session channels, the channel index is the position in the section
     uint8_t *startChannelsUp = &this->bufferSession[RADIOLIB_LORAWAN_SESSION_UL_CHANNELS];
 
     cid = RADIOLIB_LORAWAN_MAC_NEW_CHANNEL;
     (void)this->getMacLen(cid, &cLen, RADIOLIB_LORAWAN_DOWNLINK);
     for(int i = 0; i < RADIOLIB_LORAWAN_NUM_AVAILABLE_CHANNELS; i++) {
-      memcpy(cOcts, startChannelsUp + (i * cLen), cLen);
-      if(memcmp(cOcts, bufferZeroes, cLen) != 0) { // only execute if it is not all zeroes
+      cOcts[0] = i;
+      memcpy(&cOcts[1], startChannelsUp + (i * RADIOLIB_LORAWAN_SESSION_UL_CHANNEL_LEN), RADIOLIB_LORAWAN_SESSION_UL_CHANNEL_LEN);
+      if(memcmp(&cOcts[1], bufferZeroes, RADIOLIB_LORAWAN_SESSION_UL_CHANNEL_LEN) != 0) { // only execute if it is not all zeroes
         (void)execMacCommand(cid, cOcts, cLen);
       }
     }
@@ -544,8 +666,9 @@ int16_t LoRaWANNode::setBufferSession(const uint8_t* persistentBuffer) {
     cid = RADIOLIB_LORAWAN_MAC_DL_CHANNEL;
     (void)this->getMacLen(cid, &cLen, RADIOLIB_LORAWAN_DOWNLINK);
     for(int i = 0; i < RADIOLIB_LORAWAN_NUM_AVAILABLE_CHANNELS; i++) {
-      memcpy(cOcts, startChannelsDown + (i * cLen), cLen);
-      if(memcmp(cOcts, bufferZeroes, cLen) != 0) { // only execute if it is not all zeroes
+      cOcts[0] = i;
+      memcpy(&cOcts[1], startChannelsDown + (i * RADIOLIB_LORAWAN_SESSION_DL_CHANNEL_LEN), RADIOLIB_LORAWAN_SESSION_DL_CHANNEL_LEN);
+      if(memcmp(&cOcts[1], bufferZeroes, RADIOLIB_LORAWAN_SESSION_DL_CHANNEL_LEN) != 0) { // only execute if it is not all zeroes
         (void)execMacCommand(cid, cOcts, cLen);
       }
     }
@@ -574,20 +697,311 @@ int16_t LoRaWANNode::setBufferSession(const uint8_t* persistentBuffer) {
     (void)execMacCommand(cids[i], cOcts, cLen);
   }
 
-  // set the available channels
-  uint16_t chMask = LoRaWANNode::ntoh<uint32_t>(&this->bufferSession[RADIOLIB_LORAWAN_SESSION_AVAILABLE_CHANNELS]);
+  // set the available channels, for fixed bands this continues the saved hopping round
+  uint16_t chMask = LoRaWANNode::ntoh<uint16_t>(&this->bufferSession[RADIOLIB_LORAWAN_SESSION_AVAILABLE_CHANNELS]);
+  if(this->band->bandType == RADIOLIB_LORAWAN_BAND_FIXED) {
+    memcpy(this->chAvailFixed, &this->bufferSession[RADIOLIB_LORAWAN_SESSION_FIXED_CH_AVAIL], RADIOLIB_LORAWAN_FIXED_NUM_SUBBANDS);
+  }
   this->setAvailableChannels(chMask);
 
   // copy uplink MAC command queue back in place
   memcpy(this->fOptsUp, &this->bufferSession[RADIOLIB_LORAWAN_SESSION_MAC_QUEUE], RADIOLIB_LORAWAN_FHDR_FOPTS_MAX_LEN);
   memcpy(&this->fOptsUpLen, &this->bufferSession[RADIOLIB_LORAWAN_SESSION_MAC_QUEUE_LEN], 1);
 
+  // restore the multicast groups
+  for(uint8_t id = 0; id < RADIOLIB_LORAWAN_NUM_MC_GROUPS; id++) {
+    LoRaWANMulticastGroup_t* group = &this->mcGroups[id];
+    const uint8_t* ptr = &this->bufferSession[RADIOLIB_LORAWAN_SESSION_MC_GROUPS + id*RADIOLIB_LORAWAN_SESSION_MC_GROUP_LEN];
+    memset(group, 0, sizeof(LoRaWANMulticastGroup_t));
+    if(!ptr[RADIOLIB_LORAWAN_MC_GROUP_ACTIVE_POS]) {
+      continue;
+    }
+    group->active = true;
+    group->addr = LoRaWANNode::ntoh<uint32_t>(&ptr[RADIOLIB_LORAWAN_MC_GROUP_ADDR_POS]);
+    memcpy(group->appSKey, &ptr[RADIOLIB_LORAWAN_MC_GROUP_APP_SKEY_POS], RADIOLIB_AES128_KEY_SIZE);
+    memcpy(group->nwkSKey, &ptr[RADIOLIB_LORAWAN_MC_GROUP_NWK_SKEY_POS], RADIOLIB_AES128_KEY_SIZE);
+    group->fCntMin = LoRaWANNode::ntoh<uint32_t>(&ptr[RADIOLIB_LORAWAN_MC_GROUP_FCNT_MIN_POS]);
+    group->fCntMax = LoRaWANNode::ntoh<uint32_t>(&ptr[RADIOLIB_LORAWAN_MC_GROUP_FCNT_MAX_POS]);
+    group->fCnt = LoRaWANNode::ntoh<uint32_t>(&ptr[RADIOLIB_LORAWAN_MC_GROUP_FCNT_POS]);
+    group->sessionTime = LoRaWANNode::ntoh<uint32_t>(&ptr[RADIOLIB_LORAWAN_MC_GROUP_SESSION_TIME_POS]);
+    group->sessionTimeout = ptr[RADIOLIB_LORAWAN_MC_GROUP_SESSION_TIMEOUT_POS];
+
+    // Class C session channel, only if one was set up
+    uint32_t freq = LoRaWANNode::ntoh<uint32_t>(&ptr[RADIOLIB_LORAWAN_MC_GROUP_FREQ_POS], 3);
+    if(freq != 0) {
+      uint8_t dr = ptr[RADIOLIB_LORAWAN_MC_GROUP_DR_POS];
+      group->channel.enabled = true;
+      group->channel.idx = RADIOLIB_LORAWAN_CHANNEL_INDEX_NONE;
+      group->channel.freq = freq;
+      group->channel.drMin = dr;
+      group->channel.drMax = dr;
+      group->channel.dr = dr;
+      group->channel.available = true;
+    }
+  }
+
+  // the periodic Rejoin-Request counters start again from the restored session
+  this->resetRejoinCounters();
+
   // as both the Nonces and session are restored, revert to active session
   this->bufferNonces[RADIOLIB_LORAWAN_NONCES_ACTIVE] = (uint8_t)true;
 
   return(state);
 }
 
+int16_t LoRaWANNode::beginJournal(LoRaWANStorageReadCb_t readCb, LoRaWANStorageWriteCb_t writeCb, size_t size) {
+  if(!readCb || !writeCb) {
+    return(RADIOLIB_ERR_NULL_POINTER);
+  }
+
+  // the storage must fit at least both snapshot slots and one single-byte record
+  if(size < RADIOLIB_LORAWAN_JOURNAL_RECORDS_POS + RADIOLIB_LORAWAN_JOURNAL_RECORD_OVERHEAD + 1) {
+    return(RADIOLIB_ERR_STORAGE_TOO_SMALL);
+  }
+
+  #if !RADIOLIB_STATIC_ONLY
+  if(!this->journalShadow) {
+    this->journalShadow = new uint8_t[RADIOLIB_LORAWAN_SESSION_BUF_SIZE];
+  }
+  #endif
+  memset(this->journalShadow, 0, RADIOLIB_LORAWAN_SESSION_BUF_SIZE);
+
+  this->journalReadCb = readCb;
+  this->journalWriteCb = writeCb;
+  this->journalSize = size;
+  this->journalGen = RADIOLIB_LORAWAN_JOURNAL_GEN_NONE;
+  this->journalSlot = RADIOLIB_LORAWAN_JOURNAL_SLOT_NONE;
+
+  // there is no snapshot of the current session yet, so the first save will write one
+  this->journalPos = 0;
+  this->journalEnabled = true;
+  return(RADIOLIB_ERR_NONE);
+}
+
+int16_t LoRaWANNode::restoreJournal() {
+  if(!this->journalEnabled) {
+    return(RADIOLIB_ERR_INVALID_MODE);
+  }
+
+  if(this->isActivated()) {
+    RADIOLIB_DEBUG_PROTOCOL_PRINTLN("Did not restore journal: session already active");
+    return(RADIOLIB_ERR_NONE);
+  }
+
+  // find the newest valid snapshot - the other slot is either older or was only partially written
+  uint32_t genA = this->journalReadSlot(0);
+  uint32_t genB = this->journalReadSlot(1);
+  uint8_t slot = 1;
+  uint32_t gen = genB;
+  if((genA != RADIOLIB_LORAWAN_JOURNAL_GEN_NONE) && ((genB == RADIOLIB_LORAWAN_JOURNAL_GEN_NONE) || (genA > genB))) {
+    slot = 0;
+    gen = this->journalReadSlot(0);
+  }
+  if(gen == RADIOLIB_LORAWAN_JOURNAL_GEN_NONE) {
+    return(RADIOLIB_ERR_NETWORK_NOT_JOINED);
+  }
+  int16_t state = LoRaWANNode::checkBufferCommon(this->journalShadow, RADIOLIB_LORAWAN_SESSION_BUF_SIZE);
+  RADIOLIB_ASSERT(state);
+
+  // replay the records - the first one that is from another generation,
+  // out of bounds or only partially written marks the end of the journal
+  uint8_t record[RADIOLIB_LORAWAN_JOURNAL_RECORD_OVERHEAD + RADIOLIB_LORAWAN_JOURNAL_RECORD_MAX_LEN];
+  uint32_t pos = RADIOLIB_LORAWAN_JOURNAL_RECORDS_POS;
+  size_t numRecords = 0;
+  while(pos + RADIOLIB_LORAWAN_JOURNAL_RECORD_OVERHEAD < this->journalSize) {
+    state = this->journalReadCb(pos, record, RADIOLIB_LORAWAN_JOURNAL_RECORD_HDR_LEN);
+    RADIOLIB_ASSERT(state);
+
+    uint32_t recGen = LoRaWANNode::ntoh<uint32_t>(&record[0]);
+    uint16_t offs = LoRaWANNode::ntoh<uint16_t>(&record[4]);
+    uint8_t len = record[6];
+    if((recGen != gen) || (len == 0) || (offs + len > RADIOLIB_LORAWAN_SESSION_SIGNATURE) ||
+       (pos + RADIOLIB_LORAWAN_JOURNAL_RECORD_OVERHEAD + len > this->journalSize)) {
+      break;
+    }
+
+    state = this->journalReadCb(pos + RADIOLIB_LORAWAN_JOURNAL_RECORD_HDR_LEN, 
+                                &record[RADIOLIB_LORAWAN_JOURNAL_RECORD_HDR_LEN], len + sizeof(uint16_t));
+    RADIOLIB_ASSERT(state);
+    uint16_t crc = LoRaWANNode::journalCrc(record, RADIOLIB_LORAWAN_JOURNAL_RECORD_HDR_LEN, &record[RADIOLIB_LORAWAN_JOURNAL_RECORD_HDR_LEN], len);
+    if(crc != LoRaWANNode::ntoh<uint16_t>(&record[RADIOLIB_LORAWAN_JOURNAL_RECORD_HDR_LEN + len])) {
+      break;
+    }
+
+    memcpy(&this->journalShadow[offs], &record[RADIOLIB_LORAWAN_JOURNAL_RECORD_HDR_LEN], len);
+    pos += RADIOLIB_LORAWAN_JOURNAL_RECORD_OVERHEAD + len;
+    numRecords++;
+  }
+  RADIOLIB_DEBUG_PROTOCOL_PRINTLN("Journal slot %d generation %lu, replayed %d records", slot, (unsigned long)gen, (int)numRecords);
+
+  // the signature is not journaled, so it has to be recalculated
+  uint16_t signature = LoRaWANNode::checkSum16(this->journalShadow, RADIOLIB_LORAWAN_SESSION_BUF_SIZE - 2);
+  LoRaWANNode::hton<uint16_t>(&this->journalShadow[RADIOLIB_LORAWAN_SESSION_SIGNATURE], signature);
+
+  state = this->setBufferSession(this->journalShadow);
+  RADIOLIB_ASSERT(state);
+
+  this->journalGen = gen;
+  this->journalSlot = slot;
+  this->journalPos = pos;
+  return(state);
+}
+
+int16_t LoRaWANNode::saveJournal() {
+  if(!this->journalEnabled) {
+    return(RADIOLIB_ERR_INVALID_MODE);
+  }
+
+  // nothing to append to if there is no snapshot yet
+  if(this->journalPos == 0) {
+    return(this->compactJournal());
+  }
+
+  const uint8_t* session = this->getBufferSession();
+
+  // check how much space the records would take
+  size_t total = 0;
+  uint16_t offs = 0;
+  uint8_t len = 0;
+  while(this->journalNextRange(session, &offs, &len)) {
+    total += RADIOLIB_LORAWAN_JOURNAL_RECORD_OVERHEAD + len;
+    offs += len;
+  }
+  if(total == 0) {
+    return(RADIOLIB_ERR_NONE);
+  }
+
+  // if the journal is full or most of the session changed (e.g. after a new join), write a new snapshot instead
+  if((this->journalPos + total > this->journalSize) || (total >= RADIOLIB_LORAWAN_SESSION_BUF_SIZE)) {
+    return(this->compactJournal());
+  }
+
+  int16_t state = RADIOLIB_ERR_NONE;
+  uint8_t record[RADIOLIB_LORAWAN_JOURNAL_RECORD_OVERHEAD + RADIOLIB_LORAWAN_JOURNAL_RECORD_MAX_LEN];
+  offs = 0;
+  while(this->journalNextRange(session, &offs, &len)) {
+    LoRaWANNode::hton<uint32_t>(&record[0], this->journalGen);
+    LoRaWANNode::hton<uint16_t>(&record[4], offs);
+    record[6] = len;
+    memcpy(&record[RADIOLIB_LORAWAN_JOURNAL_RECORD_HDR_LEN], &session[offs], len);
+    uint16_t crc = LoRaWANNode::journalCrc(record, RADIOLIB_LORAWAN_JOURNAL_RECORD_HDR_LEN, &record[RADIOLIB_LORAWAN_JOURNAL_RECORD_HDR_LEN], len);
+    LoRaWANNode::hton<uint16_t>(&record[RADIOLIB_LORAWAN_JOURNAL_RECORD_HDR_LEN + len], crc);
+
+    state = this->journalWriteCb(this->journalPos, record, RADIOLIB_LORAWAN_JOURNAL_RECORD_OVERHEAD + len);
+    RADIOLIB_ASSERT(state);
+
+    memcpy(&this->journalShadow[offs], &session[offs], len);
+    this->journalPos += RADIOLIB_LORAWAN_JOURNAL_RECORD_OVERHEAD + len;
+    offs += len;
+  }
+
+  return(state);
+}
+
+int16_t LoRaWANNode::compactJournal() {
+  if(!this->journalEnabled) {
+    return(RADIOLIB_ERR_INVALID_MODE);
+  }
+
+  // continue from the newest stored snapshot, so that records of older snapshots are never replayed
+  if(this->journalSlot == RADIOLIB_LORAWAN_JOURNAL_SLOT_NONE) {
+    uint32_t genA = this->journalReadSlot(0);
+    uint32_t genB = this->journalReadSlot(1);
+    if((genA != RADIOLIB_LORAWAN_JOURNAL_GEN_NONE) && ((genB == RADIOLIB_LORAWAN_JOURNAL_GEN_NONE) || (genA > genB))) {
+      this->journalSlot = 0;
+      this->journalGen = genA;
+    } else if(genB != RADIOLIB_LORAWAN_JOURNAL_GEN_NONE) {
+      this->journalSlot = 1;
+      this->journalGen = genB;
+    }
+  }
+
+  // the new snapshot always goes into the other slot, so the current one stays valid until the new one is complete
+  uint8_t slot = (this->journalSlot == 0) ? 1 : 0;
+  uint32_t gen = this->journalGen + 1;
+  if(this->journalGen == RADIOLIB_LORAWAN_JOURNAL_GEN_NONE) {
+    gen = 0;
+  }
+
+  const uint8_t* session = this->getBufferSession();
+
+  // the slot only becomes valid once its CRC is written, which is also the last byte of the slot
+  uint8_t hdr[RADIOLIB_LORAWAN_JOURNAL_SLOT_SNAPSHOT_POS];
+  LoRaWANNode::hton<uint32_t>(hdr, gen);
+  uint8_t crcBuff[2];
+  LoRaWANNode::hton<uint16_t>(crcBuff, LoRaWANNode::journalCrc(hdr, sizeof(hdr), session, RADIOLIB_LORAWAN_SESSION_BUF_SIZE));
+
+  uint32_t pos = slot*RADIOLIB_LORAWAN_JOURNAL_SLOT_LEN;
+  int16_t state = this->journalWriteCb(pos, hdr, sizeof(hdr));
+  RADIOLIB_ASSERT(state);
+  state = this->journalWriteCb(pos + RADIOLIB_LORAWAN_JOURNAL_SLOT_SNAPSHOT_POS, session, RADIOLIB_LORAWAN_SESSION_BUF_SIZE);
+  RADIOLIB_ASSERT(state);
+  state = this->journalWriteCb(pos + RADIOLIB_LORAWAN_JOURNAL_SLOT_CRC_POS, crcBuff, sizeof(crcBuff));
+  RADIOLIB_ASSERT(state);
+
+  // records of the previous snapshot do not need to be cleared, they are from an older generation
+  memcpy(this->journalShadow, session, RADIOLIB_LORAWAN_SESSION_BUF_SIZE);
+  this->journalGen = gen;
+  this->journalSlot = slot;
+  this->journalPos = RADIOLIB_LORAWAN_JOURNAL_RECORDS_POS;
+  return(state);
+}
+
+uint32_t LoRaWANNode::journalReadSlot(uint8_t slot) {
+  uint32_t pos = slot*RADIOLIB_LORAWAN_JOURNAL_SLOT_LEN;
+  uint8_t hdr[RADIOLIB_LORAWAN_JOURNAL_SLOT_SNAPSHOT_POS];
+  uint8_t crcBuff[2];
+  if((this->journalReadCb(pos, hdr, sizeof(hdr)) != RADIOLIB_ERR_NONE) ||
+     (this->journalReadCb(pos + RADIOLIB_LORAWAN_JOURNAL_SLOT_SNAPSHOT_POS, this->journalShadow, RADIOLIB_LORAWAN_SESSION_BUF_SIZE) != RADIOLIB_ERR_NONE) ||
+     (this->journalReadCb(pos + RADIOLIB_LORAWAN_JOURNAL_SLOT_CRC_POS, crcBuff, sizeof(crcBuff)) != RADIOLIB_ERR_NONE)) {
+    return(RADIOLIB_LORAWAN_JOURNAL_GEN_NONE);
+  }
+
+  uint16_t crc = LoRaWANNode::journalCrc(hdr, sizeof(hdr), this->journalShadow, RADIOLIB_LORAWAN_SESSION_BUF_SIZE);
+  if(crc != LoRaWANNode::ntoh<uint16_t>(crcBuff)) {
+    return(RADIOLIB_LORAWAN_JOURNAL_GEN_NONE);
+  }
+  return(LoRaWANNode::ntoh<uint32_t>(hdr));
+}
+
+uint16_t LoRaWANNode::journalCrc(const uint8_t* hdr, size_t hdrLen, const uint8_t* buff, size_t len) {
+  RadioLibCRCInstance.size = 16;
+  RadioLibCRCInstance.poly = RADIOLIB_CRC_CCITT_POLY;
+  RadioLibCRCInstance.init = RADIOLIB_CRC_CCITT_INIT;
+  RadioLibCRCInstance.out = RADIOLIB_CRC_CCITT_OUT;
+  RadioLibCRCInstance.refIn = false;
+  RadioLibCRCInstance.refOut = false;
+  uint32_t crc = RadioLibCRCInstance.update(RADIOLIB_CRC_CCITT_INIT, hdr, hdrLen);
+  crc = RadioLibCRCInstance.update(crc, buff, len);
+  return(RadioLibCRCInstance.finish(crc));
+}
+
+bool LoRaWANNode::journalNextRange(const uint8_t* session, uint16_t* offs, uint8_t* len) {
+  // skip unchanged bytes, the signature is not journaled as it changes with every update
+  uint16_t i = *offs;
+  while((i < RADIOLIB_LORAWAN_SESSION_SIGNATURE) && (session[i] == this->journalShadow[i])) {
+    i++;
+  }
+  if(i >= RADIOLIB_LORAWAN_SESSION_SIGNATURE) {
+    return(false);
+  }
+
+  // extend the range until the next gap that is longer than the overhead of a new record
+  uint16_t start = i;
+  uint16_t end = i + 1;
+  for(i = end; (i < RADIOLIB_LORAWAN_SESSION_SIGNATURE) && (i - start < RADIOLIB_LORAWAN_JOURNAL_RECORD_MAX_LEN); i++) {
+    if(session[i] != this->journalShadow[i]) {
+      end = i + 1;
+    } else if(i - end >= RADIOLIB_LORAWAN_JOURNAL_RECORD_OVERHEAD) {
+      break;
+    }
+  }
+
+  *offs = start;
+  *len = end - start;
+  return(true);
+}
+
 int16_t LoRaWANNode::beginOTAA(uint64_t joinEUI, uint64_t devEUI, const uint8_t* nwkKey, const uint8_t* appKey) {
   if(!appKey) {
     return(RADIOLIB_ERR_NULL_POINTER);
@@ -669,6 +1083,34 @@ void LoRaWANNode::composeJoinRequest(uint8_t* out) {
   LoRaWANNode::hton<uint32_t>(&out[RADIOLIB_LORAWAN_JOIN_REQUEST_LEN - sizeof(uint32_t)], mic);
 }
 
+uint8_t LoRaWANNode::composeRejoinRequest(uint8_t rejoinType, uint8_t* out) {
+  out[0] = RADIOLIB_LORAWAN_MHDR_MTYPE_REJOIN_REQUEST | RADIOLIB_LORAWAN_MHDR_MAJOR_R1;
+  out[RADIOLIB_LORAWAN_REJOIN_REQUEST_TYPE_POS] = rejoinType;
+
+  uint8_t len = 0;
+  uint8_t* key = NULL;
+  if(rejoinType == RADIOLIB_LORAWAN_JOIN_REQUEST_TYPE_1) {
+    // type 1 is addressed to the join server and signed using JSIntKey
+    LoRaWANNode::hton<uint64_t>(&out[RADIOLIB_LORAWAN_REJOIN_REQUEST_JOIN_EUI_POS], this->joinEUI);
+    LoRaWANNode::hton<uint64_t>(&out[RADIOLIB_LORAWAN_REJOIN_REQUEST_1_DEV_EUI_POS], this->devEUI);
+    LoRaWANNode::hton<uint16_t>(&out[RADIOLIB_LORAWAN_REJOIN_REQUEST_1_RJ_COUNT_POS], this->rjCount1);
+    len = RADIOLIB_LORAWAN_REJOIN_REQUEST_1_LEN;
+    key = this->jSIntKey;
+  } else {
+    // type 0 and 2 are addressed to the network server and signed using SNwkSIntKey
+    LoRaWANNode::hton<uint32_t>(&out[RADIOLIB_LORAWAN_REJOIN_REQUEST_NET_ID_POS], this->homeNetId, 3);
+    LoRaWANNode::hton<uint64_t>(&out[RADIOLIB_LORAWAN_REJOIN_REQUEST_0_2_DEV_EUI_POS], this->devEUI);
+    LoRaWANNode::hton<uint16_t>(&out[RADIOLIB_LORAWAN_REJOIN_REQUEST_0_2_RJ_COUNT_POS], this->rjCount0);
+    len = RADIOLIB_LORAWAN_REJOIN_REQUEST_0_2_LEN;
+    key = this->sNwkSIntKey;
+  }
+
+  // add the authentication code
+  uint32_t mic = this->generateMIC(out, len - sizeof(uint32_t), key);
+  LoRaWANNode::hton<uint32_t>(&out[len - sizeof(uint32_t)], mic);
+  return(len);
+}
+
 int16_t LoRaWANNode::processJoinAccept(LoRaWANJoinEvent_t *joinEvent) {
   int16_t state = RADIOLIB_ERR_UNKNOWN;
 
@@ -703,7 +1145,16 @@ int16_t LoRaWANNode::processJoinAccept(LoRaWANJoinEvent_t *joinEvent) {
   // the first byte is the MAC header which is not encrypted
   uint8_t joinAcceptMsg[RADIOLIB_LORAWAN_JOIN_ACCEPT_MAX_LEN];
   joinAcceptMsg[0] = joinAcceptMsgEnc[0];
-  if(this->rev == 1) {
+  if(this->joinReqType != RADIOLIB_LORAWAN_JOIN_REQUEST_TYPE) {
+    // JoinAccept in reply to a RejoinRequest is encrypted using JSEncKey
+    uint8_t jSEncKey[RADIOLIB_AES128_KEY_SIZE];
+    uint8_t keyDerivationBuff[RADIOLIB_AES128_BLOCK_SIZE] = { 0 };
+    keyDerivationBuff[0] = RADIOLIB_LORAWAN_JOIN_ACCEPT_JS_ENC_KEY;
+    LoRaWANNode::hton<uint64_t>(&keyDerivationBuff[1], this->devEUI);
+    RadioLibAES128Instance.init(this->nwkKey);
+    RadioLibAES128Instance.encryptECB(keyDerivationBuff, RADIOLIB_AES128_BLOCK_SIZE, jSEncKey);
+    RadioLibAES128Instance.init(jSEncKey);
+  } else if(this->rev == 1) {
     RadioLibAES128Instance.init(this->nwkKey);
   } else {
     RadioLibAES128Instance.init(this->appKey);
@@ -727,18 +1178,14 @@ int16_t LoRaWANNode::processJoinAccept(LoRaWANJoinEvent_t *joinEvent) {
       return(RADIOLIB_ERR_JOIN_NONCE_INVALID);
     }
   }
-  this->joinNonce = joinNonceNew;
-
-  this->homeNetId = LoRaWANNode::ntoh<uint32_t>(&joinAcceptMsg[RADIOLIB_LORAWAN_JOIN_ACCEPT_HOME_NET_ID_POS], 3);
-  this->devAddr = LoRaWANNode::ntoh<uint32_t>(&joinAcceptMsg[RADIOLIB_LORAWAN_JOIN_ACCEPT_DEV_ADDR_POS]);
 
   // check LoRaWAN revision (the MIC verification depends on this)
   uint8_t dlSettings = joinAcceptMsg[RADIOLIB_LORAWAN_JOIN_ACCEPT_DL_SETTINGS_POS];
-  this->rev = (dlSettings & RADIOLIB_LORAWAN_JOIN_ACCEPT_R_1_1) >> 7;
-  RADIOLIB_DEBUG_PROTOCOL_PRINTLN("LoRaWAN revision: 1.%d", this->rev);
+  uint8_t revNew = (dlSettings & RADIOLIB_LORAWAN_JOIN_ACCEPT_R_1_1) >> 7;
+  RADIOLIB_DEBUG_PROTOCOL_PRINTLN("LoRaWAN revision: 1.%d", revNew);
 
   // verify MIC
-  if(this->rev == 1) {
+  if(revNew == 1) {
     // 1.1 version, first we need to derive the join accept integrity key
     uint8_t keyDerivationBuff[RADIOLIB_AES128_BLOCK_SIZE] = { 0 };
     keyDerivationBuff[0] = RADIOLIB_LORAWAN_JOIN_ACCEPT_JS_INT_KEY;
@@ -746,14 +1193,13 @@ int16_t LoRaWANNode::processJoinAccept(LoRaWANJoinEvent_t *joinEvent) {
     RadioLibAES128Instance.init(this->nwkKey);
     RadioLibAES128Instance.encryptECB(keyDerivationBuff, RADIOLIB_AES128_BLOCK_SIZE, this->jSIntKey);
 
-    // prepare the buffer for MIC calculation
-    uint8_t micBuff[3*RADIOLIB_AES128_BLOCK_SIZE] = { 0 };
-    micBuff[0] = RADIOLIB_LORAWAN_JOIN_REQUEST_TYPE;
-    LoRaWANNode::hton<uint64_t>(&micBuff[1], this->joinEUI);
-    LoRaWANNode::hton<uint16_t>(&micBuff[9], this->devNonce - 1);
-    memcpy(&micBuff[11], joinAcceptMsg, lenRx);
+    // the MIC is calculated over a header followed by the message
+    uint8_t micHdr[11] = { 0 };
+    micHdr[0] = this->joinReqType;
+    LoRaWANNode::hton<uint64_t>(&micHdr[1], this->joinEUI);
+    LoRaWANNode::hton<uint16_t>(&micHdr[9], this->joinReqNonce);
     
-    if(!verifyMIC(micBuff, lenRx + 11, this->jSIntKey)) {
+    if(!verifyMIC(joinAcceptMsg, lenRx, this->jSIntKey, micHdr, sizeof(micHdr))) {
       return(RADIOLIB_ERR_CRC_MISMATCH);
     }
   
@@ -764,30 +1210,54 @@ int16_t LoRaWANNode::processJoinAccept(LoRaWANJoinEvent_t *joinEvent) {
     }
 
   }
-  
-  // in case of dynamic band, reset the channels to clear JoinRequest-specific channels
-  if(this->band->bandType == RADIOLIB_LORAWAN_BAND_DYNAMIC) {
-    this->selectChannelPlanDyn(false);
-  }
+
+  // the JoinAccept is authentic, so it can be applied
+  this->joinNonce = joinNonceNew;
+  this->rev = revNew;
+  this->homeNetId = LoRaWANNode::ntoh<uint32_t>(&joinAcceptMsg[RADIOLIB_LORAWAN_JOIN_ACCEPT_HOME_NET_ID_POS], 3);
+  this->devAddr = LoRaWANNode::ntoh<uint32_t>(&joinAcceptMsg[RADIOLIB_LORAWAN_JOIN_ACCEPT_DEV_ADDR_POS]);
 
   uint8_t cOcts[5];
   uint8_t cid = RADIOLIB_LORAWAN_MAC_RX_PARAM_SETUP;
   uint8_t cLen = 0;
-  (void)this->getMacLen(cid, &cLen, RADIOLIB_LORAWAN_DOWNLINK);
-  cOcts[0] = dlSettings & 0x7F;
-  LoRaWANNode::hton<uint32_t>(&cOcts[1], this->channels[RADIOLIB_LORAWAN_DIR_RX2].freq, 3);
-  (void)execMacCommand(cid, cOcts, cLen);
 
-  cid = RADIOLIB_LORAWAN_MAC_RX_TIMING_SETUP;
-  (void)this->getMacLen(cid, &cLen, RADIOLIB_LORAWAN_DOWNLINK);
-  cOcts[0] = joinAcceptMsg[RADIOLIB_LORAWAN_JOIN_ACCEPT_RX_DELAY_POS];
-  (void)execMacCommand(cid, cOcts, cLen);
+  if(this->joinReqType == RADIOLIB_LORAWAN_JOIN_REQUEST_TYPE_2) {
+    // RejoinRequest type 2 only rekeys the session, radio parameters are kept
+    this->fCntUp = 0;
+    this->aFCntDown = 0;
+    this->nFCntDown = 0;
+    this->confFCntUp = RADIOLIB_LORAWAN_FCNT_NONE;
+    this->confFCntDown = RADIOLIB_LORAWAN_FCNT_NONE;
+    this->adrFCnt = 0;
+    this->rjCount0 = 0;
+
+  } else {
+    // RejoinRequest type 0 and 1 reset the session including all radio parameters
+    if(this->joinReqType != RADIOLIB_LORAWAN_JOIN_REQUEST_TYPE) {
+      this->createSession(RADIOLIB_LORAWAN_MODE_OTAA, this->channels[RADIOLIB_LORAWAN_UPLINK].dr);
+    }
+
+    // in case of dynamic band, reset the channels to clear JoinRequest-specific channels
+    if(this->band->bandType == RADIOLIB_LORAWAN_BAND_DYNAMIC) {
+      this->selectChannelPlanDyn(false);
+    }
+
+    (void)this->getMacLen(cid, &cLen, RADIOLIB_LORAWAN_DOWNLINK);
+    cOcts[0] = dlSettings & 0x7F;
+    LoRaWANNode::hton<uint32_t>(&cOcts[1], this->channels[RADIOLIB_LORAWAN_DIR_RX2].freq, 3);
+    (void)execMacCommand(cid, cOcts, cLen);
+
+    cid = RADIOLIB_LORAWAN_MAC_RX_TIMING_SETUP;
+    (void)this->getMacLen(cid, &cLen, RADIOLIB_LORAWAN_DOWNLINK);
+    cOcts[0] = joinAcceptMsg[RADIOLIB_LORAWAN_JOIN_ACCEPT_RX_DELAY_POS];
+    (void)execMacCommand(cid, cOcts, cLen);
 
-  // process CFlist if present (and if CFListType matches used band type)
-  if(lenRx == RADIOLIB_LORAWAN_JOIN_ACCEPT_MAX_LEN && joinAcceptMsg[RADIOLIB_LORAWAN_JOIN_ACCEPT_CFLIST_TYPE_POS] == this->band->bandType) {
-    this->processCFList(&joinAcceptMsg[RADIOLIB_LORAWAN_JOIN_ACCEPT_CFLIST_POS]);
-  } 
-  // if no (valid) CFList was received, default or subband are already setup so don't need to do anything else
+    // process CFlist if present (and if CFListType matches used band type)
+    if(lenRx == RADIOLIB_LORAWAN_JOIN_ACCEPT_MAX_LEN && joinAcceptMsg[RADIOLIB_LORAWAN_JOIN_ACCEPT_CFLIST_TYPE_POS] == this->band->bandType) {
+      this->processCFList(&joinAcceptMsg[RADIOLIB_LORAWAN_JOIN_ACCEPT_CFLIST_POS]);
+    } 
+    // if no (valid) CFList was received, default or subband are already setup so don't need to do anything else
+  }
 
   uint8_t keyDerivationBuff[RADIOLIB_AES128_BLOCK_SIZE] = { 0 };
   LoRaWANNode::hton<uint32_t>(&keyDerivationBuff[RADIOLIB_LORAWAN_JOIN_ACCEPT_AES_JOIN_NONCE_POS], this->joinNonce, 3);
@@ -796,7 +1266,7 @@ int16_t LoRaWANNode::processJoinAccept(LoRaWANJoinEvent_t *joinEvent) {
   if(this->rev == 1) {
     // 1.1 version, derive the keys
     LoRaWANNode::hton<uint64_t>(&keyDerivationBuff[RADIOLIB_LORAWAN_JOIN_ACCEPT_AES_JOIN_EUI_POS], this->joinEUI);
-    LoRaWANNode::hton<uint16_t>(&keyDerivationBuff[RADIOLIB_LORAWAN_JOIN_ACCEPT_AES_DEV_NONCE_POS], this->devNonce - 1);
+    LoRaWANNode::hton<uint16_t>(&keyDerivationBuff[RADIOLIB_LORAWAN_JOIN_ACCEPT_AES_DEV_NONCE_POS], this->joinReqNonce);
     keyDerivationBuff[0] = RADIOLIB_LORAWAN_JOIN_ACCEPT_APP_S_KEY;
 
     RadioLibAES128Instance.init(this->appKey);
@@ -817,7 +1287,7 @@ int16_t LoRaWANNode::processJoinAccept(LoRaWANJoinEvent_t *joinEvent) {
   } else {
     // 1.0 version, just derive the keys
     LoRaWANNode::hton<uint32_t>(&keyDerivationBuff[RADIOLIB_LORAWAN_JOIN_ACCEPT_HOME_NET_ID_POS], this->homeNetId, 3);
-    LoRaWANNode::hton<uint16_t>(&keyDerivationBuff[RADIOLIB_LORAWAN_JOIN_ACCEPT_DEV_ADDR_POS], this->devNonce - 1);
+    LoRaWANNode::hton<uint16_t>(&keyDerivationBuff[RADIOLIB_LORAWAN_JOIN_ACCEPT_DEV_ADDR_POS], this->joinReqNonce);
     keyDerivationBuff[0] = RADIOLIB_LORAWAN_JOIN_ACCEPT_APP_S_KEY;
     RadioLibAES128Instance.init(this->appKey);
     RadioLibAES128Instance.encryptECB(keyDerivationBuff, RADIOLIB_AES128_BLOCK_SIZE, this->appSKey);
@@ -931,25 +1401,29 @@ int16_t LoRaWANNode::activateOTAA(uint8_t joinDr, LoRaWANJoinEvent_t *joinEvent)
   }
 
   // send it
-  state = this->phyLayer->transmit(joinRequestMsg, RADIOLIB_LORAWAN_JOIN_REQUEST_LEN);
-  this->rxDelayStart = mod->hal->millis();
+  state = this->transmitTimed(joinRequestMsg, RADIOLIB_LORAWAN_JOIN_REQUEST_LEN);
   RADIOLIB_ASSERT(state);
   RADIOLIB_DEBUG_PROTOCOL_PRINTLN("JoinRequest sent (DevNonce = %d) <-- Rx Delay start", this->devNonce);
   RADIOLIB_DEBUG_PROTOCOL_HEXDUMP(joinRequestMsg, RADIOLIB_LORAWAN_JOIN_REQUEST_LEN);
 
   // JoinRequest successfully sent, so increase & save devNonce
+  this->joinReqType = RADIOLIB_LORAWAN_JOIN_REQUEST_TYPE;
+  this->joinReqNonce = this->devNonce;
   this->devNonce += 1;
   LoRaWANNode::hton<uint16_t>(&this->bufferNonces[RADIOLIB_LORAWAN_NONCES_DEV_NONCE], this->devNonce);
 
   // set the Time on Air of the JoinRequest
   this->lastToA = this->phyLayer->getTimeOnAir(RADIOLIB_LORAWAN_JOIN_REQUEST_LEN) / 1000;
+  this->addAirtime(this->channels[RADIOLIB_LORAWAN_UPLINK].freq, this->lastToA);
+  this->stats.numJoinRequests++;
+  this->stats.airtime += this->lastToA;
 
   // configure Rx1 and Rx2 delay for JoinAccept message - these are re-configured once a valid JoinAccept is received
   this->rxDelays[1] = RADIOLIB_LORAWAN_JOIN_ACCEPT_DELAY_1_MS;
   this->rxDelays[2] = RADIOLIB_LORAWAN_JOIN_ACCEPT_DELAY_2_MS;
 
   // handle Rx1 and Rx2 windows - returns window > 0 if a downlink is received
-  state = receiveCommon(RADIOLIB_LORAWAN_DOWNLINK, this->channels, this->rxDelays, 2, this->rxDelayStart);
+  state = receiveCommon(RADIOLIB_LORAWAN_DOWNLINK, this->channels, this->rxDelays, 2, this->rxDelayStartUs);
   if(state < RADIOLIB_ERR_NONE) {
     return(state);
   } else if (state == RADIOLIB_ERR_NONE) {
@@ -959,66 +1433,234 @@ int16_t LoRaWANNode::activateOTAA(uint8_t joinDr, LoRaWANJoinEvent_t *joinEvent)
   // process JoinAccept message
   state = this->processJoinAccept(joinEvent);
   RADIOLIB_ASSERT(state);
+  this->resetRejoinCounters();
 
   return(RADIOLIB_LORAWAN_NEW_SESSION);
 }
 
-int16_t LoRaWANNode::activateABP(uint8_t initialDr) {
-  // check if there is an active session
-  if(this->isActivated()) {
-    // already activated, don't do anything
-    return(RADIOLIB_ERR_NONE);
+int16_t LoRaWANNode::sendRejoinRequest(uint8_t rejoinType, LoRaWANJoinEvent_t* joinEvent) {
+  // if not joined, don't do anything
+  if(!this->isActivated()) {
+    return(RADIOLIB_ERR_NETWORK_NOT_JOINED);
   }
-  if(this->bufferNonces[RADIOLIB_LORAWAN_NONCES_ACTIVE]) {
-    // session restored but not yet activated - do so now
-    this->isActive = true;
-    return(RADIOLIB_LORAWAN_SESSION_RESTORED);
+
+  // RejoinRequests only exist for OTAA sessions of LoRaWAN 1.1
+  if((this->lwMode != RADIOLIB_LORAWAN_MODE_OTAA) || (rejoinType > RADIOLIB_LORAWAN_JOIN_REQUEST_TYPE_2)) {
+    return(RADIOLIB_ERR_INVALID_MODE);
+  }
+  if(this->rev != 1) {
+    return(RADIOLIB_ERR_INVALID_REVISION);
   }
 
-  // setup all MAC properties to default values
-  this->createSession(RADIOLIB_LORAWAN_MODE_ABP, initialDr);
+  int16_t state = RADIOLIB_ERR_UNKNOWN;
 
-  // new session all good, so set active-bit to true
-  this->bufferNonces[RADIOLIB_LORAWAN_NONCES_ACTIVE] = (uint8_t)true;
+  // build the RejoinRequest message
+  uint8_t rejoinRequestMsg[RADIOLIB_LORAWAN_REJOIN_REQUEST_1_LEN];
+  uint8_t rejoinRequestLen = this->composeRejoinRequest(rejoinType, rejoinRequestMsg);
 
-  // generate the signature of the Nonces buffer, and store it in the last two bytes of the Nonces buffer
-  uint16_t signature = LoRaWANNode::checkSum16(this->bufferNonces, RADIOLIB_LORAWAN_NONCES_BUF_SIZE - 2);
-  LoRaWANNode::hton<uint16_t>(&this->bufferNonces[RADIOLIB_LORAWAN_NONCES_SIGNATURE], signature);
+  // select a random pair of Tx/Rx channels
+  state = this->selectChannels();
+  RADIOLIB_ASSERT(state);
 
-  // store DevAddr and all keys
-  LoRaWANNode::hton<uint32_t>(&this->bufferSession[RADIOLIB_LORAWAN_SESSION_DEV_ADDR], this->devAddr);
-  memcpy(&this->bufferSession[RADIOLIB_LORAWAN_SESSION_APP_SKEY], this->appSKey, RADIOLIB_AES128_BLOCK_SIZE);
-  memcpy(&this->bufferSession[RADIOLIB_LORAWAN_SESSION_NWK_SENC_KEY], this->nwkSEncKey, RADIOLIB_AES128_BLOCK_SIZE);
-  memcpy(&this->bufferSession[RADIOLIB_LORAWAN_SESSION_FNWK_SINT_KEY], this->fNwkSIntKey, RADIOLIB_AES128_BLOCK_SIZE);
-  memcpy(&this->bufferSession[RADIOLIB_LORAWAN_SESSION_SNWK_SINT_KEY], this->sNwkSIntKey, RADIOLIB_AES128_BLOCK_SIZE);
-  
-  // set the signature of the Nonces buffer in the Session buffer
-  LoRaWANNode::hton<uint16_t>(&this->bufferSession[RADIOLIB_LORAWAN_SESSION_NONCES_SIGNATURE], signature);
-  
-  // store network parameters
-  LoRaWANNode::hton<uint32_t>(&this->bufferSession[RADIOLIB_LORAWAN_SESSION_HOMENET_ID], this->homeNetId);
-  LoRaWANNode::hton<uint8_t>(&this->bufferSession[RADIOLIB_LORAWAN_SESSION_VERSION], this->rev);
+  // set the physical layer configuration for uplink
+  state = this->setPhyProperties(&this->channels[RADIOLIB_LORAWAN_UPLINK],
+                                 RADIOLIB_LORAWAN_UPLINK, 
+                                 this->txPowerMax - 2*this->txPowerSteps);
+  RADIOLIB_ASSERT(state);
 
-  this->isActive = true;
+  // calculate RejoinRequest time-on-air in milliseconds
+  this->lastToA = this->phyLayer->getTimeOnAir(rejoinRequestLen) / 1000;
+  if(this->dwellTimeEnabledUp && (this->lastToA > this->dwellTimeUp)) {
+    RADIOLIB_DEBUG_PROTOCOL_PRINTLN("Dwell time exceeded: ToA = %lu, max = %d", (unsigned long)this->lastToA, this->dwellTimeUp);
+    return(RADIOLIB_ERR_DWELL_TIME_EXCEEDED);
+  }
 
-  return(RADIOLIB_LORAWAN_NEW_SESSION);
-}
+  // send it
+  state = this->transmitTimed(rejoinRequestMsg, rejoinRequestLen);
+  RADIOLIB_ASSERT(state);
+  RADIOLIB_DEBUG_PROTOCOL_PRINTLN("RejoinRequest type %d sent <-- Rx Delay start", rejoinType);
+  RADIOLIB_DEBUG_PROTOCOL_HEXDUMP(rejoinRequestMsg, rejoinRequestLen);
+
+  // RejoinRequest successfully sent, so increase the counter of this type
+  this->joinReqType = rejoinType;
+  if(rejoinType == RADIOLIB_LORAWAN_JOIN_REQUEST_TYPE_1) {
+    // RJcount1 must never repeat for the same JoinEUI, so it is kept next to DevNonce
+    // the session keeps matching the Nonces buffer, as no JoinAccept may follow
+    this->joinReqNonce = this->rjCount1;
+    this->rjCount1 += 1;
+    LoRaWANNode::hton<uint16_t>(&this->bufferNonces[RADIOLIB_LORAWAN_NONCES_RJ_COUNT1], this->rjCount1);
+    uint16_t signature = LoRaWANNode::checkSum16(this->bufferNonces, RADIOLIB_LORAWAN_NONCES_BUF_SIZE - 2);
+    LoRaWANNode::hton<uint16_t>(&this->bufferNonces[RADIOLIB_LORAWAN_NONCES_SIGNATURE], signature);
+    LoRaWANNode::hton<uint16_t>(&this->bufferSession[RADIOLIB_LORAWAN_SESSION_NONCES_SIGNATURE], signature);
+  } else {
+    this->joinReqNonce = this->rjCount0;
+    this->rjCount0 += 1;
+  }
 
-void LoRaWANNode::processCFList(uint8_t* cfList) {
-  RADIOLIB_DEBUG_PROTOCOL_PRINTLN("Processing CFList");
-  
-  uint8_t cOcts[14] = { 0 }; // TODO explain
-  uint8_t cid;
-  uint8_t cLen = 0;
+  this->addAirtime(this->channels[RADIOLIB_LORAWAN_UPLINK].freq, this->lastToA);
+  this->stats.numJoinRequests++;
+  this->stats.airtime += this->lastToA;
 
-  if(this->band->bandType == RADIOLIB_LORAWAN_BAND_DYNAMIC) {
-    // retrieve number of existing (default) channels
-    size_t num = 0;
-    for(int i = 0; i < RADIOLIB_LORAWAN_NUM_AVAILABLE_CHANNELS; i++) {
-      if(!this->channelPlan[RADIOLIB_LORAWAN_UPLINK][i].enabled) {
-        break;
-      }
-      num++;
+  // the JoinAccept uses the JoinAccept delays, the delays of the session are kept in case there is no answer
+  RadioLibTime_t joinAcceptDelays[3] = { 0, RADIOLIB_LORAWAN_JOIN_ACCEPT_DELAY_1_MS, RADIOLIB_LORAWAN_JOIN_ACCEPT_DELAY_2_MS };
+
+  // handle Rx1 and Rx2 windows - returns window > 0 if a downlink is received
+  state = receiveCommon(RADIOLIB_LORAWAN_DOWNLINK, this->channels, joinAcceptDelays, 2, this->rxDelayStartUs);
+  if(state < RADIOLIB_ERR_NONE) {
+    return(state);
+  } else if (state == RADIOLIB_ERR_NONE) {
+    return(RADIOLIB_ERR_NO_JOIN_ACCEPT);
+  }
+
+  // process JoinAccept message
+  state = this->processJoinAccept(joinEvent);
+  RADIOLIB_ASSERT(state);
+  this->resetRejoinCounters();
+
+  if(joinEvent) {
+    joinEvent->newSession = true;
+    joinEvent->devNonce = this->joinReqNonce;
+  }
+
+  return(RADIOLIB_LORAWAN_NEW_SESSION);
+}
+
+bool LoRaWANNode::isRejoinDue() {
+  // RejoinRequests only exist for OTAA sessions of LoRaWAN 1.1
+  if(!this->isActivated() || (this->lwMode != RADIOLIB_LORAWAN_MODE_OTAA) || (this->rev != 1)) {
+    return(false);
+  }
+
+  Module* mod = this->phyLayer->getMod();
+  RadioLibTime_t now = mod->hal->millis();
+
+  // the network requested RejoinRequests which are not all sent yet
+  if(this->forceRejoinType != RADIOLIB_LORAWAN_JOIN_REQUEST_TYPE) {
+    return(now - this->forceRejoinTime >= this->forceRejoinDelay);
+  }
+
+  // count the time in seconds, so that periods of up to 2^25 seconds fit
+  RadioLibTime_t elapsed = (now - this->rejoinTimestamp) / 1000;
+  this->rejoinSeconds += elapsed;
+  this->rejoinTimestamp += elapsed * 1000;
+
+  // periodic RejoinRequest after 2^(MaxCountN + 4) uplinks or 2^(MaxTimeN + 10) seconds
+  if(this->fCntUp - this->rejoinFCnt >= (1UL << (this->rejoinMaxCountN + 4))) {
+    return(true);
+  }
+  return(this->rejoinSeconds >= (1UL << (this->rejoinMaxTimeN + 10)));
+}
+
+int16_t LoRaWANNode::rejoinIfDue(LoRaWANJoinEvent_t* joinEvent) {
+  if(!this->isRejoinDue()) {
+    return(RADIOLIB_ERR_NONE);
+  }
+
+  Module* mod = this->phyLayer->getMod();
+  uint8_t rejoinType = RADIOLIB_LORAWAN_JOIN_REQUEST_TYPE_0;
+  uint8_t drUp = this->channels[RADIOLIB_LORAWAN_UPLINK].dr;
+
+  if(this->forceRejoinType != RADIOLIB_LORAWAN_JOIN_REQUEST_TYPE) {
+    rejoinType = this->forceRejoinType;
+
+    // use the datarate requested by the network, if it exists in this band
+    if((this->forceRejoinDr < RADIOLIB_LORAWAN_CHANNEL_NUM_DATARATES) && 
+       (this->band->dataRates[this->forceRejoinDr] != RADIOLIB_LORAWAN_DATA_RATE_UNUSED)) {
+      this->channels[RADIOLIB_LORAWAN_UPLINK].dr = this->forceRejoinDr;
+    }
+
+    // schedule the next retry after 32 * 2^Period seconds plus a random delay of up to 32 seconds
+    this->forceRejoinRetries--;
+    if(this->forceRejoinRetries == 0) {
+      this->forceRejoinType = RADIOLIB_LORAWAN_JOIN_REQUEST_TYPE;
+    }
+    this->forceRejoinTime = mod->hal->millis();
+    this->forceRejoinDelay = (RADIOLIB_LORAWAN_FORCE_REJOIN_PERIOD_MS << this->forceRejoinPeriod) + 
+                             this->phyLayer->random(RADIOLIB_LORAWAN_FORCE_REJOIN_PERIOD_MS);
+  
+  } else {
+    // periodic RejoinRequests are counted from this attempt, whether or not the network answers
+    this->resetRejoinCounters();
+  
+  }
+
+  int16_t state = this->sendRejoinRequest(rejoinType, joinEvent);
+
+  // a new session (except for type 2) sets its own datarate, otherwise return to the previous one
+  if((state != RADIOLIB_LORAWAN_NEW_SESSION) || (rejoinType == RADIOLIB_LORAWAN_JOIN_REQUEST_TYPE_2)) {
+    this->channels[RADIOLIB_LORAWAN_UPLINK].dr = drUp;
+  }
+
+  // it is up to the network whether it answers, so no answer is not an error
+  if(state == RADIOLIB_ERR_NO_JOIN_ACCEPT) {
+    state = RADIOLIB_ERR_NONE;
+  }
+  return(state);
+}
+
+void LoRaWANNode::resetRejoinCounters() {
+  Module* mod = this->phyLayer->getMod();
+  this->rejoinFCnt = this->fCntUp;
+  this->rejoinSeconds = 0;
+  this->rejoinTimestamp = mod->hal->millis();
+}
+
+int16_t LoRaWANNode::activateABP(uint8_t initialDr) {
+  // check if there is an active session
+  if(this->isActivated()) {
+    // already activated, don't do anything
+    return(RADIOLIB_ERR_NONE);
+  }
+  if(this->bufferNonces[RADIOLIB_LORAWAN_NONCES_ACTIVE]) {
+    // session restored but not yet activated - do so now
+    this->isActive = true;
+    return(RADIOLIB_LORAWAN_SESSION_RESTORED);
+  }
+
+  // setup all MAC properties to default values
+  this->createSession(RADIOLIB_LORAWAN_MODE_ABP, initialDr);
+
+  // new session all good, so set active-bit to true
+  this->bufferNonces[RADIOLIB_LORAWAN_NONCES_ACTIVE] = (uint8_t)true;
+
+  // generate the signature of the Nonces buffer, and store it in the last two bytes of the Nonces buffer
+  uint16_t signature = LoRaWANNode::checkSum16(this->bufferNonces, RADIOLIB_LORAWAN_NONCES_BUF_SIZE - 2);
+  LoRaWANNode::hton<uint16_t>(&this->bufferNonces[RADIOLIB_LORAWAN_NONCES_SIGNATURE], signature);
+
+  // store DevAddr and all keys
+  LoRaWANNode::hton<uint32_t>(&this->bufferSession[RADIOLIB_LORAWAN_SESSION_DEV_ADDR], this->devAddr);
+  memcpy(&this->bufferSession[RADIOLIB_LORAWAN_SESSION_APP_SKEY], this->appSKey, RADIOLIB_AES128_BLOCK_SIZE);
+  memcpy(&this->bufferSession[RADIOLIB_LORAWAN_SESSION_NWK_SENC_KEY], this->nwkSEncKey, RADIOLIB_AES128_BLOCK_SIZE);
+  memcpy(&this->bufferSession[RADIOLIB_LORAWAN_SESSION_FNWK_SINT_KEY], this->fNwkSIntKey, RADIOLIB_AES128_BLOCK_SIZE);
+  memcpy(&this->bufferSession[RADIOLIB_LORAWAN_SESSION_SNWK_SINT_KEY], this->sNwkSIntKey, RADIOLIB_AES128_BLOCK_SIZE);
+  
+  // set the signature of the Nonces buffer in the Session buffer
+  LoRaWANNode::hton<uint16_t>(&this->bufferSession[RADIOLIB_LORAWAN_SESSION_NONCES_SIGNATURE], signature);
+  
+  // store network parameters
+  LoRaWANNode::hton<uint32_t>(&this->bufferSession[RADIOLIB_LORAWAN_SESSION_HOMENET_ID], this->homeNetId);
+  LoRaWANNode::hton<uint8_t>(&this->bufferSession[RADIOLIB_LORAWAN_SESSION_VERSION], this->rev);
+
+  this->isActive = true;
+
+  return(RADIOLIB_LORAWAN_NEW_SESSION);
+}
+
+void LoRaWANNode::processCFList(uint8_t* cfList) {
+  RADIOLIB_DEBUG_PROTOCOL_PRINTLN("Processing CFList");
+  
+  uint8_t cOcts[14] = { 0 }; // TODO explain
+  uint8_t cid;
+  uint8_t cLen = 0;
+
+  if(this->band->bandType == RADIOLIB_LORAWAN_BAND_DYNAMIC) {
+    // retrieve number of existing (default) channels
+    size_t num = 0;
+    for(int i = 0; i < RADIOLIB_LORAWAN_NUM_AVAILABLE_CHANNELS; i++) {
+      if(!this->channelPlan[RADIOLIB_LORAWAN_UPLINK][i].enabled) {
+        break;
+      }
+      num++;
     }
 
     cid = RADIOLIB_LORAWAN_MAC_NEW_CHANNEL;
@@ -1038,12 +1680,7 @@ void LoRaWANNode::processCFList(uint8_t* cfList) {
       (void)execMacCommand(cid, cOcts, cLen);
     }
   } else {                // RADIOLIB_LORAWAN_BAND_FIXED
-    // complete channel mask received, so clear all existing channels
-    for(int i = 0; i < RADIOLIB_LORAWAN_NUM_AVAILABLE_CHANNELS; i++) {
-      this->channelPlan[RADIOLIB_LORAWAN_UPLINK][i] = RADIOLIB_LORAWAN_CHANNEL_NONE;
-    }
-
-    // copy channel mask straight over to LinkAdr MAC command
+    // complete channel mask received, so copy channel mask straight over to LinkAdr MAC command
     cid = RADIOLIB_LORAWAN_MAC_LINK_ADR;
     cLen = 14;                                      // special internal ADR length
     cOcts[0] = 0xFF;                                // same datarate and cOcts
@@ -1159,6 +1796,81 @@ void LoRaWANNode::adrBackoff() {
   return;
 }
 
+void LoRaWANNode::adaptUplink() {
+  // periodically request the link margin from the network
+  if((this->adaptiveLinkCheckPeriod > 0) && (this->fCntUp - this->adaptiveFCnt >= this->adaptiveLinkCheckPeriod)) {
+    if(this->sendMacCommandReq(RADIOLIB_LORAWAN_MAC_LINK_CHECK) == RADIOLIB_ERR_NONE) {
+      this->adaptiveFCnt = this->fCntUp;
+    }
+  }
+
+  // nothing to do until a new margin is known
+  if(this->adaptiveMargin == RADIOLIB_LORAWAN_ADAPTIVE_MARGIN_NONE) {
+    return;
+  }
+
+  // each datarate or Tx power step is worth roughly 3 dB of margin
+  int16_t steps = (this->adaptiveMargin - (int16_t)this->adaptiveMarginTarget) / RADIOLIB_LORAWAN_ADAPTIVE_STEP_DB;
+  RADIOLIB_DEBUG_PROTOCOL_PRINTLN("Adaptive uplink: margin = %d dB, gateways = %d, steps = %d", this->adaptiveMargin, this->adaptiveGwCnt, steps);
+  this->adaptiveMargin = RADIOLIB_LORAWAN_ADAPTIVE_MARGIN_NONE;
+
+  // spare margin: first increase the datarate to save airtime, then decrease Tx power
+  // only LoRa datarates are considered, as FSK and LR-FHSS do not fit the 3 dB per step scale
+  while(steps > 0) {
+    uint8_t drNext = this->channels[RADIOLIB_LORAWAN_UPLINK].dr + 1;
+    if((drNext >= RADIOLIB_LORAWAN_CHANNEL_NUM_DATARATES) || 
+       ((this->band->dataRates[drNext] & RADIOLIB_LORAWAN_DATA_RATE_MODEM) != RADIOLIB_LORAWAN_DATA_RATE_LORA) ||
+       (this->setDatarate(drNext) != RADIOLIB_ERR_NONE)) {
+      break;
+    }
+    steps--;
+  }
+  while((steps > 0) && (this->txPowerSteps < this->band->powerNumSteps)) {
+    if(this->setTxPower(this->txPowerMax - 2*(this->txPowerSteps + 1)) != RADIOLIB_ERR_NONE) {
+      break;
+    }
+    steps--;
+  }
+
+  // missing margin: first increase Tx power, then decrease the datarate
+  while((steps < 0) && (this->txPowerSteps > 0)) {
+    if(this->setTxPower(this->txPowerMax - 2*(this->txPowerSteps - 1)) != RADIOLIB_ERR_NONE) {
+      break;
+    }
+    steps++;
+  }
+  while((steps < 0) && (this->channels[RADIOLIB_LORAWAN_UPLINK].dr > 0)) {
+    if(this->setDatarate(this->channels[RADIOLIB_LORAWAN_UPLINK].dr - 1) != RADIOLIB_ERR_NONE) {
+      break;
+    }
+    steps++;
+  }
+
+  // if the margin is still too low, repeat the uplinks to improve the delivery probability
+  // with sufficient margin, a single transmission is enough, unless only a single gateway is known to receive it
+  if(steps < 0) {
+    this->nbTrans = RADIOLIB_MIN(this->nbTrans + 1, RADIOLIB_LORAWAN_ADAPTIVE_NB_TRANS_MAX);
+  } else if(this->adaptiveGwCnt != 1) {
+    this->nbTrans = 1;
+  }
+}
+
+int16_t LoRaWANNode::getDownlinkMargin(uint8_t dr) {
+  if(dr >= RADIOLIB_LORAWAN_CHANNEL_NUM_DATARATES) {
+    return(RADIOLIB_LORAWAN_ADAPTIVE_MARGIN_NONE);
+  }
+
+  // only LoRa has a well-known demodulation floor: -7.5 dB at SF7, 2.5 dB lower for every next SF
+  DataRate_t dataRate;
+  ModemType_t modem;
+  if((LoRaWANNode::decodeDataRate(this->band->dataRates[dr], &dataRate, &modem) != RADIOLIB_ERR_NONE) ||
+     (modem != ModemType_t::RADIOLIB_MODEM_LORA)) {
+    return(RADIOLIB_LORAWAN_ADAPTIVE_MARGIN_NONE);
+  }
+  float margin = this->phyLayer->getSNR() + 7.5f + 2.5f*(dataRate.lora.spreadingFactor - 7);
+  return((int16_t)margin);
+}
+
 void LoRaWANNode::composeUplink(const uint8_t* in, uint8_t lenIn, uint8_t* out, uint8_t fPort, bool isConfirmed) {
   // set the packet fields
   if(isConfirmed) {
@@ -1198,7 +1910,7 @@ void LoRaWANNode::composeUplink(const uint8_t* in, uint8_t lenIn, uint8_t* out,
 
     if(this->rev == 1) {
       // in LoRaWAN v1.1, the FOpts are encrypted using the NwkSEncKey
-      processAES(this->fOptsUp, this->fOptsUpLen, this->nwkSEncKey, &out[RADIOLIB_LORAWAN_FHDR_FOPTS_POS], this->fCntUp, RADIOLIB_LORAWAN_UPLINK, 0x01, true);
+      processAES(this->fOptsUp, this->fOptsUpLen, this->nwkSEncKey, &out[RADIOLIB_LORAWAN_FHDR_FOPTS_POS], this->devAddr, this->fCntUp, RADIOLIB_LORAWAN_UPLINK, 0x01, true);
     } else {
       // in LoRaWAN v1.0.x, the FOpts are unencrypted
       memcpy(&out[RADIOLIB_LORAWAN_FHDR_FOPTS_POS], this->fOptsUp, this->fOptsUpLen);
@@ -1216,7 +1928,7 @@ void LoRaWANNode::composeUplink(const uint8_t* in, uint8_t lenIn, uint8_t* out,
   }
 
   // encrypt the frame payload
-  processAES(in, lenIn, encKey, &out[RADIOLIB_LORAWAN_FRAME_PAYLOAD_POS(this->fOptsUpLen)], this->fCntUp, RADIOLIB_LORAWAN_UPLINK, 0x00, true);
+  processAES(in, lenIn, encKey, &out[RADIOLIB_LORAWAN_FRAME_PAYLOAD_POS(this->fOptsUpLen)], this->devAddr, this->fCntUp, RADIOLIB_LORAWAN_UPLINK, 0x00, true);
 }
 
 void LoRaWANNode::micUplink(uint8_t* inOut, uint8_t lenInOut) {
@@ -1271,19 +1983,23 @@ int16_t LoRaWANNode::transmitUplink(LoRaWANChannel_t* chnl, uint8_t* in, uint8_t
     this->tUplink = tNow;
   }
 
-  // if dutycycle is enabled and the time since last uplink + interval has not elapsed, return an error
-  // but: don't check this for retransmissions
-  if(!retrans && this->dutyCycleEnabled) {
-    if(this->rxDelayStart + (RadioLibTime_t)dutyCycleInterval(this->dutyCycle, this->lastToA) > this->tUplink) {
-      return(RADIOLIB_ERR_UPLINK_UNAVAILABLE);
-    }
-  }
-
   // set the physical layer configuration for uplink
   state = this->setPhyProperties(chnl,
                                  RADIOLIB_LORAWAN_UPLINK, 
                                  this->txPowerMax - 2*this->txPowerSteps);
   RADIOLIB_ASSERT(state);
+
+  // if dutycycle is enabled and the airtime used during the last hour leaves no room for this uplink
+  // at the scheduled time, return an error
+  // but: don't check this for retransmissions
+  RadioLibTime_t toa = this->phyLayer->getTimeOnAir(len) / 1000;
+  if(!retrans && this->dutyCycleEnabled) {
+    // tUplink is never in the past at this point, so the difference cannot underflow
+    RadioLibTime_t wait = this->airtimeWait(chnl->freq, toa);
+    if((wait == RADIOLIB_LORAWAN_TIME_UNAVAILABLE) || (wait > this->tUplink - tNow)) {
+      return(RADIOLIB_ERR_UPLINK_UNAVAILABLE);
+    }
+  }
   
   // if requested, wait until transmitting uplink
   tNow = mod->hal->millis();
@@ -1294,20 +2010,29 @@ int16_t LoRaWANNode::transmitUplink(LoRaWANChannel_t* chnl, uint8_t* in, uint8_t
     }
   }
 
-  state = this->phyLayer->transmit(in, len);
+  // when sending through a relay, it has to be woken up first, after which the uplink configuration is restored
+  if(this->relayUplinks) {
+    state = this->wakeRelay(chnl);
+    RADIOLIB_ASSERT(state);
+    state = this->setPhyProperties(chnl, RADIOLIB_LORAWAN_UPLINK, this->txPowerMax - 2*this->txPowerSteps);
+    RADIOLIB_ASSERT(state);
+  }
 
-  // set the timestamp so that we can measure when to start receiving
-  this->rxDelayStart = mod->hal->millis();
+  // send it and set the timestamp so that we can measure when to start receiving
+  state = this->transmitTimed(in, len);
   RADIOLIB_DEBUG_PROTOCOL_PRINTLN("Uplink sent <-- Rx Delay start");
 
-  // increase Time on Air of the uplink sequence
-  this->lastToA += this->phyLayer->getTimeOnAir(len) / 1000;
+  // increase Time on Air of the uplink sequence, and account for it in the sliding hour
+  this->lastToA += toa;
+  this->addAirtime(chnl->freq, toa);
+  this->stats.numTransmissions++;
+  this->stats.airtime += toa;
 
   return(state);
 }
 
 // flag to indicate whether there was some action during Rx mode (timeout or downlink)
-static volatile bool downlinkAction = false;
+static RADIOLIB_THREAD_LOCAL volatile bool downlinkAction = false;
 
 // interrupt service routine to handle downlinks automatically
 #if defined(ESP8266) || defined(ESP32)
@@ -1317,6 +2042,67 @@ static void LoRaWANNodeOnDownlinkAction(void) {
   downlinkAction = true;
 }
 
+// flag to indicate that an uplink was sent, and the timestamp at which that happened
+static RADIOLIB_THREAD_LOCAL volatile bool uplinkAction = false;
+static RADIOLIB_THREAD_LOCAL volatile RadioLibTime_t uplinkTimestamp = 0;
+static RADIOLIB_THREAD_LOCAL RadioLibHal* uplinkHal = NULL;
+
+// interrupt service routine to timestamp the end of uplinks
+#if defined(ESP8266) || defined(ESP32)
+  IRAM_ATTR
+#endif
+static void LoRaWANNodeOnUplinkAction(void) {
+  uplinkTimestamp = uplinkHal->micros();
+  uplinkAction = true;
+}
+
+int16_t LoRaWANNode::transmitTimed(const uint8_t* in, uint8_t len) {
+  Module* mod = this->phyLayer->getMod();
+  int16_t state = RADIOLIB_ERR_UNKNOWN;
+
+  // in LR-FHSS, the interrupt also requests frequency hops, which only the blocking transmit handles
+  uint8_t dataRate = this->band->dataRates[this->channels[RADIOLIB_LORAWAN_UPLINK].dr];
+  if((dataRate & RADIOLIB_LORAWAN_DATA_RATE_MODEM) == RADIOLIB_LORAWAN_DATA_RATE_LR_FHSS) {
+    state = this->phyLayer->transmit(in, len);
+    this->rxDelayStartUs = mod->hal->micros();
+    this->rxDelayStart = mod->hal->millis();
+    return(state);
+  }
+
+  // start transmitting, the interrupt will capture the exact time the transmission finished
+  uplinkAction = false;
+  uplinkHal = mod->hal;
+  this->phyLayer->setPacketSentAction(LoRaWANNodeOnUplinkAction);
+  state = this->phyLayer->startTransmit(in, len);
+  if(state == RADIOLIB_ERR_NONE) {
+    // wait for the transmission to finish, with the same timeout as blocking transmit (500% of time-on-air)
+    RadioLibTime_t timeout = this->phyLayer->getTimeOnAir(len) * 5;
+    RadioLibTime_t start = mod->hal->micros();
+    while(!uplinkAction && (mod->hal->micros() - start <= timeout)) {
+      mod->hal->yield();
+    }
+    if(!uplinkAction) {
+      state = RADIOLIB_ERR_TX_TIMEOUT;
+    }
+  }
+  this->phyLayer->clearPacketSentAction();
+
+  // set the timestamps of the end of transmission - in case of an error, this is the current time
+  RadioLibTime_t now = mod->hal->micros();
+  this->rxDelayStartUs = uplinkAction ? uplinkTimestamp : now;
+  this->rxDelayStart = mod->hal->millis() - (now - this->rxDelayStartUs) / 1000;
+
+  // finish the transmission even if it timed out, to put the radio back into standby
+  int16_t stateFinish = this->phyLayer->finishTransmit();
+  RADIOLIB_ASSERT(state);
+  return(stateFinish);
+}
+
+RadioLibTime_t LoRaWANNode::getRxWindowGuard(RadioLibTime_t rxDelay) {
+  // fixed guard for interrupt latency and the like, plus the host clock error accumulated during the Rx delay
+  return(this->scanGuard * 1000 + (rxDelay * this->clockDrift) / 1000);
+}
+
 int16_t LoRaWANNode::receiveCommon(uint8_t dir, const LoRaWANChannel_t* dlChannels, const RadioLibTime_t* dlDelays, uint8_t numWindows, RadioLibTime_t tReference) {
   Module* mod = this->phyLayer->getMod();
 
@@ -1324,12 +2110,12 @@ int16_t LoRaWANNode::receiveCommon(uint8_t dir, const LoRaWANChannel_t* dlChanne
 
   // check if there are any upcoming Rx windows
   // if the Rx1 window has already started, you're too late, because most downlinks happen in Rx1
-  RadioLibTime_t now = mod->hal->millis();  // fix the current timestamp to prevent negative delays
-  if(now > tReference + dlDelays[1] - this->scanGuard) {
+  RadioLibTime_t elapsed = mod->hal->micros() - tReference;  // fix the elapsed time to prevent negative delays
+  if(elapsed + this->getRxWindowGuard(dlDelays[1]) > dlDelays[1] * 1000) {
     // if function was called while Rx windows are in progress,
     // wait until last window closes to prevent very bad stuff
-    if(now < tReference + dlDelays[numWindows]) {
-      mod->hal->delay(dlDelays[numWindows] + tReference - now);
+    if(elapsed < dlDelays[numWindows] * 1000) {
+      mod->hal->delay(dlDelays[numWindows] - elapsed / 1000);
     }
     // update the end timestamp in case user got stuck between uplink and downlink
     this->rxDelayEnd = mod->hal->millis();
@@ -1352,31 +2138,42 @@ int16_t LoRaWANNode::receiveCommon(uint8_t dir, const LoRaWANChannel_t* dlChanne
     state = this->setPhyProperties(&dlChannels[window], dir, this->txPowerMax - 2*this->txPowerSteps);
     RADIOLIB_ASSERT(state);
 
-    // calculate the Rx timeout
-    RadioLibTime_t timeoutHost = this->phyLayer->getTimeOnAir(0) + 2*this->scanGuard*1000;
+    // calculate the Rx timeout, the window is widened by the guard time on both sides
+    RadioLibTime_t guard = this->getRxWindowGuard(dlDelays[window]);
+    RadioLibTime_t timeoutHost = this->phyLayer->getTimeOnAir(0) + 2*guard;
     RadioLibTime_t timeoutMod  = this->phyLayer->calculateRxTimeout(timeoutHost);
 
-    // wait for the start of the Rx window
-    RadioLibTime_t waitLen = tReference + dlDelays[window] - mod->hal->millis();
-    // make sure that no underflow occured; if so, clip the delay (although this will likely miss any downlink)
-    if(waitLen > dlDelays[window]) {
-      waitLen = dlDelays[window];
+    // the window should open one guard time early, compensating for the time it takes to start the receiver
+    RadioLibTime_t tWindow = dlDelays[window] * 1000;
+    if(tWindow > guard + this->rxStartLatency) {
+      tWindow -= guard + this->rxStartLatency;
     }
-    // the waiting duration is shortened a bit to cover any possible timing errors
-    if(waitLen > this->scanGuard) {
-      waitLen -= this->scanGuard;
+
+    // wait for the start of the Rx window - most of it is spent in a millisecond delay,
+    // the remainder is waited out with microsecond precision
+    elapsed = mod->hal->micros() - tReference;
+    if(elapsed < tWindow) {
+      RadioLibTime_t waitLen = tWindow - elapsed;
+      if(waitLen > 2000) {
+        mod->hal->delay(waitLen / 1000 - 1);
+      }
+      elapsed = mod->hal->micros() - tReference;
+      if(elapsed < tWindow) {
+        mod->hal->delayMicroseconds(tWindow - elapsed);
+      }
     }
-    mod->hal->delay(waitLen);
 
     // open Rx window by starting receive with specified timeout
     // TODO remove default arguments
+    RadioLibTime_t tStart = mod->hal->micros();
     state = this->phyLayer->startReceive(timeoutMod, RADIOLIB_IRQ_RX_DEFAULT_FLAGS, RADIOLIB_IRQ_RX_DEFAULT_MASK, 0);
-    tOpen = mod->hal->millis();
+    tOpen = mod->hal->micros();
     RADIOLIB_ASSERT(state);
-    RADIOLIB_DEBUG_PROTOCOL_PRINTLN("Opening Rx%d window (%d ms timeout)... <-- Rx Delay end ", window, (int)(timeoutHost / 1000 + scanGuard / 2));
+    this->rxStartLatency = tOpen - tStart;
+    RADIOLIB_DEBUG_PROTOCOL_PRINTLN("Opening Rx%d window (%lu us timeout)... <-- Rx Delay end ", window, (unsigned long)timeoutHost);
     
     // wait for the timeout to complete (and a small additional delay)
-    mod->hal->delay(timeoutHost / 1000 + this->scanGuard / 2);
+    mod->hal->delay((timeoutHost + guard) / 1000);
     RADIOLIB_DEBUG_PROTOCOL_PRINTLN("Closing Rx%d window", window);
 
     // if the IRQ bit for Rx Timeout is not set, something is received, so stop the windows
@@ -1387,9 +2184,13 @@ int16_t LoRaWANNode::receiveCommon(uint8_t dir, const LoRaWANChannel_t* dlChanne
     if(!timedOut) {
       break;
     }
+
+    // the receiver was on for the full window
+    this->rxOnTime += timeoutHost;
   }
   // Rx windows are now closed
   this->rxDelayEnd = mod->hal->millis();
+  this->rxOnCount++;
 
   // if we got here due to a timeout, stop ongoing activities
   if(timedOut) {
@@ -1402,19 +2203,20 @@ int16_t LoRaWANNode::receiveCommon(uint8_t dir, const LoRaWANChannel_t* dlChanne
   if(this->TS011) {
     maxPayLen = RADIOLIB_MIN(maxPayLen, 222); // payload length is limited to 222 if under repeater
   }
-  RadioLibTime_t tMax = this->phyLayer->getTimeOnAir(maxPayLen + 13) / 1000; // mandatory FHDR is 12/13 bytes
+  RadioLibTime_t tMax = this->phyLayer->getTimeOnAir(maxPayLen + 13); // mandatory FHDR is 12/13 bytes
   bool downlinkComplete = true;
   
   // wait for the DIO to fire indicating a downlink is received
   while(!downlinkAction) {
     mod->hal->yield();
     // stay in Rx mode for the maximum allowed Time-on-Air plus small grace period
-    if(mod->hal->millis() - tOpen > tMax + scanGuard) {
+    if(mod->hal->micros() - tOpen > tMax + this->scanGuard * 1000) {
       RADIOLIB_DEBUG_PROTOCOL_PRINTLN("Downlink missing!");
       downlinkComplete = false;
       break;
     }
   }
+  this->rxOnTime += mod->hal->micros() - tOpen;
 
   // update time of downlink reception
   if(downlinkComplete) {
@@ -1458,6 +2260,7 @@ int16_t LoRaWANNode::parseDownlink(uint8_t* data, size_t* len, LoRaWANEvent_t* e
   // an extra byte is subtracted because downlink frames may not have a fPort
   if(downlinkMsgLen < RADIOLIB_LORAWAN_FRAME_LEN(0, 0) - 1 - RADIOLIB_AES128_BLOCK_SIZE) {
     RADIOLIB_DEBUG_PROTOCOL_PRINTLN("Downlink message too short (%lu bytes)", (unsigned long)downlinkMsgLen);
+    this->stats.numDownlinksForeign++;
     return(RADIOLIB_ERR_DOWNLINK_MALFORMED);
   }
 
@@ -1484,11 +2287,31 @@ int16_t LoRaWANNode::parseDownlink(uint8_t* data, size_t* len, LoRaWANEvent_t* e
     return(state);
   }
 
-  // check the address
+  // in dense networks, many of the received frames are meant for other devices
+  // so first check the header fields that can be compared directly, before any parsing or cryptography
+  uint8_t mhdr = downlinkMsg[RADIOLIB_LORAWAN_FHDR_LEN_START_OFFS];
+  uint8_t mType = mhdr & RADIOLIB_LORAWAN_MHDR_MTYPE_MASK;
+  if(((mType != RADIOLIB_LORAWAN_MHDR_MTYPE_UNCONF_DATA_DOWN) && (mType != RADIOLIB_LORAWAN_MHDR_MTYPE_CONF_DATA_DOWN)) ||
+     ((mhdr & RADIOLIB_LORAWAN_MHDR_MAJOR_MASK) != RADIOLIB_LORAWAN_MHDR_MAJOR_R1)) {
+    RADIOLIB_DEBUG_PROTOCOL_PRINTLN("Not a data downlink (MHDR 0x%02X)", mhdr);
+    this->stats.numDownlinksForeign++;
+    #if !RADIOLIB_STATIC_ONLY
+      delete[] downlinkMsg;
+    #endif
+    return(RADIOLIB_ERR_DOWNLINK_MALFORMED);
+  }
+
+  // check the address - this may also be one of the multicast groups
   uint32_t addr = LoRaWANNode::ntoh<uint32_t>(&downlinkMsg[RADIOLIB_LORAWAN_FHDR_DEV_ADDR_POS]);
+  uint8_t mcGroup = RADIOLIB_LORAWAN_NUM_MC_GROUPS;
   if(addr != this->devAddr) {
+    mcGroup = this->findMulticastGroup(addr);
+  }
+  bool isMulticast = (mcGroup < RADIOLIB_LORAWAN_NUM_MC_GROUPS);
+  if((addr != this->devAddr) && !isMulticast) {
     RADIOLIB_DEBUG_PROTOCOL_PRINTLN("Device address mismatch, expected 0x%08lX, got 0x%08lX", 
                                     (unsigned long)this->devAddr, (unsigned long)addr);
+    this->stats.numDownlinksForeign++;
     #if !RADIOLIB_STATIC_ONLY
       delete[] downlinkMsg;
     #endif
@@ -1563,6 +2386,16 @@ int16_t LoRaWANNode::parseDownlink(uint8_t* data, size_t* len, LoRaWANEvent_t* e
     #endif
     return(RADIOLIB_ERR_INVALID_PORT);
   }
+
+  // multicast frames can only be unconfirmed application frames without any MAC commands
+  if(isMulticast && ((fOptsPbLen > 0) || (fPort == RADIOLIB_LORAWAN_FPORT_MAC_COMMAND) || 
+     ((downlinkMsg[RADIOLIB_LORAWAN_FHDR_LEN_START_OFFS] & RADIOLIB_LORAWAN_MHDR_MTYPE_MASK) != RADIOLIB_LORAWAN_MHDR_MTYPE_UNCONF_DATA_DOWN))) {
+    RADIOLIB_DEBUG_PROTOCOL_PRINTLN("Invalid multicast frame for group %d", mcGroup);
+    #if !RADIOLIB_STATIC_ONLY
+      delete[] downlinkMsg;
+    #endif
+    return(RADIOLIB_ERR_DOWNLINK_MALFORMED);
+  }
   
   // get the frame counter
   uint16_t fCnt16 = LoRaWANNode::ntoh<uint16_t>(&downlinkMsg[RADIOLIB_LORAWAN_FHDR_FCNT_POS]);
@@ -1579,8 +2412,27 @@ int16_t LoRaWANNode::parseDownlink(uint8_t* data, size_t* len, LoRaWANEvent_t* e
   // assume a 16-bit to 32-bit rollover if difference between counters in LSB is smaller than MAX_FCNT_GAP
   // if that isn't the case and the received fCnt is smaller or equal to the last heard fCnt, then error
   uint32_t fCnt32 = fCnt16;
-  if(fCntDownPrev > 0) {
+  if(isMulticast) {
+    // multicast groups keep their own frame counter, which must lie within the configured range
+    LoRaWANMulticastGroup_t* group = &this->mcGroups[mcGroup];
+    uint32_t fCntNext = group->fCntMin;
+    if(group->fCnt != RADIOLIB_LORAWAN_FCNT_NONE) {
+      fCntNext = group->fCnt + 1;
+    }
+    fCnt32 = (fCntNext & 0xFFFF0000) | fCnt16;
+    if(fCnt32 < fCntNext) {
+      fCnt32 += ((uint32_t)1 << 16);
+    }
+    if((fCnt32 < fCntNext) || (fCnt32 > group->fCntMax) || (fCnt32 - fCntNext > RADIOLIB_LORAWAN_MAX_FCNT_GAP)) {
+      this->stats.numDownlinksFCntInvalid++;
+      #if !RADIOLIB_STATIC_ONLY
+        delete[] downlinkMsg;
+      #endif
+      return(RADIOLIB_ERR_A_FCNT_DOWN_INVALID);
+    }
+  } else if(fCntDownPrev > 0) {
     if((fCnt16 <= fCntDownPrev) && ((0xFFFF - (uint16_t)fCntDownPrev + fCnt16) > RADIOLIB_LORAWAN_MAX_FCNT_GAP)) {
+      this->stats.numDownlinksFCntInvalid++;
       #if !RADIOLIB_STATIC_ONLY
         delete[] downlinkMsg;
       #endif
@@ -1597,7 +2449,7 @@ int16_t LoRaWANNode::parseDownlink(uint8_t* data, size_t* len, LoRaWANEvent_t* e
 
   // check if the ACK bit is set, indicating this frame acknowledges the previous uplink
   bool isConfirmingUp = false;
-  if((downlinkMsg[RADIOLIB_LORAWAN_FHDR_FCTRL_POS] & RADIOLIB_LORAWAN_FCTRL_ACK)) {
+  if(!isMulticast && (downlinkMsg[RADIOLIB_LORAWAN_FHDR_FCTRL_POS] & RADIOLIB_LORAWAN_FCTRL_ACK)) {
     isConfirmingUp = true;
   }
 
@@ -1610,12 +2462,17 @@ int16_t LoRaWANNode::parseDownlink(uint8_t* data, size_t* len, LoRaWANEvent_t* e
     LoRaWANNode::hton<uint16_t>(&downlinkMsg[RADIOLIB_LORAWAN_BLOCK_CONF_FCNT_POS], (uint16_t)this->confFCntUp);
   }
   downlinkMsg[RADIOLIB_LORAWAN_BLOCK_DIR_POS] = RADIOLIB_LORAWAN_DOWNLINK;
-  LoRaWANNode::hton<uint32_t>(&downlinkMsg[RADIOLIB_LORAWAN_BLOCK_DEV_ADDR_POS], this->devAddr);
-  LoRaWANNode::hton<uint16_t>(&downlinkMsg[RADIOLIB_LORAWAN_BLOCK_FCNT_POS], fCnt32);
+  LoRaWANNode::hton<uint32_t>(&downlinkMsg[RADIOLIB_LORAWAN_BLOCK_DEV_ADDR_POS], addr);
+  LoRaWANNode::hton<uint32_t>(&downlinkMsg[RADIOLIB_LORAWAN_BLOCK_FCNT_POS], fCnt32);
   downlinkMsg[RADIOLIB_LORAWAN_MIC_BLOCK_LEN_POS] = downlinkMsgLen - sizeof(uint32_t);
 
   // check the MIC
-  if(!verifyMIC(downlinkMsg, RADIOLIB_AES128_BLOCK_SIZE + downlinkMsgLen, this->sNwkSIntKey)) {
+  uint8_t* micKey = this->sNwkSIntKey;
+  if(isMulticast) {
+    micKey = this->mcGroups[mcGroup].nwkSKey;
+  }
+  if(!verifyMIC(downlinkMsg, RADIOLIB_AES128_BLOCK_SIZE + downlinkMsgLen, micKey)) {
+    this->stats.numDownlinksMicInvalid++;
     #if !RADIOLIB_STATIC_ONLY
       delete[] downlinkMsg;
     #endif
@@ -1623,7 +2480,9 @@ int16_t LoRaWANNode::parseDownlink(uint8_t* data, size_t* len, LoRaWANEvent_t* e
   }
   
   // save current fCnt to respective frame counter
-  if (isAppDownlink) {
+  if(isMulticast) {
+    this->mcGroups[mcGroup].fCnt = fCnt32;
+  } else if (isAppDownlink) {
     this->aFCntDown = fCnt32;
   } else {
     this->nFCntDown = fCnt32;
@@ -1642,7 +2501,9 @@ int16_t LoRaWANNode::parseDownlink(uint8_t* data, size_t* len, LoRaWANEvent_t* e
   }
 
   // a downlink was received, so reset the ADR counter to the last uplink's fCnt
-  this->adrFCnt = this->getFCntUp();
+  if(!isMulticast) {
+    this->adrFCnt = this->getFCntUp();
+  }
   
   // if this downlink is on FPort 0, the FOptsLen is the length of the payload
   // in any other case, the payload (length) is user accessible
@@ -1669,12 +2530,14 @@ int16_t LoRaWANNode::parseDownlink(uint8_t* data, size_t* len, LoRaWANEvent_t* e
 
   // figure out which key to use to decrypt the payload
   uint8_t* encKey = this->appSKey;
-    if((fPort == RADIOLIB_LORAWAN_FPORT_MAC_COMMAND) || (fPort == RADIOLIB_LORAWAN_FPORT_TS011)) {
+  if(isMulticast) {
+    encKey = this->mcGroups[mcGroup].appSKey;
+  } else if((fPort == RADIOLIB_LORAWAN_FPORT_MAC_COMMAND) || (fPort == RADIOLIB_LORAWAN_FPORT_TS011)) {
     encKey = this->nwkSEncKey;
   }
 
   // decrypt the frame payload
-  processAES(&downlinkMsg[RADIOLIB_LORAWAN_FRAME_PAYLOAD_POS(fOptsPbLen)], payLen, encKey, dest, fCnt32, RADIOLIB_LORAWAN_DOWNLINK, 0x00, true);
+  processAES(&downlinkMsg[RADIOLIB_LORAWAN_FRAME_PAYLOAD_POS(fOptsPbLen)], payLen, encKey, dest, addr, fCnt32, RADIOLIB_LORAWAN_DOWNLINK, 0x00, true);
   
   // decrypt any piggy-backed FOpts
   if(fOptsPbLen > 0) {
@@ -1682,13 +2545,41 @@ int16_t LoRaWANNode::parseDownlink(uint8_t* data, size_t* len, LoRaWANEvent_t* e
     if(this->rev == 1) {
       // in LoRaWAN v1.1, the piggy-backed FOpts are encrypted using the NwkSEncKey
       uint8_t ctrId = 0x01 + isAppDownlink; // see LoRaWAN v1.1 errata
-      processAES(&downlinkMsg[RADIOLIB_LORAWAN_FHDR_FOPTS_POS], (size_t)fOptsPbLen, this->nwkSEncKey, fOpts, fCnt32, RADIOLIB_LORAWAN_DOWNLINK, ctrId, true);
+      processAES(&downlinkMsg[RADIOLIB_LORAWAN_FHDR_FOPTS_POS], (size_t)fOptsPbLen, this->nwkSEncKey, fOpts, addr, fCnt32, RADIOLIB_LORAWAN_DOWNLINK, ctrId, true);
     } else {
       // in LoRaWAN v1.0.x, the piggy-backed FOpts are unencrypted
       memcpy(fOpts, &downlinkMsg[RADIOLIB_LORAWAN_FHDR_FOPTS_POS], (size_t)fOptsPbLen);
     }
   }
 
+  // application layer packages are handled internally and not passed to the user
+  if(((fPort == RADIOLIB_LORAWAN_FPORT_MULTICAST_SETUP) && this->mcEnabled) ||
+     ((fPort == RADIOLIB_LORAWAN_FPORT_FRAG_TRANSPORT) && this->fragEnabled)) {
+    this->processPackage(fPort, data, payLen, mcGroup);
+    *len = 0;
+  }
+
+  // multicast frames carry no MAC commands, so processing is done at this point
+  if(isMulticast) {
+    if(event) {
+      event->dir = RADIOLIB_LORAWAN_DOWNLINK;
+      event->confirmed = false;
+      event->confirming = false;
+      event->frmPending = (downlinkMsg[RADIOLIB_LORAWAN_FHDR_FCTRL_POS] & RADIOLIB_LORAWAN_FCTRL_FRAME_PENDING) != 0;
+      event->datarate = this->channels[RADIOLIB_LORAWAN_DOWNLINK].dr;
+      event->freq = this->channels[RADIOLIB_LORAWAN_DOWNLINK].freq / 10000.0;
+      event->power = this->txPowerMax - this->txPowerSteps * 2;
+      event->fCnt = fCnt32;
+      event->fPort = fPort;
+    }
+
+    #if !RADIOLIB_STATIC_ONLY
+      delete[] fOpts;
+      delete[] downlinkMsg;
+    #endif
+    return(RADIOLIB_ERR_NONE);
+  }
+
   // clear the previous MAC commands, if any
   memset(this->fOptsDown, 0, RADIOLIB_LORAWAN_FHDR_FOPTS_MAX_LEN);
 
@@ -1824,487 +2715,1881 @@ int16_t LoRaWANNode::parseDownlink(uint8_t* data, size_t* len, LoRaWANEvent_t* e
   return(RADIOLIB_ERR_NONE);
 }
 
-bool LoRaWANNode::execMacCommand(uint8_t cid, uint8_t* optIn, uint8_t lenIn) {
-  uint8_t buff[RADIOLIB_LORAWAN_MAX_MAC_COMMAND_LEN_DOWN];
-  return(this->execMacCommand(cid, optIn, lenIn, buff));
+int16_t LoRaWANNode::beginMulticast(const uint8_t* genAppKey) {
+  // LoRaWAN 1.0.x devices need a dedicated GenAppKey to derive the multicast keys
+  if((this->rev == 0) && !genAppKey) {
+    return(RADIOLIB_ERR_NULL_POINTER);
+  }
+  if(genAppKey) {
+    memcpy(this->genAppKey, genAppKey, RADIOLIB_AES128_KEY_SIZE);
+  }
+  this->mcEnabled = true;
+  return(RADIOLIB_ERR_NONE);
 }
 
-bool LoRaWANNode::execMacCommand(uint8_t cid, uint8_t* optIn, uint8_t lenIn, uint8_t* optOut) {
-  RADIOLIB_DEBUG_PROTOCOL_PRINTLN("[MAC] 0x%02x", cid);
-  RADIOLIB_DEBUG_PROTOCOL_HEXDUMP(optIn, lenIn);
-
-  if(cid >= RADIOLIB_LORAWAN_MAC_PROPRIETARY) {
-    // TODO call user-provided callback for proprietary MAC commands?
-    return(false);
+int16_t LoRaWANNode::setMulticastGroup(uint8_t id, uint32_t addr, const uint8_t* mcAppSKey, const uint8_t* mcNwkSKey, uint32_t fCntMin, uint32_t fCntMax) {
+  if(!mcAppSKey || !mcNwkSKey) {
+    return(RADIOLIB_ERR_NULL_POINTER);
+  }
+  if(id >= RADIOLIB_LORAWAN_NUM_MC_GROUPS) {
+    return(RADIOLIB_ERR_MULTICAST_GROUP_UNDEFINED);
   }
 
-  switch(cid) {
-    case(RADIOLIB_LORAWAN_MAC_RESET): {
-      // get the server version
-      uint8_t srvVersion = optIn[0];
-      RADIOLIB_DEBUG_PROTOCOL_PRINTLN("ResetConf: server version 1.%d", srvVersion);
-      if(srvVersion == this->rev) {
-        // valid server version, stop sending the ResetInd MAC command
-        LoRaWANNode::deleteMacCommand(RADIOLIB_LORAWAN_MAC_RESET, this->fOptsUp, &this->fOptsUpLen, RADIOLIB_LORAWAN_UPLINK);
-      }
-      return(false);
-    } break;
-
-    case(RADIOLIB_LORAWAN_MAC_LINK_CHECK): {
-      RADIOLIB_DEBUG_PROTOCOL_PRINTLN("LinkCheckAns: [user]");
-
-      return(false);
-    } break;
+  LoRaWANMulticastGroup_t* group = &this->mcGroups[id];
+  memset(group, 0, sizeof(LoRaWANMulticastGroup_t));
+  group->active = true;
+  group->addr = addr;
+  memcpy(group->appSKey, mcAppSKey, RADIOLIB_AES128_KEY_SIZE);
+  memcpy(group->nwkSKey, mcNwkSKey, RADIOLIB_AES128_KEY_SIZE);
+  group->fCntMin = fCntMin;
+  group->fCntMax = fCntMax;
+  group->fCnt = RADIOLIB_LORAWAN_FCNT_NONE;
+  return(RADIOLIB_ERR_NONE);
+}
 
-    case(RADIOLIB_LORAWAN_MAC_LINK_ADR): {
-      // get the ADR configuration
-      uint8_t macDrUp = (optIn[0] & 0xF0) >> 4;
-      uint8_t macTxSteps = optIn[0] & 0x0F;
-      
-      RADIOLIB_DEBUG_PROTOCOL_PRINTLN("LinkAdrReq: dataRate = %d, txSteps = %d, nbTrans = %d", macDrUp, macTxSteps, lenIn > 1 ? optIn[13] : 0);
-
-      uint8_t chMaskAck = 0;
-      uint8_t drAck = 0;
-      uint8_t pwrAck = 0;
-
-      // first, get current configuration
-      uint64_t chMaskGrp0123 = 0;
-      uint32_t chMaskGrp45 = 0;
-      this->getChannelPlanMask(&chMaskGrp0123, &chMaskGrp45);
-      uint16_t chMaskActive = 0;
-      (void)this->getAvailableChannels(&chMaskActive);
-      uint8_t currentDr = this->channels[RADIOLIB_LORAWAN_UPLINK].dr;
-
-      // only apply channel mask if present (internal Dr/Tx commands do not set channel mask)
-      if(lenIn > 1) {
-        uint64_t macChMaskGrp0123 = LoRaWANNode::ntoh<uint64_t>(&optIn[1]);
-        uint32_t macChMaskGrp45 = LoRaWANNode::ntoh<uint32_t>(&optIn[9]);
-        // apply requested channel mask and enable all of them for testing datarate
-        chMaskAck = this->applyChannelMask(macChMaskGrp0123, macChMaskGrp45);
-      } else {
-        chMaskAck = true;
-      }
-      
-      this->setAvailableChannels(0xFFFF);
+int16_t LoRaWANNode::clearMulticastGroup(uint8_t id) {
+  if((id >= RADIOLIB_LORAWAN_NUM_MC_GROUPS) || !this->mcGroups[id].active) {
+    return(RADIOLIB_ERR_MULTICAST_GROUP_UNDEFINED);
+  }
+  memset(&this->mcGroups[id], 0, sizeof(LoRaWANMulticastGroup_t));
+  return(RADIOLIB_ERR_NONE);
+}
 
-      int16_t state;
+int16_t LoRaWANNode::receiveMulticast(uint8_t id, uint8_t* dataDown, size_t* lenDown, RadioLibTime_t timeout, LoRaWANEvent_t* eventDown) {
+  if(!dataDown || !lenDown) {
+    return(RADIOLIB_ERR_NULL_POINTER);
+  }
+  *lenDown = 0;
+  if((id >= RADIOLIB_LORAWAN_NUM_MC_GROUPS) || !this->mcGroups[id].active) {
+    return(RADIOLIB_ERR_MULTICAST_GROUP_UNDEFINED);
+  }
+  Module* mod = this->phyLayer->getMod();
 
-      // try to apply the datarate configuration
-      // if value is set to 'keep current values', retrieve current value
-      if(macDrUp == 0x0F) {
-        macDrUp = currentDr;
-      }
+  // listen on the channel of the Class C session, or fall back to the Rx2 channel if there is none
+  LoRaWANChannel_t chnl = this->mcGroups[id].channel;
+  if(chnl.freq == 0) {
+    chnl = this->channels[RADIOLIB_LORAWAN_DIR_RX2];
+  }
 
-      if (this->band->dataRates[macDrUp] != RADIOLIB_LORAWAN_DATA_RATE_UNUSED) {
-        // check if the module supports this data rate
-        DataRate_t dr;
-        state = this->findDataRate(macDrUp, &dr);
+  this->phyLayer->standby();
+  int16_t state = this->setPhyProperties(&chnl, RADIOLIB_LORAWAN_DOWNLINK, this->txPowerMax - 2*this->txPowerSteps);
+  RADIOLIB_ASSERT(state);
 
-        // if datarate in hardware all good, set datarate for now
-        // and check if there are any available Tx channels for this datarate
-        if(state == RADIOLIB_ERR_NONE) {
-          this->channels[RADIOLIB_LORAWAN_UPLINK].dr = macDrUp;
+  // the downlink channel is reported in the event
+  LoRaWANChannel_t chnlPrev = this->channels[RADIOLIB_LORAWAN_DOWNLINK];
+  this->channels[RADIOLIB_LORAWAN_DOWNLINK] = chnl;
 
-          // only if we have available Tx channels, we set an Ack
-          if(this->getAvailableChannels(NULL) > 0) {
-            drAck = 1;
-          } else {
-            RADIOLIB_DEBUG_PROTOCOL_PRINTLN("ADR: no channels available for datarate %d", macDrUp);
-          }
+  // start continuous reception
+  downlinkAction = false;
+  this->phyLayer->setPacketReceivedAction(LoRaWANNodeOnDownlinkAction);
+  state = this->phyLayer->startReceive();
+  if(state != RADIOLIB_ERR_NONE) {
+    this->phyLayer->clearPacketReceivedAction();
+    this->channels[RADIOLIB_LORAWAN_DOWNLINK] = chnlPrev;
+    return(state);
+  }
+  RADIOLIB_DEBUG_PROTOCOL_PRINTLN("Listening for multicast group %d (%lu ms)", id, (unsigned long)timeout);
+
+  RadioLibTime_t tStart = mod->hal->millis();
+  while(!downlinkAction && (mod->hal->millis() - tStart < timeout)) {
+    mod->hal->yield();
+  }
+  this->phyLayer->clearPacketReceivedAction();
+  this->phyLayer->standby();
+
+  if(!downlinkAction) {
+    this->channels[RADIOLIB_LORAWAN_DOWNLINK] = chnlPrev;
+    return(RADIOLIB_ERR_RX_TIMEOUT);
+  }
+  this->tDownlink = mod->hal->millis();
+
+  // this may also be a Class C unicast downlink, which parseDownlink can handle as well
+  state = this->parseDownlink(dataDown, lenDown, eventDown);
+  this->channels[RADIOLIB_LORAWAN_DOWNLINK] = chnlPrev;
+  return(state);
+}
+
+uint8_t LoRaWANNode::findMulticastGroup(uint32_t addr) {
+  uint8_t id = 0;
+  for(; id < RADIOLIB_LORAWAN_NUM_MC_GROUPS; id++) {
+    if(this->mcGroups[id].active && (this->mcGroups[id].addr == addr)) {
+      break;
+    }
+  }
+  return(id);
+}
+
+void LoRaWANNode::processPackage(uint8_t fPort, const uint8_t* in, size_t len, uint8_t mcGroup) {
+  uint8_t ans[RADIOLIB_LORAWAN_PACKAGE_ANS_MAX_LEN];
+  uint8_t ansLen = 0;
+
+  // each frame may carry multiple package commands
+  size_t procLen = 0;
+  while(procLen < len) {
+    size_t cmdLen = 0;
+    if(fPort == RADIOLIB_LORAWAN_FPORT_MULTICAST_SETUP) {
+      // multicast setup is only accepted through unicast, otherwise group keys could be changed by other devices
+      if(mcGroup < RADIOLIB_LORAWAN_NUM_MC_GROUPS) {
+        return;
+      }
+      cmdLen = this->processMulticastSetup(&in[procLen], len - procLen, ans, &ansLen);
+    } else {
+      cmdLen = this->processFragTransport(&in[procLen], len - procLen, mcGroup, ans, &ansLen);
+    }
+
+    // unknown or malformed command, there is no way to find the next one
+    if(cmdLen == 0) {
+      RADIOLIB_DEBUG_PROTOCOL_PRINTLN("Unknown package command 0x%02x at FPort %d", in[procLen], fPort);
+      break;
+    }
+    procLen += cmdLen;
+  }
+
+  if(ansLen > 0) {
+    RADIOLIB_DEBUG_PROTOCOL_PRINTLN("Package answer at FPort %d (%d bytes):", fPort, ansLen);
+    RADIOLIB_DEBUG_PROTOCOL_HEXDUMP(ans, ansLen);
+    memcpy(this->packageAns, ans, ansLen);
+    this->packageAnsLen = ansLen;
+    this->packageAnsPort = fPort;
+  }
+}
+
+size_t LoRaWANNode::processMulticastSetup(const uint8_t* in, size_t len, uint8_t* ans, uint8_t* ansLen) {
+  uint8_t cid = in[0];
+  switch(cid) {
+    case(RADIOLIB_LORAWAN_MC_PACKAGE_VERSION_REQ): {
+      if(*ansLen + 3 <= RADIOLIB_LORAWAN_PACKAGE_ANS_MAX_LEN) {
+        ans[(*ansLen)++] = cid;
+        ans[(*ansLen)++] = RADIOLIB_LORAWAN_MC_PACKAGE_ID;
+        ans[(*ansLen)++] = RADIOLIB_LORAWAN_MC_PACKAGE_VERSION;
+      }
+      return(1);
+    } break;
+
+    case(RADIOLIB_LORAWAN_MC_GROUP_STATUS_REQ): {
+      if(len < 2) {
+        return(0);
+      }
+      uint8_t reqMask = in[1] & 0x0F;
+      uint8_t numTotal = 0;
+      uint8_t numAns = 0;
+      uint8_t ansMask = 0;
+      for(uint8_t id = 0; id < RADIOLIB_LORAWAN_NUM_MC_GROUPS; id++) {
+        if(this->mcGroups[id].active) {
+          numTotal++;
+          if(reqMask & (1 << id)) {
+            ansMask |= (1 << id);
+            numAns++;
+          }
+        }
+      }
+
+      // McGroupStatusAns: status byte, followed by ID and McAddr of each requested group
+      if(*ansLen + 2 + numAns*5 <= RADIOLIB_LORAWAN_PACKAGE_ANS_MAX_LEN) {
+        ans[(*ansLen)++] = cid;
+        ans[(*ansLen)++] = (numTotal << 4) | ansMask;
+        for(uint8_t id = 0; id < RADIOLIB_LORAWAN_NUM_MC_GROUPS; id++) {
+          if(ansMask & (1 << id)) {
+            ans[(*ansLen)++] = id;
+            LoRaWANNode::hton<uint32_t>(&ans[*ansLen], this->mcGroups[id].addr);
+            *ansLen += sizeof(uint32_t);
+          }
+        }
+      }
+      return(2);
+    } break;
+
+    case(RADIOLIB_LORAWAN_MC_GROUP_SETUP_REQ): {
+      // McGroupIDHeader (1), McAddr (4), McKey_encrypted (16), minMcFCount (4), maxMcFCount (4)
+      if(len < 30) {
+        return(0);
+      }
+      uint8_t id = in[1] & RADIOLIB_LORAWAN_MC_GROUP_ID_MASK;
+      uint32_t addr = LoRaWANNode::ntoh<uint32_t>(&in[2]);
+      uint32_t fCntMin = LoRaWANNode::ntoh<uint32_t>(&in[22]);
+      uint32_t fCntMax = LoRaWANNode::ntoh<uint32_t>(&in[26]);
+      RADIOLIB_DEBUG_PROTOCOL_PRINTLN("McGroupSetupReq: group %d, McAddr = 0x%08lX, FCnt %lu - %lu", id, 
+                                      (unsigned long)addr, (unsigned long)fCntMin, (unsigned long)fCntMax);
+
+      // derive McRootKey and McKEKey, which is then used to decrypt the McKey
+      uint8_t keyDerivationBuff[RADIOLIB_AES128_BLOCK_SIZE] = { 0 };
+      uint8_t mcRootKey[RADIOLIB_AES128_KEY_SIZE];
+      uint8_t mcKEKey[RADIOLIB_AES128_KEY_SIZE];
+      uint8_t mcKey[RADIOLIB_AES128_KEY_SIZE];
+      if(this->rev == 1) {
+        keyDerivationBuff[0] = 0x20;
+        RadioLibAES128Instance.init(this->appKey);
+      } else {
+        RadioLibAES128Instance.init(this->genAppKey);
+      }
+      RadioLibAES128Instance.encryptECB(keyDerivationBuff, RADIOLIB_AES128_BLOCK_SIZE, mcRootKey);
+      keyDerivationBuff[0] = 0x00;
+      RadioLibAES128Instance.init(mcRootKey);
+      RadioLibAES128Instance.encryptECB(keyDerivationBuff, RADIOLIB_AES128_BLOCK_SIZE, mcKEKey);
+      uint8_t mcKeyEnc[RADIOLIB_AES128_KEY_SIZE];
+      memcpy(mcKeyEnc, &in[6], RADIOLIB_AES128_KEY_SIZE);
+      RadioLibAES128Instance.init(mcKEKey);
+      RadioLibAES128Instance.encryptECB(mcKeyEnc, RADIOLIB_AES128_BLOCK_SIZE, mcKey);
+
+      // derive the multicast session keys
+      uint8_t mcAppSKey[RADIOLIB_AES128_KEY_SIZE];
+      uint8_t mcNwkSKey[RADIOLIB_AES128_KEY_SIZE];
+      RadioLibAES128Instance.init(mcKey);
+      keyDerivationBuff[0] = 0x01;
+      LoRaWANNode::hton<uint32_t>(&keyDerivationBuff[1], addr);
+      RadioLibAES128Instance.encryptECB(keyDerivationBuff, RADIOLIB_AES128_BLOCK_SIZE, mcAppSKey);
+      keyDerivationBuff[0] = 0x02;
+      RadioLibAES128Instance.encryptECB(keyDerivationBuff, RADIOLIB_AES128_BLOCK_SIZE, mcNwkSKey);
+
+      uint8_t status = id;
+      if(this->setMulticastGroup(id, addr, mcAppSKey, mcNwkSKey, fCntMin, fCntMax) != RADIOLIB_ERR_NONE) {
+        status |= RADIOLIB_LORAWAN_MC_GROUP_ID_ERROR;
+      }
+
+      if(*ansLen + 2 <= RADIOLIB_LORAWAN_PACKAGE_ANS_MAX_LEN) {
+        ans[(*ansLen)++] = cid;
+        ans[(*ansLen)++] = status;
+      }
+      return(30);
+    } break;
+
+    case(RADIOLIB_LORAWAN_MC_GROUP_DELETE_REQ): {
+      if(len < 2) {
+        return(0);
+      }
+      uint8_t id = in[1] & RADIOLIB_LORAWAN_MC_GROUP_ID_MASK;
+      RADIOLIB_DEBUG_PROTOCOL_PRINTLN("McGroupDeleteReq: group %d", id);
+      uint8_t status = id;
+      if(this->clearMulticastGroup(id) != RADIOLIB_ERR_NONE) {
+        status |= RADIOLIB_LORAWAN_MC_GROUP_UNDEFINED;
+      }
+
+      if(*ansLen + 2 <= RADIOLIB_LORAWAN_PACKAGE_ANS_MAX_LEN) {
+        ans[(*ansLen)++] = cid;
+        ans[(*ansLen)++] = status;
+      }
+      return(2);
+    } break;
+
+    case(RADIOLIB_LORAWAN_MC_CLASS_C_SESSION_REQ): {
+      // McGroupIDHeader (1), SessionTime (4), SessionTimeOut (1), DLFrequency (3), DR (1)
+      if(len < 11) {
+        return(0);
+      }
+      uint8_t id = in[1] & RADIOLIB_LORAWAN_MC_GROUP_ID_MASK;
+      uint32_t sessionTime = LoRaWANNode::ntoh<uint32_t>(&in[2]);
+      uint8_t sessionTimeout = in[6] & 0x0F;
+      uint32_t freq = LoRaWANNode::ntoh<uint32_t>(&in[7], 3);
+      uint8_t dr = in[10] & 0x0F;
+      RADIOLIB_DEBUG_PROTOCOL_PRINTLN("McClassCSessionReq: group %d, time = %lu, timeout = %d, freq = %7.3f, DR%d", id, 
+                                      (unsigned long)sessionTime, sessionTimeout, freq / 10000.0, dr);
+
+      uint8_t status = id;
+      if(!this->mcGroups[id].active) {
+        status |= RADIOLIB_LORAWAN_MC_SESSION_GROUP_UNDEFINED;
+      }
+      if((freq < this->band->freqMin) || (freq > this->band->freqMax)) {
+        status |= RADIOLIB_LORAWAN_MC_SESSION_FREQ_ERROR;
+      }
+      if((dr >= RADIOLIB_LORAWAN_CHANNEL_NUM_DATARATES) || (this->band->dataRates[dr] == RADIOLIB_LORAWAN_DATA_RATE_UNUSED)) {
+        status |= RADIOLIB_LORAWAN_MC_SESSION_DR_ERROR;
+      }
+
+      if(status == id) {
+        LoRaWANMulticastGroup_t* group = &this->mcGroups[id];
+        group->channel.enabled = true;
+        group->channel.idx = RADIOLIB_LORAWAN_CHANNEL_INDEX_NONE;
+        group->channel.freq = freq;
+        group->channel.drMin = dr;
+        group->channel.drMax = dr;
+        group->channel.dr = dr;
+        group->channel.available = true;
+        group->sessionTime = sessionTime;
+        group->sessionTimeout = sessionTimeout;
+      }
+
+      // the session is started by the application through receiveMulticast(), 
+      // so the time to start is always reported as zero
+      if(*ansLen + 5 <= RADIOLIB_LORAWAN_PACKAGE_ANS_MAX_LEN) {
+        ans[(*ansLen)++] = cid;
+        ans[(*ansLen)++] = status;
+        if(status == id) {
+          LoRaWANNode::hton<uint32_t>(&ans[*ansLen], 0, 3);
+          *ansLen += 3;
+        }
+      }
+      return(11);
+    } break;
+
+    case(RADIOLIB_LORAWAN_MC_CLASS_B_SESSION_REQ): {
+      // Class B is not supported, skip the request without answering
+      if(len < 11) {
+        return(0);
+      }
+      return(11);
+    } break;
+  }
+
+  return(0);
+}
+
+size_t LoRaWANNode::processFragTransport(const uint8_t* in, size_t len, uint8_t mcGroup, uint8_t* ans, uint8_t* ansLen) {
+  LoRaWANFragSession_t* session = &this->fragSession;
+  uint8_t cid = in[0];
+  switch(cid) {
+    case(RADIOLIB_LORAWAN_FRAG_PACKAGE_VERSION_REQ): {
+      if(*ansLen + 3 <= RADIOLIB_LORAWAN_PACKAGE_ANS_MAX_LEN) {
+        ans[(*ansLen)++] = cid;
+        ans[(*ansLen)++] = RADIOLIB_LORAWAN_FRAG_PACKAGE_ID;
+        ans[(*ansLen)++] = RADIOLIB_LORAWAN_FRAG_PACKAGE_VERSION;
+      }
+      return(1);
+    } break;
+
+    case(RADIOLIB_LORAWAN_FRAG_SESSION_STATUS_REQ): {
+      if(len < 2) {
+        return(0);
+      }
+      uint8_t index = (in[1] >> 1) & RADIOLIB_LORAWAN_FRAG_INDEX_MASK;
+      bool allParticipants = in[1] & 0x01;
+      if(!session->active || (session->index != index)) {
+        return(2);
+      }
+
+      // number of fragments that are still needed to reconstruct the data block
+      uint16_t missing = 0;
+      if(!session->complete) {
+        if(session->decoding) {
+          missing = session->nbMissing - session->nbRows;
         } else {
-          RADIOLIB_DEBUG_PROTOCOL_PRINTLN("ADR: hardware failure configurating datarate %d, code %d", macDrUp, state);
+          for(uint16_t i = 0; i < session->nbFrag; i++) {
+            missing += !TEST_BIT_IN_ARRAY_LSB(this->fragReceived, i);
+          }
         }
-      
       }
 
-      // try to apply the power configuration
-      // if value is set to 'keep current values', retrieve current value
-      if(macTxSteps == 0x0F) {
-        macTxSteps = this->txPowerSteps;
-      }
+      // if not all participants are requested to answer, only those with missing fragments do
+      if(!allParticipants && (missing == 0)) {
+        return(2);
+      }
+
+      if(*ansLen + 5 <= RADIOLIB_LORAWAN_PACKAGE_ANS_MAX_LEN) {
+        ans[(*ansLen)++] = cid;
+        uint16_t receivedAndIndex = ((uint16_t)index << 14) | (session->nbReceived & RADIOLIB_LORAWAN_FRAG_NUMBER_MASK);
+        LoRaWANNode::hton<uint16_t>(&ans[*ansLen], receivedAndIndex);
+        *ansLen += sizeof(uint16_t);
+        ans[(*ansLen)++] = RADIOLIB_MIN(missing, 255);
+        ans[(*ansLen)++] = session->matrixFull ? RADIOLIB_LORAWAN_FRAG_STATUS_MATRIX_MEMORY : 0;
+      }
+      return(2);
+    } break;
+
+    case(RADIOLIB_LORAWAN_FRAG_SESSION_SETUP_REQ): {
+      // FragSession (1), NbFrag (2), FragSize (1), Control (1), Padding (1), Descriptor (4)
+      if(len < 11) {
+        return(0);
+      }
+      uint8_t index = (in[1] >> 4) & RADIOLIB_LORAWAN_FRAG_INDEX_MASK;
+      uint8_t mcGroupMask = in[1] & 0x0F;
+      uint16_t nbFrag = LoRaWANNode::ntoh<uint16_t>(&in[2]);
+      uint8_t fragSize = in[4];
+      uint8_t fragAlgo = (in[5] >> 3) & 0x07;
+      uint8_t padding = in[6];
+      uint32_t descriptor = LoRaWANNode::ntoh<uint32_t>(&in[7]);
+      RADIOLIB_DEBUG_PROTOCOL_PRINTLN("FragSessionSetupReq: index %d, %d fragments of %d bytes, algo %d, padding %d", 
+                                      index, nbFrag, fragSize, fragAlgo, padding);
+
+      uint8_t status = index << 6;
+
+      // only one session at a time is supported
+      if(session->active && (session->index != index)) {
+        status |= RADIOLIB_LORAWAN_FRAG_SETUP_INDEX_UNSUPPORTED;
+      }
+
+      // only the parity check matrix from TS004 is supported
+      if(fragAlgo != 0) {
+        status |= RADIOLIB_LORAWAN_FRAG_SETUP_ENCODING_UNSUPPORTED;
+      }
+
+      // check the data block fits into storage
+      if((nbFrag == 0) || (fragSize == 0) || ((size_t)nbFrag * fragSize > this->fragBuffSize)) {
+        status |= RADIOLIB_LORAWAN_FRAG_SETUP_NOT_ENOUGH_MEMORY;
+      }
+      #if RADIOLIB_STATIC_ONLY
+      if(nbFrag > RADIOLIB_LORAWAN_FRAG_MAX_NB_FRAG) {
+        status |= RADIOLIB_LORAWAN_FRAG_SETUP_NOT_ENOUGH_MEMORY;
+      }
+      #endif
+
+      if((status & 0x0F) == 0) {
+        this->clearFragSession();
+        session->active = true;
+        session->index = index;
+        session->mcGroupMask = mcGroupMask;
+        session->nbFrag = nbFrag;
+        session->fragSize = fragSize;
+        session->padding = padding;
+        session->descriptor = descriptor;
+
+        uint16_t matrixRows = RADIOLIB_MIN(nbFrag, RADIOLIB_LORAWAN_FRAG_MAX_MISSING);
+        #if !RADIOLIB_STATIC_ONLY
+        this->fragReceived = new uint8_t[(nbFrag + 7) / 8];
+        this->fragMatrix = new uint8_t[((size_t)matrixRows * matrixRows + 7) / 8];
+        #endif
+        memset(this->fragReceived, 0, (nbFrag + 7) / 8);
+        memset(this->fragMatrix, 0, ((size_t)matrixRows * matrixRows + 7) / 8);
+      }
+
+      if(*ansLen + 2 <= RADIOLIB_LORAWAN_PACKAGE_ANS_MAX_LEN) {
+        ans[(*ansLen)++] = cid;
+        ans[(*ansLen)++] = status;
+      }
+      return(11);
+    } break;
+
+    case(RADIOLIB_LORAWAN_FRAG_SESSION_DELETE_REQ): {
+      if(len < 2) {
+        return(0);
+      }
+      uint8_t index = in[1] & RADIOLIB_LORAWAN_FRAG_INDEX_MASK;
+      uint8_t status = index;
+      if(session->active && (session->index == index)) {
+        this->clearFragSession();
+      } else {
+        status |= RADIOLIB_LORAWAN_FRAG_DELETE_NO_SESSION;
+      }
+
+      if(*ansLen + 2 <= RADIOLIB_LORAWAN_PACKAGE_ANS_MAX_LEN) {
+        ans[(*ansLen)++] = cid;
+        ans[(*ansLen)++] = status;
+      }
+      return(2);
+    } break;
+
+    case(RADIOLIB_LORAWAN_FRAG_DATA_FRAGMENT): {
+      // IndexAndN (2), followed by the fragment itself
+      // the fragment size is known from the session setup, so the fragment always extends to the end of the frame
+      if(len < 3) {
+        return(0);
+      }
+      uint16_t indexAndN = LoRaWANNode::ntoh<uint16_t>(&in[1]);
+      uint8_t index = indexAndN >> 14;
+      uint16_t n = indexAndN & RADIOLIB_LORAWAN_FRAG_NUMBER_MASK;
+      if(!session->active || (session->index != index) || (len - 3 != session->fragSize)) {
+        return(len);
+      }
+
+      // multicast fragments are only accepted from the groups assigned to this session
+      if((mcGroup < RADIOLIB_LORAWAN_NUM_MC_GROUPS) && !(session->mcGroupMask & (1 << mcGroup))) {
+        return(len);
+      }
+
+      if(!session->complete && (n > 0)) {
+        this->processFragment(n, &in[3]);
+      }
+      return(len);
+    } break;
+  }
+
+  return(0);
+}
+
+int16_t LoRaWANNode::beginFragmentation(uint8_t* buff, size_t size) {
+  if(!buff) {
+    return(RADIOLIB_ERR_NULL_POINTER);
+  }
+  this->clearFragSession();
+  this->fragBuff = buff;
+  this->fragReadCb = NULL;
+  this->fragWriteCb = NULL;
+  this->fragBuffSize = size;
+  this->fragEnabled = true;
+  return(RADIOLIB_ERR_NONE);
+}
+
+int16_t LoRaWANNode::beginFragmentation(LoRaWANStorageReadCb_t readCb, LoRaWANStorageWriteCb_t writeCb, size_t size) {
+  if(!readCb || !writeCb) {
+    return(RADIOLIB_ERR_NULL_POINTER);
+  }
+  this->clearFragSession();
+  this->fragBuff = NULL;
+  this->fragReadCb = readCb;
+  this->fragWriteCb = writeCb;
+  this->fragBuffSize = size;
+  this->fragEnabled = true;
+  return(RADIOLIB_ERR_NONE);
+}
+
+bool LoRaWANNode::isFragmentationComplete(size_t* len, uint32_t* descriptor) {
+  if(!this->fragSession.active || !this->fragSession.complete) {
+    return(false);
+  }
+  if(len) {
+    *len = (size_t)this->fragSession.nbFrag * this->fragSession.fragSize - this->fragSession.padding;
+  }
+  if(descriptor) {
+    *descriptor = this->fragSession.descriptor;
+  }
+  return(true);
+}
+
+bool LoRaWANNode::isPackageAnswerPending() {
+  return(this->packageAnsLen > 0);
+}
+
+int16_t LoRaWANNode::sendPackageAnswer(LoRaWANEvent_t* eventUp, LoRaWANEvent_t* eventDown) {
+  if(this->packageAnsLen == 0) {
+    return(RADIOLIB_ERR_NONE);
+  }
+
+  // copy the answer, as the buffer may be overwritten by requests in the downlink
+  uint8_t ans[RADIOLIB_LORAWAN_PACKAGE_ANS_MAX_LEN];
+  uint8_t ansLen = this->packageAnsLen;
+  uint8_t fPort = this->packageAnsPort;
+  memcpy(ans, this->packageAns, ansLen);
+  this->packageAnsLen = 0;
+
+  size_t lenDown = 0;
+  uint8_t dataDown[RADIOLIB_LORAWAN_MAX_DOWNLINK_SIZE];
+  int16_t state = this->sendReceive(ans, ansLen, fPort, dataDown, &lenDown, false, eventUp, eventDown);
+
+  // if the uplink could not be sent, keep the answer for the next attempt
+  if((state < RADIOLIB_ERR_NONE) && (this->packageAnsLen == 0)) {
+    memcpy(this->packageAns, ans, ansLen);
+    this->packageAnsLen = ansLen;
+    this->packageAnsPort = fPort;
+  }
+  return(state);
+}
+
+int16_t LoRaWANNode::beginAggregation(uint8_t* buff, size_t size, RadioLibTime_t maxAge) {
+  if(!buff) {
+    return(RADIOLIB_ERR_NULL_POINTER);
+  }
+
+  // each FPort needs space for at least one record with a single byte of value
+  size_t len = RADIOLIB_MIN(size / RADIOLIB_LORAWAN_AGGR_NUM_PORTS, (size_t)0xFF);
+  if(len < RADIOLIB_LORAWAN_AGGR_RECORD_HDR_LEN + 1) {
+    return(RADIOLIB_ERR_STORAGE_TOO_SMALL);
+  }
+
+  this->aggrBuff = buff;
+  this->aggrBuffLen = len;
+  memset(this->aggrPorts, 0, sizeof(this->aggrPorts));
+  this->aggrMaxAge = maxAge;
+  this->aggrEnabled = true;
+  return(RADIOLIB_ERR_NONE);
+}
+
+int16_t LoRaWANNode::aggregate(uint8_t fPort, uint8_t type, const uint8_t* data, uint8_t len, bool priority, 
+                               LoRaWANEvent_t* eventUp, LoRaWANEvent_t* eventDown) {
+  // build a temporary buffer
+  // LoRaWAN downlinks can have 250 bytes at most with 1 extra byte for NULL
+  size_t lenDown = 0;
+  uint8_t dataDown[251];
+
+  return(this->aggregate(fPort, type, data, len, dataDown, &lenDown, priority, eventUp, eventDown));
+}
+
+int16_t LoRaWANNode::aggregate(uint8_t fPort, uint8_t type, const uint8_t* data, uint8_t len, uint8_t* dataDown, size_t* lenDown, 
+                               bool priority, LoRaWANEvent_t* eventUp, LoRaWANEvent_t* eventDown) {
+  if(!this->aggrEnabled) {
+    return(RADIOLIB_ERR_INVALID_MODE);
+  }
+  if((!data && (len > 0)) || !dataDown || !lenDown) {
+    return(RADIOLIB_ERR_NULL_POINTER);
+  }
+  if((fPort < RADIOLIB_LORAWAN_FPORT_PAYLOAD_MIN) || (fPort > RADIOLIB_LORAWAN_FPORT_PAYLOAD_MAX)) {
+    return(RADIOLIB_ERR_INVALID_PORT);
+  }
+  *lenDown = 0;
+
+  // a single record must fit into an uplink at the current datarate
+  uint8_t maxLen = RADIOLIB_MIN(this->getMaxPayloadLen(), this->aggrBuffLen);
+  size_t recLen = RADIOLIB_LORAWAN_AGGR_RECORD_HDR_LEN + len;
+  if(recLen > maxLen) {
+    return(RADIOLIB_ERR_PACKET_TOO_LONG);
+  }
+
+  // find the buffer of this FPort, or take a free one
+  uint8_t idx = 0;
+  for(; idx < RADIOLIB_LORAWAN_AGGR_NUM_PORTS; idx++) {
+    if(this->aggrPorts[idx].fPort == fPort) {
+      break;
+    }
+  }
+  if(idx == RADIOLIB_LORAWAN_AGGR_NUM_PORTS) {
+    for(idx = 0; idx < RADIOLIB_LORAWAN_AGGR_NUM_PORTS; idx++) {
+      if(this->aggrPorts[idx].len == 0) {
+        break;
+      }
+    }
+  }
+  if(idx == RADIOLIB_LORAWAN_AGGR_NUM_PORTS) {
+    return(RADIOLIB_ERR_AGGREGATION_BUFFER_FULL);
+  }
+  LoRaWANAggregate_t* aggr = &this->aggrPorts[idx];
+
+  // send the buffered records first if this one would not fit
+  int16_t state = RADIOLIB_ERR_NONE;
+  if(aggr->len + recLen > maxLen) {
+    state = this->flushAggregate(idx, dataDown, lenDown, eventUp, eventDown);
+    RADIOLIB_ASSERT(state);
+    if(aggr->len + recLen > maxLen) {
+      return(RADIOLIB_ERR_AGGREGATION_BUFFER_FULL);
+    }
+  }
+
+  aggr->fPort = fPort;
+  uint8_t* buff = &this->aggrBuff[idx * this->aggrBuffLen];
+  if(aggr->len == 0) {
+    aggr->tFirst = this->phyLayer->getMod()->hal->millis();
+  }
+  buff[aggr->len] = type;
+  buff[aggr->len + 1] = len;
+  if(len > 0) {
+    memcpy(&buff[aggr->len + RADIOLIB_LORAWAN_AGGR_RECORD_HDR_LEN], data, len);
+  }
+  aggr->len += recLen;
+
+  // a downlink received while making room must not be overwritten, the record is sent by the next flush
+  if(state > RADIOLIB_ERR_NONE) {
+    return(state);
+  }
+
+  // send right away if requested, or if there is no space left for another record
+  if(priority || (aggr->len + RADIOLIB_LORAWAN_AGGR_RECORD_HDR_LEN >= maxLen)) {
+    state = this->flushAggregate(idx, dataDown, lenDown, eventUp, eventDown);
+  }
+  return(state);
+}
+
+int16_t LoRaWANNode::flushAggregated(bool force, LoRaWANEvent_t* eventUp, LoRaWANEvent_t* eventDown) {
+  // build a temporary buffer
+  // LoRaWAN downlinks can have 250 bytes at most with 1 extra byte for NULL
+  size_t lenDown = 0;
+  uint8_t dataDown[251];
+
+  return(this->flushAggregated(dataDown, &lenDown, force, eventUp, eventDown));
+}
+
+int16_t LoRaWANNode::flushAggregated(uint8_t* dataDown, size_t* lenDown, bool force, LoRaWANEvent_t* eventUp, LoRaWANEvent_t* eventDown) {
+  if(!this->aggrEnabled) {
+    return(RADIOLIB_ERR_INVALID_MODE);
+  }
+  if(!dataDown || !lenDown) {
+    return(RADIOLIB_ERR_NULL_POINTER);
+  }
+  *lenDown = 0;
+
+  int16_t state = RADIOLIB_ERR_NONE;
+  RadioLibTime_t now = this->phyLayer->getMod()->hal->millis();
+  for(uint8_t idx = 0; idx < RADIOLIB_LORAWAN_AGGR_NUM_PORTS; idx++) {
+    LoRaWANAggregate_t* aggr = &this->aggrPorts[idx];
+    if(aggr->len == 0) {
+      continue;
+    }
+    if(force || ((this->aggrMaxAge > 0) && (now - aggr->tFirst >= this->aggrMaxAge))) {
+      state = this->flushAggregate(idx, dataDown, lenDown, eventUp, eventDown);
+      RADIOLIB_ASSERT(state);
+
+      // stop at the first downlink, the remaining buffers are sent by the next call
+      if(state > RADIOLIB_ERR_NONE) {
+        break;
+      }
+    }
+  }
+  return(state);
+}
+
+int16_t LoRaWANNode::flushAggregate(uint8_t idx, uint8_t* dataDown, size_t* lenDown, LoRaWANEvent_t* eventUp, LoRaWANEvent_t* eventDown) {
+  LoRaWANAggregate_t* aggr = &this->aggrPorts[idx];
+  uint8_t* buff = &this->aggrBuff[idx * this->aggrBuffLen];
+
+  // the datarate may have dropped since the records were buffered, so only send as many whole records as fit
+  uint8_t maxLen = this->getMaxPayloadLen();
+  uint8_t len = 0;
+  while((len < aggr->len) && (len + RADIOLIB_LORAWAN_AGGR_RECORD_HDR_LEN + buff[len + 1] <= maxLen)) {
+    len += RADIOLIB_LORAWAN_AGGR_RECORD_HDR_LEN + buff[len + 1];
+  }
+  if(len == 0) {
+    return(RADIOLIB_ERR_PACKET_TOO_LONG);
+  }
+  RADIOLIB_DEBUG_PROTOCOL_PRINTLN("Sending %d of %d aggregated bytes on FPort %d", len, aggr->len, aggr->fPort);
+
+  int16_t state = this->sendReceive(buff, len, aggr->fPort, dataDown, lenDown, false, eventUp, eventDown);
+  if(state < RADIOLIB_ERR_NONE) {
+    // keep the records for the next attempt
+    return(state);
+  }
+
+  // remaining records keep the timestamp, so that they are sent on the next flush
+  memmove(buff, &buff[len], aggr->len - len);
+  aggr->len -= len;
+  if(aggr->len == 0) {
+    aggr->fPort = 0;
+  }
+  return(state);
+}
+
+bool LoRaWANNode::getAggregatedRecord(const uint8_t* in, size_t len, size_t* pos, uint8_t* type, const uint8_t** value, uint8_t* valueLen) {
+  if(!in || !pos || (*pos + RADIOLIB_LORAWAN_AGGR_RECORD_HDR_LEN > len)) {
+    return(false);
+  }
+  uint8_t recLen = in[*pos + 1];
+  if(*pos + RADIOLIB_LORAWAN_AGGR_RECORD_HDR_LEN + recLen > len) {
+    return(false);
+  }
+
+  if(type) {
+    *type = in[*pos];
+  }
+  if(value) {
+    *value = &in[*pos + RADIOLIB_LORAWAN_AGGR_RECORD_HDR_LEN];
+  }
+  if(valueLen) {
+    *valueLen = recLen;
+  }
+  *pos += RADIOLIB_LORAWAN_AGGR_RECORD_HDR_LEN + recLen;
+  return(true);
+}
+
+int16_t LoRaWANNode::beginRelay(RadioLibTime_t rxrDelay) {
+  if(!this->isActivated()) {
+    return(RADIOLIB_ERR_NETWORK_NOT_JOINED);
+  }
+  if(!this->band->txWoR[0].enabled) {
+    RADIOLIB_DEBUG_PROTOCOL_PRINTLN("There are no WOR channels in this band");
+    return(RADIOLIB_ERR_INVALID_MODE);
+  }
+
+  // even the shortest forwarded uplink and the downlink for it must fit before the RxR window
+  RadioLibTime_t turnaround = 0;
+  int16_t state = this->getRelayTurnaround(RADIOLIB_LORAWAN_RELAY_PHY_PAYLOAD_MIN_LEN, &turnaround);
+  RADIOLIB_ASSERT(state);
+  if(rxrDelay <= turnaround) {
+    RADIOLIB_DEBUG_PROTOCOL_PRINTLN("RxR delay must be longer than %lu ms", (unsigned long)turnaround);
+    return(RADIOLIB_ERR_INVALID_RX_PERIOD);
+  }
+  this->relayRxrDelay = rxrDelay;
+
+  // forwarded uplinks and relayed downlinks are carried on FPort 226
+  this->TS011 = true;
+  this->relayEnabled = true;
+  return(RADIOLIB_ERR_NONE);
+}
+
+int16_t LoRaWANNode::addRelayDevice(uint32_t devAddr, const uint8_t* rootWorSKey) {
+  if(!rootWorSKey) {
+    return(RADIOLIB_ERR_NULL_POINTER);
+  }
+
+  // update the existing entry, or take the first free one
+  uint8_t idx = this->findRelayDevice(devAddr);
+  if(idx == RADIOLIB_LORAWAN_RELAY_MAX_DEVICES) {
+    for(idx = 0; idx < RADIOLIB_LORAWAN_RELAY_MAX_DEVICES; idx++) {
+      if(!this->relayDevices[idx].active) {
+        break;
+      }
+    }
+  }
+  if(idx == RADIOLIB_LORAWAN_RELAY_MAX_DEVICES) {
+    return(RADIOLIB_ERR_RELAY_DEVICE_UNAVAILABLE);
+  }
+
+  LoRaWANRelayDevice_t* dev = &this->relayDevices[idx];
+  memset(dev, 0, sizeof(LoRaWANRelayDevice_t));
+  dev->active = true;
+  dev->devAddr = devAddr;
+  LoRaWANNode::deriveWorKeys(rootWorSKey, devAddr, dev->worSIntKey, dev->worSEncKey);
+  return(RADIOLIB_ERR_NONE);
+}
+
+int16_t LoRaWANNode::removeRelayDevice(uint32_t devAddr) {
+  uint8_t idx = this->findRelayDevice(devAddr);
+  if(idx == RADIOLIB_LORAWAN_RELAY_MAX_DEVICES) {
+    return(RADIOLIB_ERR_RELAY_DEVICE_UNAVAILABLE);
+  }
+  memset(&this->relayDevices[idx], 0, sizeof(LoRaWANRelayDevice_t));
+  return(RADIOLIB_ERR_NONE);
+}
+
+int16_t LoRaWANNode::relayListen(LoRaWANEvent_t* eventUp, LoRaWANEvent_t* eventDown) {
+  if(!this->relayEnabled) {
+    return(RADIOLIB_ERR_INVALID_MODE);
+  }
+  Module* mod = this->phyLayer->getMod();
+  int8_t pwr = this->txPowerMax - 2*this->txPowerSteps;
+  int16_t state = RADIOLIB_ERR_UNKNOWN;
+
+  // wake-on-radio: run channel activity detection on each WOR channel
+  uint8_t worChannel = 0;
+  for(; worChannel < 2; worChannel++) {
+    if(!this->band->txWoR[worChannel].enabled) {
+      continue;
+    }
+    state = this->setPhyProperties(&this->band->txWoR[worChannel], RADIOLIB_LORAWAN_UPLINK, pwr);
+    RADIOLIB_ASSERT(state);
+    state = this->phyLayer->scanChannel();
+    if(state == RADIOLIB_PREAMBLE_DETECTED) {
+      break;
+    }
+    if(state != RADIOLIB_CHANNEL_FREE) {
+      return(state);
+    }
+  }
+  if(worChannel == 2) {
+    return(0);
+  }
+
+  // receive the WOR frame: MHDR | DevAddr | WFCnt | ULFreq | ULDR | MIC, after space for the MIC block
+  uint8_t wor[RADIOLIB_AES128_BLOCK_SIZE + RADIOLIB_LORAWAN_RELAY_WOR_LEN];
+  uint8_t* worFrame = &wor[RADIOLIB_AES128_BLOCK_SIZE];
+  state = this->phyLayer->receive(worFrame, RADIOLIB_LORAWAN_RELAY_WOR_LEN);
+  if((state == RADIOLIB_ERR_RX_TIMEOUT) || (state == RADIOLIB_ERR_CRC_MISMATCH)) {
+    return(0);
+  }
+  RADIOLIB_ASSERT(state);
+  RadioLibTime_t tWor = mod->hal->millis();
+  if((this->phyLayer->getPacketLength() != RADIOLIB_LORAWAN_RELAY_WOR_LEN) || (worFrame[0] != RADIOLIB_LORAWAN_RELAY_WOR_UPLINK)) {
+    return(0);
+  }
+
+  // only trusted end devices may use the relay, and each WOR frame is accepted only once
+  uint32_t devAddr = LoRaWANNode::ntoh<uint32_t>(&worFrame[RADIOLIB_LORAWAN_RELAY_WOR_DEV_ADDR_POS]);
+  uint32_t wfCnt = LoRaWANNode::ntoh<uint32_t>(&worFrame[RADIOLIB_LORAWAN_RELAY_WOR_WFCNT_POS]);
+  uint8_t idx = this->findRelayDevice(devAddr);
+  if(idx == RADIOLIB_LORAWAN_RELAY_MAX_DEVICES) {
+    RADIOLIB_DEBUG_PROTOCOL_PRINTLN("WOR from untrusted device %08lX", (unsigned long)devAddr);
+    return(0);
+  }
+  LoRaWANRelayDevice_t* dev = &this->relayDevices[idx];
+  LoRaWANNode::setWorMicBlock(wor, sizeof(wor), devAddr, wfCnt, RADIOLIB_LORAWAN_UPLINK);
+  if(!this->verifyMIC(wor, sizeof(wor), dev->worSIntKey)) {
+    RADIOLIB_DEBUG_PROTOCOL_PRINTLN("WOR MIC mismatch for device %08lX", (unsigned long)devAddr);
+    return(0);
+  }
+  if(wfCnt < dev->wfCntNext) {
+    RADIOLIB_DEBUG_PROTOCOL_PRINTLN("WOR replay from device %08lX (WFCnt = %lu)", (unsigned long)devAddr, (unsigned long)wfCnt);
+    return(0);
+  }
+  dev->wfCntNext = wfCnt + 1;
+
+  // the WOR frame announces the channel of the actual uplink
+  uint8_t ulChannel[RADIOLIB_LORAWAN_RELAY_WOR_PAYLOAD_LEN];
+  this->processAES(&worFrame[RADIOLIB_LORAWAN_RELAY_WOR_PAYLOAD_POS], RADIOLIB_LORAWAN_RELAY_WOR_PAYLOAD_LEN, dev->worSEncKey, 
+                   ulChannel, devAddr, wfCnt, RADIOLIB_LORAWAN_UPLINK, 0x00, true);
+  LoRaWANChannel_t chnlUp = RADIOLIB_LORAWAN_CHANNEL_NONE;
+  chnlUp.enabled = true;
+  chnlUp.freq = LoRaWANNode::ntoh<uint32_t>(&ulChannel[0], 3);
+  chnlUp.dr = ulChannel[3] & 0x0F;
+  if((chnlUp.freq < this->band->freqMin) || (chnlUp.freq > this->band->freqMax) || 
+     (chnlUp.dr >= RADIOLIB_LORAWAN_CHANNEL_NUM_DATARATES) ||
+     (this->band->dataRates[chnlUp.dr] == RADIOLIB_LORAWAN_DATA_RATE_UNUSED)) {
+    RADIOLIB_DEBUG_PROTOCOL_PRINTLN("WOR with invalid uplink channel: freq = %7.3f, DR%d", chnlUp.freq / 10000.0, chnlUp.dr);
+    return(0);
+  }
+
+  // acknowledge the WOR frame on the corresponding ACK channel, authenticated with the same WOR frame counter
+  uint8_t ack[RADIOLIB_AES128_BLOCK_SIZE + RADIOLIB_LORAWAN_RELAY_WOR_ACK_LEN];
+  uint8_t* ackFrame = &ack[RADIOLIB_AES128_BLOCK_SIZE];
+  ackFrame[0] = RADIOLIB_LORAWAN_RELAY_WOR_ACK;
+  LoRaWANNode::hton<uint32_t>(&ackFrame[RADIOLIB_LORAWAN_RELAY_WOR_DEV_ADDR_POS], devAddr);
+  LoRaWANNode::setWorMicBlock(ack, sizeof(ack), devAddr, wfCnt, RADIOLIB_LORAWAN_DOWNLINK);
+  uint32_t mic = this->generateMIC(ack, sizeof(ack) - sizeof(uint32_t), dev->worSIntKey);
+  LoRaWANNode::hton<uint32_t>(&ack[sizeof(ack) - sizeof(uint32_t)], mic);
+  state = this->setPhyProperties(&this->band->txAck[worChannel], RADIOLIB_LORAWAN_DOWNLINK, pwr);
+  RADIOLIB_ASSERT(state);
+  RadioLibTime_t tElapsed = mod->hal->millis() - tWor;
+  if(tElapsed < RADIOLIB_LORAWAN_RELAY_WOR_ACK_DELAY) {
+    mod->hal->delay(RADIOLIB_LORAWAN_RELAY_WOR_ACK_DELAY - tElapsed);
+  }
+  state = this->phyLayer->transmit(ackFrame, RADIOLIB_LORAWAN_RELAY_WOR_ACK_LEN);
+  RADIOLIB_ASSERT(state);
+  this->addAirtime(this->band->txAck[worChannel].freq, this->phyLayer->getTimeOnAir(RADIOLIB_LORAWAN_RELAY_WOR_ACK_LEN) / 1000);
+
+  // receive the uplink of the end device, leaving space for the forwarding metadata
+  uint8_t msg[RADIOLIB_LORAWAN_RELAY_METADATA_LEN + RADIOLIB_LORAWAN_RELAY_PHY_PAYLOAD_MAX_LEN];
+  uint8_t* phyPayload = &msg[RADIOLIB_LORAWAN_RELAY_METADATA_LEN];
+  state = this->setPhyProperties(&chnlUp, RADIOLIB_LORAWAN_UPLINK, pwr);
+  RADIOLIB_ASSERT(state);
+  state = this->phyLayer->receive(phyPayload, RADIOLIB_LORAWAN_RELAY_PHY_PAYLOAD_MAX_LEN);
+  RadioLibTime_t tUplink = mod->hal->millis();
+  if((state == RADIOLIB_ERR_RX_TIMEOUT) || (state == RADIOLIB_ERR_CRC_MISMATCH)) {
+    return(0);
+  }
+  RADIOLIB_ASSERT(state);
+  size_t phyLen = this->phyLayer->getPacketLength();
+  if((phyLen < RADIOLIB_LORAWAN_RELAY_PHY_PAYLOAD_MIN_LEN) || (phyLen > RADIOLIB_LORAWAN_RELAY_PHY_PAYLOAD_MAX_LEN) || 
+     (LoRaWANNode::ntoh<uint32_t>(&phyPayload[1]) != devAddr)) {
+    return(0);
+  }
+
+  // UplinkMetadata: DR (bits 0-3), SNR + 20 (bits 4-8), -RSSI (bits 9-15), WOR channel (bits 16-17)
+  int16_t snr = (int16_t)this->phyLayer->getSNR() + 20;
+  snr = RADIOLIB_MAX(0, RADIOLIB_MIN(snr, 31));
+  int16_t rssi = -(int16_t)this->phyLayer->getRSSI();
+  rssi = RADIOLIB_MAX(0, RADIOLIB_MIN(rssi, 127));
+  uint32_t metadata = (uint32_t)chnlUp.dr | ((uint32_t)snr << 4) | ((uint32_t)rssi << 9) | ((uint32_t)worChannel << 16);
+  LoRaWANNode::hton<uint32_t>(&msg[0], metadata, 3);
+  LoRaWANNode::hton<uint32_t>(&msg[3], chnlUp.freq, 3);
+  RADIOLIB_DEBUG_PROTOCOL_PRINTLN("Forwarding %d bytes from device %08lX (RSSI = %d, SNR = %d)", 
+                                  (int)phyLen, (unsigned long)devAddr, -rssi, snr - 20);
+
+  // longer uplinks, or a lower datarate of the relay since beginRelay, may leave no time for a downlink
+  RadioLibTime_t turnaround = 0;
+  state = this->getRelayTurnaround(phyLen, &turnaround);
+  RADIOLIB_ASSERT(state);
+  if(mod->hal->millis() - tUplink + turnaround > this->relayRxrDelay) {
+    RADIOLIB_DEBUG_PROTOCOL_PRINTLN("A downlink may not fit before the RxR window (%lu ms needed)", 
+                                    (unsigned long)(mod->hal->millis() - tUplink + turnaround));
+  }
+
+  // forward the uplink to the network server
+  LoRaWANEvent_t event;
+  if(!eventDown) {
+    eventDown = &event;
+  }
+  uint8_t dataDown[RADIOLIB_LORAWAN_MAX_DOWNLINK_SIZE];
+  size_t lenDown = 0;
+  state = this->sendReceive(msg, RADIOLIB_LORAWAN_RELAY_METADATA_LEN + phyLen, RADIOLIB_LORAWAN_FPORT_TS011, 
+                            dataDown, &lenDown, false, eventUp, eventDown);
+  if(state < RADIOLIB_ERR_NONE) {
+    return(state);
+  }
+  dev->numForwarded++;
+  if((state == 0) || (eventDown->fPort != RADIOLIB_LORAWAN_FPORT_TS011) || (lenDown == 0)) {
+    return(1);
+  }
+
+  // relay the downlink in the RxR window of the end device, on the ACK channel of the WOR channel
+  LoRaWANChannel_t chnlDown = this->band->txAck[worChannel];
+  state = this->setPhyProperties(&chnlDown, RADIOLIB_LORAWAN_DOWNLINK, pwr);
+  RADIOLIB_ASSERT(state);
+  tElapsed = mod->hal->millis() - tUplink;
+  if(tElapsed > this->relayRxrDelay) {
+    RADIOLIB_DEBUG_PROTOCOL_PRINTLN("Missed the RxR window by %lu ms", (unsigned long)(tElapsed - this->relayRxrDelay));
+    return(1);
+  }
+  mod->hal->delay(this->relayRxrDelay - tElapsed);
+  state = this->phyLayer->transmit(dataDown, lenDown);
+  RADIOLIB_ASSERT(state);
+  this->addAirtime(chnlDown.freq, this->phyLayer->getTimeOnAir(lenDown) / 1000);
+  return(2);
+}
+
+uint8_t LoRaWANNode::findRelayDevice(uint32_t devAddr) {
+  uint8_t idx = 0;
+  for(; idx < RADIOLIB_LORAWAN_RELAY_MAX_DEVICES; idx++) {
+    if(this->relayDevices[idx].active && (this->relayDevices[idx].devAddr == devAddr)) {
+      break;
+    }
+  }
+  return(idx);
+}
+
+int16_t LoRaWANNode::getRelayTurnaround(size_t phyLen, RadioLibTime_t* turnaround) {
+  int8_t pwr = this->txPowerMax - 2*this->txPowerSteps;
+
+  // the time-on-air only depends on the datarate, so any valid frequency will do
+  LoRaWANChannel_t chnl = this->channels[RADIOLIB_LORAWAN_DIR_RX2];
+  chnl.dr = this->channels[RADIOLIB_LORAWAN_UPLINK].dr;
+  int16_t state = this->setPhyProperties(&chnl, RADIOLIB_LORAWAN_UPLINK, pwr);
+  RADIOLIB_ASSERT(state);
+  size_t lenUp = RADIOLIB_LORAWAN_FRAME_LEN(RADIOLIB_LORAWAN_RELAY_METADATA_LEN + phyLen, this->fOptsUpLen);
+  RadioLibTime_t toaUp = this->phyLayer->getTimeOnAir(lenUp - RADIOLIB_LORAWAN_FHDR_LEN_START_OFFS);
+
+  // the downlink for the end device may arrive as late as RX2, and be as long as RX2 allows
+  state = this->setPhyProperties(&this->channels[RADIOLIB_LORAWAN_DIR_RX2], RADIOLIB_LORAWAN_DOWNLINK, pwr);
+  RADIOLIB_ASSERT(state);
+  uint8_t maxPayLen = RADIOLIB_MIN(this->band->payloadLenMax[this->channels[RADIOLIB_LORAWAN_DIR_RX2].dr], 222);
+  RadioLibTime_t toaDown = this->phyLayer->getTimeOnAir(maxPayLen + 13);
+
+  *turnaround = (toaUp + toaDown) / 1000 + this->rxDelays[2];
+  return(RADIOLIB_ERR_NONE);
+}
+
+int16_t LoRaWANNode::setRelayMode(bool enable, RadioLibTime_t rxrDelay) {
+  if(!enable) {
+    this->relayUplinks = false;
+    return(RADIOLIB_ERR_NONE);
+  }
+
+  // a relay cannot send its own uplinks through another relay
+  if(this->relayEnabled || !this->band->txWoR[0].enabled) {
+    return(RADIOLIB_ERR_INVALID_MODE);
+  }
+  if(rxrDelay == 0) {
+    return(RADIOLIB_ERR_INVALID_RX_PERIOD);
+  }
+  this->relayRxrDelay = rxrDelay;
+  this->relayUplinks = true;
+  return(RADIOLIB_ERR_NONE);
+}
+
+int16_t LoRaWANNode::getRootWorSKey(uint8_t* key) {
+  if(!key) {
+    return(RADIOLIB_ERR_NULL_POINTER);
+  }
+  if(!this->isActivated()) {
+    return(RADIOLIB_ERR_NETWORK_NOT_JOINED);
+  }
+
+  // for LoRaWAN 1.0, the network session encryption key is the same as NwkSKey
+  uint8_t keyDerivationBuff[RADIOLIB_AES128_BLOCK_SIZE] = { 0 };
+  keyDerivationBuff[0] = RADIOLIB_LORAWAN_JOIN_ACCEPT_ROOT_WOR_S_KEY;
+  RadioLibAES128Instance.init(this->nwkSEncKey);
+  RadioLibAES128Instance.encryptECB(keyDerivationBuff, RADIOLIB_AES128_BLOCK_SIZE, key);
+  return(RADIOLIB_ERR_NONE);
+}
+
+int16_t LoRaWANNode::wakeRelay(const LoRaWANChannel_t* chnl) {
+  Module* mod = this->phyLayer->getMod();
+  int8_t pwr = this->txPowerMax - 2*this->txPowerSteps;
+  int16_t state = RADIOLIB_ERR_UNKNOWN;
+
+  uint8_t rootWorSKey[RADIOLIB_AES128_KEY_SIZE];
+  uint8_t worSIntKey[RADIOLIB_AES128_KEY_SIZE];
+  uint8_t worSEncKey[RADIOLIB_AES128_KEY_SIZE];
+  state = this->getRootWorSKey(rootWorSKey);
+  RADIOLIB_ASSERT(state);
+  LoRaWANNode::deriveWorKeys(rootWorSKey, this->devAddr, worSIntKey, worSEncKey);
+
+  // the WOR frame counter has to increase even after a reset, so it is tied to the persistent uplink frame counter
+  uint32_t wfCnt = RADIOLIB_MAX(this->relayWFCnt + 1, this->fCntUp << 4);
+  this->relayWFCnt = wfCnt;
+
+  // build the WOR frame after space for the MIC block, the uplink channel is encrypted
+  uint8_t wor[RADIOLIB_AES128_BLOCK_SIZE + RADIOLIB_LORAWAN_RELAY_WOR_LEN];
+  uint8_t* worFrame = &wor[RADIOLIB_AES128_BLOCK_SIZE];
+  worFrame[0] = RADIOLIB_LORAWAN_RELAY_WOR_UPLINK;
+  LoRaWANNode::hton<uint32_t>(&worFrame[RADIOLIB_LORAWAN_RELAY_WOR_DEV_ADDR_POS], this->devAddr);
+  LoRaWANNode::hton<uint32_t>(&worFrame[RADIOLIB_LORAWAN_RELAY_WOR_WFCNT_POS], wfCnt);
+  uint8_t ulChannel[RADIOLIB_LORAWAN_RELAY_WOR_PAYLOAD_LEN];
+  LoRaWANNode::hton<uint32_t>(&ulChannel[0], chnl->freq, 3);
+  ulChannel[3] = chnl->dr;
+  this->processAES(ulChannel, RADIOLIB_LORAWAN_RELAY_WOR_PAYLOAD_LEN, worSEncKey, &worFrame[RADIOLIB_LORAWAN_RELAY_WOR_PAYLOAD_POS], 
+                   this->devAddr, wfCnt, RADIOLIB_LORAWAN_UPLINK, 0x00, true);
+  LoRaWANNode::setWorMicBlock(wor, sizeof(wor), this->devAddr, wfCnt, RADIOLIB_LORAWAN_UPLINK);
+  uint32_t mic = this->generateMIC(wor, sizeof(wor) - sizeof(uint32_t), worSIntKey);
+  LoRaWANNode::hton<uint32_t>(&wor[sizeof(wor) - sizeof(uint32_t)], mic);
+
+  // the long preamble makes sure the relay catches the frame while it cycles through the WOR channels
+  state = this->setPhyProperties(&this->band->txWoR[0], RADIOLIB_LORAWAN_UPLINK, pwr, RADIOLIB_LORAWAN_RELAY_WOR_PREAMBLE_LEN);
+  RADIOLIB_ASSERT(state);
+  RadioLibTime_t toa = this->phyLayer->getTimeOnAir(RADIOLIB_LORAWAN_RELAY_WOR_LEN) / 1000;
+  state = this->phyLayer->transmit(worFrame, RADIOLIB_LORAWAN_RELAY_WOR_LEN);
+  this->addAirtime(this->band->txWoR[0].freq, toa);
+  this->stats.airtime += toa;
+  RADIOLIB_ASSERT(state);
+
+  // wait for the acknowledgement, authenticated with the same WOR frame counter
+  uint8_t ack[RADIOLIB_AES128_BLOCK_SIZE + RADIOLIB_LORAWAN_RELAY_WOR_ACK_LEN];
+  uint8_t* ackFrame = &ack[RADIOLIB_AES128_BLOCK_SIZE];
+  state = this->setPhyProperties(&this->band->txAck[0], RADIOLIB_LORAWAN_DOWNLINK, pwr);
+  RADIOLIB_ASSERT(state);
+  RadioLibTime_t tStart = mod->hal->micros();
+  state = this->phyLayer->receive(ackFrame, RADIOLIB_LORAWAN_RELAY_WOR_ACK_LEN);
+  this->rxOnTime += mod->hal->micros() - tStart;
+  if((state == RADIOLIB_ERR_RX_TIMEOUT) || (state == RADIOLIB_ERR_CRC_MISMATCH)) {
+    RADIOLIB_DEBUG_PROTOCOL_PRINTLN("No WOR ACK from the relay");
+    return(RADIOLIB_ERR_RELAY_NO_ACK);
+  }
+  RADIOLIB_ASSERT(state);
+  LoRaWANNode::setWorMicBlock(ack, sizeof(ack), this->devAddr, wfCnt, RADIOLIB_LORAWAN_DOWNLINK);
+  if((this->phyLayer->getPacketLength() != RADIOLIB_LORAWAN_RELAY_WOR_ACK_LEN) || 
+     (ackFrame[0] != RADIOLIB_LORAWAN_RELAY_WOR_ACK) ||
+     (LoRaWANNode::ntoh<uint32_t>(&ackFrame[RADIOLIB_LORAWAN_RELAY_WOR_DEV_ADDR_POS]) != this->devAddr) ||
+     !this->verifyMIC(ack, sizeof(ack), worSIntKey)) {
+    return(RADIOLIB_ERR_RELAY_NO_ACK);
+  }
+  return(RADIOLIB_ERR_NONE);
+}
+
+void LoRaWANNode::deriveWorKeys(const uint8_t* rootWorSKey, uint32_t devAddr, uint8_t* worSIntKey, uint8_t* worSEncKey) {
+  uint8_t keyDerivationBuff[RADIOLIB_AES128_BLOCK_SIZE] = { 0 };
+  LoRaWANNode::hton<uint32_t>(&keyDerivationBuff[RADIOLIB_LORAWAN_JOIN_ACCEPT_AES_DEV_ADDR_POS], devAddr);
+  RadioLibAES128Instance.init((uint8_t*)rootWorSKey);
+
+  keyDerivationBuff[0] = RADIOLIB_LORAWAN_JOIN_ACCEPT_WOR_S_INT_KEY;
+  RadioLibAES128Instance.encryptECB(keyDerivationBuff, RADIOLIB_AES128_BLOCK_SIZE, worSIntKey);
+
+  keyDerivationBuff[0] = RADIOLIB_LORAWAN_JOIN_ACCEPT_WOR_S_ENC_KEY;
+  RadioLibAES128Instance.encryptECB(keyDerivationBuff, RADIOLIB_AES128_BLOCK_SIZE, worSEncKey);
+}
+
+void LoRaWANNode::setWorMicBlock(uint8_t* msg, size_t len, uint32_t devAddr, uint32_t wfCnt, uint8_t dir) {
+  // same layout as the B0 block of data frames, with the WOR frame counter
+  memset(msg, 0, RADIOLIB_AES128_BLOCK_SIZE);
+  msg[RADIOLIB_LORAWAN_BLOCK_MAGIC_POS] = RADIOLIB_LORAWAN_MIC_BLOCK_MAGIC;
+  msg[RADIOLIB_LORAWAN_BLOCK_DIR_POS] = dir;
+  LoRaWANNode::hton<uint32_t>(&msg[RADIOLIB_LORAWAN_BLOCK_DEV_ADDR_POS], devAddr);
+  LoRaWANNode::hton<uint32_t>(&msg[RADIOLIB_LORAWAN_BLOCK_FCNT_POS], wfCnt);
+  msg[RADIOLIB_LORAWAN_MIC_BLOCK_LEN_POS] = len - RADIOLIB_AES128_BLOCK_SIZE - sizeof(uint32_t);
+}
+
+void LoRaWANNode::clearFragSession() {
+  #if !RADIOLIB_STATIC_ONLY
+  delete[] this->fragReceived;
+  delete[] this->fragMatrix;
+  this->fragReceived = NULL;
+  this->fragMatrix = NULL;
+  #endif
+  memset(&this->fragSession, 0, sizeof(LoRaWANFragSession_t));
+}
+
+void LoRaWANNode::processFragment(uint16_t n, const uint8_t* data) {
+  LoRaWANFragSession_t* session = &this->fragSession;
+  uint16_t m = session->nbFrag;
+  session->nbReceived++;
+
+  // as long as no coded fragment was received, uncoded fragments are simply stored
+  if(!session->decoding) {
+    if(n <= m) {
+      if(!TEST_BIT_IN_ARRAY_LSB(this->fragReceived, n - 1)) {
+        SET_BIT_IN_ARRAY_LSB(this->fragReceived, n - 1);
+        this->fragStorageWrite(n - 1, data);
+      }
+
+      // check if all uncoded fragments are here
+      uint16_t i = 0;
+      for(; i < m; i++) {
+        if(!TEST_BIT_IN_ARRAY_LSB(this->fragReceived, i)) {
+          break;
+        }
+      }
+      if(i == m) {
+        RADIOLIB_DEBUG_PROTOCOL_PRINTLN("Data block complete (%d fragments)", m);
+        session->complete = true;
+      }
+      return;
+    }
+
+    // first coded fragment, the set of missing fragments is now fixed
+    session->decoding = true;
+    session->nbMissing = 0;
+    for(uint16_t i = 0; i < m; i++) {
+      session->nbMissing += !TEST_BIT_IN_ARRAY_LSB(this->fragReceived, i);
+    }
+    if(session->nbMissing > RADIOLIB_LORAWAN_FRAG_MAX_MISSING) {
+      RADIOLIB_DEBUG_PROTOCOL_PRINTLN("Too many missing fragments (%d) to recover", session->nbMissing);
+      session->matrixFull = true;
+    }
+  }
+
+  if(session->matrixFull) {
+    return;
+  }
+  uint16_t numMissing = session->nbMissing;
+
+  // get the parity check row for this fragment, uncoded fragments have a single bit set
+  #if !RADIOLIB_STATIC_ONLY
+  uint8_t* row = new uint8_t[(m + 7) / 8];
+  uint8_t* line = new uint8_t[(numMissing + 7) / 8];
+  uint8_t* frag = new uint8_t[session->fragSize];
+  uint8_t* fragTmp = new uint8_t[session->fragSize];
+  #else
+  uint8_t row[(RADIOLIB_LORAWAN_FRAG_MAX_NB_FRAG + 7) / 8];
+  uint8_t line[(RADIOLIB_LORAWAN_FRAG_MAX_MISSING + 7) / 8];
+  uint8_t frag[RADIOLIB_STATIC_ARRAY_SIZE];
+  uint8_t fragTmp[RADIOLIB_STATIC_ARRAY_SIZE];
+  #endif
+  if(n <= m) {
+    memset(row, 0, (m + 7) / 8);
+    SET_BIT_IN_ARRAY_LSB(row, n - 1);
+  } else {
+    LoRaWANNode::fragParityRow(n - m, m, row);
+  }
+  memcpy(frag, data, session->fragSize);
+
+  // remove the contribution of fragments that were already received,
+  // and map the remaining ones onto the set of missing fragments
+  memset(line, 0, (numMissing + 7) / 8);
+  bool empty = true;
+  for(uint16_t i = 0; i < m; i++) {
+    if(!TEST_BIT_IN_ARRAY_LSB(row, i)) {
+      continue;
+    }
+    if(TEST_BIT_IN_ARRAY_LSB(this->fragReceived, i)) {
+      this->fragStorageRead(i, fragTmp);
+      for(uint8_t j = 0; j < session->fragSize; j++) {
+        frag[j] ^= fragTmp[j];
+      }
+    } else {
+      SET_BIT_IN_ARRAY_LSB(line, this->fragIndexToMissing(i));
+      empty = false;
+    }
+  }
+
+  // Gaussian elimination - the matrix is kept upper triangular,
+  // with the data of row p stored in place of the p-th missing fragment
+  while(!empty) {
+    uint16_t p = 0;
+    while(!TEST_BIT_IN_ARRAY_LSB(line, p)) {
+      p++;
+    }
+
+    size_t rowPos = (size_t)p * numMissing;
+    if(!TEST_BIT_IN_ARRAY_LSB(this->fragMatrix, rowPos + p)) {
+      // free row, store the line and the data
+      for(uint16_t i = p; i < numMissing; i++) {
+        if(TEST_BIT_IN_ARRAY_LSB(line, i)) {
+          SET_BIT_IN_ARRAY_LSB(this->fragMatrix, rowPos + i);
+        }
+      }
+      this->fragStorageWrite(this->fragMissingToIndex(p), frag);
+      session->nbRows++;
+      break;
+    }
+
+    // row is taken, eliminate the leading bit and continue
+    this->fragStorageRead(this->fragMissingToIndex(p), fragTmp);
+    for(uint8_t j = 0; j < session->fragSize; j++) {
+      frag[j] ^= fragTmp[j];
+    }
+    empty = true;
+    for(uint16_t i = p; i < numMissing; i++) {
+      if(TEST_BIT_IN_ARRAY_LSB(this->fragMatrix, rowPos + i)) {
+        if(TEST_BIT_IN_ARRAY_LSB(line, i)) {
+          CLEAR_BIT_IN_ARRAY_LSB(line, i);
+        } else {
+          SET_BIT_IN_ARRAY_LSB(line, i);
+        }
+      }
+      if(TEST_BIT_IN_ARRAY_LSB(line, i)) {
+        empty = false;
+      }
+    }
+  }
+
+  // once the matrix is full rank, solve it by back substitution
+  if(session->nbRows == numMissing) {
+    for(int32_t p = numMissing - 1; p >= 0; p--) {
+      uint16_t idx = this->fragMissingToIndex(p);
+      this->fragStorageRead(idx, frag);
+      size_t rowPos = (size_t)p * numMissing;
+      for(uint16_t i = p + 1; i < numMissing; i++) {
+        if(TEST_BIT_IN_ARRAY_LSB(this->fragMatrix, rowPos + i)) {
+          this->fragStorageRead(this->fragMissingToIndex(i), fragTmp);
+          for(uint8_t j = 0; j < session->fragSize; j++) {
+            frag[j] ^= fragTmp[j];
+          }
+        }
+      }
+      this->fragStorageWrite(idx, frag);
+    }
+    RADIOLIB_DEBUG_PROTOCOL_PRINTLN("Data block recovered (%d fragments lost)", numMissing);
+    session->complete = true;
+  }
+
+  #if !RADIOLIB_STATIC_ONLY
+  delete[] row;
+  delete[] line;
+  delete[] frag;
+  delete[] fragTmp;
+  #endif
+}
+
+int16_t LoRaWANNode::fragStorageRead(uint16_t idx, uint8_t* data) {
+  uint32_t addr = (uint32_t)idx * this->fragSession.fragSize;
+  if(this->fragReadCb) {
+    return(this->fragReadCb(addr, data, this->fragSession.fragSize));
+  }
+  memcpy(data, &this->fragBuff[addr], this->fragSession.fragSize);
+  return(RADIOLIB_ERR_NONE);
+}
+
+int16_t LoRaWANNode::fragStorageWrite(uint16_t idx, const uint8_t* data) {
+  uint32_t addr = (uint32_t)idx * this->fragSession.fragSize;
+  if(this->fragWriteCb) {
+    return(this->fragWriteCb(addr, data, this->fragSession.fragSize));
+  }
+  memcpy(&this->fragBuff[addr], data, this->fragSession.fragSize);
+  return(RADIOLIB_ERR_NONE);
+}
+
+uint16_t LoRaWANNode::fragMissingToIndex(uint16_t pos) {
+  for(uint16_t i = 0; i < this->fragSession.nbFrag; i++) {
+    if(!TEST_BIT_IN_ARRAY_LSB(this->fragReceived, i)) {
+      if(pos == 0) {
+        return(i);
+      }
+      pos--;
+    }
+  }
+  return(0);
+}
+
+uint16_t LoRaWANNode::fragIndexToMissing(uint16_t idx) {
+  uint16_t pos = 0;
+  for(uint16_t i = 0; i < idx; i++) {
+    pos += !TEST_BIT_IN_ARRAY_LSB(this->fragReceived, i);
+  }
+  return(pos);
+}
+
+void LoRaWANNode::fragParityRow(uint16_t n, uint16_t m, uint8_t* row) {
+  memset(row, 0, (m + 7) / 8);
+
+  // if m is a power of two, the modulo would be biased, so TS004 extends it by one
+  uint32_t mTmp = 0;
+  if((m & (m - 1)) == 0) {
+    mTmp = 1;
+  }
+
+  // pseudo-random selection of m/2 fragments using the PRBS23 sequence
+  uint32_t x = 1 + (1001 * (uint32_t)n);
+  for(uint16_t i = 0; i < m / 2; i++) {
+    uint32_t r = (uint32_t)1 << 16;
+    while(r >= m) {
+      x = (x >> 1) | (((x & 0x01) ^ ((x >> 5) & 0x01)) << 22);
+      r = x % (m + mTmp);
+    }
+    SET_BIT_IN_ARRAY_LSB(row, r);
+  }
+}
+
+bool LoRaWANNode::execMacCommand(uint8_t cid, uint8_t* optIn, uint8_t lenIn) {
+  uint8_t buff[RADIOLIB_LORAWAN_MAX_MAC_COMMAND_LEN_DOWN];
+  return(this->execMacCommand(cid, optIn, lenIn, buff));
+}
+
+bool LoRaWANNode::execMacCommand(uint8_t cid, uint8_t* optIn, uint8_t lenIn, uint8_t* optOut) {
+  RADIOLIB_DEBUG_PROTOCOL_PRINTLN("[MAC] 0x%02x", cid);
+  RADIOLIB_DEBUG_PROTOCOL_HEXDUMP(optIn, lenIn);
 
-      int8_t power = this->txPowerMax - 2*macTxSteps;
-      int8_t powerActual = 0;
-      state = this->phyLayer->checkOutputPower(power, &powerActual);
-      // only acknowledge if the radio is able to operate at or below the requested power level
-      if(state == RADIOLIB_ERR_NONE || (state == RADIOLIB_ERR_INVALID_OUTPUT_POWER && powerActual < power)) {
-        pwrAck = 1;
-        this->txPowerSteps = macTxSteps;
-      } else {
-        RADIOLIB_DEBUG_PROTOCOL_PRINTLN("ADR failed to configure Tx power %d, code %d!", power, state);
-      }
+  if(cid >= RADIOLIB_LORAWAN_MAC_PROPRIETARY) {
+    // the payload is passed to the user directly from the downlink buffer
+    LoRaWANCustomMacCommand_t* custom = this->findCustomMacCommand(cid);
+    if(!custom || !custom->cb) {
+      return(false);
+    }
+    return(custom->cb(cid, optIn, lenIn, optOut));
+  }
 
-      // set ACK bits
-      optOut[0] = (pwrAck << 2) | (drAck << 1) | (chMaskAck << 0);
+  // standard MAC commands are dispatched through the handler table, in the same order as MacTable
+  for(size_t i = 0; i < RADIOLIB_LORAWAN_NUM_MAC_COMMANDS; i++) {
+    if((MacTable[i].cid == cid) && LoRaWANNode::macHandlers[i]) {
+      return((this->*LoRaWANNode::macHandlers[i])(optIn, lenIn, optOut));
+    }
+  }
 
-      RADIOLIB_DEBUG_PROTOCOL_PRINTLN("LinkAdrAns: %02x", optOut[0]);
+  // derived classes may implement additional MAC commands
+  return(derivedMacHandler(cid, optIn, lenIn, optOut));
+}
 
-      // if ACK not completely successful, revert and stop
-      if(optOut[0] != 0x07) {
-        this->applyChannelMask(chMaskGrp0123, chMaskGrp45);
-        this->setAvailableChannels(chMaskActive);
-        this->channels[RADIOLIB_LORAWAN_UPLINK].dr = currentDr;
-        // Tx power was not modified
-        return(true);
-      }
+const LoRaWANNode::MacHandler_t LoRaWANNode::macHandlers[RADIOLIB_LORAWAN_NUM_MAC_COMMANDS] = {
+  &LoRaWANNode::execMacReset,
+  &LoRaWANNode::execMacLinkCheck,
+  &LoRaWANNode::execMacLinkAdr,
+  &LoRaWANNode::execMacDutyCycle,
+  &LoRaWANNode::execMacRxParamSetup,
+  &LoRaWANNode::execMacDevStatus,
+  &LoRaWANNode::execMacNewChannel,
+  &LoRaWANNode::execMacRxTimingSetup,
+  &LoRaWANNode::execMacTxParamSetup,
+  &LoRaWANNode::execMacDlChannel,
+  &LoRaWANNode::execMacRekey,
+  &LoRaWANNode::execMacAdrParamSetup,
+  &LoRaWANNode::execMacDeviceTime,
+  &LoRaWANNode::execMacForceRejoin,
+  &LoRaWANNode::execMacRejoinParamSetup,
+  NULL,   // proprietary commands are handled by the user registry
+};
+
+bool LoRaWANNode::execMacReset(uint8_t* optIn, uint8_t lenIn, uint8_t* optOut) {
+  (void)lenIn;
+  (void)optOut;
 
-      // ACK successful, so apply and save
-      this->txPowerSteps = macTxSteps;
-      if(lenIn > 1) {
-        uint8_t macNbTrans = optIn[13] & 0x0F;
+  // get the server version
+  uint8_t srvVersion = optIn[0];
+  RADIOLIB_DEBUG_PROTOCOL_PRINTLN("ResetConf: server version 1.%d", srvVersion);
+  if(srvVersion == this->rev) {
+    // valid server version, stop sending the ResetInd MAC command
+    LoRaWANNode::deleteMacCommand(RADIOLIB_LORAWAN_MAC_RESET, this->fOptsUp, &this->fOptsUpLen, RADIOLIB_LORAWAN_UPLINK);
+  }
+  return(false);
+}
 
-        // if there is a value for NbTrans > 0, apply it
-        if(macNbTrans) {
-          this->nbTrans = macNbTrans;
-        } else {
-          // for LoRaWAN v1.0.4, if NbTrans == 0, the end-device SHALL use the default value (being 1)
-          if(this->rev == 0) {
-            this->nbTrans = 1;
-          }
-          // for LoRaWAN v1.1, if NbTrans == 0, the end-device SHALL keep the current NbTrans value unchanged
-          // so, don't do anything
-        }
-        
-      }
+bool LoRaWANNode::execMacLinkCheck(uint8_t* optIn, uint8_t lenIn, uint8_t* optOut) {
+  (void)lenIn;
+  (void)optOut;
 
-      // restore original active channels
-      this->setAvailableChannels(chMaskActive);
+  RADIOLIB_DEBUG_PROTOCOL_PRINTLN("LinkCheckAns: [user]");
 
-      // save to the ADR MAC location
-      // but first re-set the Dr/Tx/NbTrans field to make sure they're not set to 0xF
-      optIn[0]  = (this->channels[RADIOLIB_LORAWAN_UPLINK].dr) << 4;
-      optIn[0] |= this->txPowerSteps;
-      if(lenIn > 1) {
-        optIn[13] = this->nbTrans;
-      }
-      memcpy(&this->bufferSession[RADIOLIB_LORAWAN_SESSION_LINK_ADR], optIn, lenIn);
+  // the margin is also used by device-side adaptive uplink control
+  this->adaptiveMargin = optIn[0];
+  this->adaptiveGwCnt = optIn[1];
 
-      return(true);
-    } break;
+  return(false);
+}
 
-    case(RADIOLIB_LORAWAN_MAC_DUTY_CYCLE): {
-      uint8_t maxDutyCycle = optIn[0] & 0x0F;
-      RADIOLIB_DEBUG_PROTOCOL_PRINTLN("DutyCycleReq: max duty cycle = 1/2^%d", maxDutyCycle);
-      if(maxDutyCycle == 0) {
-        this->dutyCycle = this->band->dutyCycle;
-      } else {
-        this->dutyCycle = (RadioLibTime_t)60 * (RadioLibTime_t)60 * (RadioLibTime_t)1000 / (RadioLibTime_t)(1UL << maxDutyCycle);
-      }
+bool LoRaWANNode::execMacLinkAdr(uint8_t* optIn, uint8_t lenIn, uint8_t* optOut) {
+  // get the ADR configuration
+  uint8_t macDrUp = (optIn[0] & 0xF0) >> 4;
+  uint8_t macTxSteps = optIn[0] & 0x0F;
+  
+  RADIOLIB_DEBUG_PROTOCOL_PRINTLN("LinkAdrReq: dataRate = %d, txSteps = %d, nbTrans = %d", macDrUp, macTxSteps, lenIn > 1 ? optIn[13] : 0);
 
-      memcpy(&this->bufferSession[RADIOLIB_LORAWAN_SESSION_DUTY_CYCLE], optIn, lenIn);
+  uint8_t chMaskAck = 0;
+  uint8_t drAck = 0;
+  uint8_t pwrAck = 0;
 
-      return(true);
-    } break;
+  // first, get current configuration
+  uint64_t chMaskGrp0123 = 0;
+  uint32_t chMaskGrp45 = 0;
+  this->getChannelPlanMask(&chMaskGrp0123, &chMaskGrp45);
+  uint16_t chMaskActive = 0;
+  (void)this->getAvailableChannels(&chMaskActive);
+  uint8_t currentDr = this->channels[RADIOLIB_LORAWAN_UPLINK].dr;
 
-    case(RADIOLIB_LORAWAN_MAC_RX_PARAM_SETUP): {
-      // get the configuration
-      uint8_t macRx1DrOffset = (optIn[0] & 0x70) >> 4;
-      uint8_t macRx2Dr = optIn[0] & 0x0F;
-      uint32_t macRx2Freq = LoRaWANNode::ntoh<uint32_t>(&optIn[1], 3);
-      
-      uint8_t rx1DrOsAck = 0;
-      uint8_t rx2DrAck = 0;
-      uint8_t rx2FreqAck = 0;
-
-      RADIOLIB_DEBUG_PROTOCOL_PRINTLN("RXParamSetupReq: Rx1DrOffset = %d, rx2DataRate = %d, freq = %7.3f", 
-                                      macRx1DrOffset, macRx2Dr, macRx2Freq / 10000.0);
-      
-      // check the requested configuration
-      uint8_t uplinkDr = this->channels[RADIOLIB_LORAWAN_UPLINK].dr;
-      DataRate_t dr;
-      if(this->band->rx1DrTable[uplinkDr][macRx1DrOffset] != RADIOLIB_LORAWAN_DATA_RATE_UNUSED) {
-        if(this->findDataRate(this->band->rx1DrTable[uplinkDr][macRx1DrOffset], &dr) == RADIOLIB_ERR_NONE) {
-          rx1DrOsAck = 1;
-        }
-      }
-      if(macRx2Dr >= this->band->rx2.drMin && macRx2Dr <= this->band->rx2.drMax) {
-        if(this->band->dataRates[macRx2Dr] != RADIOLIB_LORAWAN_DATA_RATE_UNUSED) {
-          if(this->findDataRate(macRx2Dr, &dr) == RADIOLIB_ERR_NONE) {
-            rx2DrAck = 1;
-          }
-        }
-      }
-      if(macRx2Freq >= this->band->freqMin && macRx2Freq <= this->band->freqMax) {
-        if(this->phyLayer->setFrequency(macRx2Freq / 10000.0) == RADIOLIB_ERR_NONE) {
-          rx2FreqAck = 1;
-        }
-      }
-      optOut[0] = (rx1DrOsAck << 2) | (rx2DrAck << 1) | (rx2FreqAck << 0);
+  // only apply channel mask if present (internal Dr/Tx commands do not set channel mask)
+  if(lenIn > 1) {
+    uint64_t macChMaskGrp0123 = LoRaWANNode::ntoh<uint64_t>(&optIn[1]);
+    uint32_t macChMaskGrp45 = LoRaWANNode::ntoh<uint32_t>(&optIn[9]);
+    // apply requested channel mask and enable all of them for testing datarate
+    chMaskAck = this->applyChannelMask(macChMaskGrp0123, macChMaskGrp45);
+  } else {
+    chMaskAck = true;
+  }
+  
+  this->setAvailableChannels(0xFFFF);
+
+  int16_t state;
+
+  // try to apply the datarate configuration
+  // if value is set to 'keep current values', retrieve current value
+  if(macDrUp == 0x0F) {
+    macDrUp = currentDr;
+  }
+
+  if (this->band->dataRates[macDrUp] != RADIOLIB_LORAWAN_DATA_RATE_UNUSED) {
+    // check if the module supports this data rate
+    DataRate_t dr;
+    state = this->findDataRate(macDrUp, &dr);
+
+    // if datarate in hardware all good, set datarate for now
+    // and check if there are any available Tx channels for this datarate
+    if(state == RADIOLIB_ERR_NONE) {
+      this->channels[RADIOLIB_LORAWAN_UPLINK].dr = macDrUp;
 
-      // if not fully acknowledged, return now without applying the requested configuration
-      if(optOut[0] != 0x07) {
-        return(true);
+      // only if we have available Tx channels, we set an Ack
+      if(this->getAvailableChannels(NULL) > 0) {
+        drAck = 1;
+      } else {
+        RADIOLIB_DEBUG_PROTOCOL_PRINTLN("ADR: no channels available for datarate %d", macDrUp);
       }
+    } else {
+      RADIOLIB_DEBUG_PROTOCOL_PRINTLN("ADR: hardware failure configurating datarate %d, code %d", macDrUp, state);
+    }
+  
+  }
 
-      // passed ACK, so apply configuration
-      this->rx1DrOffset = macRx1DrOffset;
-      this->channels[RADIOLIB_LORAWAN_DIR_RX2].dr = macRx2Dr;
-      this->channels[RADIOLIB_LORAWAN_DIR_RX2].freq = macRx2Freq;
-      memcpy(&this->bufferSession[RADIOLIB_LORAWAN_SESSION_RX_PARAM_SETUP], optIn, lenIn);
+  // try to apply the power configuration
+  // if value is set to 'keep current values', retrieve current value
+  if(macTxSteps == 0x0F) {
+    macTxSteps = this->txPowerSteps;
+  }
 
-      return(true);
-    } break;
+  int8_t power = this->txPowerMax - 2*macTxSteps;
+  int8_t powerActual = 0;
+  state = this->phyLayer->checkOutputPower(power, &powerActual);
+  // only acknowledge if the radio is able to operate at or below the requested power level
+  if(state == RADIOLIB_ERR_NONE || (state == RADIOLIB_ERR_INVALID_OUTPUT_POWER && powerActual < power)) {
+    pwrAck = 1;
+    this->txPowerSteps = macTxSteps;
+  } else {
+    RADIOLIB_DEBUG_PROTOCOL_PRINTLN("ADR failed to configure Tx power %d, code %d!", power, state);
+  }
 
-    case(RADIOLIB_LORAWAN_MAC_DEV_STATUS): {
-      // set the uplink reply
-      optOut[0] = this->battLevel;
-      int8_t snr = this->phyLayer->getSNR();
-      optOut[1] = snr & 0x3F;
+  // set ACK bits
+  optOut[0] = (pwrAck << 2) | (drAck << 1) | (chMaskAck << 0);
 
-      RADIOLIB_DEBUG_PROTOCOL_PRINTLN("DevStatusAns: status = 0x%02x%02x", optOut[0], optOut[1]);
-      return(true);
-    } break;
+  RADIOLIB_DEBUG_PROTOCOL_PRINTLN("LinkAdrAns: %02x", optOut[0]);
 
-    case(RADIOLIB_LORAWAN_MAC_NEW_CHANNEL): {
-      // only implemented on dynamic bands
-      if(this->band->bandType == RADIOLIB_LORAWAN_BAND_FIXED) {
-        return(false);
-      }
-
-      // get the configuration
-      uint8_t macChIndex = optIn[0];
-      uint32_t macFreq = LoRaWANNode::ntoh<uint32_t>(&optIn[1], 3);
-      uint8_t macDrMax = (optIn[4] & 0xF0) >> 4;
-      uint8_t macDrMin = optIn[4] & 0x0F;
-      
-      uint8_t drAck = 0;
-      uint8_t freqAck = 0;
-
-      // the default channels shall not be modified, so check if this is a default channel
-      // if the channel index is set, this channel is defined, so return a NACK
-      if(macChIndex < 3 && this->band->txFreqs[macChIndex].idx != RADIOLIB_LORAWAN_CHANNEL_INDEX_NONE) {
-        optOut[0] = 0;
-        return(true);
-      }
-
-      // check if the outermost datarates are defined and if the device supports them
-      DataRate_t dr;
-      if(this->band->dataRates[macDrMin] != RADIOLIB_LORAWAN_DATA_RATE_UNUSED && this->findDataRate(macDrMin, &dr) == RADIOLIB_ERR_NONE) {
-        if(this->band->dataRates[macDrMax] != RADIOLIB_LORAWAN_DATA_RATE_UNUSED && this->findDataRate(macDrMax, &dr) == RADIOLIB_ERR_NONE) {
-          drAck = 1;
-        }
-      }
+  // if ACK not completely successful, revert and stop
+  if(optOut[0] != 0x07) {
+    this->applyChannelMask(chMaskGrp0123, chMaskGrp45);
+    this->setAvailableChannels(chMaskActive);
+    this->channels[RADIOLIB_LORAWAN_UPLINK].dr = currentDr;
+    // Tx power was not modified
+    return(true);
+  }
 
-      // check if the frequency is allowed and possible
-      if(macFreq >= this->band->freqMin && macFreq <= this->band->freqMax) {
-        if(this->phyLayer->setFrequency((float)macFreq / 10000.0) == RADIOLIB_ERR_NONE) {
-          freqAck = 1;
-        }
-      // otherwise, if frequency is 0, disable the channel which is also a valid option
-      } else if(macFreq == 0) {
-        freqAck = 1;
+  // ACK successful, so apply and save
+  this->txPowerSteps = macTxSteps;
+  if(lenIn > 1) {
+    uint8_t macNbTrans = optIn[13] & 0x0F;
+
+    // if there is a value for NbTrans > 0, apply it
+    if(macNbTrans) {
+      this->nbTrans = macNbTrans;
+    } else {
+      // for LoRaWAN v1.0.4, if NbTrans == 0, the end-device SHALL use the default value (being 1)
+      if(this->rev == 0) {
+        this->nbTrans = 1;
       }
+      // for LoRaWAN v1.1, if NbTrans == 0, the end-device SHALL keep the current NbTrans value unchanged
+      // so, don't do anything
+    }
+    
+  }
 
-      // set ACK bits
-      optOut[0] = (drAck << 1) | (freqAck << 0);
+  // restore original active channels
+  this->setAvailableChannels(chMaskActive);
 
-      // if not fully acknowledged, return now without applying the requested configuration
-      if(optOut[0] != 0x03) {
-        return(true);
-      }
+  // save to the ADR MAC location
+  // but first re-set the Dr/Tx/NbTrans field to make sure they're not set to 0xF
+  optIn[0]  = (this->channels[RADIOLIB_LORAWAN_UPLINK].dr) << 4;
+  optIn[0] |= this->txPowerSteps;
+  if(lenIn > 1) {
+    optIn[13] = this->nbTrans;
+  }
+  memcpy(&this->bufferSession[RADIOLIB_LORAWAN_SESSION_LINK_ADR], optIn, lenIn);
 
-      // ACK successful, so apply and save
-      if(macFreq > 0) {
-        this->channelPlan[RADIOLIB_LORAWAN_UPLINK][macChIndex].enabled   = true;
-        this->channelPlan[RADIOLIB_LORAWAN_UPLINK][macChIndex].idx       = macChIndex;
-        this->channelPlan[RADIOLIB_LORAWAN_UPLINK][macChIndex].freq      = macFreq;
-        this->channelPlan[RADIOLIB_LORAWAN_UPLINK][macChIndex].drMin     = macDrMin;
-        this->channelPlan[RADIOLIB_LORAWAN_UPLINK][macChIndex].drMax     = macDrMax;
-        this->channelPlan[RADIOLIB_LORAWAN_UPLINK][macChIndex].available = true;
-        // downlink channel is identical to uplink channel
-        this->channelPlan[RADIOLIB_LORAWAN_DOWNLINK][macChIndex] = this->channelPlan[RADIOLIB_LORAWAN_UPLINK][macChIndex];
-      } else {
-        this->channelPlan[RADIOLIB_LORAWAN_UPLINK][macChIndex] = RADIOLIB_LORAWAN_CHANNEL_NONE;
-        this->channelPlan[RADIOLIB_LORAWAN_DOWNLINK][macChIndex] = RADIOLIB_LORAWAN_CHANNEL_NONE;
+  return(true);
+}
 
-      }
+bool LoRaWANNode::execMacDutyCycle(uint8_t* optIn, uint8_t lenIn, uint8_t* optOut) {
+  (void)optOut;
 
-      RADIOLIB_DEBUG_PROTOCOL_PRINTLN("UL: %3d %d %7.3f (%d - %d) | DL: %3d %d %7.3f (%d - %d)", 
-                              this->channelPlan[RADIOLIB_LORAWAN_UPLINK][macChIndex].idx,
-                              this->channelPlan[RADIOLIB_LORAWAN_UPLINK][macChIndex].enabled,
-                              this->channelPlan[RADIOLIB_LORAWAN_UPLINK][macChIndex].freq / 10000.0,
-                              this->channelPlan[RADIOLIB_LORAWAN_UPLINK][macChIndex].drMin,
-                              this->channelPlan[RADIOLIB_LORAWAN_UPLINK][macChIndex].drMax,
+  uint8_t maxDutyCycle = optIn[0] & 0x0F;
+  RADIOLIB_DEBUG_PROTOCOL_PRINTLN("DutyCycleReq: max duty cycle = 1/2^%d", maxDutyCycle);
+  if(maxDutyCycle == 0) {
+    this->dutyCycle = this->band->dutyCycle;
+  } else {
+    this->dutyCycle = (RadioLibTime_t)60 * (RadioLibTime_t)60 * (RadioLibTime_t)1000 / (RadioLibTime_t)(1UL << maxDutyCycle);
+  }
 
-                              this->channelPlan[RADIOLIB_LORAWAN_DOWNLINK][macChIndex].idx,
-                              this->channelPlan[RADIOLIB_LORAWAN_DOWNLINK][macChIndex].enabled,
-                              this->channelPlan[RADIOLIB_LORAWAN_DOWNLINK][macChIndex].freq / 10000.0,
-                              this->channelPlan[RADIOLIB_LORAWAN_DOWNLINK][macChIndex].drMin,
-                              this->channelPlan[RADIOLIB_LORAWAN_DOWNLINK][macChIndex].drMax
-                            );
+  memcpy(&this->bufferSession[RADIOLIB_LORAWAN_SESSION_DUTY_CYCLE], optIn, lenIn);
 
-      memcpy(&this->bufferSession[RADIOLIB_LORAWAN_SESSION_UL_CHANNELS] + macChIndex * lenIn, optIn, lenIn);
+  return(true);
+}
 
-      return(true);
-    } break;
+bool LoRaWANNode::execMacRxParamSetup(uint8_t* optIn, uint8_t lenIn, uint8_t* optOut) {
+  // get the configuration
+  uint8_t macRx1DrOffset = (optIn[0] & 0x70) >> 4;
+  uint8_t macRx2Dr = optIn[0] & 0x0F;
+  uint32_t macRx2Freq = LoRaWANNode::ntoh<uint32_t>(&optIn[1], 3);
+  
+  uint8_t rx1DrOsAck = 0;
+  uint8_t rx2DrAck = 0;
+  uint8_t rx2FreqAck = 0;
 
-    case(RADIOLIB_LORAWAN_MAC_DL_CHANNEL): {
-      // only implemented on dynamic bands
-      if(this->band->bandType == RADIOLIB_LORAWAN_BAND_FIXED) {
-        return(false);
-      }
-
-      // get the configuration
-      uint8_t macChIndex = optIn[0];
-      uint32_t macFreq = LoRaWANNode::ntoh<uint32_t>(&optIn[1], 3);
-      RADIOLIB_DEBUG_PROTOCOL_PRINTLN("DlChannelReq: index = %d, freq = %7.3f MHz", macChIndex, macFreq / 10000.0);
-      uint8_t freqDlAck = 0;
-      uint8_t freqUlAck = 0;
-      
-      // check if the frequency is allowed possible
-      if(macFreq >= this->band->freqMin && macFreq <= this->band->freqMax) { 
-        if(this->phyLayer->setFrequency(macFreq / 10000.0) == RADIOLIB_ERR_NONE) {
-          freqDlAck = 1;
-        }
-      }
-      
-      // check if the corresponding uplink frequency is actually set
-      if(this->channelPlan[RADIOLIB_LORAWAN_UPLINK][macChIndex].freq > 0) {
-        freqUlAck = 1;
+  RADIOLIB_DEBUG_PROTOCOL_PRINTLN("RXParamSetupReq: Rx1DrOffset = %d, rx2DataRate = %d, freq = %7.3f", 
+                                  macRx1DrOffset, macRx2Dr, macRx2Freq / 10000.0);
+  
+  // check the requested configuration
+  uint8_t uplinkDr = this->channels[RADIOLIB_LORAWAN_UPLINK].dr;
+  DataRate_t dr;
+  if(this->band->rx1DrTable[uplinkDr][macRx1DrOffset] != RADIOLIB_LORAWAN_DATA_RATE_UNUSED) {
+    if(this->findDataRate(this->band->rx1DrTable[uplinkDr][macRx1DrOffset], &dr) == RADIOLIB_ERR_NONE) {
+      rx1DrOsAck = 1;
+    }
+  }
+  if(macRx2Dr >= this->band->rx2.drMin && macRx2Dr <= this->band->rx2.drMax) {
+    if(this->band->dataRates[macRx2Dr] != RADIOLIB_LORAWAN_DATA_RATE_UNUSED) {
+      if(this->findDataRate(macRx2Dr, &dr) == RADIOLIB_ERR_NONE) {
+        rx2DrAck = 1;
       }
+    }
+  }
+  if(macRx2Freq >= this->band->freqMin && macRx2Freq <= this->band->freqMax) {
+    if(this->phyLayer->setFrequency(macRx2Freq / 10000.0) == RADIOLIB_ERR_NONE) {
+      rx2FreqAck = 1;
+    }
+  }
+  optOut[0] = (rx1DrOsAck << 2) | (rx2DrAck << 1) | (rx2FreqAck << 0);
+
+  // if not fully acknowledged, return now without applying the requested configuration
+  if(optOut[0] != 0x07) {
+    return(true);
+  }
 
-      // set ACK bits
-      optOut[0] = (freqUlAck << 1) | (freqDlAck << 0);
+  // passed ACK, so apply configuration
+  this->rx1DrOffset = macRx1DrOffset;
+  this->channels[RADIOLIB_LORAWAN_DIR_RX2].dr = macRx2Dr;
+  this->channels[RADIOLIB_LORAWAN_DIR_RX2].freq = macRx2Freq;
+  memcpy(&this->bufferSession[RADIOLIB_LORAWAN_SESSION_RX_PARAM_SETUP], optIn, lenIn);
 
-      // if not fully acknowledged, return now without applying the requested configuration
-      if(optOut[0] != 0x03) {
-        return(true);
-      }
+  return(true);
+}
 
-      // ACK successful, so apply and save
-      this->channelPlan[RADIOLIB_LORAWAN_DOWNLINK][macChIndex].freq = macFreq;
+bool LoRaWANNode::execMacDevStatus(uint8_t* optIn, uint8_t lenIn, uint8_t* optOut) {
+  (void)optIn;
+  (void)lenIn;
 
-      memcpy(&this->bufferSession[RADIOLIB_LORAWAN_SESSION_DL_CHANNELS] + macChIndex * lenIn, optIn, lenIn);
+  // set the uplink reply
+  optOut[0] = this->battLevel;
+  int8_t snr = this->phyLayer->getSNR();
+  optOut[1] = snr & 0x3F;
 
-      return(true);
-    } break;
+  RADIOLIB_DEBUG_PROTOCOL_PRINTLN("DevStatusAns: status = 0x%02x%02x", optOut[0], optOut[1]);
+  return(true);
+}
 
-    case(RADIOLIB_LORAWAN_MAC_RX_TIMING_SETUP): {
-      // get the configuration
-      uint8_t delay = optIn[0] & 0x0F;
-      RADIOLIB_DEBUG_PROTOCOL_PRINTLN("RXTimingSetupReq: delay = %d sec", delay);
-      
-      // apply the configuration
-      if(delay == 0) {
-        delay = 1;
-      }
-      this->rxDelays[1] = delay * 1000;               // Rx1 delay
-      this->rxDelays[2] = this->rxDelays[1] + 1000;   // Rx2 delay
+bool LoRaWANNode::execMacNewChannel(uint8_t* optIn, uint8_t lenIn, uint8_t* optOut) {
+  (void)lenIn;
 
-      memcpy(&this->bufferSession[RADIOLIB_LORAWAN_SESSION_RX_TIMING_SETUP], optIn, lenIn);
+  // only implemented on dynamic bands
+  if(this->band->bandType == RADIOLIB_LORAWAN_BAND_FIXED) {
+    return(false);
+  }
 
-      return(true);
-    } break;
+  // get the configuration
+  uint8_t macChIndex = optIn[0];
+  uint32_t macFreq = LoRaWANNode::ntoh<uint32_t>(&optIn[1], 3);
+  uint8_t macDrMax = (optIn[4] & 0xF0) >> 4;
+  uint8_t macDrMin = optIn[4] & 0x0F;
+  
+  uint8_t drAck = 0;
+  uint8_t freqAck = 0;
 
-    case(RADIOLIB_LORAWAN_MAC_TX_PARAM_SETUP): {
-      // TxParamSetupReq is only supported on a subset of bands
-      // in other bands, silently ignore without response
-      if(!this->band->txParamSupported) {
-        return(false);
-      }
-      uint8_t dlDwell = (optIn[0] & 0x20) >> 5;
-      uint8_t ulDwell = (optIn[0] & 0x10) >> 4;
-      uint8_t maxEirpRaw = optIn[0] & 0x0F;
+  // the default channels shall not be modified, so check if this is a default channel
+  // if the channel index is set, this channel is defined, so return a NACK
+  if(macChIndex < 3 && this->band->txFreqs[macChIndex].idx != RADIOLIB_LORAWAN_CHANNEL_INDEX_NONE) {
+    optOut[0] = 0;
+    return(true);
+  }
 
-      // who the f came up with this ...
-      const uint8_t eirpEncoding[] = { 8, 10, 12, 13, 14, 16, 18, 20, 21, 24, 26, 27, 29, 30, 33, 36 };
-      this->txPowerMax = eirpEncoding[maxEirpRaw];
-      RADIOLIB_DEBUG_PROTOCOL_PRINTLN("TxParamSetupReq: dlDwell = %d, ulDwell = %d, maxEirp = %d dBm", dlDwell, ulDwell, eirpEncoding[maxEirpRaw]);
+  // check if the outermost datarates are defined and if the device supports them
+  DataRate_t dr;
+  if(this->band->dataRates[macDrMin] != RADIOLIB_LORAWAN_DATA_RATE_UNUSED && this->findDataRate(macDrMin, &dr) == RADIOLIB_ERR_NONE) {
+    if(this->band->dataRates[macDrMax] != RADIOLIB_LORAWAN_DATA_RATE_UNUSED && this->findDataRate(macDrMax, &dr) == RADIOLIB_ERR_NONE) {
+      drAck = 1;
+    }
+  }
 
-      this->dwellTimeEnabledUp = ulDwell ? true : false;
-      this->dwellTimeUp = ulDwell ? RADIOLIB_LORAWAN_DWELL_TIME : 0;
+  // check if the frequency is allowed and possible
+  if(macFreq >= this->band->freqMin && macFreq <= this->band->freqMax) {
+    if(this->phyLayer->setFrequency((float)macFreq / 10000.0) == RADIOLIB_ERR_NONE) {
+      freqAck = 1;
+    }
+  // otherwise, if frequency is 0, disable the channel which is also a valid option
+  } else if(macFreq == 0) {
+    freqAck = 1;
+  }
 
-      this->dwellTimeEnabledDn = dlDwell ? true : false;
-      this->dwellTimeDn = dlDwell ? RADIOLIB_LORAWAN_DWELL_TIME : 0;
+  // set ACK bits
+  optOut[0] = (drAck << 1) | (freqAck << 0);
 
-      memcpy(&this->bufferSession[RADIOLIB_LORAWAN_SESSION_TX_PARAM_SETUP], optIn, lenIn);
+  // if not fully acknowledged, return now without applying the requested configuration
+  if(optOut[0] != 0x03) {
+    return(true);
+  }
 
-      return(true);
-    } break;
+  // ACK successful, so apply and save
+  if(macFreq > 0) {
+    this->channelPlan[RADIOLIB_LORAWAN_UPLINK][macChIndex].enabled   = true;
+    this->channelPlan[RADIOLIB_LORAWAN_UPLINK][macChIndex].idx       = macChIndex;
+    this->channelPlan[RADIOLIB_LORAWAN_UPLINK][macChIndex].freq      = macFreq;
+    this->channelPlan[RADIOLIB_LORAWAN_UPLINK][macChIndex].drMin     = macDrMin;
+    this->channelPlan[RADIOLIB_LORAWAN_UPLINK][macChIndex].drMax     = macDrMax;
+    this->channelPlan[RADIOLIB_LORAWAN_UPLINK][macChIndex].available = true;
+    // downlink channel is identical to uplink channel
+    this->channelPlan[RADIOLIB_LORAWAN_DOWNLINK][macChIndex] = this->channelPlan[RADIOLIB_LORAWAN_UPLINK][macChIndex];
+  } else {
+    this->channelPlan[RADIOLIB_LORAWAN_UPLINK][macChIndex] = RADIOLIB_LORAWAN_CHANNEL_NONE;
+    this->channelPlan[RADIOLIB_LORAWAN_DOWNLINK][macChIndex] = RADIOLIB_LORAWAN_CHANNEL_NONE;
 
-    case(RADIOLIB_LORAWAN_MAC_REKEY): {
-      // get the server version
-      uint8_t srvVersion = optIn[0];
-      RADIOLIB_DEBUG_PROTOCOL_PRINTLN("RekeyConf: server version = 1.%d", srvVersion);
+  }
 
-      // If the server’s version is invalid the device SHALL discard the RekeyConf command and retransmit the RekeyInd in the next uplink frame
-      if((srvVersion > 0) && (srvVersion <= this->rev)) {
-        // valid server version, accept
-        this->rev = srvVersion;
-        
-      } else {
-        // if not a valid server version, retransmit RekeyInd
-        uint8_t cLen = 0;
-        this->getMacLen(cid, &cLen, RADIOLIB_LORAWAN_UPLINK);
-        uint8_t cOcts[1] = { this->rev };
-        (void)LoRaWANNode::pushMacCommand(cid, cOcts, this->fOptsUp, &this->fOptsUpLen, RADIOLIB_LORAWAN_UPLINK);
-        
-        // discard RekeyConf, therefore return false so it doesn't send a reply
-        return(false);
-      }
+  RADIOLIB_DEBUG_PROTOCOL_PRINTLN("UL: %3d %d %7.3f (%d - %d) | DL: %3d %d %7.3f (%d - %d)", 
+                          this->channelPlan[RADIOLIB_LORAWAN_UPLINK][macChIndex].idx,
+                          this->channelPlan[RADIOLIB_LORAWAN_UPLINK][macChIndex].enabled,
+                          this->channelPlan[RADIOLIB_LORAWAN_UPLINK][macChIndex].freq / 10000.0,
+                          this->channelPlan[RADIOLIB_LORAWAN_UPLINK][macChIndex].drMin,
+                          this->channelPlan[RADIOLIB_LORAWAN_UPLINK][macChIndex].drMax,
 
-      optOut[0] = this->rev;
+                          this->channelPlan[RADIOLIB_LORAWAN_DOWNLINK][macChIndex].idx,
+                          this->channelPlan[RADIOLIB_LORAWAN_DOWNLINK][macChIndex].enabled,
+                          this->channelPlan[RADIOLIB_LORAWAN_DOWNLINK][macChIndex].freq / 10000.0,
+                          this->channelPlan[RADIOLIB_LORAWAN_DOWNLINK][macChIndex].drMin,
+                          this->channelPlan[RADIOLIB_LORAWAN_DOWNLINK][macChIndex].drMax
+                        );
 
-      LoRaWANNode::hton<uint8_t>(&this->bufferSession[RADIOLIB_LORAWAN_SESSION_VERSION], this->rev);
-      return(false);
-    } break;
+  memcpy(&this->bufferSession[RADIOLIB_LORAWAN_SESSION_UL_CHANNELS] + macChIndex * RADIOLIB_LORAWAN_SESSION_UL_CHANNEL_LEN, 
+         &optIn[1], RADIOLIB_LORAWAN_SESSION_UL_CHANNEL_LEN);
 
-    case(RADIOLIB_LORAWAN_MAC_ADR_PARAM_SETUP): {
-      this->adrLimitExp = (optIn[0] & 0xF0) >> 4;
-      this->adrDelayExp = optIn[0] & 0x0F;
-      RADIOLIB_DEBUG_PROTOCOL_PRINTLN("ADRParamSetupReq: limitExp = %d, delayExp = %d", this->adrLimitExp, this->adrDelayExp);
+  return(true);
+}
 
-      memcpy(&this->bufferSession[RADIOLIB_LORAWAN_SESSION_ADR_PARAM_SETUP], optIn, lenIn);
+bool LoRaWANNode::execMacRxTimingSetup(uint8_t* optIn, uint8_t lenIn, uint8_t* optOut) {
+  (void)optOut;
 
-      return(true);
-    } break;
+  // get the configuration
+  uint8_t delay = optIn[0] & 0x0F;
+  RADIOLIB_DEBUG_PROTOCOL_PRINTLN("RXTimingSetupReq: delay = %d sec", delay);
+  
+  // apply the configuration
+  if(delay == 0) {
+    delay = 1;
+  }
+  this->rxDelays[1] = delay * 1000;               // Rx1 delay
+  this->rxDelays[2] = this->rxDelays[1] + 1000;   // Rx2 delay
 
-    case(RADIOLIB_LORAWAN_MAC_DEVICE_TIME): {
-      RADIOLIB_DEBUG_PROTOCOL_PRINTLN("DeviceTimeAns: [user]");
+  memcpy(&this->bufferSession[RADIOLIB_LORAWAN_SESSION_RX_TIMING_SETUP], optIn, lenIn);
 
-      return(false);
-    } break;
+  return(true);
+}
 
-    case(RADIOLIB_LORAWAN_MAC_FORCE_REJOIN): {
-      // TODO implement this
-      uint16_t rejoinReq = LoRaWANNode::ntoh<uint16_t>(optIn);
-      uint8_t period = (rejoinReq & 0x3800) >> 11;
-      uint8_t maxRetries = (rejoinReq & 0x0700) >> 8;
-      uint8_t rejoinType = (rejoinReq & 0x0070) >> 4;
-      uint8_t dr = rejoinReq & 0x000F;
-      RADIOLIB_DEBUG_PROTOCOL_PRINTLN("ForceRejoinReq: period = %d, maxRetries = %d, rejoinType = %d, dr = %d", period, maxRetries, rejoinType, dr);
-      (void)period;
-      (void)maxRetries;
-      (void)rejoinType;
-      (void)dr;
-      return(false);
-    } break;
+bool LoRaWANNode::execMacTxParamSetup(uint8_t* optIn, uint8_t lenIn, uint8_t* optOut) {
+  (void)optOut;
 
-    case(RADIOLIB_LORAWAN_MAC_REJOIN_PARAM_SETUP): {
-      // TODO implement this
-      uint8_t maxTime = (optIn[0] & 0xF0) >> 4;
-      uint8_t maxCount = optIn[0] & 0x0F;
-      RADIOLIB_DEBUG_PROTOCOL_PRINTLN("RejoinParamSetupReq: maxTime = %d, maxCount = %d", maxTime, maxCount);
+  // TxParamSetupReq is only supported on a subset of bands
+  // in other bands, silently ignore without response
+  if(!this->band->txParamSupported) {
+    return(false);
+  }
+  uint8_t dlDwell = (optIn[0] & 0x20) >> 5;
+  uint8_t ulDwell = (optIn[0] & 0x10) >> 4;
+  uint8_t maxEirpRaw = optIn[0] & 0x0F;
 
-      memcpy(&this->bufferSession[RADIOLIB_LORAWAN_SESSION_REJOIN_PARAM_SETUP], optIn, lenIn);
+  // who the f came up with this ...
+  const uint8_t eirpEncoding[] = { 8, 10, 12, 13, 14, 16, 18, 20, 21, 24, 26, 27, 29, 30, 33, 36 };
+  this->txPowerMax = eirpEncoding[maxEirpRaw];
+  RADIOLIB_DEBUG_PROTOCOL_PRINTLN("TxParamSetupReq: dlDwell = %d, ulDwell = %d, maxEirp = %d dBm", dlDwell, ulDwell, eirpEncoding[maxEirpRaw]);
 
-      lenIn = 0;
-      optIn[0] = (1 << 1) | 1;
+  this->dwellTimeEnabledUp = ulDwell ? true : false;
+  this->dwellTimeUp = ulDwell ? RADIOLIB_LORAWAN_DWELL_TIME : 0;
 
-      (void)maxTime;
-      (void)maxCount;
-      return(true);
-    } break;
+  this->dwellTimeEnabledDn = dlDwell ? true : false;
+  this->dwellTimeDn = dlDwell ? RADIOLIB_LORAWAN_DWELL_TIME : 0;
 
-    default: {
-      // derived classes may implement additional MAC commands
-      return(derivedMacHandler(cid, optIn, lenIn, optOut));
+  memcpy(&this->bufferSession[RADIOLIB_LORAWAN_SESSION_TX_PARAM_SETUP], optIn, lenIn);
+
+  return(true);
+}
+
+bool LoRaWANNode::execMacDlChannel(uint8_t* optIn, uint8_t lenIn, uint8_t* optOut) {
+  (void)lenIn;
+
+  // only implemented on dynamic bands
+  if(this->band->bandType == RADIOLIB_LORAWAN_BAND_FIXED) {
+    return(false);
+  }
+
+  // get the configuration
+  uint8_t macChIndex = optIn[0];
+  uint32_t macFreq = LoRaWANNode::ntoh<uint32_t>(&optIn[1], 3);
+  RADIOLIB_DEBUG_PROTOCOL_PRINTLN("DlChannelReq: index = %d, freq = %7.3f MHz", macChIndex, macFreq / 10000.0);
+  uint8_t freqDlAck = 0;
+  uint8_t freqUlAck = 0;
+  
+  // check if the frequency is allowed possible
+  if(macFreq >= this->band->freqMin && macFreq <= this->band->freqMax) { 
+    if(this->phyLayer->setFrequency(macFreq / 10000.0) == RADIOLIB_ERR_NONE) {
+      freqDlAck = 1;
     }
   }
+  
+  // check if the corresponding uplink frequency is actually set
+  if(this->channelPlan[RADIOLIB_LORAWAN_UPLINK][macChIndex].freq > 0) {
+    freqUlAck = 1;
+  }
+
+  // set ACK bits
+  optOut[0] = (freqUlAck << 1) | (freqDlAck << 0);
+
+  // if not fully acknowledged, return now without applying the requested configuration
+  if(optOut[0] != 0x03) {
+    return(true);
+  }
+
+  // ACK successful, so apply and save
+  this->channelPlan[RADIOLIB_LORAWAN_DOWNLINK][macChIndex].freq = macFreq;
+
+  memcpy(&this->bufferSession[RADIOLIB_LORAWAN_SESSION_DL_CHANNELS] + macChIndex * RADIOLIB_LORAWAN_SESSION_DL_CHANNEL_LEN, 
+         &optIn[1], RADIOLIB_LORAWAN_SESSION_DL_CHANNEL_LEN);
+
+  return(true);
+}
+
+bool LoRaWANNode::execMacRekey(uint8_t* optIn, uint8_t lenIn, uint8_t* optOut) {
+  (void)lenIn;
+
+  // get the server version
+  uint8_t srvVersion = optIn[0];
+  RADIOLIB_DEBUG_PROTOCOL_PRINTLN("RekeyConf: server version = 1.%d", srvVersion);
+
+  // If the server’s version is invalid the device SHALL discard the RekeyConf command and retransmit the RekeyInd in the next uplink frame
+  if((srvVersion > 0) && (srvVersion <= this->rev)) {
+    // valid server version, accept
+    this->rev = srvVersion;
+    
+  } else {
+    // if not a valid server version, retransmit RekeyInd
+    uint8_t cLen = 0;
+    this->getMacLen(RADIOLIB_LORAWAN_MAC_REKEY, &cLen, RADIOLIB_LORAWAN_UPLINK);
+    uint8_t cOcts[1] = { this->rev };
+    (void)LoRaWANNode::pushMacCommand(RADIOLIB_LORAWAN_MAC_REKEY, cOcts, this->fOptsUp, &this->fOptsUpLen, RADIOLIB_LORAWAN_UPLINK);
+    
+    // discard RekeyConf, therefore return false so it doesn't send a reply
+    return(false);
+  }
+
+  optOut[0] = this->rev;
 
+  LoRaWANNode::hton<uint8_t>(&this->bufferSession[RADIOLIB_LORAWAN_SESSION_VERSION], this->rev);
+  return(false);
+}
+
+bool LoRaWANNode::execMacAdrParamSetup(uint8_t* optIn, uint8_t lenIn, uint8_t* optOut) {
+  (void)optOut;
+
+  this->adrLimitExp = (optIn[0] & 0xF0) >> 4;
+  this->adrDelayExp = optIn[0] & 0x0F;
+  RADIOLIB_DEBUG_PROTOCOL_PRINTLN("ADRParamSetupReq: limitExp = %d, delayExp = %d", this->adrLimitExp, this->adrDelayExp);
+
+  memcpy(&this->bufferSession[RADIOLIB_LORAWAN_SESSION_ADR_PARAM_SETUP], optIn, lenIn);
+
+  return(true);
+}
+
+bool LoRaWANNode::execMacDeviceTime(uint8_t* optIn, uint8_t lenIn, uint8_t* optOut) {
+  (void)lenIn;
+  (void)optOut;
+
+  RADIOLIB_DEBUG_PROTOCOL_PRINTLN("DeviceTimeAns: [user]");
+
+  // keep the answer available for the user, but also use it to synchronize the internal clock
+  this->syncNetworkTime(LoRaWANNode::ntoh<uint32_t>(&optIn[0]), optIn[4]);
+  return(false);
+}
+
+bool LoRaWANNode::execMacForceRejoin(uint8_t* optIn, uint8_t lenIn, uint8_t* optOut) {
+  (void)lenIn;
+  (void)optOut;
+
+  uint16_t rejoinReq = LoRaWANNode::ntoh<uint16_t>(optIn);
+  uint8_t period = (rejoinReq & 0x3800) >> 11;
+  uint8_t maxRetries = (rejoinReq & 0x0700) >> 8;
+  uint8_t rejoinType = (rejoinReq & 0x0070) >> 4;
+  uint8_t dr = rejoinReq & 0x000F;
+  RADIOLIB_DEBUG_PROTOCOL_PRINTLN("ForceRejoinReq: period = %d, maxRetries = %d, rejoinType = %d, dr = %d", period, maxRetries, rejoinType, dr);
+
+  // the RejoinRequests are sent by rejoinIfDue, the first one as soon as possible
+  // RejoinType 0 and 1 both request a RejoinRequest type 0
+  this->forceRejoinType = (rejoinType == 2) ? RADIOLIB_LORAWAN_JOIN_REQUEST_TYPE_2 : RADIOLIB_LORAWAN_JOIN_REQUEST_TYPE_0;
+  this->forceRejoinDr = dr;
+  this->forceRejoinPeriod = period;
+  this->forceRejoinRetries = maxRetries + 1;
+  this->forceRejoinDelay = 0;
   return(false);
 }
 
+bool LoRaWANNode::execMacRejoinParamSetup(uint8_t* optIn, uint8_t lenIn, uint8_t* optOut) {
+  this->rejoinMaxTimeN = (optIn[0] & 0xF0) >> 4;
+  this->rejoinMaxCountN = optIn[0] & 0x0F;
+  RADIOLIB_DEBUG_PROTOCOL_PRINTLN("RejoinParamSetupReq: maxTime = %d, maxCount = %d", this->rejoinMaxTimeN, this->rejoinMaxCountN);
+
+  memcpy(&this->bufferSession[RADIOLIB_LORAWAN_SESSION_REJOIN_PARAM_SETUP], optIn, lenIn);
+
+  // the time limit is supported
+  optOut[0] = (1 << 0);
+  return(true);
+}
+
 bool LoRaWANNode::derivedMacHandler(uint8_t cid, uint8_t* optIn, uint8_t lenIn, uint8_t* optOut) {
   (void)cid;
   (void)optIn;
@@ -2345,12 +4630,12 @@ void LoRaWANNode::preprocessMacLinkAdr(uint8_t* mPtr, uint8_t cLen, uint8_t* mAd
           int bank = 0;
           for(; bank < 8; bank++) {
             if(chMask & ((uint16_t)1 << bank)) {
-              chMaskGrp0123 |= (0xFF << (8 * bank));
+              chMaskGrp0123 |= ((uint64_t)0xFF << (8 * bank));
             }
           }
           for(; bank < 10; bank++) {
             if(chMask & ((uint16_t)1 << bank)) {
-              chMaskGrp45 |= (0xFF << (8 * (bank - 8)));
+              chMaskGrp45 |= ((uint32_t)0xFF << (8 * (bank - 8)));
             }
           }
         }
@@ -2361,10 +4646,15 @@ void LoRaWANNode::preprocessMacLinkAdr(uint8_t* mPtr, uint8_t cLen, uint8_t* mAd
         // except for CN500:  all 125kHz channels ON
 
         // for dynamic bands: retrieve all currently defined channels
-        // for fixed bands:   cannot store all defined channels, so select a random one from each bank
-        this->getChannelPlanMask(&chMaskGrp0123, &chMaskGrp45);
-        if(this->band->bandType == RADIOLIB_LORAWAN_BAND_FIXED && this->band->bandNum != BandCN500) {
+        // for fixed bands:   enable the full mask, channels that do not exist in the band are dropped later
+        if(this->band->bandType == RADIOLIB_LORAWAN_BAND_DYNAMIC) {
+          this->getChannelPlanMask(&chMaskGrp0123, &chMaskGrp45);
+        } else if(this->band->bandNum != BandCN500) {
+          chMaskGrp0123 = ~(uint64_t)0;
           chMaskGrp45 |= (uint32_t)chMask;
+        } else {
+          chMaskGrp0123 = ~(uint64_t)0;
+          chMaskGrp45 = ~(uint32_t)0;
         }
         break;
       case 7:
@@ -2394,7 +4684,24 @@ void LoRaWANNode::postprocessMacLinkAdr(uint8_t* ack, uint8_t cLen) {
   }
 }
 
+LoRaWANCustomMacCommand_t* LoRaWANNode::findCustomMacCommand(uint8_t cid) {
+  for(size_t i = 0; i < RADIOLIB_LORAWAN_NUM_CUSTOM_MAC_COMMANDS; i++) {
+    if((this->customMacCommands[i].cid == cid) && (cid != 0)) {
+      return(&this->customMacCommands[i]);
+    }
+  }
+  return(NULL);
+}
+
 int16_t LoRaWANNode::getMacCommand(uint8_t cid, LoRaWANMacCommand_t* cmd) {
+  // registered proprietary commands take precedence over the generic proprietary entry
+  LoRaWANCustomMacCommand_t* custom = this->findCustomMacCommand(cid);
+  if(custom) {
+    LoRaWANMacCommand_t customCmd = { .cid = cid, .lenDn = custom->lenDn, .lenUp = custom->lenUp, .persist = false, .user = true };
+    memcpy((void*)cmd, (void*)&customCmd, sizeof(LoRaWANMacCommand_t));
+    return(RADIOLIB_ERR_NONE);
+  }
+
   for(size_t i = 0; i < RADIOLIB_LORAWAN_NUM_MAC_COMMANDS; i++) {
     if(MacTable[i].cid == cid) {
       memcpy((void*)cmd, (void*)&MacTable[i], sizeof(LoRaWANMacCommand_t));
@@ -2409,10 +4716,11 @@ int16_t LoRaWANNode::getMacCommand(uint8_t cid, LoRaWANMacCommand_t* cmd) {
 int16_t LoRaWANNode::derivedMacFinder(uint8_t cid, LoRaWANMacCommand_t* cmd) {
   (void)cid;
   (void)cmd;
+
   return(RADIOLIB_ERR_INVALID_CID);
 }
 
-int16_t LoRaWANNode::sendMacCommandReq(uint8_t cid) {
+int16_t LoRaWANNode::sendMacCommandReq(uint8_t cid, const uint8_t* payload) {
   LoRaWANMacCommand_t cmd = RADIOLIB_LORAWAN_MAC_COMMAND_NONE;
   int16_t state = this->getMacCommand(cid, &cmd);
   RADIOLIB_ASSERT(state);
@@ -2420,6 +4728,9 @@ int16_t LoRaWANNode::sendMacCommandReq(uint8_t cid) {
     RADIOLIB_DEBUG_PROTOCOL_PRINTLN("You are not allowed to request this MAC command");
     return(RADIOLIB_ERR_INVALID_CID);
   }
+  if((cmd.lenUp > 0) && !payload) {
+    return(RADIOLIB_ERR_NULL_POINTER);
+  }
 
   // if there are already 15 MAC bytes in the uplink queue, we can't add a new one
   if(fOptsUpLen >= RADIOLIB_LORAWAN_FHDR_FOPTS_MAX_LEN) {
@@ -2432,10 +4743,50 @@ int16_t LoRaWANNode::sendMacCommandReq(uint8_t cid) {
     return(RADIOLIB_ERR_NONE);
   }
 
-  state = LoRaWANNode::pushMacCommand(cid, NULL, this->fOptsUp, &this->fOptsUpLen, RADIOLIB_LORAWAN_UPLINK);
+  state = LoRaWANNode::pushMacCommand(cid, (uint8_t*)payload, this->fOptsUp, &this->fOptsUpLen, RADIOLIB_LORAWAN_UPLINK);
   return(state);
 }
 
+int16_t LoRaWANNode::setMacCommandHandler(uint8_t cid, uint8_t lenDn, uint8_t lenUp, LoRaWANMacCommandCb_t cb) {
+  if(cid < RADIOLIB_LORAWAN_MAC_PROPRIETARY) {
+    return(RADIOLIB_ERR_INVALID_CID);
+  }
+
+  // the command including its ID must fit into FOpts in both directions
+  if((lenDn >= RADIOLIB_LORAWAN_FHDR_FOPTS_MAX_LEN) || (lenUp >= RADIOLIB_LORAWAN_FHDR_FOPTS_MAX_LEN)) {
+    return(RADIOLIB_ERR_INVALID_CID);
+  }
+
+  // update the existing entry, or take the first free one
+  LoRaWANCustomMacCommand_t* custom = this->findCustomMacCommand(cid);
+  if(!custom) {
+    for(size_t i = 0; i < RADIOLIB_LORAWAN_NUM_CUSTOM_MAC_COMMANDS; i++) {
+      if(this->customMacCommands[i].cid == 0) {
+        custom = &this->customMacCommands[i];
+        break;
+      }
+    }
+  }
+  if(!custom) {
+    return(RADIOLIB_ERR_MAC_COMMAND_REGISTRY_FULL);
+  }
+
+  custom->cid = cid;
+  custom->lenDn = lenDn;
+  custom->lenUp = lenUp;
+  custom->cb = cb;
+  return(RADIOLIB_ERR_NONE);
+}
+
+int16_t LoRaWANNode::clearMacCommandHandler(uint8_t cid) {
+  LoRaWANCustomMacCommand_t* custom = this->findCustomMacCommand(cid);
+  if(!custom) {
+    return(RADIOLIB_ERR_COMMAND_QUEUE_ITEM_NOT_FOUND);
+  }
+  memset(custom, 0, sizeof(LoRaWANCustomMacCommand_t));
+  return(RADIOLIB_ERR_NONE);
+}
+
 int16_t LoRaWANNode::getMacLinkCheckAns(uint8_t* margin, uint8_t* gwCnt) {
   uint8_t payload[2] = { 0 };
   int16_t state = this->getMacPayload(RADIOLIB_LORAWAN_MAC_LINK_CHECK, this->fOptsDown, fOptsDownLen, payload, RADIOLIB_LORAWAN_DOWNLINK);
@@ -2455,8 +4806,7 @@ int16_t LoRaWANNode::getMacDeviceTimeAns(uint32_t* gpsEpoch, uint8_t* fraction,
   if(gpsEpoch) { 
     *gpsEpoch = LoRaWANNode::ntoh<uint32_t>(&payload[0]); 
     if(returnUnix) {
-      uint32_t unixOffset = 315964800UL - 18UL; // 18 leap seconds since GPS epoch (Jan. 6th 1980)
-      *gpsEpoch += unixOffset;
+      *gpsEpoch += RADIOLIB_LORAWAN_GPS_UNIX_OFFSET;
     }
   }
   if(fraction) { *fraction = payload[4]; }
@@ -2598,17 +4948,7 @@ void LoRaWANNode::clearMacCommands(uint8_t* inOut, uint8_t* lenInOut, uint8_t di
 
 int16_t LoRaWANNode::setDatarate(uint8_t drUp) {
   // scan through all enabled channels and check if the requested datarate is available
-  bool isValidDR = false;
-  for(size_t i = 0; i < RADIOLIB_LORAWAN_NUM_AVAILABLE_CHANNELS; i++) {
-    LoRaWANChannel_t *chnl = &(this->channelPlan[RADIOLIB_LORAWAN_UPLINK][i]);
-    if(chnl->enabled) {
-      if(drUp >= chnl->drMin && drUp <= chnl->drMax) {
-        isValidDR = true;
-        break;
-      }
-    }
-  }
-  if(!isValidDR) {
+  if(!this->isValidDatarate(drUp)) {
     RADIOLIB_DEBUG_PROTOCOL_PRINTLN("No defined channel allows datarate %d", drUp);
     return(RADIOLIB_ERR_INVALID_DATA_RATE);
   }
@@ -2686,6 +5026,18 @@ void LoRaWANNode::setADR(bool enable) {
   this->adrEnabled = enable;
 }
 
+void LoRaWANNode::setAdaptiveUplink(bool enable, uint8_t marginTarget, uint8_t linkCheckPeriod, uint8_t asymmetry) {
+  this->adaptiveEnabled = enable;
+  this->adaptiveMarginTarget = marginTarget;
+  this->adaptiveLinkCheckPeriod = linkCheckPeriod;
+  this->adaptiveAsymmetry = asymmetry;
+
+  // request the link margin in the first uplink
+  this->adaptiveFCnt = this->fCntUp - linkCheckPeriod;
+  this->adaptiveMargin = RADIOLIB_LORAWAN_ADAPTIVE_MARGIN_NONE;
+  this->adaptiveGwCnt = 0;
+}
+
 void LoRaWANNode::setDutyCycle(bool enable, RadioLibTime_t msPerHour) {
   this->dutyCycleEnabled = enable;
   if(!enable) {
@@ -2731,6 +5083,108 @@ void LoRaWANNode::scheduleTransmission(RadioLibTime_t tUplink) {
   this->tUplink = tUplink;
 }
 
+int16_t LoRaWANNode::getNetworkTime(uint32_t* gpsEpoch, uint16_t* ms, bool returnUnix) {
+  if(this->timeSyncGps == 0) {
+    return(RADIOLIB_ERR_NO_NETWORK_TIME);
+  }
+
+  uint64_t tNetwork = this->localToNetworkTime(this->phyLayer->getMod()->hal->millis());
+  if(gpsEpoch) {
+    *gpsEpoch = tNetwork / 1000;
+    if(returnUnix) {
+      *gpsEpoch += RADIOLIB_LORAWAN_GPS_UNIX_OFFSET;
+    }
+  }
+  if(ms) {
+    *ms = tNetwork % 1000;
+  }
+  return(RADIOLIB_ERR_NONE);
+}
+
+int16_t LoRaWANNode::scheduleTransmissionGps(uint32_t gpsEpoch, uint16_t ms) {
+  if(this->timeSyncGps == 0) {
+    return(RADIOLIB_ERR_NO_NETWORK_TIME);
+  }
+
+  this->tUplink = this->networkToLocalTime((uint64_t)gpsEpoch*1000 + ms);
+  return(RADIOLIB_ERR_NONE);
+}
+
+int16_t LoRaWANNode::scheduleTransmissionSlot(uint32_t period, uint32_t window, RadioLibTime_t slotLen) {
+  if(this->timeSyncGps == 0) {
+    return(RADIOLIB_ERR_NO_NETWORK_TIME);
+  }
+  period = RADIOLIB_MAX(period, (uint32_t)1);
+  if((window == 0) || (window > period)) {
+    window = period;
+  }
+
+  // by default, slots fit the last uplink with some margin for the clock error between devices
+  if(slotLen == 0) {
+    slotLen = this->lastToA + RADIOLIB_LORAWAN_SLOT_GUARD_MS;
+  }
+  uint32_t numSlots = RADIOLIB_MAX(((uint64_t)window * 1000) / slotLen, (uint64_t)1);
+
+  uint64_t tNow = this->localToNetworkTime(this->phyLayer->getMod()->hal->millis());
+  uint64_t periodMs = (uint64_t)period * 1000;
+  uint32_t num = tNow / periodMs;
+  uint64_t tSlot = 0;
+
+  // use the slot in the current period if it is still ahead, otherwise the one in the next period
+  for(uint8_t i = 0; i < 2; i++, num++) {
+    // mix the DevAddr with the period number, so that slots are spread uniformly and change every period
+    uint32_t hash = this->devAddr ^ (num * 0x9E3779B9UL);
+    hash ^= hash >> 16;
+    hash *= 0x85EBCA6BUL;
+    hash ^= hash >> 13;
+    hash *= 0xC2B2AE35UL;
+    hash ^= hash >> 16;
+
+    tSlot = (uint64_t)num * periodMs + (uint64_t)(hash % numSlots) * slotLen;
+    if(tSlot > tNow) {
+      break;
+    }
+  }
+
+  RADIOLIB_DEBUG_PROTOCOL_PRINTLN("Uplink slot at GPS time %lu.%03u", (unsigned long)(tSlot / 1000), (unsigned int)(tSlot % 1000));
+  this->tUplink = this->networkToLocalTime(tSlot);
+  return(RADIOLIB_ERR_NONE);
+}
+
+void LoRaWANNode::syncNetworkTime(uint32_t gpsEpoch, uint8_t fraction) {
+  // the network time applies to the end of the uplink that carried the DeviceTimeReq
+  // so find the internal clock time at which this GPS second started
+  RadioLibTime_t tLocal = this->rxDelayStart - ((RadioLibTime_t)fraction * 1000) / 256;
+
+  // with a previous synchronization long enough ago, estimate how fast the internal clock runs
+  if(this->timeSyncGps != 0) {
+    int64_t elapsedLocal = (int64_t)(RadioLibTime_t)(tLocal - this->timeSyncLocal);
+    int64_t elapsedNetwork = ((int64_t)gpsEpoch - (int64_t)this->timeSyncGps) * 1000;
+    if(elapsedLocal >= (int64_t)RADIOLIB_LORAWAN_TIME_SYNC_DRIFT_MIN_MS) {
+      int64_t drift = ((elapsedNetwork - elapsedLocal) * 1000000) / elapsedLocal;
+      if((drift <= RADIOLIB_LORAWAN_TIME_SYNC_DRIFT_MAX_PPM) && (drift >= -RADIOLIB_LORAWAN_TIME_SYNC_DRIFT_MAX_PPM)) {
+        this->timeSyncDrift = (int32_t)drift;
+      }
+    }
+  }
+
+  this->timeSyncGps = gpsEpoch;
+  this->timeSyncLocal = tLocal;
+  RADIOLIB_DEBUG_PROTOCOL_PRINTLN("Network time synchronized, drift %ld ppm", (long)this->timeSyncDrift);
+}
+
+uint64_t LoRaWANNode::localToNetworkTime(RadioLibTime_t tLocal) {
+  int64_t elapsed = (int64_t)(RadioLibTime_t)(tLocal - this->timeSyncLocal);
+  elapsed += (elapsed * this->timeSyncDrift) / 1000000;
+  return((uint64_t)this->timeSyncGps * 1000 + elapsed);
+}
+
+RadioLibTime_t LoRaWANNode::networkToLocalTime(uint64_t tNetwork) {
+  int64_t elapsed = (int64_t)tNetwork - (int64_t)this->timeSyncGps * 1000;
+  elapsed -= (elapsed * this->timeSyncDrift) / (1000000 + this->timeSyncDrift);
+  return(this->timeSyncLocal + (RadioLibTime_t)elapsed);
+}
+
 // return fCnt of last uplink; also return 0 if no uplink occured yet
 uint32_t LoRaWANNode::getFCntUp() {
   if(this->fCntUp == 0) {
@@ -2760,6 +5214,21 @@ RadioLibTime_t LoRaWANNode::getLastToA() {
   return(this->lastToA);
 }
 
+LoRaWANStats_t LoRaWANNode::getStats() {
+  return(this->stats);
+}
+
+void LoRaWANNode::resetStats() {
+  memset(&this->stats, 0, sizeof(this->stats));
+}
+
+RadioLibTime_t LoRaWANNode::getAverageRxOnTime() {
+  if(this->rxOnCount == 0) {
+    return(0);
+  }
+  return(this->rxOnTime / this->rxOnCount);
+}
+
 int16_t LoRaWANNode::setPhyProperties(const LoRaWANChannel_t* chnl, uint8_t dir, int8_t pwr, size_t pre) {
   // set the physical layer configuration
   int16_t state = this->phyLayer->standby();
@@ -2919,7 +5388,17 @@ void LoRaWANNode::getChannelPlanMask(uint64_t* chMaskGrp0123, uint32_t* chMaskGr
 
   // if there are any channels selected, create the mask from those channels
   // channels are always selected for dynamic bands and/or when a device is active
-  if(this->band->bandType == RADIOLIB_LORAWAN_BAND_DYNAMIC || this->isActivated()) {
+  if(this->band->bandType == RADIOLIB_LORAWAN_BAND_FIXED && this->isActivated()) {
+    for(uint8_t i = 0; i < RADIOLIB_LORAWAN_FIXED_NUM_SUBBANDS; i++) {
+      if(i < 8) {
+        *chMaskGrp0123 |= ((uint64_t)this->chMaskFixed[i] << (8 * i));
+      } else {
+        *chMaskGrp45 |= ((uint32_t)this->chMaskFixed[i] << (8 * (i - 8)));
+      }
+    }
+    return;
+
+  } else if(this->band->bandType == RADIOLIB_LORAWAN_BAND_DYNAMIC) {
     for(int i = 0; i < RADIOLIB_LORAWAN_NUM_AVAILABLE_CHANNELS; i++) {
       uint8_t idx = this->channelPlan[RADIOLIB_LORAWAN_UPLINK][i].idx;
       if(idx != RADIOLIB_LORAWAN_CHANNEL_INDEX_NONE) {
@@ -2936,36 +5415,16 @@ void LoRaWANNode::getChannelPlanMask(uint64_t* chMaskGrp0123, uint32_t* chMaskGr
     // if a subband is set, we can set the channel indices straight from subband
     if(this->subBand > 0 && this->subBand <= 8) {
       // for sub band 1-8, set bank of 8 125kHz + single 500kHz channel
-      *chMaskGrp0123 |= 0xFF << ((this->subBand - 1) * 8);
-      *chMaskGrp45 |= 0x01 << ((this->subBand - 1) * 8);
+      *chMaskGrp0123 |= (uint64_t)0xFF << ((this->subBand - 1) * 8);
+      *chMaskGrp45 |= (uint32_t)0x01 << (this->subBand - 1);
     } else if(this->subBand > 8 && this->subBand <= 12) {
       // CN500 only: for sub band 9-12, set bank of 8 125kHz channels
-      *chMaskGrp45 |= 0xFF << ((this->subBand - 9) * 8);
+      *chMaskGrp45 |= (uint32_t)0xFF << ((this->subBand - 9) * 8);
     } else {
-      // if subband is set to 0, all 125kHz channels are enabled.
-      // however, we can 'only' store 16 channels, so we don't use all channels at once.
-      // instead, we select a random channel from each bank of 8 channels + 1 from second plan.
-      uint8_t num125kHz = this->band->txSpans[0].numChannels;
-      uint8_t numBanks = num125kHz / 8;
-      for(uint8_t bank = 0; bank < numBanks; bank++) {
-        uint8_t bankIdx = this->phyLayer->random(8);
-        uint8_t idx = bank * 8 + bankIdx;
-        if(idx < 64) {
-          *chMaskGrp0123 |= ((uint64_t)1 << idx);
-        } else {
-          *chMaskGrp45 |= ((uint32_t)1 << (idx - 64));
-        }
-      }
-      // the 500 kHz channels are in the usual channel plan however
-      // these are the channel indices 64-71 for bands other than CN500
-      if(this->band->bandNum != BandCN500) {
-        for(int i = 0; i < RADIOLIB_LORAWAN_NUM_AVAILABLE_CHANNELS; i++) {
-          uint8_t idx = this->channelPlan[RADIOLIB_LORAWAN_UPLINK][i].idx;
-          if(idx != RADIOLIB_LORAWAN_CHANNEL_INDEX_NONE && idx >= 64) {
-            *chMaskGrp45 |= ((uint32_t)1 << (idx - 64));
-          }
-        }
-      }
+      // if subband is set to 0, all channels are enabled (125kHz as well as 500kHz)
+      // channels that do not exist in this band are dropped when the mask is applied
+      *chMaskGrp0123 = ~(uint64_t)0;
+      *chMaskGrp45 = ~(uint32_t)0;
     }
   }
 }
@@ -3010,11 +5469,6 @@ void LoRaWANNode::selectChannelPlanDyn(bool joinRequest) {
 void LoRaWANNode::selectChannelPlanFix() {
   RADIOLIB_DEBUG_PROTOCOL_PRINTLN("Setting up fixed channels (subband %d)", this->subBand);
 
-  // clear all existing channels
-  for(size_t i = 0; i < RADIOLIB_LORAWAN_NUM_AVAILABLE_CHANNELS; i++) {
-    this->channelPlan[RADIOLIB_LORAWAN_UPLINK][i] = RADIOLIB_LORAWAN_CHANNEL_NONE;
-  }
-
   // get channel masks for this subband
   uint64_t chMaskGrp0123 = 0;
   uint32_t chMaskGrp45 = 0;
@@ -3034,6 +5488,16 @@ uint8_t LoRaWANNode::getAvailableChannels(uint16_t* chMask) {
   uint8_t num = 0;
   uint16_t mask = 0;
   uint8_t currentDr = this->channels[RADIOLIB_LORAWAN_UPLINK].dr;
+
+  // fixed bands keep their availability in the bitsets, the 16-bit mask is not used
+  if(this->band->bandType == RADIOLIB_LORAWAN_BAND_FIXED) {
+    num = this->getFixedChannels(currentDr, NULL);
+    if(chMask) {
+      *chMask = mask;
+    }
+    return(num);
+  }
+
   for(uint8_t i = 0; i < RADIOLIB_LORAWAN_NUM_AVAILABLE_CHANNELS; i++) {
     // if channel is available and usable for current datarate, set corresponding bit
     if(this->channelPlan[RADIOLIB_LORAWAN_UPLINK][i].available) {
@@ -3051,6 +5515,19 @@ uint8_t LoRaWANNode::getAvailableChannels(uint16_t* chMask) {
 }
 
 void LoRaWANNode::setAvailableChannels(uint16_t mask) {
+  // for fixed bands, a full mask starts a new hopping round over all enabled channels
+  // any other mask keeps the current round, limited to the channels that are still enabled
+  if(this->band->bandType == RADIOLIB_LORAWAN_BAND_FIXED) {
+    for(uint8_t i = 0; i < RADIOLIB_LORAWAN_FIXED_NUM_SUBBANDS; i++) {
+      if(mask == 0xFFFF) {
+        this->chAvailFixed[i] = this->chMaskFixed[i];
+      } else {
+        this->chAvailFixed[i] &= this->chMaskFixed[i];
+      }
+    }
+    return;
+  }
+
   for(uint8_t i = 0; i < RADIOLIB_LORAWAN_NUM_AVAILABLE_CHANNELS; i++) {
     // if channel is enabled, set to available
     if(mask & (0x0001 << i) && this->channelPlan[RADIOLIB_LORAWAN_UPLINK][i].enabled) {
@@ -3061,7 +5538,28 @@ void LoRaWANNode::setAvailableChannels(uint16_t mask) {
   }
 }
 
-int16_t LoRaWANNode::selectChannels() {
+int16_t LoRaWANNode::selectChannels(RadioLibTime_t toa) {
+  int16_t state;
+  if(this->band->bandType == RADIOLIB_LORAWAN_BAND_DYNAMIC) {
+    state = this->selectChannelDyn(toa);
+  } else {                // RADIOLIB_LORAWAN_BAND_FIXED
+    state = this->selectChannelFix();
+  }
+  RADIOLIB_ASSERT(state);
+
+  uint8_t rx1Dr = this->band->rx1DrTable[this->channels[RADIOLIB_LORAWAN_UPLINK].dr][this->rx1DrOffset];
+
+  // if downlink dwelltime is enabled, datarate < 2 cannot be used, so clip to 2
+  // only in use on AS923_x bands
+  if(this->dwellTimeEnabledDn && rx1Dr < 2) {
+    rx1Dr = 2;
+  }
+  this->channels[RADIOLIB_LORAWAN_DOWNLINK].dr = rx1Dr;
+
+  return(RADIOLIB_ERR_NONE);
+}
+
+int16_t LoRaWANNode::selectChannelDyn(RadioLibTime_t toa) {
   uint16_t chMask = 0x0000;
   uint8_t numChannels = this->getAvailableChannels(&chMask);
 
@@ -3076,6 +5574,23 @@ int16_t LoRaWANNode::selectChannels() {
     }
   }
 
+  // under duty cycle limits, only keep the channels that are available the earliest
+  if(this->dutyCycleEnabled) {
+    RadioLibTime_t waitMin = RADIOLIB_LORAWAN_TIME_UNAVAILABLE;
+    for(uint8_t i = 0; i < RADIOLIB_LORAWAN_NUM_AVAILABLE_CHANNELS; i++) {
+      if(chMask & (0x0001 << i)) {
+        RadioLibTime_t wait = this->airtimeWait(this->channelPlan[RADIOLIB_LORAWAN_UPLINK][i].freq, toa);
+        waitMin = RADIOLIB_MIN(waitMin, wait);
+      }
+    }
+    for(uint8_t i = 0; i < RADIOLIB_LORAWAN_NUM_AVAILABLE_CHANNELS; i++) {
+      if((chMask & (0x0001 << i)) && (this->airtimeWait(this->channelPlan[RADIOLIB_LORAWAN_UPLINK][i].freq, toa) > waitMin)) {
+        chMask &= ~(0x0001 << i);
+        numChannels--;
+      }
+    }
+  }
+
   // select a random value within the number of possible channels
   int chRand = this->phyLayer->random(numChannels);
 
@@ -3096,33 +5611,116 @@ int16_t LoRaWANNode::selectChannels() {
   this->channels[RADIOLIB_LORAWAN_UPLINK] = this->channelPlan[RADIOLIB_LORAWAN_UPLINK][chIdx];
   this->channels[RADIOLIB_LORAWAN_UPLINK].dr = currentDr;
   
-  if(this->band->bandType == RADIOLIB_LORAWAN_BAND_DYNAMIC) {
-    // for dynamic bands, the downlink channel is the one matched to the uplink channel
-    this->channels[RADIOLIB_LORAWAN_DOWNLINK] = this->channelPlan[RADIOLIB_LORAWAN_DOWNLINK][chIdx];
-  
-  } else {                // RADIOLIB_LORAWAN_BAND_FIXED
-    // for fixed bands, the downlink channel is the uplink channel ID `modulo` number of downlink channels
-    LoRaWANChannel_t channelDn = RADIOLIB_LORAWAN_CHANNEL_NONE;
-    channelDn.enabled = true;
-    channelDn.idx = this->channels[RADIOLIB_LORAWAN_UPLINK].idx % this->band->rx1Span.numChannels;
-    channelDn.freq = this->band->rx1Span.freqStart + channelDn.idx*this->band->rx1Span.freqStep;
-    channelDn.drMin = this->band->rx1Span.drMin;
-    channelDn.drMax = this->band->rx1Span.drMax;
-    this->channels[RADIOLIB_LORAWAN_DOWNLINK] = channelDn;
+  // for dynamic bands, the downlink channel is the one matched to the uplink channel
+  this->channels[RADIOLIB_LORAWAN_DOWNLINK] = this->channelPlan[RADIOLIB_LORAWAN_DOWNLINK][chIdx];
+
+  return(RADIOLIB_ERR_NONE);
+}
+
+int16_t LoRaWANNode::selectChannelFix() {
+  uint8_t currentDr = this->channels[RADIOLIB_LORAWAN_UPLINK].dr;
+  uint8_t chMask[RADIOLIB_LORAWAN_FIXED_NUM_SUBBANDS];
+  uint8_t numChannels = this->getFixedChannels(currentDr, chMask);
+
+  // if there are no available channels, try resetting them all to available
+  if(numChannels == 0) {
+    this->setAvailableChannels(0xFFFF);
+    numChannels = this->getFixedChannels(currentDr, chMask);
 
+    // if there are still no channels available, give up
+    if(numChannels == 0) {
+      return(RADIOLIB_ERR_NO_CHANNEL_AVAILABLE);
+    }
   }
-  uint8_t rx1Dr = this->band->rx1DrTable[currentDr][this->rx1DrOffset];
 
-  // if downlink dwelltime is enabled, datarate < 2 cannot be used, so clip to 2
-  // only in use on AS923_x bands
-  if(this->dwellTimeEnabledDn && rx1Dr < 2) {
-    rx1Dr = 2;
+  // select a random value within the number of possible channels
+  uint8_t chRand = this->phyLayer->random(numChannels);
+
+  // skip over complete sub-bands first, then clear the lowest set bits of the remaining sub-band
+  uint8_t subBand = 0;
+  while(chRand >= rlb_popcount(chMask[subBand])) {
+    chRand -= rlb_popcount(chMask[subBand]);
+    subBand++;
   }
-  this->channels[RADIOLIB_LORAWAN_DOWNLINK].dr = rx1Dr;
+  uint8_t bits = chMask[subBand];
+  for(; chRand > 0; chRand--) {
+    bits &= bits - 1;
+  }
+  uint8_t chIdx = 8*subBand + rlb_ctz(bits);
+
+  // as we are now going to use this channel, mark unavailable for next uplink
+  this->chAvailFixed[subBand] &= ~(1 << (chIdx % 8));
+
+  this->getFixedChannel(chIdx, &this->channels[RADIOLIB_LORAWAN_UPLINK]);
+  this->channels[RADIOLIB_LORAWAN_UPLINK].dr = currentDr;
+
+  // for fixed bands, the downlink channel is the uplink channel ID `modulo` number of downlink channels
+  LoRaWANChannel_t channelDn = RADIOLIB_LORAWAN_CHANNEL_NONE;
+  channelDn.enabled = true;
+  channelDn.idx = chIdx % this->band->rx1Span.numChannels;
+  channelDn.freq = this->band->rx1Span.freqStart + channelDn.idx*this->band->rx1Span.freqStep;
+  channelDn.drMin = this->band->rx1Span.drMin;
+  channelDn.drMax = this->band->rx1Span.drMax;
+  this->channels[RADIOLIB_LORAWAN_DOWNLINK] = channelDn;
 
   return(RADIOLIB_ERR_NONE);
 }
 
+void LoRaWANNode::getFixedChannel(uint8_t idx, LoRaWANChannel_t* chnl) {
+  // the first span holds the first channels, the second span (if any) holds the rest
+  const LoRaWANChannelSpan_t* span = &this->band->txSpans[0];
+  uint8_t ofs = idx;
+  if(idx >= span->numChannels) {
+    ofs -= span->numChannels;
+    span = &this->band->txSpans[1];
+  }
+  chnl->enabled = true;
+  chnl->idx   = idx;
+  chnl->freq  = span->freqStart + ofs*span->freqStep;
+  chnl->drMin = span->drMin;
+  chnl->drMax = span->drMax;
+}
+
+uint8_t LoRaWANNode::getFixedChannels(uint8_t dr, uint8_t* mask) {
+  uint8_t num = 0;
+  for(uint8_t i = 0; i < RADIOLIB_LORAWAN_FIXED_NUM_SUBBANDS; i++) {
+    // all spans consist of complete sub-bands, so the datarate only needs to be checked once per sub-band
+    const LoRaWANChannelSpan_t* span = &this->band->txSpans[(8*i < this->band->txSpans[0].numChannels) ? 0 : 1];
+    uint8_t bits = 0;
+    if(dr >= span->drMin && dr <= span->drMax) {
+      bits = this->chAvailFixed[i];
+    }
+    if(mask) {
+      mask[i] = bits;
+    }
+    num += rlb_popcount(bits);
+  }
+  return(num);
+}
+
+bool LoRaWANNode::isValidDatarate(uint8_t dr) {
+  LoRaWANChannel_t chnl = RADIOLIB_LORAWAN_CHANNEL_NONE;
+  if(this->band->bandType == RADIOLIB_LORAWAN_BAND_FIXED) {
+    for(uint8_t i = 0; i < RADIOLIB_LORAWAN_FIXED_NUM_SUBBANDS; i++) {
+      if(this->chMaskFixed[i]) {
+        this->getFixedChannel(8*i, &chnl);
+        if(dr >= chnl.drMin && dr <= chnl.drMax) {
+          return(true);
+        }
+      }
+    }
+    return(false);
+  }
+
+  for(uint8_t i = 0; i < RADIOLIB_LORAWAN_NUM_AVAILABLE_CHANNELS; i++) {
+    chnl = this->channelPlan[RADIOLIB_LORAWAN_UPLINK][i];
+    if(chnl.enabled && dr >= chnl.drMin && dr <= chnl.drMax) {
+      return(true);
+    }
+  }
+  return(false);
+}
+
 bool LoRaWANNode::applyChannelMask(uint64_t chMaskGrp0123, uint32_t chMaskGrp45) {
   if(this->band->bandType == RADIOLIB_LORAWAN_BAND_DYNAMIC) {
     for(int i = 0; i < RADIOLIB_LORAWAN_NUM_AVAILABLE_CHANNELS; i++) {
@@ -3137,39 +5735,21 @@ bool LoRaWANNode::applyChannelMask(uint64_t chMaskGrp0123, uint32_t chMaskGrp45)
       }
     }
   } else {    // bandType == RADIOLIB_LORAWAN_BAND_FIXED
-    // full channel mask received, so clear all existing channels
-    LoRaWANChannel_t chnl = RADIOLIB_LORAWAN_CHANNEL_NONE;
-    for(size_t i = 0; i < RADIOLIB_LORAWAN_NUM_AVAILABLE_CHANNELS; i++) {
-      this->channelPlan[RADIOLIB_LORAWAN_UPLINK][i] = chnl;
-    }
-    int num = 0;
-    uint8_t spanNum = 0;
-    int chNum = 0;
-    int chOfs = 0;
-    for(; chNum < 64; chNum++) {
-      if(chMaskGrp0123 & ((uint64_t)1 << chNum)) {
-        chnl.enabled = true;
-        chnl.idx   = chNum;
-        chnl.freq  = this->band->txSpans[spanNum].freqStart + chNum*this->band->txSpans[spanNum].freqStep;
-        chnl.drMin = this->band->txSpans[spanNum].drMin;
-        chnl.drMax = this->band->txSpans[spanNum].drMax;
-        this->channelPlan[RADIOLIB_LORAWAN_UPLINK][num++] = chnl;
-      }
-    }
-    if(this->band->numTxSpans > 1) {
-      spanNum += 1;
-      chNum = 0;
-      chOfs = 64;
-    }
-    for(; chNum < this->band->txSpans[spanNum].numChannels; chNum++) {
-      if(chMaskGrp45 & ((uint32_t)1 << chNum)) {
-        chnl.enabled = true;
-        chnl.idx   = chNum + chOfs;
-        chnl.freq  = this->band->txSpans[spanNum].freqStart + chNum*this->band->txSpans[spanNum].freqStep;
-        chnl.drMin = this->band->txSpans[spanNum].drMin;
-        chnl.drMax = this->band->txSpans[spanNum].drMax;
-        this->channelPlan[RADIOLIB_LORAWAN_UPLINK][num++] = chnl;
+    // full channel mask received, so copy it over to the bitsets, skipping channels that do not exist in this band
+    uint8_t numChannels = this->band->txSpans[0].numChannels + this->band->txSpans[1].numChannels;
+    for(uint8_t i = 0; i < RADIOLIB_LORAWAN_FIXED_NUM_SUBBANDS; i++) {
+      uint8_t bits;
+      if(i < 8) {
+        bits = (uint8_t)(chMaskGrp0123 >> (8 * i));
+      } else {
+        bits = (uint8_t)(chMaskGrp45 >> (8 * (i - 8)));
       }
+      if(8*i >= numChannels) {
+        bits = 0;
+      } else if(numChannels - 8*i < 8) {
+        bits &= (1 << (numChannels - 8*i)) - 1;
+      }
+      this->chMaskFixed[i] = bits;
     }
   }
 
@@ -3182,6 +5762,16 @@ bool LoRaWANNode::applyChannelMask(uint64_t chMaskGrp0123, uint32_t chMaskGrp45)
 
 #if RADIOLIB_DEBUG_PROTOCOL
 void LoRaWANNode::printChannels() {
+  if(this->band->bandType == RADIOLIB_LORAWAN_BAND_FIXED) {
+    for(uint8_t i = 0; i < RADIOLIB_LORAWAN_FIXED_NUM_SUBBANDS; i++) {
+      if(this->chMaskFixed[i]) {
+        RADIOLIB_DEBUG_PROTOCOL_PRINTLN("UL: %3d - %3d enabled 0x%02x available 0x%02x",
+                                        8*i, 8*i + 7, this->chMaskFixed[i], this->chAvailFixed[i]);
+      }
+    }
+    return;
+  }
+
   for (int i = 0; i < RADIOLIB_LORAWAN_NUM_AVAILABLE_CHANNELS; i++) {
     if(this->channelPlan[RADIOLIB_LORAWAN_UPLINK][i].enabled) {
       RADIOLIB_DEBUG_PROTOCOL_PRINTLN("UL: %3d %d %7.3f (%d - %d) | DL: %3d %d %7.3f (%d - %d)",
@@ -3213,19 +5803,26 @@ uint32_t LoRaWANNode::generateMIC(uint8_t* msg, size_t len, uint8_t* key) {
   return(((uint32_t)cmac[0]) | ((uint32_t)cmac[1] << 8) | ((uint32_t)cmac[2] << 16) | ((uint32_t)cmac[3]) << 24);
 }
 
-bool LoRaWANNode::verifyMIC(uint8_t* msg, size_t len, uint8_t* key) {
+bool LoRaWANNode::verifyMIC(uint8_t* msg, size_t len, uint8_t* key, const uint8_t* hdr, size_t hdrLen) {
   if((msg == NULL) || (len < sizeof(uint32_t))) {
     return(0);
   }
 
-  // extract MIC from the message
-  uint32_t micReceived = LoRaWANNode::ntoh<uint32_t>(&msg[len - sizeof(uint32_t)]);
+  // calculate the expected value over the optional header followed by the message
+  uint8_t cmac[RADIOLIB_AES128_BLOCK_SIZE];
+  RadioLibAES128Instance.init(key);
+  RadioLibAES128Instance.initCMAC();
+  if(hdr) {
+    RadioLibAES128Instance.updateCMAC(hdr, hdrLen);
+  }
+  RadioLibAES128Instance.updateCMAC(msg, len - sizeof(uint32_t));
+  RadioLibAES128Instance.finishCMAC(cmac);
 
-  // calculate the expected value and compare
-  uint32_t micCalculated = generateMIC(msg, len - sizeof(uint32_t), key);
-  if(micCalculated != micReceived) {
+  // MIC is the first 4 bytes of the CMAC, so it can be compared directly to the last 4 bytes of the message
+  if(!rlb_memeq_ct(cmac, &msg[len - sizeof(uint32_t)], sizeof(uint32_t))) {
     RADIOLIB_DEBUG_PROTOCOL_PRINTLN("MIC mismatch, expected %08lx, got %08lx", 
-                                    (unsigned long)micCalculated, (unsigned long)micReceived);
+                                    (unsigned long)LoRaWANNode::ntoh<uint32_t>(cmac), 
+                                    (unsigned long)LoRaWANNode::ntoh<uint32_t>(&msg[len - sizeof(uint32_t)]));
     return(false);
   }
 
@@ -3245,12 +5842,133 @@ RadioLibTime_t LoRaWANNode::dutyCycleInterval(RadioLibTime_t msPerHour, RadioLib
 }
 
 RadioLibTime_t LoRaWANNode::timeUntilUplink() {
+  // the next uplink can happen on whichever enabled channel is available the earliest
+  RadioLibTime_t waitMin = RADIOLIB_LORAWAN_TIME_UNAVAILABLE;
+  uint8_t numChannels = RADIOLIB_LORAWAN_NUM_AVAILABLE_CHANNELS;
+  if(this->band->bandType == RADIOLIB_LORAWAN_BAND_FIXED) {
+    numChannels = this->band->txSpans[0].numChannels + this->band->txSpans[1].numChannels;
+  }
+  for(uint8_t i = 0; i < numChannels; i++) {
+    RadioLibTime_t wait = this->timeUntilUplink(i);
+    if(wait < waitMin) {
+      waitMin = wait;
+    }
+  }
+  return(waitMin);
+}
+
+RadioLibTime_t LoRaWANNode::timeUntilUplink(uint8_t chIdx) {
+  LoRaWANChannel_t chnl = RADIOLIB_LORAWAN_CHANNEL_NONE;
+  if(this->band->bandType == RADIOLIB_LORAWAN_BAND_FIXED) {
+    if((chIdx < 8*RADIOLIB_LORAWAN_FIXED_NUM_SUBBANDS) && (this->chMaskFixed[chIdx / 8] & (1 << (chIdx % 8)))) {
+      this->getFixedChannel(chIdx, &chnl);
+    }
+  } else if(chIdx < RADIOLIB_LORAWAN_NUM_AVAILABLE_CHANNELS) {
+    chnl = this->channelPlan[RADIOLIB_LORAWAN_UPLINK][chIdx];
+  }
+  if(!chnl.enabled) {
+    return(RADIOLIB_LORAWAN_TIME_UNAVAILABLE);
+  }
+  if(!this->dutyCycleEnabled) {
+    return(0);
+  }
+
+  // the next uplink is assumed to take as long as the last one
+  return(this->airtimeWait(chnl.freq, this->lastToA));
+}
+
+int8_t LoRaWANNode::findDutyCycleBand(uint32_t freq) {
+  uint8_t numBands = RADIOLIB_MIN(this->band->numDutyCycleBands, RADIOLIB_LORAWAN_NUM_DUTY_CYCLE_BANDS);
+  for(uint8_t i = 0; i < numBands; i++) {
+    if((freq >= this->band->dutyCycleBands[i].freqStart) && (freq < this->band->dutyCycleBands[i].freqEnd)) {
+      return(i);
+    }
+  }
+  return(-1);
+}
+
+void LoRaWANNode::addAirtime(uint32_t freq, RadioLibTime_t toa) {
+  Module* mod = this->phyLayer->getMod();
+  RadioLibTime_t now = mod->hal->millis();
+
+  // airtime is accounted both in the sub-band and aggregated over all sub-bands
+  int8_t dcBand = this->findDutyCycleBand(freq);
+  if(dcBand >= 0) {
+    LoRaWANAirtimeLedger_t* ledger = &this->airtimeLedger[dcBand];
+    LoRaWANNode::airtimeLedgerRoll(ledger, now);
+    ledger->airtime[ledger->slot] += toa;
+  }
+  LoRaWANAirtimeLedger_t* aggregated = &this->airtimeLedger[RADIOLIB_LORAWAN_NUM_DUTY_CYCLE_BANDS];
+  LoRaWANNode::airtimeLedgerRoll(aggregated, now);
+  aggregated->airtime[aggregated->slot] += toa;
+}
+
+RadioLibTime_t LoRaWANNode::airtimeWait(uint32_t freq, RadioLibTime_t toa) {
   Module* mod = this->phyLayer->getMod();
-  RadioLibTime_t nextUplink = this->rxDelayStart + dutyCycleInterval(this->dutyCycle, this->lastToA);
-  if(mod->hal->millis() > nextUplink){
+  RadioLibTime_t now = mod->hal->millis();
+  RadioLibTime_t wait = 0;
+
+  // check the regulatory limit of the sub-band
+  int8_t dcBand = this->findDutyCycleBand(freq);
+  if(dcBand >= 0) {
+    wait = LoRaWANNode::airtimeLedgerWait(&this->airtimeLedger[dcBand], now, toa, this->band->dutyCycleBands[dcBand].dutyCycle);
+  }
+
+  // check the aggregated limit - in bands with sub-bands, this only applies
+  // when it was changed from the band default (by DutyCycleReq or by the user)
+  if((dcBand < 0) || (this->dutyCycle != this->band->dutyCycle)) {
+    RadioLibTime_t waitAggregated = LoRaWANNode::airtimeLedgerWait(&this->airtimeLedger[RADIOLIB_LORAWAN_NUM_DUTY_CYCLE_BANDS], 
+                                                                   now, toa, this->dutyCycle);
+    wait = RADIOLIB_MAX(wait, waitAggregated);
+  }
+
+  return(wait);
+}
+
+void LoRaWANNode::airtimeLedgerRoll(LoRaWANAirtimeLedger_t* ledger, RadioLibTime_t now) {
+  // the elapsed time is calculated as a difference, so it stays correct when the clock wraps around
+  RadioLibTime_t numPassed = (now - ledger->slotStart) / RADIOLIB_LORAWAN_AIRTIME_SLOT_LEN;
+  if(numPassed == 0) {
+    return;
+  }
+  ledger->slotStart += numPassed * RADIOLIB_LORAWAN_AIRTIME_SLOT_LEN;
+
+  // clear all slots that passed since the last update
+  uint8_t numCleared = RADIOLIB_MIN(numPassed, (RadioLibTime_t)RADIOLIB_LORAWAN_AIRTIME_NUM_SLOTS + 1);
+  for(uint8_t i = 0; i < numCleared; i++) {
+    ledger->slot = (ledger->slot + 1) % (RADIOLIB_LORAWAN_AIRTIME_NUM_SLOTS + 1);
+    ledger->airtime[ledger->slot] = 0;
+  }
+}
+
+RadioLibTime_t LoRaWANNode::airtimeLedgerWait(LoRaWANAirtimeLedger_t* ledger, RadioLibTime_t now, RadioLibTime_t toa, RadioLibTime_t limit) {
+  // no limit at all
+  if(limit == 0) {
+    return(0);
+  }
+
+  LoRaWANNode::airtimeLedgerRoll(ledger, now);
+
+  RadioLibTime_t used = 0;
+  for(uint8_t i = 0; i <= RADIOLIB_LORAWAN_AIRTIME_NUM_SLOTS; i++) {
+    used += ledger->airtime[i];
+  }
+  if(used + toa <= limit) {
     return(0);
   }
-  return(nextUplink - mod->hal->millis() + 1);
+
+  // go through the slots from the oldest one, and find the first time the airtime fits
+  // airtime is treated as if it was used at the very end of its slot, which expires one hour later
+  RadioLibTime_t elapsed = now - ledger->slotStart;
+  for(uint8_t i = 0; i <= RADIOLIB_LORAWAN_AIRTIME_NUM_SLOTS; i++) {
+    used -= ledger->airtime[(ledger->slot + 1 + i) % (RADIOLIB_LORAWAN_AIRTIME_NUM_SLOTS + 1)];
+    if(used + toa <= limit) {
+      return((RadioLibTime_t)(1 + i) * RADIOLIB_LORAWAN_AIRTIME_SLOT_LEN - elapsed);
+    }
+  }
+
+  // the uplink takes longer than the hourly limit
+  return(RADIOLIB_LORAWAN_TIME_UNAVAILABLE);
 }
 
 uint8_t LoRaWANNode::getMaxPayloadLen() {
@@ -3278,6 +5996,17 @@ uint8_t LoRaWANNode::getMaxPayloadLen() {
     return(maxLen - 13 - this->fOptsUpLen);
   }
 
+  // for LoRa, each byte takes at least its share of the payload symbols on top of preamble and header,
+  // so any length whose bytes alone take longer than the dwell time (plus rounding to ms) is too long
+  uint8_t dataRateBand = this->band->dataRates[this->channels[RADIOLIB_LORAWAN_UPLINK].dr];
+  if((dataRateBand & RADIOLIB_LORAWAN_DATA_RATE_MODEM) == RADIOLIB_LORAWAN_DATA_RATE_LORA) {
+    const LoRaWANLoRaDataRate_t* lora = &LoRaDataRateTable[RADIOLIB_LORAWAN_LORA_DATA_RATE_IDX(dataRateBand)];
+    if(lora->byteUs > 0) {
+      RadioLibTime_t lenTooLong = (this->dwellTimeUp + 1) * 1000 / lora->byteUs + 1;
+      maxLen = (uint8_t)RADIOLIB_MIN((RadioLibTime_t)maxLen, lenTooLong);
+    }
+  }
+
   // do some binary search to find maximum allowed length
   uint8_t curLen = (minLen + maxLen) / 2;
   while(curLen != minLen && curLen != maxLen) {
@@ -3299,36 +6028,46 @@ int16_t LoRaWANNode::findDataRate(uint8_t dr, DataRate_t* dataRate) {
     return(state);
   }
 
+  // decode the band's datarate field, this does not involve the radio
   ModemType_t modemNew;
+  state = LoRaWANNode::decodeDataRate(this->band->dataRates[dr], dataRate, &modemNew);
+  RADIOLIB_ASSERT(state);
 
-  uint8_t dataRateBand = this->band->dataRates[dr];
+  // get the currently configured modem from the radio
+  ModemType_t modemCurrent;
+  state = this->phyLayer->getModem(&modemCurrent);
+  RADIOLIB_ASSERT(state);
+
+  // if the required modem is different than the current one, change over
+  if(modemNew != modemCurrent) {
+    state = this->phyLayer->setModem(modemNew);
+    RADIOLIB_ASSERT(state);
+  }
+
+  state = this->phyLayer->checkDataRate(*dataRate);
+  return(state);
+}
 
+int16_t LoRaWANNode::decodeDataRate(uint8_t dataRateBand, DataRate_t* dataRate, ModemType_t* modem) {
   switch(dataRateBand & RADIOLIB_LORAWAN_DATA_RATE_MODEM) {
-    case(RADIOLIB_LORAWAN_DATA_RATE_LORA):
-      modemNew = ModemType_t::RADIOLIB_MODEM_LORA;
-      dataRate->lora.spreadingFactor = ((dataRateBand & RADIOLIB_LORAWAN_DATA_RATE_SF) >> 3) + 7;
-      switch(dataRateBand & RADIOLIB_LORAWAN_DATA_RATE_BW) {
-        case(RADIOLIB_LORAWAN_DATA_RATE_BW_125_KHZ):
-          dataRate->lora.bandwidth = 125.0;
-          break;
-        case(RADIOLIB_LORAWAN_DATA_RATE_BW_250_KHZ):
-          dataRate->lora.bandwidth = 250.0;
-          break;
-        case(RADIOLIB_LORAWAN_DATA_RATE_BW_500_KHZ):
-          dataRate->lora.bandwidth = 500.0;
-          break;
-        default:
-          return(RADIOLIB_ERR_UNSUPPORTED);
+    case(RADIOLIB_LORAWAN_DATA_RATE_LORA): {
+      // spreading factor and bandwidth come from the table generated at compile time
+      const LoRaWANLoRaDataRate_t* lora = &LoRaDataRateTable[RADIOLIB_LORAWAN_LORA_DATA_RATE_IDX(dataRateBand)];
+      if(lora->sf == 0) {
+        return(RADIOLIB_ERR_UNSUPPORTED);
       }
+      *modem = ModemType_t::RADIOLIB_MODEM_LORA;
+      dataRate->lora.spreadingFactor = lora->sf;
+      dataRate->lora.bandwidth = lora->bw;
       dataRate->lora.codingRate = 5;
-      break;
+    } break;
     case(RADIOLIB_LORAWAN_DATA_RATE_FSK):
-      modemNew = ModemType_t::RADIOLIB_MODEM_FSK;
+      *modem = ModemType_t::RADIOLIB_MODEM_FSK;
       dataRate->fsk.bitRate = 50;
       dataRate->fsk.freqDev = 25;
       break;
     case(RADIOLIB_LORAWAN_DATA_RATE_LR_FHSS):
-      modemNew = ModemType_t::RADIOLIB_MODEM_LRFHSS;
+      *modem = ModemType_t::RADIOLIB_MODEM_LRFHSS;
       switch(dataRateBand & RADIOLIB_LORAWAN_DATA_RATE_BW) {
         case(RADIOLIB_LORAWAN_DATA_RATE_BW_137_KHZ):
           dataRate->lrFhss.bw = 0x02; // specific encoding
@@ -3360,59 +6099,35 @@ int16_t LoRaWANNode::findDataRate(uint8_t dr, DataRate_t* dataRate) {
       return(RADIOLIB_ERR_UNSUPPORTED);
   }
 
-  // get the currently configured modem from the radio
-  ModemType_t modemCurrent;
-  state = this->phyLayer->getModem(&modemCurrent);
-  RADIOLIB_ASSERT(state);
-
-  // if the required modem is different than the current one, change over
-  if(modemNew != modemCurrent) {
-    state = this->phyLayer->setModem(modemNew);
-    RADIOLIB_ASSERT(state);
-  }
-
-  state = this->phyLayer->checkDataRate(*dataRate);
-  return(state);
+  return(RADIOLIB_ERR_NONE);
 }
 
-void LoRaWANNode::processAES(const uint8_t* in, size_t len, uint8_t* key, uint8_t* out, uint32_t fCnt, uint8_t dir, uint8_t ctrId, bool counter) {
-  // figure out how many encryption blocks are there
-  size_t numBlocks = len/RADIOLIB_AES128_BLOCK_SIZE;
-  if(len % RADIOLIB_AES128_BLOCK_SIZE) {
-    numBlocks++;
-  }
-
-  // generate the encryption blocks
-  uint8_t encBuffer[RADIOLIB_AES128_BLOCK_SIZE] = { 0 };
+void LoRaWANNode::processAES(const uint8_t* in, size_t len, uint8_t* key, uint8_t* out, uint32_t addr, uint32_t fCnt, uint8_t dir, uint8_t ctrId, bool counter) {
+  // generate the first encryption block
   uint8_t encBlock[RADIOLIB_AES128_BLOCK_SIZE] = { 0 };
   encBlock[RADIOLIB_LORAWAN_BLOCK_MAGIC_POS] = RADIOLIB_LORAWAN_ENC_BLOCK_MAGIC;
   encBlock[RADIOLIB_LORAWAN_ENC_BLOCK_COUNTER_ID_POS] = ctrId;
   encBlock[RADIOLIB_LORAWAN_BLOCK_DIR_POS] = dir;
-  LoRaWANNode::hton<uint32_t>(&encBlock[RADIOLIB_LORAWAN_BLOCK_DEV_ADDR_POS], this->devAddr);
+  LoRaWANNode::hton<uint32_t>(&encBlock[RADIOLIB_LORAWAN_BLOCK_DEV_ADDR_POS], addr);
   LoRaWANNode::hton<uint32_t>(&encBlock[RADIOLIB_LORAWAN_BLOCK_FCNT_POS], fCnt);
+  if(counter) {
+    encBlock[RADIOLIB_LORAWAN_ENC_BLOCK_COUNTER_POS] = 1;
+  }
 
   // now encrypt the input
   // on downlink frames, this has a decryption effect because server actually "decrypts" the plaintext
-  size_t remLen = len;
-  for(size_t i = 0; i < numBlocks; i++) {
-
-    if(counter) {
-      encBlock[RADIOLIB_LORAWAN_ENC_BLOCK_COUNTER_POS] = i + 1;
-    }
-
-    // encrypt the buffer
-    RadioLibAES128Instance.init(key);
-    RadioLibAES128Instance.encryptECB(encBlock, RADIOLIB_AES128_BLOCK_SIZE, encBuffer);
+  RadioLibAES128Instance.init(key);
+  if(counter) {
+    // the counter is the last byte of the block, so it is incremented by CTR mode
+    RadioLibAES128Instance.initCTR(encBlock);
+    RadioLibAES128Instance.updateCTR(in, len, out);
+    return;
+  }
 
-    // now xor the buffer with the input
-    size_t xorLen = remLen;
-    if(xorLen > RADIOLIB_AES128_BLOCK_SIZE) {
-      xorLen = RADIOLIB_AES128_BLOCK_SIZE;
-    }
-    for(uint8_t j = 0; j < xorLen; j++) {
-      out[i*RADIOLIB_AES128_BLOCK_SIZE + j] = in[i*RADIOLIB_AES128_BLOCK_SIZE + j] ^ encBuffer[j];
-    }
-    remLen -= xorLen;
+  // without counter, the same encryption block is used for all of the input
+  for(size_t i = 0; i < len; i += RADIOLIB_AES128_BLOCK_SIZE) {
+    RadioLibAES128Instance.initCTR(encBlock);
+    RadioLibAES128Instance.updateCTR(&in[i], RADIOLIB_MIN(len - i, (size_t)RADIOLIB_AES128_BLOCK_SIZE), &out[i]);
   }
 }
 
@@ -29,9 +29,11 @@
 #define RADIOLIB_LORAWAN_MHDR_MTYPE_UNCONF_DATA_DOWN            (0x03 << 5) //  7     5                   unconfirmed data down
 #define RADIOLIB_LORAWAN_MHDR_MTYPE_CONF_DATA_UP                (0x04 << 5) //  7     5                   confirmed data up
 #define RADIOLIB_LORAWAN_MHDR_MTYPE_CONF_DATA_DOWN              (0x05 << 5) //  7     5                   confirmed data down
+#define RADIOLIB_LORAWAN_MHDR_MTYPE_REJOIN_REQUEST              (0x06 << 5) //  7     5                   rejoin request
 #define RADIOLIB_LORAWAN_MHDR_MTYPE_PROPRIETARY                 (0x07 << 5) //  7     5                   proprietary
 #define RADIOLIB_LORAWAN_MHDR_MTYPE_MASK                        (0x07 << 5) //  7     5                   bitmask of all possible options
 #define RADIOLIB_LORAWAN_MHDR_MAJOR_R1                          (0x00 << 0) //  1     0     major version: LoRaWAN R1
+#define RADIOLIB_LORAWAN_MHDR_MAJOR_MASK                        (0x03 << 0) //  1     0                   bitmask of all possible options
 
 // frame control field encoding
 #define RADIOLIB_LORAWAN_FCTRL_ADR_ENABLED                      (0x01 << 7) //  7     7     adaptive data rate: enabled
@@ -46,6 +48,8 @@
 #define RADIOLIB_LORAWAN_FPORT_PAYLOAD_MAX                      (0xDF << 0) //  7     0     end of user-allowed fPort range
 #define RADIOLIB_LORAWAN_FPORT_TS009                            (0xE0 << 0) //  7     0     fPort used for TS009 testing
 #define RADIOLIB_LORAWAN_FPORT_TS011                            (0xE2 << 0) //  7     0     fPort used for TS011 Forwarding
+#define RADIOLIB_LORAWAN_FPORT_MULTICAST_SETUP                  (0xC8 << 0) //  7     0     fPort used for TS005 Remote Multicast Setup
+#define RADIOLIB_LORAWAN_FPORT_FRAG_TRANSPORT                   (0xC9 << 0) //  7     0     fPort used for TS004 Fragmented Data Block Transport
 #define RADIOLIB_LORAWAN_FPORT_RESERVED                         (0xE0 << 0) //  7     0     fPort values equal to and larger than this are reserved
 
 // data rate encoding
@@ -94,7 +98,8 @@
 #define RADIOLIB_LORAWAN_RETRANSMIT_TIMEOUT_MAX_MS              (3000)
 #define RADIOLIB_LORAWAN_POWER_STEP_SIZE_DBM                    (-2)
 #define RADIOLIB_LORAWAN_REJOIN_MAX_COUNT_N                     (10)  // send rejoin request 16384 uplinks
-#define RADIOLIB_LORAWAN_REJOIN_MAX_TIME_N                      (15)  // once every year, not actually implemented
+#define RADIOLIB_LORAWAN_REJOIN_MAX_TIME_N                      (15)  // once every year
+#define RADIOLIB_LORAWAN_FORCE_REJOIN_PERIOD_MS                 (32000UL)  // base period between forced rejoin requests
 
 // join request message layout
 #define RADIOLIB_LORAWAN_JOIN_REQUEST_LEN                       (23)
@@ -106,6 +111,17 @@
 #define RADIOLIB_LORAWAN_JOIN_REQUEST_TYPE_1                    (0x01)
 #define RADIOLIB_LORAWAN_JOIN_REQUEST_TYPE_2                    (0x02)
 
+// rejoin request message layout
+#define RADIOLIB_LORAWAN_REJOIN_REQUEST_0_2_LEN                 (19)
+#define RADIOLIB_LORAWAN_REJOIN_REQUEST_1_LEN                   (24)
+#define RADIOLIB_LORAWAN_REJOIN_REQUEST_TYPE_POS                (1)
+#define RADIOLIB_LORAWAN_REJOIN_REQUEST_NET_ID_POS              (2)   // type 0 and 2
+#define RADIOLIB_LORAWAN_REJOIN_REQUEST_0_2_DEV_EUI_POS         (5)
+#define RADIOLIB_LORAWAN_REJOIN_REQUEST_0_2_RJ_COUNT_POS        (13)
+#define RADIOLIB_LORAWAN_REJOIN_REQUEST_JOIN_EUI_POS            (2)   // type 1
+#define RADIOLIB_LORAWAN_REJOIN_REQUEST_1_DEV_EUI_POS           (10)
+#define RADIOLIB_LORAWAN_REJOIN_REQUEST_1_RJ_COUNT_POS          (18)
+
 // join accept message layout
 #define RADIOLIB_LORAWAN_JOIN_ACCEPT_MAX_LEN                    (33)
 #define RADIOLIB_LORAWAN_JOIN_ACCEPT_JOIN_NONCE_POS             (1)
@@ -148,6 +164,9 @@
 #define RADIOLIB_LORAWAN_FRAME_PAYLOAD_POS(FOPTS)               (RADIOLIB_LORAWAN_FHDR_LEN_START_OFFS + 9 + (FOPTS))
 #define RADIOLIB_LORAWAN_FRAME_LEN(PAYLOAD, FOPTS)              (16 + 13 + (PAYLOAD) + (FOPTS))
 
+// largest application payload that can be received in a single downlink
+#define RADIOLIB_LORAWAN_MAX_DOWNLINK_SIZE                      (250)
+
 // payload encryption/MIC blocks common layout
 #define RADIOLIB_LORAWAN_BLOCK_MAGIC_POS                        (0)
 #define RADIOLIB_LORAWAN_BLOCK_CONF_FCNT_POS                    (1)
@@ -172,11 +191,28 @@
 // unused frame counter value
 #define RADIOLIB_LORAWAN_FCNT_NONE                              (0xFFFFFFFF)
 
+// time returned when an uplink is not possible at all
+#define RADIOLIB_LORAWAN_TIME_UNAVAILABLE                       (0xFFFFFFFF)
+
 // TR013 CSMA recommended values
 #define RADIOLIB_LORAWAN_DIFS_DEFAULT                           (2)
 #define RADIOLIB_LORAWAN_BACKOFF_MAX_DEFAULT                    (6)
 #define RADIOLIB_LORAWAN_MAX_CHANGES_DEFAULT                    (4)
 
+// device-side adaptive uplink control
+#define RADIOLIB_LORAWAN_ADAPTIVE_MARGIN_DEFAULT                (10)  // link margin to keep in reserve, in dB
+#define RADIOLIB_LORAWAN_ADAPTIVE_LINK_CHECK_PERIOD             (16)  // number of uplinks between LinkCheckReq
+#define RADIOLIB_LORAWAN_ADAPTIVE_STEP_DB                       (3)   // margin per datarate or Tx power step
+#define RADIOLIB_LORAWAN_ADAPTIVE_ASYMMETRY_DEFAULT             (10)  // downlink stronger than uplink, in dB
+#define RADIOLIB_LORAWAN_ADAPTIVE_NB_TRANS_MAX                  (3)
+#define RADIOLIB_LORAWAN_ADAPTIVE_MARGIN_NONE                   (-128)
+
+// network time synchronization through DeviceTimeAns
+#define RADIOLIB_LORAWAN_TIME_SYNC_DRIFT_MIN_MS                 (600000UL)  // minimum time between syncs to estimate drift
+#define RADIOLIB_LORAWAN_TIME_SYNC_DRIFT_MAX_PPM                (10000)     // larger drift estimates are discarded
+#define RADIOLIB_LORAWAN_SLOT_GUARD_MS                          (20)        // margin added to slots for clock errors
+#define RADIOLIB_LORAWAN_GPS_UNIX_OFFSET                        (315964800UL - 18UL)  // incl. 18 leap seconds
+
 // MAC commands
 #define RADIOLIB_LORAWAN_NUM_MAC_COMMANDS                       (23)
 
@@ -203,11 +239,148 @@
 // the maximum number of simultaneously available channels
 #define RADIOLIB_LORAWAN_NUM_AVAILABLE_CHANNELS                 (16)
 
+// fixed bands keep all of their (up to 96) channels in bitsets, one byte per sub-band of 8 channels
+#define RADIOLIB_LORAWAN_FIXED_NUM_SUBBANDS                     (12)
+
 // maximum MAC command sizes
 #define RADIOLIB_LORAWAN_MAX_MAC_COMMAND_LEN_DOWN               (5)
 #define RADIOLIB_LORAWAN_MAX_MAC_COMMAND_LEN_UP                 (2)
 #define RADIOLIB_LORAWAN_MAX_NUM_ADR_COMMANDS                   (8)
 
+// maximum number of user-registered (proprietary) MAC commands
+#if !defined(RADIOLIB_LORAWAN_NUM_CUSTOM_MAC_COMMANDS)
+  #define RADIOLIB_LORAWAN_NUM_CUSTOM_MAC_COMMANDS              (4)
+#endif
+
+// Remote Multicast Setup package (TS005)
+#define RADIOLIB_LORAWAN_MC_PACKAGE_ID                          (0x02)
+#define RADIOLIB_LORAWAN_MC_PACKAGE_VERSION                     (0x01)
+#define RADIOLIB_LORAWAN_MC_PACKAGE_VERSION_REQ                 (0x00)
+#define RADIOLIB_LORAWAN_MC_GROUP_STATUS_REQ                    (0x01)
+#define RADIOLIB_LORAWAN_MC_GROUP_SETUP_REQ                     (0x02)
+#define RADIOLIB_LORAWAN_MC_GROUP_DELETE_REQ                    (0x03)
+#define RADIOLIB_LORAWAN_MC_CLASS_C_SESSION_REQ                 (0x04)
+#define RADIOLIB_LORAWAN_MC_CLASS_B_SESSION_REQ                 (0x05)
+#define RADIOLIB_LORAWAN_MC_GROUP_ID_MASK                       (0x03)
+#define RADIOLIB_LORAWAN_MC_GROUP_ID_ERROR                      (0x01 << 2) //  2     2     McGroupSetupAns: group ID not supported
+#define RADIOLIB_LORAWAN_MC_GROUP_UNDEFINED                     (0x01 << 2) //  2     2     McGroupDeleteAns: group not defined
+#define RADIOLIB_LORAWAN_MC_SESSION_DR_ERROR                    (0x01 << 3) //  3     3     McClassCSessionAns: datarate not supported
+#define RADIOLIB_LORAWAN_MC_SESSION_FREQ_ERROR                  (0x01 << 4) //  4     4                         frequency not supported
+#define RADIOLIB_LORAWAN_MC_SESSION_GROUP_UNDEFINED             (0x01 << 5) //  5     5                         group not defined
+#define RADIOLIB_LORAWAN_NUM_MC_GROUPS                          (4)
+
+// channels in the Session buffer, stored at the position of their index, so the index itself is not saved
+// dynamic bands:           uplink channels: frequency (3 bytes) | DR range (1 byte), downlink channels: frequency (3 bytes)
+// fixed bands:             channels left in the current hopping round, one byte per sub-band
+//                          (the enabled channels are the channel mask of the LinkADR section, in the same format)
+#define RADIOLIB_LORAWAN_SESSION_UL_CHANNEL_LEN                 (4)
+#define RADIOLIB_LORAWAN_SESSION_DL_CHANNEL_LEN                 (3)
+#define RADIOLIB_LORAWAN_SESSION_FIXED_CH_AVAIL                 (RADIOLIB_LORAWAN_SESSION_UL_CHANNELS)
+
+// multicast group context in the Session buffer
+#define RADIOLIB_LORAWAN_SESSION_MC_GROUP_LEN                   (58)
+#define RADIOLIB_LORAWAN_MC_GROUP_ACTIVE_POS                    (0)
+#define RADIOLIB_LORAWAN_MC_GROUP_ADDR_POS                      (1)
+#define RADIOLIB_LORAWAN_MC_GROUP_APP_SKEY_POS                  (5)
+#define RADIOLIB_LORAWAN_MC_GROUP_NWK_SKEY_POS                  (21)
+#define RADIOLIB_LORAWAN_MC_GROUP_FCNT_MIN_POS                  (37)
+#define RADIOLIB_LORAWAN_MC_GROUP_FCNT_MAX_POS                  (41)
+#define RADIOLIB_LORAWAN_MC_GROUP_FCNT_POS                      (45)
+#define RADIOLIB_LORAWAN_MC_GROUP_FREQ_POS                      (49)
+#define RADIOLIB_LORAWAN_MC_GROUP_DR_POS                        (52)
+#define RADIOLIB_LORAWAN_MC_GROUP_SESSION_TIME_POS              (53)
+#define RADIOLIB_LORAWAN_MC_GROUP_SESSION_TIMEOUT_POS           (57)
+
+// Fragmented Data Block Transport package (TS004)
+#define RADIOLIB_LORAWAN_FRAG_PACKAGE_ID                        (0x03)
+#define RADIOLIB_LORAWAN_FRAG_PACKAGE_VERSION                   (0x01)
+#define RADIOLIB_LORAWAN_FRAG_PACKAGE_VERSION_REQ               (0x00)
+#define RADIOLIB_LORAWAN_FRAG_SESSION_STATUS_REQ                (0x01)
+#define RADIOLIB_LORAWAN_FRAG_SESSION_SETUP_REQ                 (0x02)
+#define RADIOLIB_LORAWAN_FRAG_SESSION_DELETE_REQ                (0x03)
+#define RADIOLIB_LORAWAN_FRAG_DATA_FRAGMENT                     (0x08)
+#define RADIOLIB_LORAWAN_FRAG_SETUP_ENCODING_UNSUPPORTED        (0x01 << 0) //  0     0     FragSessionSetupAns: unsupported FEC algorithm
+#define RADIOLIB_LORAWAN_FRAG_SETUP_NOT_ENOUGH_MEMORY           (0x01 << 1) //  1     1                          not enough memory
+#define RADIOLIB_LORAWAN_FRAG_SETUP_INDEX_UNSUPPORTED           (0x01 << 2) //  2     2                          session index not supported
+#define RADIOLIB_LORAWAN_FRAG_SETUP_WRONG_DESCRIPTOR            (0x01 << 3) //  3     3                          descriptor rejected
+#define RADIOLIB_LORAWAN_FRAG_STATUS_MATRIX_MEMORY              (0x01 << 0) //  0     0     FragSessionStatusAns: not enough matrix memory
+#define RADIOLIB_LORAWAN_FRAG_DELETE_NO_SESSION                 (0x01 << 2) //  2     2     FragSessionDeleteAns: session does not exist
+#define RADIOLIB_LORAWAN_FRAG_INDEX_MASK                        (0x03)
+#define RADIOLIB_LORAWAN_FRAG_NUMBER_MASK                       (0x3FFF)
+
+// maximum number of fragments in a session (only used in static-only mode)
+#if !defined(RADIOLIB_LORAWAN_FRAG_MAX_NB_FRAG)
+  #define RADIOLIB_LORAWAN_FRAG_MAX_NB_FRAG                     (1024)
+#endif
+
+// maximum number of lost fragments that can be recovered through forward error correction
+// this determines the size of the decoding matrix, which takes (N*N)/8 bytes
+#if !defined(RADIOLIB_LORAWAN_FRAG_MAX_MISSING)
+  #define RADIOLIB_LORAWAN_FRAG_MAX_MISSING                     (64)
+#endif
+
+// relay role - forwarding towards the network follows TS011 (FPort 226 with uplink metadata),
+// the wake-on-radio frames between end device and relay use the TS011 session keys (RootWorSKey, WorSIntKey, WorSEncKey)
+// and a WOR frame counter, but a layout of their own, so only end devices using this library can wake the relay
+#define RADIOLIB_LORAWAN_RELAY_WOR_UPLINK                       (RADIOLIB_LORAWAN_MHDR_MTYPE_PROPRIETARY | 0x00)
+#define RADIOLIB_LORAWAN_RELAY_WOR_ACK                          (RADIOLIB_LORAWAN_MHDR_MTYPE_PROPRIETARY | 0x01)
+#define RADIOLIB_LORAWAN_RELAY_WOR_LEN                          (17)  // MHDR | DevAddr | WFCnt | ULFreq | ULDR | MIC
+#define RADIOLIB_LORAWAN_RELAY_WOR_ACK_LEN                      (9)   // MHDR | DevAddr | MIC
+#define RADIOLIB_LORAWAN_RELAY_WOR_DEV_ADDR_POS                 (1)
+#define RADIOLIB_LORAWAN_RELAY_WOR_WFCNT_POS                    (5)
+#define RADIOLIB_LORAWAN_RELAY_WOR_PAYLOAD_POS                  (9)   // ULFreq | ULDR, encrypted with WorSEncKey
+#define RADIOLIB_LORAWAN_RELAY_WOR_PAYLOAD_LEN                  (4)
+#define RADIOLIB_LORAWAN_RELAY_WOR_PREAMBLE_LEN                 (32)  // long enough to be caught by the CAD loop of the relay
+#define RADIOLIB_LORAWAN_RELAY_WOR_ACK_DELAY                    (10)  // gives the end device time to start receiving
+#define RADIOLIB_LORAWAN_RELAY_METADATA_LEN                     (6)   // UplinkMetadata | Frequency
+#define RADIOLIB_LORAWAN_RELAY_PHY_PAYLOAD_MIN_LEN              (12)  // MHDR | DevAddr | FCtrl | FCnt | MIC
+#define RADIOLIB_LORAWAN_RELAY_PHY_PAYLOAD_MAX_LEN              (230 - RADIOLIB_LORAWAN_RELAY_METADATA_LEN)
+
+// maximum number of end devices in the relay trust list
+#if !defined(RADIOLIB_LORAWAN_RELAY_MAX_DEVICES)
+  #define RADIOLIB_LORAWAN_RELAY_MAX_DEVICES                    (16)
+#endif
+
+// maximum number of regulatory duty cycle sub-bands in a band
+#define RADIOLIB_LORAWAN_NUM_DUTY_CYCLE_BANDS                   (6)
+
+// airtime is accounted over a sliding hour, split into this many time slots
+// more slots make the accounting more accurate, but take more memory
+#if !defined(RADIOLIB_LORAWAN_AIRTIME_NUM_SLOTS)
+  #define RADIOLIB_LORAWAN_AIRTIME_NUM_SLOTS                    (6)
+#endif
+#define RADIOLIB_LORAWAN_AIRTIME_SLOT_LEN                       ((RadioLibTime_t)3600000 / RADIOLIB_LORAWAN_AIRTIME_NUM_SLOTS)
+
+// number of most recent uplink datarates kept in the node statistics
+#if !defined(RADIOLIB_LORAWAN_STATS_DR_HISTORY_LEN)
+  #define RADIOLIB_LORAWAN_STATS_DR_HISTORY_LEN                 (16)
+#endif
+
+// uplink aggregation: number of FPorts that can be aggregated at the same time
+#if !defined(RADIOLIB_LORAWAN_AGGR_NUM_PORTS)
+  #define RADIOLIB_LORAWAN_AGGR_NUM_PORTS                       (2)
+#endif
+
+// aggregated record:       type (1 byte) | length (1 byte) | value (length bytes)
+#define RADIOLIB_LORAWAN_AGGR_RECORD_HDR_LEN                    (2)
+
+// the length of application layer package answer buffer
+#define RADIOLIB_LORAWAN_PACKAGE_ANS_MAX_LEN                    (48)
+
+// session journal layout:  snapshot slot A | snapshot slot B | delta records
+// snapshot slot:           generation (4 bytes) | session snapshot (SESSION_BUF_SIZE bytes) | CRC (2 bytes)
+// delta record:            generation (4 bytes) | offset (2 bytes) | length (1 byte) | data (length bytes) | CRC (2 bytes)
+#define RADIOLIB_LORAWAN_JOURNAL_SLOT_SNAPSHOT_POS              (4)
+#define RADIOLIB_LORAWAN_JOURNAL_SLOT_CRC_POS                   (RADIOLIB_LORAWAN_JOURNAL_SLOT_SNAPSHOT_POS + RADIOLIB_LORAWAN_SESSION_BUF_SIZE)
+#define RADIOLIB_LORAWAN_JOURNAL_SLOT_LEN                       (RADIOLIB_LORAWAN_JOURNAL_SLOT_CRC_POS + 2)
+#define RADIOLIB_LORAWAN_JOURNAL_NUM_SLOTS                      (2)
+#define RADIOLIB_LORAWAN_JOURNAL_RECORDS_POS                    (RADIOLIB_LORAWAN_JOURNAL_NUM_SLOTS*RADIOLIB_LORAWAN_JOURNAL_SLOT_LEN)
+#define RADIOLIB_LORAWAN_JOURNAL_RECORD_HDR_LEN                 (7)
+#define RADIOLIB_LORAWAN_JOURNAL_RECORD_OVERHEAD                (RADIOLIB_LORAWAN_JOURNAL_RECORD_HDR_LEN + 2)
+#define RADIOLIB_LORAWAN_JOURNAL_RECORD_MAX_LEN                 (0xFF)
+#define RADIOLIB_LORAWAN_JOURNAL_GEN_NONE                       (0xFFFFFFFF)
+#define RADIOLIB_LORAWAN_JOURNAL_SLOT_NONE                      (0xFF)
+
 /*!
   \struct LoRaWANMacCommand_t
   \brief MAC command specification structure.
@@ -250,7 +423,92 @@ constexpr LoRaWANMacCommand_t MacTable[RADIOLIB_LORAWAN_NUM_MAC_COMMANDS] = {
   { RADIOLIB_LORAWAN_MAC_PROPRIETARY,         5, 0, false, true  },
 };
 
-#define RADIOLIB_LORAWAN_NONCES_VERSION_VAL (0x0001)
+/*!
+  \struct LoRaWANLoRaDataRate_t
+  \brief Modulation parameters and airtime of a LoRa datarate, see LoRaDataRateTable.
+*/
+struct LoRaWANLoRaDataRate_t {
+  /*! \brief Spreading factor, 0 if the datarate field is not a valid LoRa datarate */
+  const uint8_t sf;
+
+  /*! \brief Whether low data rate optimization is used, as the radios do for symbols of 16 ms or longer */
+  const bool ldro;
+
+  /*! \brief Bandwidth in kHz */
+  const float bw;
+
+  /*! \brief Symbol duration in microseconds */
+  const uint32_t symbolUs;
+
+  /*! \brief Airtime per payload byte in microseconds at coding rate 4/5, without preamble and header */
+  const uint32_t byteUs;
+};
+
+// LoRa datarates are looked up by the spreading factor and bandwidth bits of the band datarate field
+#define RADIOLIB_LORAWAN_LORA_DATA_RATE_IDX(DR)                 (((DR) & (RADIOLIB_LORAWAN_DATA_RATE_SF | RADIOLIB_LORAWAN_DATA_RATE_BW)) >> 1)
+#define RADIOLIB_LORAWAN_LORA_DATA_RATE_NUM                     (32)
+
+// helpers to generate LoRaDataRateTable at compile time, from the index of the table entry
+constexpr uint8_t loraDataRateSf(uint8_t idx) {
+  return((((idx >> 2) <= 5) && ((idx & 0x03) <= 2)) ? (idx >> 2) + 7 : 0);
+}
+
+constexpr uint32_t loraDataRateSymbolUs(uint8_t idx) {
+  return(loraDataRateSf(idx) ? ((uint32_t)8 << loraDataRateSf(idx)) >> (idx & 0x03) : 0);
+}
+
+constexpr bool loraDataRateLdro(uint8_t idx) {
+  return(loraDataRateSymbolUs(idx) >= 16000);
+}
+
+// 8 bits per byte, spread over SF - 2*LDRO bits per symbol, with 5 coded bits for every 4 bits
+constexpr uint32_t loraDataRateByteUs(uint8_t idx) {
+  return(loraDataRateSf(idx) ? (loraDataRateSymbolUs(idx) * 10) / (loraDataRateSf(idx) - (loraDataRateLdro(idx) ? 2 : 0)) : 0);
+}
+
+#define RADIOLIB_LORAWAN_LORA_DATA_RATE(IDX) { loraDataRateSf(IDX), loraDataRateLdro(IDX), 125.0f * (1 << ((IDX) & 0x03)), \
+                                               loraDataRateSymbolUs(IDX), loraDataRateByteUs(IDX) }
+
+constexpr LoRaWANLoRaDataRate_t LoRaDataRateTable[RADIOLIB_LORAWAN_LORA_DATA_RATE_NUM] = {
+  RADIOLIB_LORAWAN_LORA_DATA_RATE(0),  RADIOLIB_LORAWAN_LORA_DATA_RATE(1),  RADIOLIB_LORAWAN_LORA_DATA_RATE(2),  RADIOLIB_LORAWAN_LORA_DATA_RATE(3),
+  RADIOLIB_LORAWAN_LORA_DATA_RATE(4),  RADIOLIB_LORAWAN_LORA_DATA_RATE(5),  RADIOLIB_LORAWAN_LORA_DATA_RATE(6),  RADIOLIB_LORAWAN_LORA_DATA_RATE(7),
+  RADIOLIB_LORAWAN_LORA_DATA_RATE(8),  RADIOLIB_LORAWAN_LORA_DATA_RATE(9),  RADIOLIB_LORAWAN_LORA_DATA_RATE(10), RADIOLIB_LORAWAN_LORA_DATA_RATE(11),
+  RADIOLIB_LORAWAN_LORA_DATA_RATE(12), RADIOLIB_LORAWAN_LORA_DATA_RATE(13), RADIOLIB_LORAWAN_LORA_DATA_RATE(14), RADIOLIB_LORAWAN_LORA_DATA_RATE(15),
+  RADIOLIB_LORAWAN_LORA_DATA_RATE(16), RADIOLIB_LORAWAN_LORA_DATA_RATE(17), RADIOLIB_LORAWAN_LORA_DATA_RATE(18), RADIOLIB_LORAWAN_LORA_DATA_RATE(19),
+  RADIOLIB_LORAWAN_LORA_DATA_RATE(20), RADIOLIB_LORAWAN_LORA_DATA_RATE(21), RADIOLIB_LORAWAN_LORA_DATA_RATE(22), RADIOLIB_LORAWAN_LORA_DATA_RATE(23),
+  RADIOLIB_LORAWAN_LORA_DATA_RATE(24), RADIOLIB_LORAWAN_LORA_DATA_RATE(25), RADIOLIB_LORAWAN_LORA_DATA_RATE(26), RADIOLIB_LORAWAN_LORA_DATA_RATE(27),
+  RADIOLIB_LORAWAN_LORA_DATA_RATE(28), RADIOLIB_LORAWAN_LORA_DATA_RATE(29), RADIOLIB_LORAWAN_LORA_DATA_RATE(30), RADIOLIB_LORAWAN_LORA_DATA_RATE(31),
+};
+
+/*!
+  \brief Callback to handle a user-registered (proprietary) MAC command received from the server.
+  \param cid ID of the MAC command.
+  \param optIn Pointer to the command payload, directly in the decrypted downlink buffer.
+  \param lenIn Length of the command payload, as registered.
+  \param optOut Buffer to write the answer payload into (as many bytes as registered for the answer).
+  \returns Whether an answer should be sent in the next uplink.
+*/
+typedef bool (*LoRaWANMacCommandCb_t)(uint8_t cid, const uint8_t* optIn, uint8_t lenIn, uint8_t* optOut);
+
+/*!
+  \struct LoRaWANCustomMacCommand_t
+  \brief Structure to save a user-registered (proprietary) MAC command.
+*/
+struct LoRaWANCustomMacCommand_t {
+  /*! \brief Command ID, 0 if this entry is not used */
+  uint8_t cid;
+
+  /*! \brief Downlink (request) payload length */
+  uint8_t lenDn;
+
+  /*! \brief Uplink (answer) payload length */
+  uint8_t lenUp;
+
+  /*! \brief Handler to call when the command is received */
+  LoRaWANMacCommandCb_t cb;
+};
+
+#define RADIOLIB_LORAWAN_NONCES_VERSION_VAL (0x0002)
 
 enum LoRaWANSchemeBase_t {
   RADIOLIB_LORAWAN_NONCES_START       = 0x00,
@@ -260,7 +518,8 @@ enum LoRaWANSchemeBase_t {
   RADIOLIB_LORAWAN_NONCES_PLAN        = RADIOLIB_LORAWAN_NONCES_CLASS + sizeof(uint8_t),          // 1 byte
   RADIOLIB_LORAWAN_NONCES_CHECKSUM    = RADIOLIB_LORAWAN_NONCES_PLAN + sizeof(uint8_t),           // 2 bytes
   RADIOLIB_LORAWAN_NONCES_DEV_NONCE   = RADIOLIB_LORAWAN_NONCES_CHECKSUM + sizeof(uint16_t),      // 2 bytes
-  RADIOLIB_LORAWAN_NONCES_JOIN_NONCE  = RADIOLIB_LORAWAN_NONCES_DEV_NONCE + sizeof(uint16_t),     // 3 bytes
+  RADIOLIB_LORAWAN_NONCES_RJ_COUNT1   = RADIOLIB_LORAWAN_NONCES_DEV_NONCE + sizeof(uint16_t),     // 2 bytes
+  RADIOLIB_LORAWAN_NONCES_JOIN_NONCE  = RADIOLIB_LORAWAN_NONCES_RJ_COUNT1 + sizeof(uint16_t),     // 3 bytes
   RADIOLIB_LORAWAN_NONCES_ACTIVE      = RADIOLIB_LORAWAN_NONCES_JOIN_NONCE + 3,                   // 1 byte
   RADIOLIB_LORAWAN_NONCES_SIGNATURE   = RADIOLIB_LORAWAN_NONCES_ACTIVE + sizeof(uint8_t),         // 2 bytes
   RADIOLIB_LORAWAN_NONCES_BUF_SIZE    = RADIOLIB_LORAWAN_NONCES_SIGNATURE + sizeof(uint16_t)      // Nonces buffer size
@@ -281,8 +540,7 @@ enum LoRaWANSchemeSession_t {
   RADIOLIB_LORAWAN_SESSION_CONF_FCNT_UP       = RADIOLIB_LORAWAN_SESSION_ADR_FCNT + sizeof(uint32_t), 	    // 4 bytes
   RADIOLIB_LORAWAN_SESSION_CONF_FCNT_DOWN     = RADIOLIB_LORAWAN_SESSION_CONF_FCNT_UP + sizeof(uint32_t),   // 4 bytes
   RADIOLIB_LORAWAN_SESSION_RJ_COUNT0          = RADIOLIB_LORAWAN_SESSION_CONF_FCNT_DOWN + sizeof(uint32_t), // 2 bytes
-  RADIOLIB_LORAWAN_SESSION_RJ_COUNT1          = RADIOLIB_LORAWAN_SESSION_RJ_COUNT0 + sizeof(uint16_t), 	    // 2 bytes
-  RADIOLIB_LORAWAN_SESSION_HOMENET_ID         = RADIOLIB_LORAWAN_SESSION_RJ_COUNT1 + sizeof(uint16_t), 	    // 4 bytes
+  RADIOLIB_LORAWAN_SESSION_HOMENET_ID         = RADIOLIB_LORAWAN_SESSION_RJ_COUNT0 + sizeof(uint16_t), 	    // 4 bytes
   RADIOLIB_LORAWAN_SESSION_VERSION            = RADIOLIB_LORAWAN_SESSION_HOMENET_ID + sizeof(uint32_t), 	  // 1 byte
   RADIOLIB_LORAWAN_SESSION_LINK_ADR           = RADIOLIB_LORAWAN_SESSION_VERSION + sizeof(uint8_t),         // 14 bytes
   RADIOLIB_LORAWAN_SESSION_DUTY_CYCLE         = RADIOLIB_LORAWAN_SESSION_LINK_ADR + 14, 	        // 1 byte
@@ -295,12 +553,13 @@ enum LoRaWANSchemeSession_t {
   RADIOLIB_LORAWAN_SESSION_PING_SLOT_CHANNEL  = RADIOLIB_LORAWAN_SESSION_BEACON_FREQ + 3, 	      // 4 bytes
   RADIOLIB_LORAWAN_SESSION_PERIODICITY        = RADIOLIB_LORAWAN_SESSION_PING_SLOT_CHANNEL + 4,   // 1 byte
   RADIOLIB_LORAWAN_SESSION_LAST_TIME          = RADIOLIB_LORAWAN_SESSION_PERIODICITY + 1, 	      // 4 bytes
-  RADIOLIB_LORAWAN_SESSION_UL_CHANNELS        = RADIOLIB_LORAWAN_SESSION_LAST_TIME + 4, 	        // 16*5 bytes
-  RADIOLIB_LORAWAN_SESSION_DL_CHANNELS        = RADIOLIB_LORAWAN_SESSION_UL_CHANNELS + RADIOLIB_LORAWAN_NUM_AVAILABLE_CHANNELS*5, // 16*4 bytes
-  RADIOLIB_LORAWAN_SESSION_AVAILABLE_CHANNELS = RADIOLIB_LORAWAN_SESSION_DL_CHANNELS + RADIOLIB_LORAWAN_NUM_AVAILABLE_CHANNELS*4, // 2 bytes
+  RADIOLIB_LORAWAN_SESSION_UL_CHANNELS        = RADIOLIB_LORAWAN_SESSION_LAST_TIME + 4, 	        // 16*4 bytes
+  RADIOLIB_LORAWAN_SESSION_DL_CHANNELS        = RADIOLIB_LORAWAN_SESSION_UL_CHANNELS + RADIOLIB_LORAWAN_NUM_AVAILABLE_CHANNELS*RADIOLIB_LORAWAN_SESSION_UL_CHANNEL_LEN, // 16*3 bytes
+  RADIOLIB_LORAWAN_SESSION_AVAILABLE_CHANNELS = RADIOLIB_LORAWAN_SESSION_DL_CHANNELS + RADIOLIB_LORAWAN_NUM_AVAILABLE_CHANNELS*RADIOLIB_LORAWAN_SESSION_DL_CHANNEL_LEN, // 2 bytes
   RADIOLIB_LORAWAN_SESSION_MAC_QUEUE          = RADIOLIB_LORAWAN_SESSION_AVAILABLE_CHANNELS + sizeof(uint16_t),                   // 15 bytes
   RADIOLIB_LORAWAN_SESSION_MAC_QUEUE_LEN      = RADIOLIB_LORAWAN_SESSION_MAC_QUEUE + RADIOLIB_LORAWAN_FHDR_FOPTS_MAX_LEN,         // 1 byte
-  RADIOLIB_LORAWAN_SESSION_SIGNATURE          = RADIOLIB_LORAWAN_SESSION_MAC_QUEUE_LEN + sizeof(uint8_t),   // 2 bytes
+  RADIOLIB_LORAWAN_SESSION_MC_GROUPS          = RADIOLIB_LORAWAN_SESSION_MAC_QUEUE_LEN + sizeof(uint8_t),   // 4*58 bytes
+  RADIOLIB_LORAWAN_SESSION_SIGNATURE          = RADIOLIB_LORAWAN_SESSION_MC_GROUPS + RADIOLIB_LORAWAN_NUM_MC_GROUPS*RADIOLIB_LORAWAN_SESSION_MC_GROUP_LEN,   // 2 bytes
   RADIOLIB_LORAWAN_SESSION_BUF_SIZE           = RADIOLIB_LORAWAN_SESSION_SIGNATURE + sizeof(uint16_t)       // Session buffer size
 };
 
@@ -364,6 +623,36 @@ struct LoRaWANChannelSpan_t {
 // alias for unused channel span
 #define RADIOLIB_LORAWAN_CHANNEL_SPAN_NONE    { .numChannels = 0, .freqStart = 0, .freqStep = 0, .drMin = 0, .drMax = 0, .drJoinRequest = RADIOLIB_LORAWAN_DATA_RATE_UNUSED }
 
+/*!
+  \struct LoRaWANDutyCycleBand_t
+  \brief Structure to save information about a regulatory sub-band with its own duty cycle limit.
+*/
+struct LoRaWANDutyCycleBand_t {
+  /*! \brief Lowest frequency in the sub-band (coded in 100 Hz steps) */
+  uint32_t freqStart;
+
+  /*! \brief Highest frequency in the sub-band (coded in 100 Hz steps) */
+  uint32_t freqEnd;
+
+  /*! \brief Number of milliseconds per hour of allowed Time-on-Air in the sub-band */
+  RadioLibTime_t dutyCycle;
+};
+
+/*!
+  \struct LoRaWANAirtimeLedger_t
+  \brief Structure to keep track of the Time-on-Air used during the last hour, split into time slots.
+*/
+struct LoRaWANAirtimeLedger_t {
+  /*! \brief Index of the most recent time slot */
+  uint8_t slot;
+
+  /*! \brief Clock time at the start of the most recent time slot */
+  RadioLibTime_t slotStart;
+
+  /*! \brief Time-on-Air in milliseconds used in each time slot, indexed by slot number modulo number of slots */
+  RadioLibTime_t airtime[RADIOLIB_LORAWAN_AIRTIME_NUM_SLOTS + 1];
+};
+
 /*!
   \struct LoRaWANBand_t
   \brief Structure to save information about LoRaWAN band
@@ -393,6 +682,12 @@ struct LoRaWANBand_t {
   /*! \brief Number of milliseconds per hour of allowed Time-on-Air */
   RadioLibTime_t dutyCycle;
 
+  /*! \brief Number of regulatory sub-bands with separate duty cycle limits (0 if the limit is band-wide) */
+  uint8_t numDutyCycleBands;
+
+  /*! \brief Regulatory sub-bands with separate duty cycle limits, NULL if the limit is band-wide */
+  const LoRaWANDutyCycleBand_t* dutyCycleBands;
+
   /*! \brief Maximum dwell time per uplink message in milliseconds */
   RadioLibTime_t dwellTimeUp;
 
@@ -433,17 +728,41 @@ struct LoRaWANBand_t {
 };
 
 // supported bands
+// unused bands can be removed from the build to save memory by defining RADIOLIB_EXCLUDE_LORAWAN_<band>,
+// e.g. RADIOLIB_EXCLUDE_LORAWAN_US915; excluded bands are NULL in the LoRaWANBands array
+#if !RADIOLIB_EXCLUDE_LORAWAN_EU868
 extern const LoRaWANBand_t EU868;
+#endif
+#if !RADIOLIB_EXCLUDE_LORAWAN_US915
 extern const LoRaWANBand_t US915;
+#endif
+#if !RADIOLIB_EXCLUDE_LORAWAN_EU433
 extern const LoRaWANBand_t EU433;
+#endif
+#if !RADIOLIB_EXCLUDE_LORAWAN_AU915
 extern const LoRaWANBand_t AU915;
+#endif
+#if !RADIOLIB_EXCLUDE_LORAWAN_CN500
 extern const LoRaWANBand_t CN500;
+#endif
+#if !RADIOLIB_EXCLUDE_LORAWAN_AS923
 extern const LoRaWANBand_t AS923;
+#endif
+#if !RADIOLIB_EXCLUDE_LORAWAN_AS923_2
 extern const LoRaWANBand_t AS923_2;
+#endif
+#if !RADIOLIB_EXCLUDE_LORAWAN_AS923_3
 extern const LoRaWANBand_t AS923_3;
+#endif
+#if !RADIOLIB_EXCLUDE_LORAWAN_AS923_4
 extern const LoRaWANBand_t AS923_4;
+#endif
+#if !RADIOLIB_EXCLUDE_LORAWAN_KR920
 extern const LoRaWANBand_t KR920;
+#endif
+#if !RADIOLIB_EXCLUDE_LORAWAN_IN865
 extern const LoRaWANBand_t IN865;
+#endif
 
 /*!
   \struct LoRaWANBandNum_t
@@ -522,6 +841,171 @@ struct LoRaWANEvent_t {
   uint8_t nbTrans;
 };
 
+/*!
+  \struct LoRaWANStats_t
+  \brief Structure to save statistics about the operation of a node (e.g. for field diagnostics or network simulations).
+*/
+struct LoRaWANStats_t {
+  /*! \brief Number of JoinRequests and RejoinRequests sent */
+  uint32_t numJoinRequests;
+
+  /*! \brief Number of uplinks sent (one per call to sendReceive, regardless of retransmissions) */
+  uint32_t numUplinks;
+
+  /*! \brief Number of transmissions, including retransmissions */
+  uint32_t numTransmissions;
+
+  /*! \brief Number of downlinks received in an Rx window */
+  uint32_t numDownlinks;
+
+  /*! \brief Total Time-on-Air of all JoinRequests and uplinks in milliseconds */
+  RadioLibTime_t airtime;
+
+  /*! \brief Number of times the uplink datarate changed between consecutive uplinks */
+  uint32_t numDrChanges;
+
+  /*! \brief Datarates of the most recent uplinks, oldest first */
+  uint8_t drHistory[RADIOLIB_LORAWAN_STATS_DR_HISTORY_LEN];
+
+  /*! \brief Number of valid entries in the datarate history */
+  uint8_t drHistoryLen;
+
+  /*! \brief Number of received frames dropped because they were not data downlinks addressed to this device */
+  uint32_t numDownlinksForeign;
+
+  /*! \brief Number of received frames dropped because of an invalid frame counter (e.g. replayed frames) */
+  uint32_t numDownlinksFCntInvalid;
+
+  /*! \brief Number of received frames dropped because of a MIC mismatch */
+  uint32_t numDownlinksMicInvalid;
+};
+
+/*!
+  \struct LoRaWANMulticastGroup_t
+  \brief Structure to save multicast group context (TS005 Remote Multicast Setup).
+*/
+struct LoRaWANMulticastGroup_t {
+  /*! \brief Whether this group is defined */
+  bool active;
+
+  /*! \brief Multicast address (McAddr) */
+  uint32_t addr;
+
+  /*! \brief Multicast application session key (McAppSKey) */
+  uint8_t appSKey[RADIOLIB_AES128_KEY_SIZE];
+
+  /*! \brief Multicast network session key (McNwkSKey) */
+  uint8_t nwkSKey[RADIOLIB_AES128_KEY_SIZE];
+
+  /*! \brief Lowest frame counter value that is accepted for this group */
+  uint32_t fCntMin;
+
+  /*! \brief Highest frame counter value that is accepted for this group */
+  uint32_t fCntMax;
+
+  /*! \brief Last received frame counter, RADIOLIB_LORAWAN_FCNT_NONE if nothing was received yet */
+  uint32_t fCnt;
+
+  /*! \brief Downlink channel of the Class C multicast session */
+  LoRaWANChannel_t channel;
+
+  /*! \brief Start of the Class C multicast session (seconds since GPS epoch) */
+  uint32_t sessionTime;
+
+  /*! \brief Maximum duration of the Class C multicast session, as 2^timeout seconds */
+  uint8_t sessionTimeout;
+};
+
+/*!
+  \struct LoRaWANFragSession_t
+  \brief Structure to save fragmentation session context (TS004 Fragmented Data Block Transport).
+*/
+struct LoRaWANFragSession_t {
+  /*! \brief Whether this session is set up */
+  bool active;
+
+  /*! \brief Session index (FragIndex) */
+  uint8_t index;
+
+  /*! \brief Multicast groups allowed to carry fragments of this session */
+  uint8_t mcGroupMask;
+
+  /*! \brief Number of uncoded fragments the data block is split into */
+  uint16_t nbFrag;
+
+  /*! \brief Size of each fragment in bytes */
+  uint8_t fragSize;
+
+  /*! \brief Number of padding bytes in the last fragment */
+  uint8_t padding;
+
+  /*! \brief Application-specific data block descriptor */
+  uint32_t descriptor;
+
+  /*! \brief Total number of received fragments (both uncoded and coded) */
+  uint16_t nbReceived;
+
+  /*! \brief Number of fragments that were missing when the first coded fragment arrived */
+  uint16_t nbMissing;
+
+  /*! \brief Number of rows stored in the decoding matrix */
+  uint16_t nbRows;
+
+  /*! \brief Whether a coded fragment was received, i.e. the set of missing fragments is fixed */
+  bool decoding;
+
+  /*! \brief Whether too many fragments are missing to fit the decoding matrix */
+  bool matrixFull;
+
+  /*! \brief Whether the complete data block was received or recovered */
+  bool complete;
+};
+
+/*!
+  \struct LoRaWANRelayDevice_t
+  \brief Structure to save an end device that is allowed to use the relay (relay trust list).
+*/
+struct LoRaWANRelayDevice_t {
+  /*! \brief Whether this entry is in use */
+  bool active;
+
+  /*! \brief Device address of the end device */
+  uint32_t devAddr;
+
+  /*! \brief Key used to authenticate WOR frames and WOR ACKs of this device (WorSIntKey) */
+  uint8_t worSIntKey[RADIOLIB_AES128_KEY_SIZE];
+
+  /*! \brief Key used to encrypt the uplink channel in WOR frames of this device (WorSEncKey) */
+  uint8_t worSEncKey[RADIOLIB_AES128_KEY_SIZE];
+
+  /*! \brief Lowest WOR frame counter that is accepted from this device, older ones are replays */
+  uint32_t wfCntNext;
+
+  /*! \brief Number of uplinks forwarded for this device */
+  uint32_t numForwarded;
+};
+
+/*!
+  \struct LoRaWANAggregate_t
+  \brief Structure to save the state of records aggregated for a single FPort.
+*/
+struct LoRaWANAggregate_t {
+  /*! \brief FPort the records will be sent on, 0 if this entry is not used */
+  uint8_t fPort;
+
+  /*! \brief Number of buffered bytes */
+  uint8_t len;
+
+  /*! \brief Timestamp of the oldest buffered record */
+  RadioLibTime_t tFirst;
+};
+
+/*! \brief Callback to read from user-provided storage (e.g. external Flash or EEPROM). */
+typedef int16_t (*LoRaWANStorageReadCb_t)(uint32_t addr, uint8_t* data, size_t len);
+
+/*! \brief Callback to write into user-provided storage (e.g. external Flash or EEPROM). */
+typedef int16_t (*LoRaWANStorageWriteCb_t)(uint32_t addr, const uint8_t* data, size_t len);
+
 /*!
   \class LoRaWANNode
   \brief LoRaWAN-compatible node (class A device).
@@ -537,6 +1021,11 @@ class LoRaWANNode {
     */
     LoRaWANNode(PhysicalLayer* phy, const LoRaWANBand_t* band, uint8_t subBand = 0);
 
+    /*!
+      \brief Default destructor.
+    */
+    virtual ~LoRaWANNode();
+
     /*!
       \brief Returns the pointer to the internal buffer that holds the LW base parameters
       \returns Pointer to uint8_t array of size RADIOLIB_LORAWAN_NONCES_BUF_SIZE
@@ -568,6 +1057,45 @@ class LoRaWANNode {
     */
     int16_t setBufferSession(const uint8_t* persistentBuffer);
 
+    /*!
+      \brief Enable incremental session persistence. Instead of rewriting the whole session buffer,
+      only the bytes that changed since the last save (frame counters, MAC state) are appended to a journal
+      in the user-provided storage. Once the journal is full, it is compacted into a new session snapshot.
+      The session is automatically saved after every uplink.
+      Snapshots alternate between two slots, so an interrupted compaction always leaves the previous snapshot
+      and its records intact. Every snapshot and record carries a 32-bit generation and a CRC,
+      so partially written data and records of older snapshots are never replayed.
+      The storage is expected to behave like EEPROM or FRAM: writing a range must not change any other byte,
+      and a write interrupted by power loss may only corrupt the range being written. On Flash, this requires
+      an EEPROM emulation layer in the callbacks; erasing a whole page from within the write callback
+      would destroy data that is still needed if power is lost before the page is rewritten.
+      \param readCb Callback to read from the storage.
+      \param writeCb Callback to write into the storage.
+      \param size Size of the storage in bytes, must be larger than RADIOLIB_LORAWAN_JOURNAL_RECORDS_POS.
+      \returns \ref status_codes
+    */
+    int16_t beginJournal(LoRaWANStorageReadCb_t readCb, LoRaWANStorageWriteCb_t writeCb, size_t size);
+
+    /*!
+      \brief Restore the session from the journal by reading the last snapshot and replaying all delta records.
+      Must be called after restoring the Nonces buffer and before activation, in place of setBufferSession.
+      \returns \ref status_codes
+    */
+    int16_t restoreJournal();
+
+    /*!
+      \brief Append the changes of the session since the last save to the journal.
+      Only needs to be called manually when the session changes outside of an uplink (e.g. after activation).
+      \returns \ref status_codes
+    */
+    int16_t saveJournal();
+
+    /*!
+      \brief Write the complete session as a new snapshot, discarding all journal records.
+      \returns \ref status_codes
+    */
+    int16_t compactJournal();
+
     /*!
       \brief Set the device credentials and activation configuration
       \param joinEUI 8-byte application identifier.
@@ -609,6 +1137,36 @@ class LoRaWANNode {
     /*! \brief Whether there is an ongoing session active */
     bool isActivated();
 
+    /*!
+      \brief Send a Rejoin-Request and process the JoinAccept if the network answers (LoRaWAN 1.1 OTAA only).
+      Type 0 resets the complete session including radio parameters, type 1 restores a session that was lost
+      (e.g. while roaming) and type 2 only rekeys the session and changes the device address.
+      If the network does not answer, the current session remains in use.
+      \param rejoinType Type of the Rejoin-Request, one of RADIOLIB_LORAWAN_JOIN_REQUEST_TYPE_0, _1 or _2.
+      \param joinEvent Pointer to a structure to store extra information about the event.
+      If set to NULL, no extra information will be passed to the user.
+      \returns RADIOLIB_LORAWAN_NEW_SESSION if the session was refreshed,
+      RADIOLIB_ERR_NO_JOIN_ACCEPT if the network did not answer, otherwise \ref status_codes
+    */
+    int16_t sendRejoinRequest(uint8_t rejoinType, LoRaWANJoinEvent_t* joinEvent = NULL);
+
+    /*!
+      \brief Check whether a Rejoin-Request is due. This is the case periodically, after the number of uplinks
+      or the time configured by the network in RejoinParamSetupReq, or when the network requested it in ForceRejoinReq.
+      \returns Whether a Rejoin-Request should be sent.
+    */
+    bool isRejoinDue();
+
+    /*!
+      \brief Send a Rejoin-Request if one is due (see isRejoinDue). Should be called regularly, e.g. after every uplink.
+      Periodic Rejoin-Requests are of type 0, forced Rejoin-Requests use the type and datarate requested by the network.
+      \param joinEvent Pointer to a structure to store extra information about the event.
+      If set to NULL, no extra information will be passed to the user.
+      \returns RADIOLIB_LORAWAN_NEW_SESSION if the session was refreshed,
+      RADIOLIB_ERR_NONE if no Rejoin-Request was due or the network did not answer, otherwise \ref status_codes
+    */
+    int16_t rejoinIfDue(LoRaWANJoinEvent_t* joinEvent = NULL);
+
     #if defined(RADIOLIB_BUILD_ARDUINO)
     /*!
       \brief Send a message to the server and wait for a downlink during Rx1 and/or Rx2 window.
@@ -685,12 +1243,32 @@ class LoRaWANNode {
 
     /*!
       \brief Add a MAC command to the uplink queue.
-      Only LinkCheck and DeviceTime are available to the user. 
+      Only LinkCheck, DeviceTime and registered proprietary commands are available to the user. 
       Other commands are ignored; duplicate MAC commands are discarded.
       \param cid ID of the MAC command
+      \param payload Payload of the MAC command, required if the command has a non-zero uplink length.
       \returns \ref status_codes
     */
-    int16_t sendMacCommandReq(uint8_t cid);
+    int16_t sendMacCommandReq(uint8_t cid, const uint8_t* payload = NULL);
+
+    /*!
+      \brief Register a proprietary MAC command, so that it can be received in downlinks and sent in uplinks.
+      If the command is already registered, its lengths and handler are updated.
+      \param cid ID of the MAC command, must be in the proprietary range (0x80 - 0xFF).
+      \param lenDn Length of the downlink (request) payload.
+      \param lenUp Length of the uplink (answer) payload.
+      \param cb Handler called when the command is received in a downlink. May be NULL for uplink-only commands.
+      \returns \ref status_codes, RADIOLIB_ERR_MAC_COMMAND_REGISTRY_FULL if all
+      RADIOLIB_LORAWAN_NUM_CUSTOM_MAC_COMMANDS entries are taken.
+    */
+    int16_t setMacCommandHandler(uint8_t cid, uint8_t lenDn, uint8_t lenUp, LoRaWANMacCommandCb_t cb);
+
+    /*!
+      \brief Remove a registered proprietary MAC command.
+      \param cid ID of the MAC command.
+      \returns \ref status_codes
+    */
+    int16_t clearMacCommandHandler(uint8_t cid);
 
     /*!
       \brief Returns the quality of connectivity after requesting a LinkCheck MAC command.
@@ -741,6 +1319,24 @@ class LoRaWANNode {
     */
     void setADR(bool enable = true);
 
+    /*!
+      \brief Toggle device-side adaptive uplink control. This is only applied while ADR is disabled (see setADR).
+      Before each uplink, the datarate, Tx power and number of transmissions are adjusted based on the uplink margin
+      from the last LinkCheckAns. Without a LinkCheckAns, the margin is estimated from the SNR of the last downlink,
+      reduced by the link asymmetry, as gateways usually transmit with more power and have better antennas than
+      end devices. Missing downlinks are handled by the ADR backoff. A higher margin target trades airtime
+      for a higher delivery probability.
+      \param enable Whether to enable adaptive uplink control or not.
+      \param marginTarget Link margin in dB to keep in reserve (default 10 dB).
+      \param linkCheckPeriod Number of uplinks between automatic LinkCheckReq (default 16),
+      set to 0 to only use the SNR of downlinks.
+      \param asymmetry How much stronger the downlink is received than the uplink, in dB (default 10 dB).
+      Typical values are 10 to 13 dB, depending on the gateway and end device Tx power.
+    */
+    void setAdaptiveUplink(bool enable, uint8_t marginTarget = RADIOLIB_LORAWAN_ADAPTIVE_MARGIN_DEFAULT, 
+                           uint8_t linkCheckPeriod = RADIOLIB_LORAWAN_ADAPTIVE_LINK_CHECK_PERIOD,
+                           uint8_t asymmetry = RADIOLIB_LORAWAN_ADAPTIVE_ASYMMETRY_DEFAULT);
+
     /*!
       \brief Toggle adherence to dutyCycle limits to on or off.
       \param enable Whether to adhere to dutyCycle limits or not (default true).
@@ -782,6 +1378,40 @@ class LoRaWANNode {
     */
     void scheduleTransmission(RadioLibTime_t tUplink);
 
+    /*!
+      \brief Get the current network time, based on the internal clock synchronized by the last DeviceTimeAns.
+      If two DeviceTimeAns are received at least 10 minutes apart, the drift of the internal clock is compensated.
+      \param gpsEpoch Number of seconds since GPS epoch (Jan. 6th 1980).
+      \param ms Milliseconds within the current second.
+      \param returnUnix If true, returns Unix timestamp instead of GPS (default true)
+      \returns \ref status_codes
+    */
+    int16_t getNetworkTime(uint32_t* gpsEpoch, uint16_t* ms = NULL, bool returnUnix = true);
+
+    /*!
+      \brief Schedule the next uplink at a network time (seconds since GPS epoch).
+      The time is converted to the internal clock, which must have been synchronized by a DeviceTimeAns.
+      If the time has already passed, the uplink is sent immediately.
+      \param gpsEpoch Number of seconds since GPS epoch (Jan. 6th 1980).
+      \param ms Milliseconds within that second.
+      \returns \ref status_codes
+    */
+    int16_t scheduleTransmissionGps(uint32_t gpsEpoch, uint16_t ms = 0);
+
+    /*!
+      \brief Schedule the next uplink in a slot of network time.
+      Periods start at multiples of the period since GPS epoch. The window at the start of each period
+      is divided into slots, and the uplink is sent at the start of one of them. The slot is derived
+      from DevAddr and the period number, so a fleet of devices spreads its uplinks evenly over the window,
+      transmissions in different slots cannot overlap, and the same two devices do not share a slot in every period.
+      Requires the internal clock to be synchronized by a DeviceTimeAns.
+      \param period Length of the period in seconds (at least 1).
+      \param window Length of the window in seconds, 0 to use the whole period.
+      \param slotLen Length of a slot in milliseconds, 0 to use the airtime of the last uplink plus a guard time.
+      \returns \ref status_codes
+    */
+    int16_t scheduleTransmissionSlot(uint32_t period, uint32_t window = 0, RadioLibTime_t slotLen = 0);
+
     /*! 
         \brief Returns the last uplink's frame counter; 
         also 0 if no uplink occured yet. 
@@ -819,6 +1449,12 @@ class LoRaWANNode {
     */
     RadioLibTime_t getLastToA();
 
+    /*!
+      \brief Get the average time the receiver was on during Rx windows, per uplink.
+      \returns Average Rx-on time per uplink (in microseconds).
+    */
+    RadioLibTime_t getAverageRxOnTime();
+
     /*!
       \brief Calculate the minimum interval to adhere to a certain dutyCycle.
       This interval is based on the ToA of one uplink and does not actually keep track of total airtime.
@@ -828,15 +1464,264 @@ class LoRaWANNode {
     */
     RadioLibTime_t dutyCycleInterval(RadioLibTime_t msPerHour, RadioLibTime_t airtime);
 
-    /*! \brief Returns time in milliseconds until next uplink is available under dutyCycle limits */
+    /*! \brief Returns time in milliseconds until next uplink is available under dutyCycle limits on any channel */
     RadioLibTime_t timeUntilUplink();
 
+    /*!
+      \brief Returns time in milliseconds until next uplink is available under dutyCycle limits on a specific channel.
+      This takes into account the airtime used during the last hour in the channel's sub-band.
+      \param chIdx Index of the channel in the uplink channel plan (for fixed bands, the channel number 0 - 95).
+      \returns Time in milliseconds, or RADIOLIB_LORAWAN_TIME_UNAVAILABLE if the channel is not enabled.
+    */
+    RadioLibTime_t timeUntilUplink(uint8_t chIdx);
+
     /*! 
       \brief Returns the maximum allowed uplink payload size given the current MAC state.
       Most importantly, this includes dwell time limitations and ADR.
     */
     uint8_t getMaxPayloadLen();
 
+    /*!
+      \brief Get the statistics collected since the node was created or the statistics were last reset.
+      \returns Structure with the node statistics.
+    */
+    LoRaWANStats_t getStats();
+
+    /*!
+      \brief Reset all collected statistics.
+    */
+    void resetStats();
+
+    /*!
+      \brief Enable the Remote Multicast Setup package (TS005) on FPort 200.
+      Multicast groups can then be configured by the network server.
+      \param genAppKey Pointer to the GenAppKey used to derive multicast keys (LoRaWAN 1.0.x).
+      For LoRaWAN 1.1, the multicast keys are derived from the AppKey and this may be NULL.
+      \returns \ref status_codes
+    */
+    int16_t beginMulticast(const uint8_t* genAppKey = NULL);
+
+    /*!
+      \brief Manually configure a multicast group, without the Remote Multicast Setup package.
+      Multicast groups and their frame counters are saved in the Session buffer.
+      \param id Multicast group ID (0 - 3).
+      \param addr Multicast address (McAddr).
+      \param mcAppSKey Pointer to the multicast application session key.
+      \param mcNwkSKey Pointer to the multicast network session key.
+      \param fCntMin Lowest accepted multicast frame counter.
+      \param fCntMax Highest accepted multicast frame counter.
+      \returns \ref status_codes
+    */
+    int16_t setMulticastGroup(uint8_t id, uint32_t addr, const uint8_t* mcAppSKey, const uint8_t* mcNwkSKey, 
+                              uint32_t fCntMin = 0, uint32_t fCntMax = 0xFFFFFFFF);
+
+    /*!
+      \brief Remove a multicast group.
+      \param id Multicast group ID (0 - 3).
+      \returns \ref status_codes
+    */
+    int16_t clearMulticastGroup(uint8_t id);
+
+    /*!
+      \brief Listen for multicast (and unicast) downlinks on the Class C channel of a multicast group.
+      Downlinks on FPort 200 and 201 are processed internally and not passed to the user.
+      \param id Multicast group ID (0 - 3).
+      \param dataDown Buffer to save received data into.
+      \param lenDown Pointer to variable that will be used to save the number of received bytes.
+      \param timeout How long to listen for, in milliseconds.
+      \param eventDown Pointer to a structure to store extra information about the downlink event
+      (fPort, frame counter, etc.). If set to NULL, no extra information will be passed to the user.
+      \returns \ref status_codes
+    */
+    int16_t receiveMulticast(uint8_t id, uint8_t* dataDown, size_t* lenDown, RadioLibTime_t timeout, LoRaWANEvent_t* eventDown = NULL);
+
+    /*!
+      \brief Enable the Fragmented Data Block Transport package (TS004) on FPort 201,
+      with the data block reassembled in a buffer in RAM.
+      \param buff Buffer to reassemble the data block in.
+      \param size Size of the buffer in bytes.
+      \returns \ref status_codes
+    */
+    int16_t beginFragmentation(uint8_t* buff, size_t size);
+
+    /*!
+      \brief Enable the Fragmented Data Block Transport package (TS004) on FPort 201,
+      with the data block reassembled through user-provided storage (e.g. external Flash).
+      \param readCb Callback to read from the storage.
+      \param writeCb Callback to write into the storage.
+      \param size Size of the storage in bytes.
+      \returns \ref status_codes
+    */
+    int16_t beginFragmentation(LoRaWANStorageReadCb_t readCb, LoRaWANStorageWriteCb_t writeCb, size_t size);
+
+    /*!
+      \brief Check whether the fragmented data block was completely received.
+      \param len Pointer to variable that will be used to save the length of the data block.
+      \param descriptor Pointer to variable that will be used to save the data block descriptor.
+      \returns Whether the data block is complete.
+    */
+    bool isFragmentationComplete(size_t* len = NULL, uint32_t* descriptor = NULL);
+
+    /*!
+      \brief Check whether there is an application layer package answer waiting to be sent.
+      \returns Whether there is a pending answer.
+    */
+    bool isPackageAnswerPending();
+
+    /*!
+      \brief Send pending application layer package answers (e.g. FragSessionSetupAns) to the server.
+      \param eventUp Pointer to a structure to store extra information about the uplink event
+      (fPort, frame counter, etc.). If set to NULL, no extra information will be passed to the user.
+      \param eventDown Pointer to a structure to store extra information about the downlink event
+      (fPort, frame counter, etc.). If set to NULL, no extra information will be passed to the user.
+      \returns Window number > 0 if downlink was received, 0 is no downlink was received, otherwise \ref status_codes
+    */
+    int16_t sendPackageAnswer(LoRaWANEvent_t* eventUp = NULL, LoRaWANEvent_t* eventDown = NULL);
+
+    /*!
+      \brief Enable aggregation of small application records into a single uplink.
+      \param buff Buffer to aggregate the records in, split equally between RADIOLIB_LORAWAN_AGGR_NUM_PORTS FPorts.
+      At most 255 bytes per FPort are used, a larger per-FPort share than the maximum payload length is not needed.
+      \param size Size of the buffer in bytes.
+      \param maxAge Maximum time in milliseconds a record may be buffered before flushAggregated sends it.
+      0 means records are only sent when the uplink is full, on priority records or on a forced flush.
+      \returns \ref status_codes
+    */
+    int16_t beginAggregation(uint8_t* buff, size_t size, RadioLibTime_t maxAge = 0);
+
+    /*!
+      \brief Add an application record to the aggregation buffer of an FPort.
+      Records are packed as type (1 byte), length (1 byte) and value. If the record does not fit into
+      the maximum payload length for the current datarate, the buffer is sent first.
+      \param fPort FPort to send the record on.
+      \param type Application-defined record type.
+      \param data Record value.
+      \param len Length of the record value in bytes.
+      \param priority Whether to send the buffer immediately after adding this record.
+      \param eventUp Pointer to a structure to store extra information about the uplink event, if one was sent.
+      \param eventDown Pointer to a structure to store extra information about the downlink event, if one was received.
+      \returns Window number > 0 if downlink was received, 0 is no downlink was received, otherwise \ref status_codes
+    */
+    int16_t aggregate(uint8_t fPort, uint8_t type, const uint8_t* data, uint8_t len, bool priority = false, 
+                      LoRaWANEvent_t* eventUp = NULL, LoRaWANEvent_t* eventDown = NULL);
+
+    /*!
+      \brief Add an application record to the aggregation buffer of an FPort, and save a possible downlink.
+      If a downlink is received while making room for the record, no further uplink is sent by this call,
+      and a priority record stays buffered until the next call to flushAggregated.
+      \param fPort FPort to send the record on.
+      \param type Application-defined record type.
+      \param data Record value.
+      \param len Length of the record value in bytes.
+      \param dataDown Buffer to save received data into.
+      \param lenDown Pointer to variable that will be used to save the number of received bytes.
+      \param priority Whether to send the buffer immediately after adding this record.
+      \param eventUp Pointer to a structure to store extra information about the uplink event, if one was sent.
+      \param eventDown Pointer to a structure to store extra information about the downlink event, if one was received.
+      \returns Window number > 0 if downlink was received, 0 is no downlink was received, otherwise \ref status_codes
+    */
+    int16_t aggregate(uint8_t fPort, uint8_t type, const uint8_t* data, uint8_t len, uint8_t* dataDown, size_t* lenDown, 
+                      bool priority = false, LoRaWANEvent_t* eventUp = NULL, LoRaWANEvent_t* eventDown = NULL);
+
+    /*!
+      \brief Send aggregated records. Should be called periodically when a maximum age is set.
+      \param force If true, all buffered records are sent. Otherwise, only buffers whose oldest record
+      exceeded the maximum age are sent.
+      \param eventUp Pointer to a structure to store extra information about the uplink event, if one was sent.
+      \param eventDown Pointer to a structure to store extra information about the downlink event, if one was received.
+      \returns Window number > 0 if downlink was received, 0 is no downlink was received, otherwise \ref status_codes
+    */
+    int16_t flushAggregated(bool force = true, LoRaWANEvent_t* eventUp = NULL, LoRaWANEvent_t* eventDown = NULL);
+
+    /*!
+      \brief Send aggregated records, and save a possible downlink. Buffers are sent one FPort at a time,
+      and the first uplink that receives a downlink ends the flush, so that the downlink is not overwritten.
+      The remaining buffers are sent by the next call. Likewise, sending stops at the first error
+      and the records that were not sent stay buffered.
+      \param dataDown Buffer to save received data into.
+      \param lenDown Pointer to variable that will be used to save the number of received bytes.
+      \param force If true, all buffered records are sent. Otherwise, only buffers whose oldest record
+      exceeded the maximum age are sent.
+      \param eventUp Pointer to a structure to store extra information about the last uplink event, if one was sent.
+      \param eventDown Pointer to a structure to store extra information about the downlink event, if one was received.
+      \returns Window number > 0 if downlink was received, 0 is no downlink was received, otherwise \ref status_codes
+    */
+    int16_t flushAggregated(uint8_t* dataDown, size_t* lenDown, bool force = true, LoRaWANEvent_t* eventUp = NULL, LoRaWANEvent_t* eventDown = NULL);
+
+    /*!
+      \brief Get the next record from an aggregated payload. Can be used on the application server side as well.
+      \param in Aggregated payload.
+      \param len Length of the aggregated payload.
+      \param pos Pointer to the current position in the payload, should be set to 0 before reading the first record.
+      \param type Pointer to variable that will be used to save the record type.
+      \param value Pointer that will be set to the record value within the payload.
+      \param valueLen Pointer to variable that will be used to save the length of the record value.
+      \returns Whether a complete record was read.
+    */
+    static bool getAggregatedRecord(const uint8_t* in, size_t len, size_t* pos, uint8_t* type, const uint8_t** value, uint8_t* valueLen);
+
+    /*!
+      \brief Enable the relay role. The node must be activated first.
+      The relay listens for wake-on-radio (WOR) frames on the WOR channels of the band,
+      forwards uplinks of trusted end devices on FPort 226 and relays their downlinks back.
+      Forwarded uplinks use the TS011 format, but the WOR and WOR ACK frames use a layout of their own
+      (see RADIOLIB_LORAWAN_RELAY_WOR_LEN), so only end devices using setRelayMode can use the relay.
+      \param rxrDelay Delay between the end of the end-device uplink and the relayed downlink (RxR window)
+      in milliseconds. Must match the delay used by the end devices. The forwarded uplink at the current datarate,
+      the RX2 delay of the relay and the longest downlink in RX2 have to fit in.
+      \returns \ref status_codes
+    */
+    int16_t beginRelay(RadioLibTime_t rxrDelay);
+
+    /*!
+      \brief Add an end device to the relay trust list, or update its key if it is already listed.
+      \param devAddr Device address of the end device.
+      \param rootWorSKey Pointer to the RootWorSKey of the end device (see getRootWorSKey),
+      from which the keys to authenticate and decrypt its WOR frames are derived.
+      \returns \ref status_codes
+    */
+    int16_t addRelayDevice(uint32_t devAddr, const uint8_t* rootWorSKey);
+
+    /*!
+      \brief Remove an end device from the relay trust list.
+      \param devAddr Device address of the end device.
+      \returns \ref status_codes
+    */
+    int16_t removeRelayDevice(uint32_t devAddr);
+
+    /*!
+      \brief Perform a single relay cycle: run channel activity detection on the WOR channels,
+      and if a trusted end device wakes the relay, forward its uplink and relay the downlink (if any).
+      Should be called continuously in the main loop of the relay.
+      \param eventUp Pointer to a structure to store extra information about the forwarded uplink event
+      (fPort, frame counter, etc.). If set to NULL, no extra information will be passed to the user.
+      \param eventDown Pointer to a structure to store extra information about the downlink event
+      (fPort, frame counter, etc.). If set to NULL, no extra information will be passed to the user.
+      \returns 2 if a downlink was relayed, 1 if an uplink was forwarded, 0 if nothing was forwarded,
+      otherwise \ref status_codes
+    */
+    int16_t relayListen(LoRaWANEvent_t* eventUp = NULL, LoRaWANEvent_t* eventDown = NULL);
+
+    /*!
+      \brief Send uplinks through a relay. Before each uplink, the end device wakes the relay
+      with a WOR frame on the first WOR channel of the band and waits for the WOR ACK.
+      Downlinks are then only received in the RxR window on the first ACK channel.
+      The relay must have this device in its trust list (see addRelayDevice).
+      \param enable Whether to send uplinks through a relay.
+      \param rxrDelay Delay between the end of the uplink and the RxR window in milliseconds,
+      must be the same as the one used by the relay.
+      \returns \ref status_codes
+    */
+    int16_t setRelayMode(bool enable, RadioLibTime_t rxrDelay = 0);
+
+    /*!
+      \brief Get the key from which the WOR session keys of this device are derived,
+      so that it can be added to the trust list of a relay. Changes with every new session.
+      \param key Pointer to a buffer of RADIOLIB_AES128_KEY_SIZE bytes to save the key.
+      \returns \ref status_codes
+    */
+    int16_t getRootWorSKey(uint8_t* key);
+
     /*! 
       \brief TS009 Protocol Specification Verification switch
       (allows FPort 224 and cuts off uplink payload instead of rejecting if maximum length exceeded).
@@ -854,8 +1739,16 @@ class LoRaWANNode {
 
       500 is the **maximum** value, but it is not a good idea to go anywhere near that.
       If you have to go above 50 you probably have a bug somewhere. Check your device timing.
+      As the Rx windows are timed from the Tx done interrupt with microsecond resolution
+      and host clock error is covered by clockDrift, this only has to cover interrupt latency.
     */
-    RadioLibTime_t scanGuard = 10;
+    RadioLibTime_t scanGuard = 2;
+
+    /*!
+      \brief Maximum error of the host clock in parts per million (e.g. crystal tolerance).
+      The Rx windows are padded by this fraction of the Rx delay on both sides.
+    */
+    uint32_t clockDrift = 100;
 
 #if !RADIOLIB_GODMODE
   protected:
@@ -896,8 +1789,31 @@ class LoRaWANNode {
     
     // device-specific parameters, persistent through sessions
     uint16_t devNonce = 0;
+    uint16_t rjCount1 = 0;
     uint32_t joinNonce = 0;
 
+    // type and DevNonce/RJcount of the last JoinRequest or RejoinRequest, needed to process the JoinAccept
+    uint8_t joinReqType = RADIOLIB_LORAWAN_JOIN_REQUEST_TYPE;
+    uint16_t joinReqNonce = 0;
+
+    // Rejoin-Request counter for type 0/2, RJcount1 is kept with the device-specific parameters
+    uint16_t rjCount0 = 0;
+
+    // periodic Rejoin-Requests (RejoinParamSetupReq), counted from the start of the session or the last rejoin
+    uint8_t rejoinMaxTimeN = RADIOLIB_LORAWAN_REJOIN_MAX_TIME_N;
+    uint8_t rejoinMaxCountN = RADIOLIB_LORAWAN_REJOIN_MAX_COUNT_N;
+    uint32_t rejoinFCnt = 0;
+    uint32_t rejoinSeconds = 0;
+    RadioLibTime_t rejoinTimestamp = 0;
+
+    // Rejoin-Requests requested by the network (ForceRejoinReq)
+    uint8_t forceRejoinType = RADIOLIB_LORAWAN_JOIN_REQUEST_TYPE;
+    uint8_t forceRejoinDr = RADIOLIB_LORAWAN_DATA_RATE_UNUSED;
+    uint8_t forceRejoinPeriod = 0;
+    uint8_t forceRejoinRetries = 0;
+    RadioLibTime_t forceRejoinTime = 0;
+    RadioLibTime_t forceRejoinDelay = 0;
+
     // session-specific parameters
     uint32_t homeNetId = 0;
     uint8_t adrLimitExp = RADIOLIB_LORAWAN_ADR_ACK_LIMIT_EXP;
@@ -915,10 +1831,25 @@ class LoRaWANNode {
     // ADR is enabled by default
     bool adrEnabled = true;
 
+    // device-side adaptive uplink control, only used while ADR is disabled
+    bool adaptiveEnabled = false;
+    uint8_t adaptiveMarginTarget = RADIOLIB_LORAWAN_ADAPTIVE_MARGIN_DEFAULT;
+    uint8_t adaptiveLinkCheckPeriod = RADIOLIB_LORAWAN_ADAPTIVE_LINK_CHECK_PERIOD;
+    uint8_t adaptiveAsymmetry = RADIOLIB_LORAWAN_ADAPTIVE_ASYMMETRY_DEFAULT;
+    uint32_t adaptiveFCnt = 0;    // frame counter of the last LinkCheckReq
+    int16_t adaptiveMargin = RADIOLIB_LORAWAN_ADAPTIVE_MARGIN_NONE;   // newest link margin, not yet applied
+    uint8_t adaptiveGwCnt = 0;    // number of gateways from the last LinkCheckAns (0 if unknown)
+
     // duty cycle is set upon initialization and activated in regions that impose this
     bool dutyCycleEnabled = false;
     uint32_t dutyCycle = 0;
 
+    // statistics about the node operation
+    LoRaWANStats_t stats;
+
+    // airtime used in the last hour, per duty cycle sub-band and aggregated over all sub-bands (last entry)
+    LoRaWANAirtimeLedger_t airtimeLedger[RADIOLIB_LORAWAN_NUM_DUTY_CYCLE_BANDS + 1];
+
     // dwell time is set upon initialization and activated in regions that impose this
     bool dwellTimeEnabledUp = false;
     uint16_t dwellTimeUp = 0;
@@ -928,6 +1859,14 @@ class LoRaWANNode {
     RadioLibTime_t tUplink = 0;   // scheduled uplink transmission time (internal clock)
     RadioLibTime_t tDownlink = 0; // time at end of downlink reception
 
+    // network time of the last DeviceTimeAns: GPS second and the internal clock time at which that second started
+    // the GPS second is 0 if the clock was never synchronized
+    uint32_t timeSyncGps = 0;
+    RadioLibTime_t timeSyncLocal = 0;
+
+    // measured drift of the internal clock, in parts per million (positive if the internal clock runs slow)
+    int32_t timeSyncDrift = 0;
+
     // enable/disable CSMA for LoRaWAN
     bool csmaEnabled = false;
 
@@ -945,6 +1884,11 @@ class LoRaWANNode {
     // available channel frequencies from list passed during OTA activation
     LoRaWANChannel_t channelPlan[2][RADIOLIB_LORAWAN_NUM_AVAILABLE_CHANNELS];
 
+    // fixed bands: enabled channels, and the enabled channels not yet used in the current hopping round
+    // bit N of byte M corresponds to channel 8*M + N
+    uint8_t chMaskFixed[RADIOLIB_LORAWAN_FIXED_NUM_SUBBANDS] = { 0 };
+    uint8_t chAvailFixed[RADIOLIB_LORAWAN_FIXED_NUM_SUBBANDS] = { 0 };
+
     // currently configured channels for TX, RX1, RX2
     LoRaWANChannel_t channels[3] = { RADIOLIB_LORAWAN_CHANNEL_NONE, RADIOLIB_LORAWAN_CHANNEL_NONE,
                                      RADIOLIB_LORAWAN_CHANNEL_NONE };
@@ -968,6 +1912,16 @@ class LoRaWANNode {
     // timestamp when the Rx1/2 windows were closed (timeout or uplink received)
     RadioLibTime_t rxDelayEnd = 0;
 
+    // timestamp of the Tx done interrupt in microseconds, the reference for Rx window timing
+    RadioLibTime_t rxDelayStartUs = 0;
+
+    // time (in microseconds) it took to start the receiver when the last Rx window was opened
+    RadioLibTime_t rxStartLatency = 0;
+
+    // total Rx-on time (in microseconds) and number of uplinks it was accumulated over
+    uint64_t rxOnTime = 0;
+    uint32_t rxOnCount = 0;
+
     // device status - battery level
     uint8_t battLevel = 0xFF;
 
@@ -980,6 +1934,66 @@ class LoRaWANNode {
     // allow port 226 for devices implementing TS011
     bool TS011 = false;
 
+    // uplink aggregation state
+    bool aggrEnabled = false;
+    RadioLibTime_t aggrMaxAge = 0;
+    LoRaWANAggregate_t aggrPorts[RADIOLIB_LORAWAN_AGGR_NUM_PORTS];
+    uint8_t* aggrBuff = NULL;
+    uint8_t aggrBuffLen = 0;
+
+    // relay state and trust list, relayRxrDelay is also used by end devices sending through a relay
+    bool relayEnabled = false;
+    bool relayUplinks = false;
+    uint32_t relayWFCnt = 0;
+    RadioLibTime_t relayRxrDelay = 0;
+    LoRaWANRelayDevice_t relayDevices[RADIOLIB_LORAWAN_RELAY_MAX_DEVICES];
+
+    // user-registered (proprietary) MAC commands
+    LoRaWANCustomMacCommand_t customMacCommands[RADIOLIB_LORAWAN_NUM_CUSTOM_MAC_COMMANDS];
+
+    // Remote Multicast Setup package state
+    bool mcEnabled = false;
+    uint8_t genAppKey[RADIOLIB_AES128_KEY_SIZE] = { 0 };
+    LoRaWANMulticastGroup_t mcGroups[RADIOLIB_LORAWAN_NUM_MC_GROUPS];
+
+    // Fragmented Data Block Transport package state
+    bool fragEnabled = false;
+    LoRaWANFragSession_t fragSession;
+    uint8_t* fragBuff = NULL;
+    size_t fragBuffSize = 0;
+    LoRaWANStorageReadCb_t fragReadCb = NULL;
+    LoRaWANStorageWriteCb_t fragWriteCb = NULL;
+
+    // fragment reception bitmap and the (upper triangular) decoding matrix
+    #if RADIOLIB_STATIC_ONLY
+    uint8_t fragReceived[(RADIOLIB_LORAWAN_FRAG_MAX_NB_FRAG + 7) / 8];
+    uint8_t fragMatrix[(RADIOLIB_LORAWAN_FRAG_MAX_MISSING * RADIOLIB_LORAWAN_FRAG_MAX_MISSING + 7) / 8];
+    #else
+    uint8_t* fragReceived = NULL;
+    uint8_t* fragMatrix = NULL;
+    #endif
+
+    // answers to application layer package requests, to be sent in the next uplink
+    uint8_t packageAns[RADIOLIB_LORAWAN_PACKAGE_ANS_MAX_LEN] = { 0 };
+    uint8_t packageAnsLen = 0;
+    uint8_t packageAnsPort = 0;
+
+    // incremental session persistence state
+    bool journalEnabled = false;
+    LoRaWANStorageReadCb_t journalReadCb = NULL;
+    LoRaWANStorageWriteCb_t journalWriteCb = NULL;
+    size_t journalSize = 0;
+    uint32_t journalPos = 0;
+    uint32_t journalGen = RADIOLIB_LORAWAN_JOURNAL_GEN_NONE;
+    uint8_t journalSlot = RADIOLIB_LORAWAN_JOURNAL_SLOT_NONE;
+
+    // copy of the session buffer as it was last written to the journal
+    #if RADIOLIB_STATIC_ONLY
+    uint8_t journalShadow[RADIOLIB_LORAWAN_SESSION_BUF_SIZE];
+    #else
+    uint8_t* journalShadow = NULL;
+    #endif
+
     // this will reset the device credentials, so the device starts completely new
     void clearNonces();
 
@@ -989,6 +2003,12 @@ class LoRaWANNode {
     // setup Join-Request payload
     void composeJoinRequest(uint8_t* joinRequestMsg);
 
+    // setup Rejoin-Request payload, returns its length
+    uint8_t composeRejoinRequest(uint8_t rejoinType, uint8_t* rejoinRequestMsg);
+
+    // restart the periodic Rejoin-Request counters
+    void resetRejoinCounters();
+
     // extract Join-Accept payload and start a new session
     int16_t processJoinAccept(LoRaWANJoinEvent_t *joinEvent);
 
@@ -1001,6 +2021,12 @@ class LoRaWANNode {
     // perform ADR backoff
     void adrBackoff();
 
+    // device-side adaptive uplink control: adjust datarate, Tx power and NbTrans to the newest link margin
+    void adaptUplink();
+
+    // estimate the link margin from the SNR of the last downlink received at the given datarate
+    int16_t getDownlinkMargin(uint8_t dr);
+
     // create an encrypted uplink buffer, composing metadata, user data and MAC data
     void composeUplink(const uint8_t* in, uint8_t lenIn, uint8_t* out, uint8_t fPort, bool isConfirmed);
 
@@ -1010,16 +2036,104 @@ class LoRaWANNode {
     // transmit uplink buffer on a specified channel
     int16_t transmitUplink(LoRaWANChannel_t* chnl, uint8_t* in, uint8_t len, bool retrans);
 
+    // transmit and save the timestamp of the Tx done interrupt for Rx window timing
+    int16_t transmitTimed(const uint8_t* in, uint8_t len);
+
+    // get the guard time (in microseconds) that an Rx window must be widened by on each side
+    RadioLibTime_t getRxWindowGuard(RadioLibTime_t rxDelay);
+
     // wait for, open and listen during receive windows; only performs listening
+    // the reference timestamp is in microseconds
     int16_t receiveCommon(uint8_t dir, const LoRaWANChannel_t* dlChannels, const RadioLibTime_t* dlDelays, uint8_t numWindows, RadioLibTime_t tReference);
 
     // extract downlink payload and process MAC commands
     int16_t parseDownlink(uint8_t* data, size_t* len, LoRaWANEvent_t* event = NULL);
 
+    // send (part of) the aggregated records of a single FPort
+    int16_t flushAggregate(uint8_t idx, uint8_t* dataDown, size_t* lenDown, LoRaWANEvent_t* eventUp, LoRaWANEvent_t* eventDown);
+
+    // find an end device in the relay trust list, returns RADIOLIB_LORAWAN_RELAY_MAX_DEVICES if none
+    uint8_t findRelayDevice(uint32_t devAddr);
+
+    // longest time from the end of an end-device uplink until the relayed downlink can be sent:
+    // the forwarded uplink with phyLen bytes from the end device, the RX2 delay and the longest RX2 downlink
+    int16_t getRelayTurnaround(size_t phyLen, RadioLibTime_t* turnaround);
+
+    // wake the relay before an uplink on the given channel and wait for its acknowledgement
+    int16_t wakeRelay(const LoRaWANChannel_t* chnl);
+
+    // derive the WOR session keys of an end device from its RootWorSKey
+    static void deriveWorKeys(const uint8_t* rootWorSKey, uint32_t devAddr, uint8_t* worSIntKey, uint8_t* worSEncKey);
+
+    // fill the MIC calculation block in the first 16 bytes of a WOR frame or WOR ACK
+    static void setWorMicBlock(uint8_t* msg, size_t len, uint32_t devAddr, uint32_t wfCnt, uint8_t dir);
+
+    // find the multicast group a downlink address belongs to, returns RADIOLIB_LORAWAN_NUM_MC_GROUPS if none
+    uint8_t findMulticastGroup(uint32_t addr);
+
+    // process application layer package (TS004/TS005) requests received on their respective FPort
+    void processPackage(uint8_t fPort, const uint8_t* in, size_t len, uint8_t mcGroup);
+
+    // process Remote Multicast Setup request, returns the length of the request or 0 if malformed
+    size_t processMulticastSetup(const uint8_t* in, size_t len, uint8_t* ans, uint8_t* ansLen);
+
+    // process Fragmented Data Block Transport request, returns the length of the request or 0 if malformed
+    size_t processFragTransport(const uint8_t* in, size_t len, uint8_t mcGroup, uint8_t* ans, uint8_t* ansLen);
+
+    // release the fragmentation session buffers
+    void clearFragSession();
+
+    // process a single (uncoded or coded) fragment
+    void processFragment(uint16_t n, const uint8_t* data);
+
+    // read/write a single fragment from/to the fragmentation storage
+    int16_t fragStorageRead(uint16_t idx, uint8_t* data);
+    int16_t fragStorageWrite(uint16_t idx, const uint8_t* data);
+
+    // get the fragment index of the n-th missing fragment, or the position of a fragment among missing ones
+    uint16_t fragMissingToIndex(uint16_t pos);
+    uint16_t fragIndexToMissing(uint16_t idx);
+
+    // generate a row of the TS004 parity check matrix for coded fragment n
+    static void fragParityRow(uint16_t n, uint16_t m, uint8_t* row);
+
+    // find the next range of session bytes (starting at offs) that differs from the journal shadow copy
+    bool journalNextRange(const uint8_t* session, uint16_t* offs, uint8_t* len);
+
+    // read a snapshot slot into the shadow copy and return its generation,
+    // or RADIOLIB_LORAWAN_JOURNAL_GEN_NONE if the slot is empty or its CRC does not match
+    uint32_t journalReadSlot(uint8_t slot);
+
+    // CRC-16 CCITT over a header followed by data, used for both snapshot slots and delta records
+    static uint16_t journalCrc(const uint8_t* hdr, size_t hdrLen, const uint8_t* buff, size_t len);
+
     // execute mac command, return the number of processed bytes for sequential processing
     bool execMacCommand(uint8_t cid, uint8_t* optIn, uint8_t lenIn);
     bool execMacCommand(uint8_t cid, uint8_t* optIn, uint8_t lenIn, uint8_t* optOut);
 
+    // handler of a standard MAC command, returns whether an answer should be sent
+    typedef bool (LoRaWANNode::*MacHandler_t)(uint8_t* optIn, uint8_t lenIn, uint8_t* optOut);
+
+    // handlers of the standard MAC commands, in the same order as MacTable
+    static const MacHandler_t macHandlers[RADIOLIB_LORAWAN_NUM_MAC_COMMANDS];
+
+    // handlers of the individual standard MAC commands
+    bool execMacReset(uint8_t* optIn, uint8_t lenIn, uint8_t* optOut);
+    bool execMacLinkCheck(uint8_t* optIn, uint8_t lenIn, uint8_t* optOut);
+    bool execMacLinkAdr(uint8_t* optIn, uint8_t lenIn, uint8_t* optOut);
+    bool execMacDutyCycle(uint8_t* optIn, uint8_t lenIn, uint8_t* optOut);
+    bool execMacRxParamSetup(uint8_t* optIn, uint8_t lenIn, uint8_t* optOut);
+    bool execMacDevStatus(uint8_t* optIn, uint8_t lenIn, uint8_t* optOut);
+    bool execMacNewChannel(uint8_t* optIn, uint8_t lenIn, uint8_t* optOut);
+    bool execMacRxTimingSetup(uint8_t* optIn, uint8_t lenIn, uint8_t* optOut);
+    bool execMacTxParamSetup(uint8_t* optIn, uint8_t lenIn, uint8_t* optOut);
+    bool execMacDlChannel(uint8_t* optIn, uint8_t lenIn, uint8_t* optOut);
+    bool execMacRekey(uint8_t* optIn, uint8_t lenIn, uint8_t* optOut);
+    bool execMacAdrParamSetup(uint8_t* optIn, uint8_t lenIn, uint8_t* optOut);
+    bool execMacDeviceTime(uint8_t* optIn, uint8_t lenIn, uint8_t* optOut);
+    bool execMacForceRejoin(uint8_t* optIn, uint8_t lenIn, uint8_t* optOut);
+    bool execMacRejoinParamSetup(uint8_t* optIn, uint8_t lenIn, uint8_t* optOut);
+
     // possible override for additional MAC commands that are not in the base specification
     virtual bool derivedMacHandler(uint8_t cid, uint8_t* optIn, uint8_t lenIn, uint8_t* optOut);
 
@@ -1029,6 +2143,9 @@ class LoRaWANNode {
     // post-process a (set of) LinkAdrAns commands depending on LoRaWAN version
     void postprocessMacLinkAdr(uint8_t* ack, uint8_t cLen);
 
+    // find a user-registered MAC command, returns NULL if none
+    LoRaWANCustomMacCommand_t* findCustomMacCommand(uint8_t cid);
+
     // get the properties of a MAC command given a certain command ID
     int16_t getMacCommand(uint8_t cid, LoRaWANMacCommand_t* cmd);
 
@@ -1084,8 +2201,40 @@ class LoRaWANNode {
     // (re)set/restore which channels can be used next for uplink/downlink
     void setAvailableChannels(uint16_t mask);
 
-    // select a set of random TX/RX channels for up- and downlink
-    int16_t selectChannels();
+    // select a set of TX/RX channels for up- and downlink
+    // this is a random channel among those that are available the earliest for an uplink with the given airtime
+    int16_t selectChannels(RadioLibTime_t toa = 0);
+
+    // select the uplink and downlink channel from the dynamic channel plan
+    int16_t selectChannelDyn(RadioLibTime_t toa);
+
+    // select the uplink and downlink channel from the fixed channel bitsets
+    int16_t selectChannelFix();
+
+    // fixed bands: get the channel with the given index, frequency and datarates are derived from the band's spans
+    void getFixedChannel(uint8_t idx, LoRaWANChannel_t* chnl);
+
+    // fixed bands: get the number of available channels that allow a given datarate,
+    // along with a per-sub-band mask of these channels
+    uint8_t getFixedChannels(uint8_t dr, uint8_t* mask);
+
+    // check whether any enabled uplink channel allows a given datarate
+    bool isValidDatarate(uint8_t dr);
+
+    // find the duty cycle sub-band that the frequency belongs to, or -1 if there is none
+    int8_t findDutyCycleBand(uint32_t freq);
+
+    // add airtime of an uplink on the given frequency to the airtime ledgers
+    void addAirtime(uint32_t freq, RadioLibTime_t toa);
+
+    // get the time until an uplink with the given airtime is allowed on the given frequency
+    RadioLibTime_t airtimeWait(uint32_t freq, RadioLibTime_t toa);
+
+    // move the ledger to the current time slot, clearing all expired slots
+    static void airtimeLedgerRoll(LoRaWANAirtimeLedger_t* ledger, RadioLibTime_t now);
+
+    // get the time until the airtime fits within the limit of a ledger
+    static RadioLibTime_t airtimeLedgerWait(LoRaWANAirtimeLedger_t* ledger, RadioLibTime_t now, RadioLibTime_t toa, RadioLibTime_t limit);
 
     // apply a 96-bit channel mask
     bool applyChannelMask(uint64_t chMaskGrp0123, uint32_t chMaskGrp45);
@@ -1098,15 +2247,25 @@ class LoRaWANNode {
     // method to generate message integrity code
     uint32_t generateMIC(uint8_t* msg, size_t len, uint8_t* key);
 
-    // method to verify message integrity code
-    // it assumes that the MIC is the last 4 bytes of the message
-    bool verifyMIC(uint8_t* msg, size_t len, uint8_t* key);
+    // method to verify message integrity code in constant time
+    // it assumes that the MIC is the last 4 bytes of the message, optionally preceded by a header not included in the message
+    bool verifyMIC(uint8_t* msg, size_t len, uint8_t* key, const uint8_t* hdr = NULL, size_t hdrLen = 0);
 
     // find the first usable data rate for the given band
     int16_t findDataRate(uint8_t dr, DataRate_t* dataRate);
 
+    // synchronize the internal clock to the network time of a DeviceTimeAns
+    void syncNetworkTime(uint32_t gpsEpoch, uint8_t fraction);
+
+    // convert between the internal clock and network time in milliseconds since GPS epoch
+    uint64_t localToNetworkTime(RadioLibTime_t tLocal);
+    RadioLibTime_t networkToLocalTime(uint64_t tNetwork);
+
+    // decode a datarate field of a band into modulation parameters and the modem to use
+    static int16_t decodeDataRate(uint8_t dataRateBand, DataRate_t* dataRate, ModemType_t* modem);
+
     // function to encrypt and decrypt payloads (regular uplink/downlink)
-    void processAES(const uint8_t* in, size_t len, uint8_t* key, uint8_t* out, uint32_t fCnt, uint8_t dir, uint8_t ctrId, bool counter);
+    void processAES(const uint8_t* in, size_t len, uint8_t* key, uint8_t* out, uint32_t addr, uint32_t fCnt, uint8_t dir, uint8_t ctrId, bool counter);
 
     // 16-bit checksum method that takes a uint8_t array of even length and calculates the checksum
     static uint16_t checkSum16(const uint8_t *key, uint16_t keyLen);
@@ -1132,7 +2291,7 @@ T LoRaWANNode::ntoh(const uint8_t* buff, size_t size) {
   }
   T res = 0;
   for(size_t i = 0; i < targetSize; i++) {
-    res |= (uint32_t)(*(buffPtr++)) << 8*i;
+    res |= (T)(*(buffPtr++)) << 8*i;
   }
   return(res);
 }
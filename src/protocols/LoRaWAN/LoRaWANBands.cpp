@@ -3,18 +3,74 @@
 #if !RADIOLIB_EXCLUDE_LORAWAN
 
 // array of pointers to currently supported LoRaWAN bands
+// bands excluded from the build are left as NULL, so that the array can still be indexed by band number
 const LoRaWANBand_t* LoRaWANBands[RADIOLIB_LORAWAN_NUM_SUPPORTED_BANDS] = {
+#if !RADIOLIB_EXCLUDE_LORAWAN_EU868
   &EU868,
+#else
+  NULL,
+#endif
+#if !RADIOLIB_EXCLUDE_LORAWAN_US915
   &US915,
+#else
+  NULL,
+#endif
+#if !RADIOLIB_EXCLUDE_LORAWAN_EU433
   &EU433,
+#else
+  NULL,
+#endif
+#if !RADIOLIB_EXCLUDE_LORAWAN_AU915
   &AU915,
+#else
+  NULL,
+#endif
+#if !RADIOLIB_EXCLUDE_LORAWAN_CN500
   &CN500,
+#else
+  NULL,
+#endif
+#if !RADIOLIB_EXCLUDE_LORAWAN_AS923
   &AS923,
+#else
+  NULL,
+#endif
+#if !RADIOLIB_EXCLUDE_LORAWAN_AS923_2
   &AS923_2,
+#else
+  NULL,
+#endif
+#if !RADIOLIB_EXCLUDE_LORAWAN_AS923_3
   &AS923_3,
+#else
+  NULL,
+#endif
+#if !RADIOLIB_EXCLUDE_LORAWAN_AS923_4
   &AS923_4,
+#else
+  NULL,
+#endif
+#if !RADIOLIB_EXCLUDE_LORAWAN_KR920
   &KR920,
+#else
+  NULL,
+#endif
+#if !RADIOLIB_EXCLUDE_LORAWAN_IN865
   &IN865,
+#else
+  NULL,
+#endif
+};
+
+#if !RADIOLIB_EXCLUDE_LORAWAN_EU868
+// regulatory sub-bands of EU868, ETSI EN 300 220
+static const LoRaWANDutyCycleBand_t EU868DutyCycleBands[] = {
+  { .freqStart = 8630000, .freqEnd = 8650000, .dutyCycle = 3600 },     // 0.1 %
+  { .freqStart = 8650000, .freqEnd = 8680000, .dutyCycle = 36000 },    // 1 %
+  { .freqStart = 8680000, .freqEnd = 8686000, .dutyCycle = 36000 },    // 1 % (g1)
+  { .freqStart = 8687000, .freqEnd = 8692000, .dutyCycle = 3600 },     // 0.1 % (g2)
+  { .freqStart = 8694000, .freqEnd = 8696500, .dutyCycle = 360000 },   // 10 % (g3)
+  { .freqStart = 8697000, .freqEnd = 8700000, .dutyCycle = 36000 }     // 1 % (g4)
 };
 
 const LoRaWANBand_t EU868 = {
@@ -26,6 +82,8 @@ const LoRaWANBand_t EU868 = {
   .powerMax = 16,
   .powerNumSteps = 7,
   .dutyCycle = 36000,
+  .numDutyCycleBands = 6,
+  .dutyCycleBands = EU868DutyCycleBands,
   .dwellTimeUp = 0,
   .dwellTimeDn = 0,
   .txParamSupported = false,
@@ -89,7 +147,9 @@ const LoRaWANBand_t EU868 = {
     RADIOLIB_LORAWAN_DATA_RATE_UNUSED
   }
 };
+#endif
 
+#if !RADIOLIB_EXCLUDE_LORAWAN_US915
 const LoRaWANBand_t US915 = {
   .bandNum = BandUS915,
   .bandType = RADIOLIB_LORAWAN_BAND_FIXED,
@@ -99,6 +159,8 @@ const LoRaWANBand_t US915 = {
   .powerMax = 30,
   .powerNumSteps = 10,
   .dutyCycle = 0,
+  .numDutyCycleBands = 0,
+  .dutyCycleBands = NULL,
   .dwellTimeUp = RADIOLIB_LORAWAN_DWELL_TIME,
   .dwellTimeDn = 0,
   .txParamSupported = false,
@@ -183,7 +245,9 @@ const LoRaWANBand_t US915 = {
     RADIOLIB_LORAWAN_DATA_RATE_UNUSED
   }
 };
+#endif
 
+#if !RADIOLIB_EXCLUDE_LORAWAN_EU433
 const LoRaWANBand_t EU433 = {
   .bandNum = BandEU433,
   .bandType = RADIOLIB_LORAWAN_BAND_DYNAMIC,
@@ -193,6 +257,8 @@ const LoRaWANBand_t EU433 = {
   .powerMax = 12,
   .powerNumSteps = 5,
   .dutyCycle = 36000,
+  .numDutyCycleBands = 0,
+  .dutyCycleBands = NULL,
   .dwellTimeUp = 0,
   .dwellTimeDn = 0,
   .txParamSupported = false,
@@ -256,7 +322,9 @@ const LoRaWANBand_t EU433 = {
     RADIOLIB_LORAWAN_DATA_RATE_UNUSED
   }
 };
+#endif
 
+#if !RADIOLIB_EXCLUDE_LORAWAN_AU915
 const LoRaWANBand_t AU915 = {
   .bandNum = BandAU915,
   .bandType = RADIOLIB_LORAWAN_BAND_FIXED,
@@ -266,6 +334,8 @@ const LoRaWANBand_t AU915 = {
   .powerMax = 30,
   .powerNumSteps = 10,
   .dutyCycle = 0,
+  .numDutyCycleBands = 0,
+  .dutyCycleBands = NULL,
   .dwellTimeUp = RADIOLIB_LORAWAN_DWELL_TIME,
   .dwellTimeDn = 0,
   .txParamSupported = true, // conflict: not implemented according to RP v1.1
@@ -350,7 +420,9 @@ const LoRaWANBand_t AU915 = {
     RADIOLIB_LORAWAN_DATA_RATE_UNUSED
   }
 };
+#endif
 
+#if !RADIOLIB_EXCLUDE_LORAWAN_CN500
 const LoRaWANBand_t CN500 = {
   .bandNum = BandCN500,
   .bandType = RADIOLIB_LORAWAN_BAND_FIXED,
@@ -360,6 +432,8 @@ const LoRaWANBand_t CN500 = {
   .powerMax = 19,
   .powerNumSteps = 7,
   .dutyCycle = 0,
+  .numDutyCycleBands = 0,
+  .dutyCycleBands = NULL,
   .dwellTimeUp = 0,
   .dwellTimeDn = 0,
   .txParamSupported = false,
@@ -437,7 +511,9 @@ const LoRaWANBand_t CN500 = {
     RADIOLIB_LORAWAN_DATA_RATE_UNUSED
   }
 };
+#endif
 
+#if !RADIOLIB_EXCLUDE_LORAWAN_AS923
 const LoRaWANBand_t AS923 = {
   .bandNum = BandAS923,
   .bandType = RADIOLIB_LORAWAN_BAND_DYNAMIC,
@@ -447,6 +523,8 @@ const LoRaWANBand_t AS923 = {
   .powerMax = 16,
   .powerNumSteps = 7,
   .dutyCycle = 36000,
+  .numDutyCycleBands = 0,
+  .dutyCycleBands = NULL,
   .dwellTimeUp = RADIOLIB_LORAWAN_DWELL_TIME,
   .dwellTimeDn = RADIOLIB_LORAWAN_DWELL_TIME,
   .txParamSupported = true,
@@ -510,7 +588,9 @@ const LoRaWANBand_t AS923 = {
     RADIOLIB_LORAWAN_DATA_RATE_UNUSED
   }
 };
+#endif
 
+#if !RADIOLIB_EXCLUDE_LORAWAN_AS923_2
 const LoRaWANBand_t AS923_2 = {
   .bandNum = BandAS923_2,
   .bandType = RADIOLIB_LORAWAN_BAND_DYNAMIC,
@@ -520,6 +600,8 @@ const LoRaWANBand_t AS923_2 = {
   .powerMax = 16,
   .powerNumSteps = 7,
   .dutyCycle = 36000,
+  .numDutyCycleBands = 0,
+  .dutyCycleBands = NULL,
   .dwellTimeUp = RADIOLIB_LORAWAN_DWELL_TIME,
   .dwellTimeDn = RADIOLIB_LORAWAN_DWELL_TIME,
   .txParamSupported = true,
@@ -583,7 +665,9 @@ const LoRaWANBand_t AS923_2 = {
     RADIOLIB_LORAWAN_DATA_RATE_UNUSED
   }
 };
+#endif
 
+#if !RADIOLIB_EXCLUDE_LORAWAN_AS923_3
 const LoRaWANBand_t AS923_3 = {
   .bandNum = BandAS923_3,
   .bandType = RADIOLIB_LORAWAN_BAND_DYNAMIC,
@@ -593,6 +677,8 @@ const LoRaWANBand_t AS923_3 = {
   .powerMax = 16,
   .powerNumSteps = 7,
   .dutyCycle = 36000,
+  .numDutyCycleBands = 0,
+  .dutyCycleBands = NULL,
   .dwellTimeUp = RADIOLIB_LORAWAN_DWELL_TIME,
   .dwellTimeDn = RADIOLIB_LORAWAN_DWELL_TIME,
   .txParamSupported = true,
@@ -656,7 +742,9 @@ const LoRaWANBand_t AS923_3 = {
     RADIOLIB_LORAWAN_DATA_RATE_UNUSED
   }
 };
+#endif
 
+#if !RADIOLIB_EXCLUDE_LORAWAN_AS923_4
 const LoRaWANBand_t AS923_4 = {
   .bandNum = BandAS923_4,
   .bandType = RADIOLIB_LORAWAN_BAND_DYNAMIC,
@@ -666,6 +754,8 @@ const LoRaWANBand_t AS923_4 = {
   .powerMax = 16,
   .powerNumSteps = 7,
   .dutyCycle = 36000,
+  .numDutyCycleBands = 0,
+  .dutyCycleBands = NULL,
   .dwellTimeUp = RADIOLIB_LORAWAN_DWELL_TIME,
   .dwellTimeDn = RADIOLIB_LORAWAN_DWELL_TIME,
   .txParamSupported = true,
@@ -729,7 +819,9 @@ const LoRaWANBand_t AS923_4 = {
     RADIOLIB_LORAWAN_DATA_RATE_UNUSED
   }
 };
+#endif
 
+#if !RADIOLIB_EXCLUDE_LORAWAN_KR920
 const LoRaWANBand_t KR920 = {
   .bandNum = BandKR920,
   .bandType = RADIOLIB_LORAWAN_BAND_DYNAMIC,
@@ -739,6 +831,8 @@ const LoRaWANBand_t KR920 = {
   .powerMax = 14,
   .powerNumSteps = 7,
   .dutyCycle = 0,
+  .numDutyCycleBands = 0,
+  .dutyCycleBands = NULL,
   .dwellTimeUp = 0,
   .dwellTimeDn = 0,
   .txParamSupported = false,
@@ -802,7 +896,9 @@ const LoRaWANBand_t KR920 = {
     RADIOLIB_LORAWAN_DATA_RATE_UNUSED
   }
 };
+#endif
 
+#if !RADIOLIB_EXCLUDE_LORAWAN_IN865
 const LoRaWANBand_t IN865 = {
   .bandNum = BandIN865,
   .bandType = RADIOLIB_LORAWAN_BAND_DYNAMIC,
@@ -812,6 +908,8 @@ const LoRaWANBand_t IN865 = {
   .powerMax = 30,
   .powerNumSteps = 10,
   .dutyCycle = 0,
+  .numDutyCycleBands = 0,
+  .dutyCycleBands = NULL,
   .dwellTimeUp = 0,
   .dwellTimeDn = 0,
   .txParamSupported = false,
@@ -875,5 +973,6 @@ const LoRaWANBand_t IN865 = {
     RADIOLIB_LORAWAN_DATA_RATE_UNUSED
   }
 };
+#endif
 
 #endif
@@ -0,0 +1,502 @@
+#include "PacketForwarder.h"
+
+#include <string.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#if defined(ESP_PLATFORM)
+#include "esp_attr.h"
+#endif
+
+#if !RADIOLIB_EXCLUDE_PACKET_FORWARDER
+
+static const char PacketForwarderBase64[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+
+// packets are timestamped in the packet received interrupt, which only takes a function without arguments
+// so there is one interrupt service routine per RF chain, sharing the timestamp source of the forwarder
+static RADIOLIB_THREAD_LOCAL RadioLibHal* PacketForwarderHal = NULL;
+static RADIOLIB_THREAD_LOCAL volatile bool PacketForwarderRxDone[RADIOLIB_PACKET_FORWARDER_MAX_RADIOS] = { false };
+static RADIOLIB_THREAD_LOCAL volatile uint32_t PacketForwarderRxTmst[RADIOLIB_PACKET_FORWARDER_MAX_RADIOS] = { 0 };
+
+template<uint8_t N>
+#if defined(ESP8266) || defined(ESP32)
+  IRAM_ATTR
+#endif
+static void PacketForwarderOnReceive(void) {
+  if(N < RADIOLIB_PACKET_FORWARDER_MAX_RADIOS) {
+    PacketForwarderRxTmst[N] = (uint32_t)PacketForwarderHal->micros();
+    PacketForwarderRxDone[N] = true;
+  }
+}
+
+static void (*const PacketForwarderRxActions[])(void) = {
+  PacketForwarderOnReceive<0>,
+  PacketForwarderOnReceive<1>,
+  PacketForwarderOnReceive<2>,
+  PacketForwarderOnReceive<3>,
+};
+
+PacketForwarder::PacketForwarder(uint64_t gatewayEui, PacketForwarderSendCb_t sendCb) {
+  this->gatewayEui = gatewayEui;
+  this->sendCb = sendCb;
+  memset(this->radios, 0, sizeof(this->radios));
+  memset(this->queue, 0, sizeof(this->queue));
+  memset(&this->stats, 0, sizeof(this->stats));
+}
+
+int16_t PacketForwarder::addRadio(PhysicalLayer* phy, float freq, uint8_t sf, float bw, uint8_t cr) {
+  if(!phy) {
+    return(RADIOLIB_ERR_NULL_POINTER);
+  }
+  if(this->numRadios >= RADIOLIB_PACKET_FORWARDER_MAX_RADIOS) {
+    return(RADIOLIB_ERR_FORWARDER_RADIO_UNAVAILABLE);
+  }
+
+  PacketForwarderRadio_t* radio = &this->radios[this->numRadios];
+  radio->phy = phy;
+  radio->freq = freq;
+  radio->dr.lora.spreadingFactor = sf;
+  radio->dr.lora.bandwidth = bw;
+  radio->dr.lora.codingRate = cr;
+  radio->busy = false;
+
+  // all timestamps are taken from the clock of the first radio
+  if(this->numRadios == 0) {
+    PacketForwarderHal = phy->getMod()->hal;
+  }
+  PacketForwarderRxDone[this->numRadios] = false;
+  phy->setPacketReceivedAction(PacketForwarderRxActions[this->numRadios]);
+
+  int16_t state = this->startReceive(this->numRadios);
+  RADIOLIB_ASSERT(state);
+
+  this->numRadios++;
+  return(state);
+}
+
+int16_t PacketForwarder::update() {
+  int16_t numForwarded = 0;
+  int16_t state = RADIOLIB_ERR_NONE;
+
+  // forward packets received by radios that are not transmitting, using the timestamp from the interrupt
+  for(uint8_t i = 0; i < this->numRadios; i++) {
+    if(this->radios[i].busy || !PacketForwarderRxDone[i]) {
+      continue;
+    }
+    PacketForwarderRxDone[i] = false;
+    state = this->forwardPacket(i, PacketForwarderRxTmst[i]);
+    if(state == RADIOLIB_ERR_NONE) {
+      numForwarded++;
+    } else if(state != RADIOLIB_ERR_CRC_MISMATCH) {
+      return(state);
+    }
+  }
+
+  // start downlinks that are due and finish the ones that were transmitted
+  for(uint8_t i = 0; i < RADIOLIB_PACKET_FORWARDER_QUEUE_LEN; i++) {
+    if(this->queue[i].state != RADIOLIB_PACKET_FORWARDER_DOWNLINK_FREE) {
+      state = this->processDownlink(&this->queue[i], this->getTimestamp());
+      RADIOLIB_ASSERT(state);
+    }
+  }
+
+  return(numForwarded);
+}
+
+void PacketForwarder::pullData() {
+  uint8_t buff[RADIOLIB_PACKET_FORWARDER_HEADER_LEN + RADIOLIB_PACKET_FORWARDER_EUI_LEN];
+  size_t len = this->writeHeader(buff, this->token++, RADIOLIB_PACKET_FORWARDER_PULL_DATA);
+  this->sendCb(buff, len);
+}
+
+int16_t PacketForwarder::handleDatagram(const uint8_t* data, size_t len) {
+  if(!data) {
+    return(RADIOLIB_ERR_NULL_POINTER);
+  }
+  if((len < RADIOLIB_PACKET_FORWARDER_HEADER_LEN) || (data[0] != RADIOLIB_PACKET_FORWARDER_PROTOCOL_VERSION)) {
+    return(RADIOLIB_ERR_INVALID_PAYLOAD);
+  }
+  uint16_t token = ((uint16_t)data[1] << 8) | (uint16_t)data[2];
+
+  switch(data[3]) {
+    case(RADIOLIB_PACKET_FORWARDER_PUSH_ACK):
+      this->stats.ackUp++;
+      break;
+
+    case(RADIOLIB_PACKET_FORWARDER_PULL_ACK):
+      break;
+
+    case(RADIOLIB_PACKET_FORWARDER_PULL_RESP): {
+      // the JSON object is not null-terminated in the datagram
+      char json[RADIOLIB_PACKET_FORWARDER_BUFF_LEN];
+      size_t jsonLen = RADIOLIB_MIN(len - RADIOLIB_PACKET_FORWARDER_HEADER_LEN, sizeof(json) - 1);
+      memcpy(json, &data[RADIOLIB_PACKET_FORWARDER_HEADER_LEN], jsonLen);
+      json[jsonLen] = '\0';
+      this->stats.dnRx++;
+
+      const char* error = NULL;
+      int16_t state = this->scheduleDownlink(json, &error);
+      if(error) {
+        RADIOLIB_DEBUG_PROTOCOL_PRINTLN("Downlink rejected: %s", error);
+        this->stats.dnRejected++;
+        this->txAck(token, error);
+      } else if(state == RADIOLIB_ERR_NONE) {
+        this->txAck(token, "NONE");
+      }
+      return(state);
+    }
+
+    default:
+      return(RADIOLIB_ERR_INVALID_PAYLOAD);
+  }
+
+  return(RADIOLIB_ERR_NONE);
+}
+
+uint32_t PacketForwarder::getTimestamp() {
+  if(this->numRadios == 0) {
+    return(0);
+  }
+  return((uint32_t)this->radios[0].phy->getMod()->hal->micros());
+}
+
+PacketForwarderStats_t PacketForwarder::getStats() {
+  return(this->stats);
+}
+
+int16_t PacketForwarder::configRadio(PhysicalLayer* phy, float freq, DataRate_t dr, bool invertIQ) {
+  int16_t state = phy->standby();
+  RADIOLIB_ASSERT(state);
+  state = phy->setFrequency(freq);
+  RADIOLIB_ASSERT(state);
+  state = phy->setDataRate(dr);
+  RADIOLIB_ASSERT(state);
+  uint8_t syncWord = RADIOLIB_PACKET_FORWARDER_SYNC_WORD;
+  state = phy->setSyncWord(&syncWord, 1);
+  RADIOLIB_ASSERT(state);
+  state = phy->setPreambleLength(RADIOLIB_PACKET_FORWARDER_PREAMBLE_LEN);
+  RADIOLIB_ASSERT(state);
+  state = phy->invertIQ(invertIQ);
+  return(state);
+}
+
+int16_t PacketForwarder::forwardPacket(uint8_t rfch, uint32_t tmst) {
+  PacketForwarderRadio_t* radio = &this->radios[rfch];
+
+  // read the packet and its metadata, then return to reception as soon as possible
+  uint8_t payload[RADIOLIB_PACKET_FORWARDER_MAX_PAYLOAD_LEN];
+  size_t len = RADIOLIB_MIN(radio->phy->getPacketLength(), (size_t)RADIOLIB_PACKET_FORWARDER_MAX_PAYLOAD_LEN);
+  int16_t state = radio->phy->readData(payload, len);
+  int16_t rssi = (int16_t)radio->phy->getRSSI();
+  int16_t snr = (int16_t)(radio->phy->getSNR() * 10.0f);
+  int16_t stateRx = radio->phy->startReceive();
+  if(state == RADIOLIB_ERR_CRC_MISMATCH) {
+    this->stats.rxBad++;
+    return(state);
+  }
+  RADIOLIB_ASSERT(state);
+  RADIOLIB_ASSERT(stateRx);
+  this->stats.rxOk++;
+
+  // frequency is printed in MHz with 100 Hz resolution, without relying on floating point support in printf
+  uint32_t freq = (uint32_t)((double)radio->freq * 10000.0 + 0.5);
+  uint16_t snrAbs = (snr < 0) ? -snr : snr;
+
+  uint8_t buff[RADIOLIB_PACKET_FORWARDER_BUFF_LEN];
+  size_t pos = this->writeHeader(buff, this->token++, RADIOLIB_PACKET_FORWARDER_PUSH_DATA);
+  char* json = (char*)&buff[pos];
+  size_t jsonLen = snprintf(json, sizeof(buff) - pos,
+    "{\"rxpk\":[{\"tmst\":%lu,\"chan\":%u,\"rfch\":%u,\"freq\":%lu.%04lu,\"stat\":1,\"modu\":\"LORA\","
+    "\"datr\":\"SF%uBW%u\",\"codr\":\"4/%u\",\"rssi\":%d,\"lsnr\":%s%u.%u,\"size\":%u,\"data\":\"",
+    (unsigned long)tmst, rfch, rfch, (unsigned long)(freq / 10000), (unsigned long)(freq % 10000),
+    radio->dr.lora.spreadingFactor, (unsigned int)radio->dr.lora.bandwidth, radio->dr.lora.codingRate,
+    rssi, (snr < 0) ? "-" : "", snrAbs / 10, snrAbs % 10, (unsigned int)len);
+  jsonLen += PacketForwarder::base64Encode(payload, len, &json[jsonLen]);
+  memcpy(&json[jsonLen], "\"}]}", 4);
+  jsonLen += 4;
+
+  RADIOLIB_DEBUG_PROTOCOL_PRINTLN("PUSH_DATA: %d bytes on RF chain %d, RSSI = %d", (int)len, rfch, rssi);
+  this->sendCb(buff, pos + jsonLen);
+  return(RADIOLIB_ERR_NONE);
+}
+
+int16_t PacketForwarder::processDownlink(PacketForwarderDownlink_t* dn, uint32_t now) {
+  PacketForwarderRadio_t* radio = &this->radios[dn->rfch];
+  int32_t remaining = (int32_t)(dn->tmst - now);
+  int16_t state = RADIOLIB_ERR_NONE;
+
+  switch(dn->state) {
+    case(RADIOLIB_PACKET_FORWARDER_DOWNLINK_QUEUED):
+      // the radio may still be transmitting another downlink
+      if(radio->busy) {
+        if(remaining < 0) {
+          RADIOLIB_DEBUG_PROTOCOL_PRINTLN("Downlink dropped, RF chain %d busy", dn->rfch);
+          dn->state = RADIOLIB_PACKET_FORWARDER_DOWNLINK_FREE;
+          this->stats.dnRejected++;
+        }
+        return(RADIOLIB_ERR_NONE);
+      }
+      if(remaining > RADIOLIB_PACKET_FORWARDER_TX_LEAD) {
+        return(RADIOLIB_ERR_NONE);
+      }
+
+      // configure the radio ahead of time, so that only the transmission itself has to be started later
+      radio->busy = true;
+      dn->state = RADIOLIB_PACKET_FORWARDER_DOWNLINK_ARMED;
+      state = this->configRadio(radio->phy, dn->freq, dn->dr, dn->invertIQ);
+      if(state == RADIOLIB_ERR_NONE) {
+        state = radio->phy->setOutputPower(dn->power);
+      }
+      if(state == RADIOLIB_ERR_NONE) {
+        state = radio->phy->setPayloadCRC(dn->crc);
+        if(state == RADIOLIB_ERR_UNSUPPORTED) {
+          state = RADIOLIB_ERR_NONE;
+        }
+      }
+      break;
+
+    case(RADIOLIB_PACKET_FORWARDER_DOWNLINK_ARMED):
+      if(remaining > 0) {
+        return(RADIOLIB_ERR_NONE);
+      }
+      if((uint32_t)(-remaining) > this->stats.dnLateMax) {
+        this->stats.dnLateMax = (uint32_t)(-remaining);
+      }
+
+      // the transmission done interrupt triggers the same action as packet reception
+      PacketForwarderRxDone[dn->rfch] = false;
+      state = radio->phy->startTransmit(dn->data, dn->len);
+      dn->tmst = now;
+      dn->state = RADIOLIB_PACKET_FORWARDER_DOWNLINK_TRANSMITTING;
+      break;
+
+    case(RADIOLIB_PACKET_FORWARDER_DOWNLINK_TRANSMITTING): {
+      // in case the interrupt is not available, give up after the expected time-on-air has passed twice
+      bool timedOut = (now - dn->tmst) > 2*radio->phy->getTimeOnAir(dn->len) + RADIOLIB_PACKET_FORWARDER_TX_LEAD;
+      if(!PacketForwarderRxDone[dn->rfch] && (radio->phy->checkIrq(RADIOLIB_IRQ_TX_DONE) <= 0) && !timedOut) {
+        return(RADIOLIB_ERR_NONE);
+      }
+      state = radio->phy->finishTransmit();
+      if(state == RADIOLIB_ERR_NONE) {
+        this->stats.dnTx++;
+      }
+
+      // return to reception, even if the transmission failed
+      dn->state = RADIOLIB_PACKET_FORWARDER_DOWNLINK_FREE;
+      int16_t stateRx = this->startReceive(dn->rfch);
+      RADIOLIB_ASSERT(state);
+      return(stateRx);
+    }
+  }
+
+  // on failure, drop the downlink and return to reception
+  if(state != RADIOLIB_ERR_NONE) {
+    dn->state = RADIOLIB_PACKET_FORWARDER_DOWNLINK_FREE;
+    (void)this->startReceive(dn->rfch);
+  }
+  return(state);
+}
+
+int16_t PacketForwarder::startReceive(uint8_t rfch) {
+  PacketForwarderRadio_t* radio = &this->radios[rfch];
+  radio->busy = false;
+
+  // uplinks are received with normal IQ
+  int16_t state = this->configRadio(radio->phy, radio->freq, radio->dr, false);
+  RADIOLIB_ASSERT(state);
+  PacketForwarderRxDone[rfch] = false;
+  return(radio->phy->startReceive());
+}
+
+int16_t PacketForwarder::scheduleDownlink(const char* json, const char** error) {
+  const char* txpk = PacketForwarder::jsonFind(json, "txpk");
+  if(!txpk) {
+    *error = RADIOLIB_PACKET_FORWARDER_ERR_INVALID_TXPK;
+    return(RADIOLIB_ERR_INVALID_PAYLOAD);
+  }
+
+  // mandatory fields
+  const char* freqPtr = PacketForwarder::jsonFind(txpk, "freq");
+  const char* datrPtr = PacketForwarder::jsonFind(txpk, "datr");
+  const char* dataPtr = PacketForwarder::jsonFind(txpk, "data");
+  if(!freqPtr || !datrPtr || !dataPtr || (datrPtr[0] != '"') || (datrPtr[1] != 'S') || (datrPtr[2] != 'F')) {
+    *error = RADIOLIB_PACKET_FORWARDER_ERR_INVALID_TXPK;
+    return(RADIOLIB_ERR_INVALID_PAYLOAD);
+  }
+
+  // find a free slot in the queue
+  PacketForwarderDownlink_t* dn = NULL;
+  for(uint8_t i = 0; i < RADIOLIB_PACKET_FORWARDER_QUEUE_LEN; i++) {
+    if(this->queue[i].state == RADIOLIB_PACKET_FORWARDER_DOWNLINK_FREE) {
+      dn = &this->queue[i];
+      break;
+    }
+  }
+  if(!dn) {
+    *error = "COLLISION_PACKET";
+    return(RADIOLIB_ERR_FORWARDER_QUEUE_FULL);
+  }
+
+  // datarate in the format "SF7BW125"
+  char* end = NULL;
+  dn->dr.lora.spreadingFactor = (uint8_t)strtoul(&datrPtr[3], &end, 10);
+  if((end[0] != 'B') || (end[1] != 'W')) {
+    *error = RADIOLIB_PACKET_FORWARDER_ERR_INVALID_TXPK;
+    return(RADIOLIB_ERR_INVALID_PAYLOAD);
+  }
+  dn->dr.lora.bandwidth = (float)strtod(&end[2], NULL);
+
+  // coding rate in the format "4/5"
+  dn->dr.lora.codingRate = 5;
+  const char* ptr = PacketForwarder::jsonFind(txpk, "codr");
+  if(ptr && (ptr[0] == '"') && (ptr[2] == '/')) {
+    dn->dr.lora.codingRate = ptr[3] - '0';
+  }
+
+  dn->freq = (float)strtod(freqPtr, NULL);
+  ptr = PacketForwarder::jsonFind(txpk, "rfch");
+  dn->rfch = ptr ? (uint8_t)strtoul(ptr, NULL, 10) : 0;
+  ptr = PacketForwarder::jsonFind(txpk, "powe");
+  dn->power = ptr ? (int8_t)strtol(ptr, NULL, 10) : 14;
+  ptr = PacketForwarder::jsonFind(txpk, "ipol");
+  dn->invertIQ = ptr && (ptr[0] == 't');
+  ptr = PacketForwarder::jsonFind(txpk, "ncrc");
+  dn->crc = !(ptr && (ptr[0] == 't'));
+  if(dn->rfch >= this->numRadios) {
+    *error = "TX_FREQ";
+    return(RADIOLIB_ERR_FORWARDER_RADIO_UNAVAILABLE);
+  }
+  if(dn->freq <= 0) {
+    *error = "TX_FREQ";
+    return(RADIOLIB_ERR_INVALID_FREQUENCY);
+  }
+
+  // too high power is reduced to the highest one the radio supports, but never increased
+  int8_t clipped = dn->power;
+  int16_t state = this->radios[dn->rfch].phy->checkOutputPower(dn->power, &clipped);
+  if(state == RADIOLIB_ERR_INVALID_OUTPUT_POWER) {
+    if(clipped > dn->power) {
+      *error = "TX_POWER";
+      return(state);
+    }
+    dn->power = clipped;
+  }
+
+  dn->len = PacketForwarder::base64Decode(&dataPtr[1], dn->data, RADIOLIB_PACKET_FORWARDER_MAX_PAYLOAD_LEN);
+  if((dataPtr[0] != '"') || (dn->len == 0)) {
+    *error = RADIOLIB_PACKET_FORWARDER_ERR_INVALID_TXPK;
+    return(RADIOLIB_ERR_INVALID_PAYLOAD);
+  }
+
+  // immediate downlinks (e.g. Class C) are sent on the next update
+  uint32_t now = this->getTimestamp();
+  ptr = PacketForwarder::jsonFind(txpk, "imme");
+  if(ptr && (ptr[0] == 't')) {
+    dn->tmst = now;
+  } else {
+    ptr = PacketForwarder::jsonFind(txpk, "tmst");
+    if(!ptr) {
+      *error = RADIOLIB_PACKET_FORWARDER_ERR_INVALID_TXPK;
+      return(RADIOLIB_ERR_INVALID_PAYLOAD);
+    }
+    dn->tmst = (uint32_t)strtoul(ptr, NULL, 10);
+    int32_t advance = (int32_t)(dn->tmst - now);
+    if(advance < 0) {
+      *error = "TOO_LATE";
+      return(RADIOLIB_ERR_FORWARDER_TOO_LATE);
+    }
+    if((uint32_t)advance > RADIOLIB_PACKET_FORWARDER_TX_MAX_ADVANCE) {
+      *error = "TOO_EARLY";
+      return(RADIOLIB_ERR_FORWARDER_TOO_EARLY);
+    }
+  }
+
+  RADIOLIB_DEBUG_PROTOCOL_PRINTLN("PULL_RESP: %d bytes on RF chain %d at %lu (now %lu)",
+                                  (int)dn->len, dn->rfch, (unsigned long)dn->tmst, (unsigned long)now);
+  dn->state = RADIOLIB_PACKET_FORWARDER_DOWNLINK_QUEUED;
+  return(RADIOLIB_ERR_NONE);
+}
+
+void PacketForwarder::txAck(uint16_t token, const char* error) {
+  uint8_t buff[RADIOLIB_PACKET_FORWARDER_HEADER_LEN + RADIOLIB_PACKET_FORWARDER_EUI_LEN + 48];
+  size_t pos = this->writeHeader(buff, token, RADIOLIB_PACKET_FORWARDER_TX_ACK);
+  pos += snprintf((char*)&buff[pos], sizeof(buff) - pos, "{\"txpk_ack\":{\"error\":\"%s\"}}", error);
+  this->sendCb(buff, pos);
+}
+
+size_t PacketForwarder::writeHeader(uint8_t* out, uint16_t token, uint8_t id) {
+  out[0] = RADIOLIB_PACKET_FORWARDER_PROTOCOL_VERSION;
+  out[1] = (uint8_t)(token >> 8);
+  out[2] = (uint8_t)token;
+  out[3] = id;
+  for(uint8_t i = 0; i < RADIOLIB_PACKET_FORWARDER_EUI_LEN; i++) {
+    out[RADIOLIB_PACKET_FORWARDER_HEADER_LEN + i] = (uint8_t)(this->gatewayEui >> (8*(RADIOLIB_PACKET_FORWARDER_EUI_LEN - 1 - i)));
+  }
+  return(RADIOLIB_PACKET_FORWARDER_HEADER_LEN + RADIOLIB_PACKET_FORWARDER_EUI_LEN);
+}
+
+const char* PacketForwarder::jsonFind(const char* json, const char* key) {
+  // look for the quoted key, followed by a colon
+  size_t keyLen = strlen(key);
+  const char* ptr = json;
+  while((ptr = strchr(ptr, '"')) != NULL) {
+    ptr++;
+    if((strncmp(ptr, key, keyLen) == 0) && (ptr[keyLen] == '"')) {
+      ptr += keyLen + 1;
+      while((*ptr == ' ') || (*ptr == '\t') || (*ptr == '\r') || (*ptr == '\n')) {
+        ptr++;
+      }
+      if(*ptr != ':') {
+        continue;
+      }
+      ptr++;
+      while((*ptr == ' ') || (*ptr == '\t') || (*ptr == '\r') || (*ptr == '\n')) {
+        ptr++;
+      }
+      return(ptr);
+    }
+  }
+  return(NULL);
+}
+
+size_t PacketForwarder::base64Encode(const uint8_t* in, size_t len, char* out) {
+  size_t pos = 0;
+  for(size_t i = 0; i < len; i += 3) {
+    uint32_t block = (uint32_t)in[i] << 16;
+    if(i + 1 < len) {
+      block |= (uint32_t)in[i + 1] << 8;
+    }
+    if(i + 2 < len) {
+      block |= (uint32_t)in[i + 2];
+    }
+    out[pos++] = PacketForwarderBase64[(block >> 18) & 0x3F];
+    out[pos++] = PacketForwarderBase64[(block >> 12) & 0x3F];
+    out[pos++] = (i + 1 < len) ? PacketForwarderBase64[(block >> 6) & 0x3F] : '=';
+    out[pos++] = (i + 2 < len) ? PacketForwarderBase64[block & 0x3F] : '=';
+  }
+  return(pos);
+}
+
+size_t PacketForwarder::base64Decode(const char* in, uint8_t* out, size_t maxLen) {
+  size_t len = 0;
+  uint32_t block = 0;
+  uint8_t numBits = 0;
+  for(; (*in != '\0') && (*in != '"') && (*in != '='); in++) {
+    const char* sym = strchr(PacketForwarderBase64, *in);
+    if(!sym) {
+      return(0);
+    }
+    block = (block << 6) | (uint32_t)(sym - PacketForwarderBase64);
+    numBits += 6;
+    if(numBits >= 8) {
+      numBits -= 8;
+      if(len >= maxLen) {
+        return(0);
+      }
+      out[len++] = (uint8_t)(block >> numBits);
+    }
+  }
+  return(len);
+}
+
+#endif
@@ -0,0 +1,254 @@
+#if !defined(_RADIOLIB_PACKET_FORWARDER_H) && !RADIOLIB_EXCLUDE_PACKET_FORWARDER
+#define _RADIOLIB_PACKET_FORWARDER_H
+
+#include "../../TypeDef.h"
+#include "../PhysicalLayer/PhysicalLayer.h"
+
+// Semtech UDP packet forwarder protocol version
+#define RADIOLIB_PACKET_FORWARDER_PROTOCOL_VERSION              (0x02)
+
+// datagram identifiers
+#define RADIOLIB_PACKET_FORWARDER_PUSH_DATA                     (0x00)
+#define RADIOLIB_PACKET_FORWARDER_PUSH_ACK                      (0x01)
+#define RADIOLIB_PACKET_FORWARDER_PULL_DATA                     (0x02)
+#define RADIOLIB_PACKET_FORWARDER_PULL_RESP                     (0x03)
+#define RADIOLIB_PACKET_FORWARDER_PULL_ACK                      (0x04)
+#define RADIOLIB_PACKET_FORWARDER_TX_ACK                        (0x05)
+
+// datagram header:   version (1 byte) | token (2 bytes) | identifier (1 byte) | gateway EUI (8 bytes, upstream only)
+#define RADIOLIB_PACKET_FORWARDER_HEADER_LEN                    (4)
+#define RADIOLIB_PACKET_FORWARDER_EUI_LEN                       (8)
+
+// LoRaWAN physical layer parameters
+#define RADIOLIB_PACKET_FORWARDER_SYNC_WORD                     (0x34)
+#define RADIOLIB_PACKET_FORWARDER_PREAMBLE_LEN                  (8)
+
+// maximum number of radios (RF chains) handled by a single forwarder
+// each radio needs its own packet received interrupt service routine, of which there are 4
+#if !defined(RADIOLIB_PACKET_FORWARDER_MAX_RADIOS)
+  #define RADIOLIB_PACKET_FORWARDER_MAX_RADIOS                  (4)
+#endif
+#if RADIOLIB_PACKET_FORWARDER_MAX_RADIOS > 4
+  #error "Packet forwarder supports at most 4 radios!"
+#endif
+
+// maximum number of downlinks waiting for their scheduled time
+#if !defined(RADIOLIB_PACKET_FORWARDER_QUEUE_LEN)
+  #define RADIOLIB_PACKET_FORWARDER_QUEUE_LEN                   (4)
+#endif
+
+// the radio is configured this many microseconds before a scheduled downlink
+#define RADIOLIB_PACKET_FORWARDER_TX_LEAD                       (20000)
+
+// downlink states
+#define RADIOLIB_PACKET_FORWARDER_DOWNLINK_FREE                 (0)
+#define RADIOLIB_PACKET_FORWARDER_DOWNLINK_QUEUED               (1)   // waiting for its timestamp
+#define RADIOLIB_PACKET_FORWARDER_DOWNLINK_ARMED                (2)   // radio configured for transmission
+#define RADIOLIB_PACKET_FORWARDER_DOWNLINK_TRANSMITTING         (3)   // transmission in progress
+
+// downlinks scheduled further in the future than this are rejected (microseconds)
+#define RADIOLIB_PACKET_FORWARDER_TX_MAX_ADVANCE                (30000000UL)
+
+// maximum LoRa payload length
+#define RADIOLIB_PACKET_FORWARDER_MAX_PAYLOAD_LEN               (255)
+
+// length of the datagram buffer, enough for one base64-encoded packet with its metadata
+#define RADIOLIB_PACKET_FORWARDER_BUFF_LEN                      (640)
+
+// TX_ACK error for a PULL_RESP that can not be parsed, the protocol has no dedicated code for it
+#define RADIOLIB_PACKET_FORWARDER_ERR_INVALID_TXPK              "INVALID_TXPK"
+
+/*! \brief Callback to send a datagram to the network server (e.g. over UDP). */
+typedef void (*PacketForwarderSendCb_t)(const uint8_t* data, size_t len);
+
+/*!
+  \struct PacketForwarderRadio_t
+  \brief Structure to save the receive configuration of a single radio (RF chain).
+*/
+struct PacketForwarderRadio_t {
+  /*! \brief Pointer to the wireless module */
+  PhysicalLayer* phy;
+
+  /*! \brief Receive frequency in MHz */
+  float freq;
+
+  /*! \brief Receive datarate */
+  DataRate_t dr;
+
+  /*! \brief Whether the radio is currently used to transmit a downlink */
+  bool busy;
+};
+
+/*!
+  \struct PacketForwarderDownlink_t
+  \brief Structure to save a downlink waiting for transmission.
+*/
+struct PacketForwarderDownlink_t {
+  /*! \brief State of this entry, one of RADIOLIB_PACKET_FORWARDER_DOWNLINK_* */
+  uint8_t state;
+
+  /*! \brief Index of the radio (RF chain) to transmit on */
+  uint8_t rfch;
+
+  /*! \brief Internal timestamp (in microseconds) at which the transmission should start */
+  uint32_t tmst;
+
+  /*! \brief Transmit frequency in MHz */
+  float freq;
+
+  /*! \brief Transmit datarate */
+  DataRate_t dr;
+
+  /*! \brief Output power in dBm */
+  int8_t power;
+
+  /*! \brief Whether to transmit with inverted IQ */
+  bool invertIQ;
+
+  /*! \brief Whether to transmit the payload CRC (LoRaWAN downlinks are sent without it) */
+  bool crc;
+
+  /*! \brief Length of the payload */
+  size_t len;
+
+  /*! \brief Payload (LoRaWAN PHYPayload) */
+  uint8_t data[RADIOLIB_PACKET_FORWARDER_MAX_PAYLOAD_LEN];
+};
+
+/*!
+  \struct PacketForwarderStats_t
+  \brief Structure to save packet forwarder statistics.
+*/
+struct PacketForwarderStats_t {
+  /*! \brief Number of packets received with a valid CRC */
+  uint32_t rxOk;
+
+  /*! \brief Number of packets received with an invalid CRC (not forwarded) */
+  uint32_t rxBad;
+
+  /*! \brief Number of PUSH_DATA datagrams acknowledged by the server */
+  uint32_t ackUp;
+
+  /*! \brief Number of downlinks received from the server */
+  uint32_t dnRx;
+
+  /*! \brief Number of downlinks transmitted */
+  uint32_t dnTx;
+
+  /*! \brief Number of downlinks rejected (too late, too early or queue full) */
+  uint32_t dnRejected;
+
+  /*! \brief Largest delay between the requested and the actual start of a downlink, in microseconds */
+  uint32_t dnLateMax;
+};
+
+/*!
+  \class PacketForwarder
+  \brief LoRaWAN gateway-side packet forwarder, using the Semtech UDP protocol.
+  Radios are kept in continuous receive mode, received packets are sent to the server as PUSH_DATA
+  and downlinks received in PULL_RESP are transmitted at the requested timestamp.
+  Packets are timestamped in the packet received interrupt of each radio, so only one forwarder
+  can be used at a time (or one per thread, see RADIOLIB_THREAD_LOCAL).
+  The transport is up to the user: outgoing datagrams are passed to a callback,
+  incoming datagrams must be passed to handleDatagram.
+*/
+class PacketForwarder {
+  public:
+    /*!
+      \brief Default constructor.
+      \param gatewayEui Gateway EUI, used to identify the gateway to the server.
+      \param sendCb Callback to send a datagram to the server.
+    */
+    PacketForwarder(uint64_t gatewayEui, PacketForwarderSendCb_t sendCb);
+
+    /*!
+      \brief Add a radio (RF chain) and start continuous LoRa reception on it.
+      The radio must be initialized (begin) beforehand. RF chains are numbered in the order they were added.
+      The packet received action of the radio is used by the forwarder to timestamp received packets.
+      \param phy Pointer to the wireless module.
+      \param freq Receive frequency in MHz.
+      \param sf LoRa spreading factor.
+      \param bw LoRa bandwidth in kHz.
+      \param cr LoRa coding rate denominator. Defaults to 4/5.
+      \returns \ref status_codes
+    */
+    int16_t addRadio(PhysicalLayer* phy, float freq, uint8_t sf, float bw, uint8_t cr = 5);
+
+    /*!
+      \brief Forward received packets to the server and start or finish transmission of scheduled downlinks.
+      Never blocks waiting for a downlink. Must be called as often as possible, as it determines
+      how precisely downlinks are transmitted at the requested timestamp.
+      \returns Number of packets forwarded to the server, or \ref status_codes on failure.
+    */
+    int16_t update();
+
+    /*!
+      \brief Send a PULL_DATA datagram, which allows the server to send downlinks (PULL_RESP) to the gateway.
+      Should be sent periodically (e.g. every 10 seconds) to keep the downlink route open.
+    */
+    void pullData();
+
+    /*!
+      \brief Process a datagram received from the server (PUSH_ACK, PULL_ACK or PULL_RESP).
+      \param data Received datagram.
+      \param len Length of the datagram in bytes.
+      \returns \ref status_codes
+    */
+    int16_t handleDatagram(const uint8_t* data, size_t len);
+
+    /*!
+      \brief Get the internal timestamp counter, as used in the tmst field.
+      \returns Timestamp in microseconds.
+    */
+    uint32_t getTimestamp();
+
+    /*!
+      \brief Get the statistics collected since the forwarder was created.
+      \returns Structure with the forwarder statistics.
+    */
+    PacketForwarderStats_t getStats();
+
+#if !RADIOLIB_GODMODE
+  private:
+#endif
+    uint64_t gatewayEui;
+    PacketForwarderSendCb_t sendCb;
+    uint16_t token = 0;
+
+    PacketForwarderRadio_t radios[RADIOLIB_PACKET_FORWARDER_MAX_RADIOS];
+    uint8_t numRadios = 0;
+
+    PacketForwarderDownlink_t queue[RADIOLIB_PACKET_FORWARDER_QUEUE_LEN];
+    PacketForwarderStats_t stats;
+
+    // configure a radio for LoRaWAN and set frequency and datarate
+    int16_t configRadio(PhysicalLayer* phy, float freq, DataRate_t dr, bool invertIQ);
+
+    // read a received packet from a radio and send it to the server
+    int16_t forwardPacket(uint8_t rfch, uint32_t tmst);
+
+    // advance a downlink through its states, returns the radio to reception once it was transmitted
+    int16_t processDownlink(PacketForwarderDownlink_t* dn, uint32_t now);
+
+    // configure a radio for reception and start receiving
+    int16_t startReceive(uint8_t rfch);
+
+    // parse the txpk object of a PULL_RESP and schedule the downlink,
+    // every rejected downlink gets an error string for its TX_ACK
+    int16_t scheduleDownlink(const char* json, const char** error);
+
+    // send TX_ACK with the given error string ("NONE" on success)
+    void txAck(uint16_t token, const char* error);
+
+    // write the datagram header including gateway EUI, returns its length
+    size_t writeHeader(uint8_t* out, uint16_t token, uint8_t id);
+
+    // find value of a key in a JSON object, returns NULL if not found
+    static const char* jsonFind(const char* json, const char* key);
+
+    // base64 conversion, returns the length of the output
+    static size_t base64Encode(const uint8_t* in, size_t len, char* out);
+    static size_t base64Decode(const char* in, uint8_t* out, size_t maxLen);
+};
+
+#endif
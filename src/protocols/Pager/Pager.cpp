@@ -550,9 +550,28 @@ uint32_t PagerClient::read() {
   }
 
   RADIOLIB_DEBUG_PROTOCOL_PRINTLN("R\t%lX", (long unsigned int)codeWord);
-  // TODO BCH error correction here
+
+  // correct bit errors, if there are too many the code word is returned as received
+  int8_t numErrors = RadioLibBCHInstance.decode(&codeWord);
+  this->stats.numCodeWords++;
+  if(numErrors < 0) {
+    RADIOLIB_DEBUG_PROTOCOL_PRINTLN("Uncorrectable code word");
+    this->stats.numUncorrectable++;
+  } else if(numErrors > 0) {
+    RADIOLIB_DEBUG_PROTOCOL_PRINTLN("Corrected %d bit errors", numErrors);
+    this->stats.numCorrected++;
+    this->stats.numBitsCorrected += numErrors;
+  }
   return(codeWord);
 }
+
+PagerStats_t PagerClient::getStats() {
+  return(this->stats);
+}
+
+void PagerClient::resetStats() {
+  memset(&this->stats, 0, sizeof(this->stats));
+}
 #endif
 
 uint8_t PagerClient::encodeBCD(char c) {
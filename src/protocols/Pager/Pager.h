@@ -55,6 +55,24 @@
 // the maximum allowed address (2^22 - 1)
 #define RADIOLIB_PAGER_ADDRESS_MAX                              (2097151)
 
+/*!
+  \struct PagerStats_t
+  \brief Structure to save statistics about the received code words.
+*/
+struct PagerStats_t {
+  /*! \brief Number of code words received */
+  uint32_t numCodeWords;
+
+  /*! \brief Number of code words in which bit errors were corrected */
+  uint32_t numCorrected;
+
+  /*! \brief Total number of corrected bit errors */
+  uint32_t numBitsCorrected;
+
+  /*! \brief Number of code words with more errors than could be corrected */
+  uint32_t numUncorrectable;
+};
+
 /*!
   \class PagerClient
   \brief Client for Pager communication.
@@ -170,6 +188,18 @@ class PagerClient {
       \returns \ref status_codes
     */
     int16_t readData(uint8_t* data, size_t* len, uint32_t* addr = NULL);
+
+    /*!
+      \brief Get the statistics of error correction of the received code words,
+      collected since the client was created or the statistics were last reset.
+      \returns Structure with the statistics.
+    */
+    PagerStats_t getStats();
+
+    /*!
+      \brief Reset all collected statistics.
+    */
+    void resetStats();
 #endif
 
 #if !RADIOLIB_GODMODE
@@ -189,6 +219,7 @@ class PagerClient {
     uint32_t *filterMasks = nullptr;
     size_t filterNumAddresses = 0;
     bool inv = false;
+    PagerStats_t stats = { 0, 0, 0, 0 };
 
     void write(uint32_t* data, size_t len);
     void write(uint32_t codeWord);
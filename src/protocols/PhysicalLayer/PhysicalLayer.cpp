@@ -247,6 +247,11 @@ int16_t PhysicalLayer::invertIQ(bool enable) {
   return(RADIOLIB_ERR_UNSUPPORTED);
 }
 
+int16_t PhysicalLayer::setPayloadCRC(bool enable) {
+  (void)enable;
+  return(RADIOLIB_ERR_UNSUPPORTED);
+}
+
 int16_t PhysicalLayer::setOutputPower(int8_t power) {
   (void)power;
   return(RADIOLIB_ERR_UNSUPPORTED);
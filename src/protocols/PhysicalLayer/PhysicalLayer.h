@@ -366,6 +366,14 @@ class PhysicalLayer {
     */
     virtual int16_t invertIQ(bool enable);
 
+    /*!
+      \brief Enable or disable the payload CRC, using the default CRC of the active modem.
+      Must be implemented in module class if the module supports it.
+      \param enable True to transmit and check the payload CRC, false to disable it.
+      \returns \ref status_codes
+    */
+    virtual int16_t setPayloadCRC(bool enable);
+
     /*!
       \brief Set output power. Must be implemented in module class if the module supports it.
       \param power Output power in dBm. The allowed range depends on the module used.
@@ -728,6 +736,7 @@ class PhysicalLayer {
     friend class FT8Client;
     friend class LoRaWANNode;
     friend class M17Client;
+    friend class PacketForwarder;
 };
 
 #endif
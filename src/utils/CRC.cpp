@@ -5,25 +5,74 @@ RadioLibCRC::RadioLibCRC() {
 }
 
 uint32_t RadioLibCRC::checksum(const uint8_t* buff, size_t len) {
-  uint32_t crc = this->init;
-  size_t pos = 0;
-  for(size_t i = 0; i < 8*len; i++) {
-    if(i % 8 == 0) {
-      uint32_t in = buff[pos++];
-      if(this->refIn) {
-        in = rlb_reflect(in, 8);
+  return(this->finish(this->update(this->init, buff, len)));
+}
+
+uint32_t RadioLibCRC::update(uint32_t crc, const uint8_t* buff, size_t len) {
+#if RADIOLIB_CRC_TABLE
+  // the tables process whole bytes, which does not work for CRCs shorter than that
+  if(this->size < 8) {
+    return(this->updateBitwise(crc, buff, len));
+  }
+
+  // generating a table takes about as long as the bitwise calculation over 256 bytes
+  if(!this->isTableValid()) {
+    if(len < RADIOLIB_CRC_TABLE_MIN_LEN) {
+      return(this->updateBitwise(crc, buff, len));
+    }
+    this->generateTable();
+  }
+
+  uint32_t mask = (uint32_t)0xFFFFFFFF >> (32 - this->size);
+  size_t i = 0;
+  if(this->refIn) {
+    // with reflected input, the tables are reflected too, so process the register LSB first
+    crc = rlb_reflect(crc & mask, this->size);
+#if RADIOLIB_CRC_TABLE > 1
+    // slice-by-N: the register is added to the first 4 bytes, then each byte is looked up in its own table
+    for(; i + RADIOLIB_CRC_TABLE <= len; i += RADIOLIB_CRC_TABLE) {
+      uint32_t res = 0;
+      for(uint8_t j = 0; j < RADIOLIB_CRC_TABLE; j++) {
+        uint8_t b = buff[i + j];
+        if(j < 4) {
+          b ^= (crc >> (8*j)) & 0xFF;
+        }
+        res ^= this->table[RADIOLIB_CRC_TABLE - 1 - j][b];
       }
-      crc ^= (in << (this->size - 8));
+      crc = res;
+    }
+#endif
+    for(; i < len; i++) {
+      crc = (crc >> 8) ^ this->table[0][(crc ^ buff[i]) & 0xFF];
     }
+    return(rlb_reflect(crc, this->size));
+  }
 
-    if(crc & ((uint32_t)1 << (this->size - 1))) {
-      crc <<= (uint32_t)1;
-      crc ^= this->poly;
-    } else {
-      crc <<= (uint32_t)1;
+  // without reflection, the register is aligned to the most significant bit
+  crc = (crc & mask) << (32 - this->size);
+#if RADIOLIB_CRC_TABLE > 1
+  for(; i + RADIOLIB_CRC_TABLE <= len; i += RADIOLIB_CRC_TABLE) {
+    uint32_t res = 0;
+    for(uint8_t j = 0; j < RADIOLIB_CRC_TABLE; j++) {
+      uint8_t b = buff[i + j];
+      if(j < 4) {
+        b ^= (crc >> (24 - 8*j)) & 0xFF;
+      }
+      res ^= this->table[RADIOLIB_CRC_TABLE - 1 - j][b];
     }
+    crc = res;
   }
+#endif
+  for(; i < len; i++) {
+    crc = (crc << 8) ^ this->table[0][(crc >> 24) ^ buff[i]];
+  }
+  return(crc >> (32 - this->size));
+#else
+  return(this->updateBitwise(crc, buff, len));
+#endif
+}
 
+uint32_t RadioLibCRC::finish(uint32_t crc) {
   crc ^= this->out;
   if(this->refOut) {
     crc = rlb_reflect(crc, this->size);
@@ -32,4 +81,63 @@ uint32_t RadioLibCRC::checksum(const uint8_t* buff, size_t len) {
   return(crc);
 }
 
+#if RADIOLIB_CRC_TABLE
+void RadioLibCRC::generateTable() {
+  if(this->refIn) {
+    uint32_t polyRef = rlb_reflect(this->poly, this->size);
+    for(uint16_t i = 0; i < 256; i++) {
+      uint32_t r = i;
+      for(uint8_t bit = 0; bit < 8; bit++) {
+        r = (r & 1) ? ((r >> 1) ^ polyRef) : (r >> 1);
+      }
+      this->table[0][i] = r;
+    }
+    for(uint8_t k = 1; k < RADIOLIB_CRC_TABLE; k++) {
+      for(uint16_t i = 0; i < 256; i++) {
+        uint32_t r = this->table[k - 1][i];
+        this->table[k][i] = (r >> 8) ^ this->table[0][r & 0xFF];
+      }
+    }
+
+  } else {
+    uint32_t polyAligned = this->poly << (32 - this->size);
+    for(uint16_t i = 0; i < 256; i++) {
+      uint32_t r = (uint32_t)i << 24;
+      for(uint8_t bit = 0; bit < 8; bit++) {
+        r = (r & 0x80000000UL) ? ((r << 1) ^ polyAligned) : (r << 1);
+      }
+      this->table[0][i] = r;
+    }
+    for(uint8_t k = 1; k < RADIOLIB_CRC_TABLE; k++) {
+      for(uint16_t i = 0; i < 256; i++) {
+        uint32_t r = this->table[k - 1][i];
+        this->table[k][i] = (r << 8) ^ this->table[0][r >> 24];
+      }
+    }
+  }
+
+  this->tableSize = this->size;
+  this->tablePoly = this->poly;
+  this->tableRefIn = this->refIn;
+}
+
+bool RadioLibCRC::isTableValid() {
+  return((this->tableSize == this->size) && (this->tablePoly == this->poly) && (this->tableRefIn == this->refIn));
+}
+#endif
+
+uint32_t RadioLibCRC::updateBitwise(uint32_t crc, const uint8_t* buff, size_t len) {
+  // feedback is the XOR of the register MSB and the next input bit, which works for any CRC size
+  for(size_t i = 0; i < len; i++) {
+    uint8_t in = this->refIn ? rlb_reflect8(buff[i]) : buff[i];
+    for(uint8_t bit = 0; bit < 8; bit++) {
+      // branchless, the feedback depends on the data and would be mispredicted half of the time
+      uint32_t fb = ((crc >> (this->size - 1)) ^ (in >> 7)) & 0x01;
+      crc = (crc << 1) ^ (this->poly & (0 - fb));
+      in <<= 1;
+    }
+  }
+  return(crc & ((uint32_t)0xFFFFFFFF >> (32 - this->size)));
+}
+
 RadioLibCRC RadioLibCRCInstance;
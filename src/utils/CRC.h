@@ -9,9 +9,19 @@
 #define RADIOLIB_CRC_CCITT_INIT                                 (0xFFFF)
 #define RADIOLIB_CRC_CCITT_OUT                                  (0xFFFF)
 
+// shortest buffer for which it is worth (re)generating the lookup tables
+#define RADIOLIB_CRC_TABLE_MIN_LEN                              (64)
+
+#if (RADIOLIB_CRC_TABLE != 0) && (RADIOLIB_CRC_TABLE != 1) && (RADIOLIB_CRC_TABLE != 4) && (RADIOLIB_CRC_TABLE != 8)
+  #error "RADIOLIB_CRC_TABLE must be 0, 1, 4 or 8"
+#endif
+
 /*!
   \class RadioLibCRC
   \brief Class to calculate CRCs of varying formats.
+  When RADIOLIB_CRC_TABLE is enabled, lookup tables are generated for the configured CRC
+  and kept until the configuration changes. For short buffers, the bitwise calculation is used
+  unless the tables for the current configuration already exist.
 */
 class RadioLibCRC {
   public:
@@ -57,6 +67,44 @@ class RadioLibCRC {
       \returns The resulting checksum.
     */
     uint32_t checksum(const uint8_t* buff, size_t len);
+
+    /*!
+      \brief Update a running CRC with the next part of the data. To calculate a checksum over multiple buffers,
+      start with the initial value, call this method for each buffer and pass the result to finish.
+      \param crc Current CRC value, either the initial value or the result of the previous update.
+      \param buff Buffer with the next part of the data.
+      \param len Size of the buffer in bytes.
+      \returns The updated CRC value.
+    */
+    uint32_t update(uint32_t crc, const uint8_t* buff, size_t len);
+
+    /*!
+      \brief Apply the final XOR value and output reflection to a running CRC.
+      \param crc CRC value returned by update.
+      \returns The resulting checksum.
+    */
+    uint32_t finish(uint32_t crc);
+
+#if !RADIOLIB_GODMODE
+  private:
+#endif
+#if RADIOLIB_CRC_TABLE
+    // table k holds the CRC of each byte followed by k zero bytes,
+    // without reflection the entries are aligned to the most significant bit
+    uint32_t table[RADIOLIB_CRC_TABLE][256];
+    uint8_t tableSize = 0;
+    uint32_t tablePoly = 0;
+    bool tableRefIn = false;
+
+    // generate the lookup tables for the current configuration
+    void generateTable();
+
+    // check whether the lookup tables match the current configuration
+    bool isTableValid();
+#endif
+
+    // bit-by-bit calculation, used when the lookup table is not available
+    uint32_t updateBitwise(uint32_t crc, const uint8_t* buff, size_t len);
 };
 
 // the global singleton
@@ -0,0 +1,86 @@
+#include "Coding.h"
+
+// Manchester code of each nibble, G. E. Thomas convention
+static const uint8_t manchesterNibble[] RADIOLIB_NONVOLATILE = {
+  0x55, 0x56, 0x59, 0x5A, 0x65, 0x66, 0x69, 0x6A,
+  0x95, 0x96, 0x99, 0x9A, 0xA5, 0xA6, 0xA9, 0xAA,
+};
+
+uint16_t rlb_whiten_pn9(uint8_t* buff, size_t len, uint16_t seed) {
+  uint16_t state = seed & 0x01FF;
+  for(size_t i = 0; i < len; i++) {
+    buff[i] ^= (uint8_t)state;
+
+    // advance the generator by 8 steps at once, the upper 4 new bits depend on the lower 4
+    uint8_t fb = (state ^ (state >> 5)) & 0x0F;
+    fb |= (((state >> 4) ^ fb) & 0x0F) << 4;
+    state = (state >> 8) | ((uint16_t)fb << 1);
+  }
+  return(state);
+}
+
+uint16_t rlb_scramble(uint8_t* buff, size_t len, uint16_t seed) {
+  uint16_t state = seed & 0x7FFF;
+  for(size_t i = 0; i < len; i++) {
+    // the next 8 output bits only depend on the current state, so a whole byte can be processed at once
+    uint8_t fb = (state ^ (state >> 1)) & 0xFF;
+    buff[i] ^= fb;
+    state = (state >> 8) | ((uint16_t)fb << 7);
+  }
+  return(state);
+}
+
+void rlb_manchester_encode(const uint8_t* in, uint8_t* out, size_t len, bool invert) {
+  uint8_t mask = invert ? 0xFF : 0x00;
+
+  // go from the end so that the output can overlap the start of the input
+  for(size_t i = len; i > 0; i--) {
+    uint8_t b = in[i - 1];
+    out[2*i - 1] = RADIOLIB_NONVOLATILE_READ_BYTE(&manchesterNibble[b & 0x0F]) ^ mask;
+    out[2*i - 2] = RADIOLIB_NONVOLATILE_READ_BYTE(&manchesterNibble[b >> 4]) ^ mask;
+  }
+}
+
+// decode a single Manchester byte to nibble, invalid symbol pairs are counted
+static uint8_t manchesterDecodeByte(uint8_t b, size_t* numInvalid) {
+  *numInvalid += rlb_popcount(~(b ^ (b >> 1)) & 0x55);
+  return(((b >> 4) & 0x08) | ((b >> 3) & 0x04) | ((b >> 2) & 0x02) | ((b >> 1) & 0x01));
+}
+
+size_t rlb_manchester_decode(const uint8_t* in, uint8_t* out, size_t len, bool invert) {
+  uint8_t mask = invert ? 0xFF : 0x00;
+  size_t numInvalid = 0;
+  for(size_t i = 0; i < len/2; i++) {
+    uint8_t hi = manchesterDecodeByte(in[2*i], &numInvalid);
+    uint8_t lo = manchesterDecodeByte(in[2*i + 1], &numInvalid);
+    out[i] = ((hi << 4) | lo) ^ mask;
+  }
+  return(numInvalid);
+}
+
+uint8_t rlb_nrzi_encode(uint8_t* buff, size_t len, uint8_t level, bool invert) {
+  uint8_t mask = invert ? 0x00 : 0xFF;
+  for(size_t i = 0; i < len; i++) {
+    // each output bit is the running XOR of all transitions so far, starting from the most significant bit
+    uint8_t x = buff[i] ^ mask;
+    x ^= x >> 1;
+    x ^= x >> 2;
+    x ^= x >> 4;
+    if(level) {
+      x ^= 0xFF;
+    }
+    buff[i] = x;
+    level = x & 0x01;
+  }
+  return(level);
+}
+
+uint8_t rlb_nrzi_decode(uint8_t* buff, size_t len, uint8_t level, bool invert) {
+  uint8_t mask = invert ? 0x00 : 0xFF;
+  for(size_t i = 0; i < len; i++) {
+    uint8_t x = buff[i];
+    buff[i] = (x ^ ((x >> 1) | (level ? 0x80 : 0x00))) ^ mask;
+    level = x & 0x01;
+  }
+  return(level);
+}
@@ -0,0 +1,73 @@
+#if !defined(_RADIOLIB_CODING_H)
+#define _RADIOLIB_CODING_H
+
+#include "../TypeDef.h"
+#include "../Module.h"
+
+// PN9 whitening properties (x^9 + x^5 + 1, as used e.g. by CC1101 and SX126x)
+#define RADIOLIB_WHITENING_PN9_SEED                             (0x01FF)
+
+/*!
+  \brief Function to apply PN9 (x^9 + x^5 + 1) data whitening to a buffer. Each byte is XORed with the lowest 8 bits
+  of the generator state, after which the generator is advanced by 8 steps at once. Whitening the same data twice
+  with the same seed restores the original data.
+  \param buff Buffer to whiten in place.
+  \param len Length of the buffer in bytes.
+  \param seed Initial state of the generator, only the lowest 9 bits are used.
+  \returns Generator state after the last byte, can be passed as seed to continue whitening of a stream.
+*/
+uint16_t rlb_whiten_pn9(uint8_t* buff, size_t len, uint16_t seed = RADIOLIB_WHITENING_PN9_SEED);
+
+/*!
+  \brief Function to apply additive scrambler (x^15 + x^14 + 1) to a buffer. Scrambling the same data twice
+  with the same seed restores the original data. Bits are processed from the least significant bit of the first byte.
+  \param buff Buffer to scramble in place.
+  \param len Length of the buffer in bytes.
+  \param seed Initial state of the scrambler.
+  \returns Scrambler state after the last byte, can be passed as seed to continue scrambling of a stream.
+*/
+uint16_t rlb_scramble(uint8_t* buff, size_t len, uint16_t seed);
+
+/*!
+  \brief Function to Manchester-encode a buffer. Bits are processed from the most significant bit of the first byte,
+  logical 1 is encoded as 10 and logical 0 as 01 (G. E. Thomas convention).
+  \param in Input buffer.
+  \param out Output buffer, must be at least 2*len bytes long. Can be the same as the input buffer.
+  \param len Length of the input buffer in bytes.
+  \param invert Set to true to use the inverted (IEEE 802.3) convention, i.e. 1 encoded as 01 and 0 as 10.
+*/
+void rlb_manchester_encode(const uint8_t* in, uint8_t* out, size_t len, bool invert = false);
+
+/*!
+  \brief Function to decode Manchester-encoded buffer. Symbol pairs that are not valid Manchester symbols
+  (00 or 11) are decoded based on the first bit of the pair, and counted.
+  \param in Input buffer.
+  \param out Output buffer, must be at least len/2 bytes long. Can be the same as the input buffer.
+  \param len Length of the input buffer in bytes, must be even.
+  \param invert Set to true to use the inverted (IEEE 802.3) convention, i.e. 1 encoded as 01 and 0 as 10.
+  \returns Number of invalid symbol pairs, 0 if the whole buffer was decoded without errors.
+*/
+size_t rlb_manchester_decode(const uint8_t* in, uint8_t* out, size_t len, bool invert = false);
+
+/*!
+  \brief Function to NRZI-encode a buffer. Bits are processed from the most significant bit of the first byte,
+  logical 0 is encoded as change of the line level and logical 1 as no change (as used e.g. by AX.25).
+  \param buff Buffer to encode in place.
+  \param len Length of the buffer in bytes.
+  \param level Line level before the first bit (0 or 1).
+  \param invert Set to true to encode logical 1 as change of the line level instead.
+  \returns Line level after the last bit, can be passed to continue encoding of a stream.
+*/
+uint8_t rlb_nrzi_encode(uint8_t* buff, size_t len, uint8_t level = 0, bool invert = false);
+
+/*!
+  \brief Function to decode NRZI-encoded buffer.
+  \param buff Buffer to decode in place.
+  \param len Length of the buffer in bytes.
+  \param level Line level before the first bit (0 or 1).
+  \param invert Set to true if logical 1 was encoded as change of the line level.
+  \returns Line level after the last bit, can be passed to continue decoding of a stream.
+*/
+uint8_t rlb_nrzi_decode(uint8_t* buff, size_t len, uint8_t level = 0, bool invert = false);
+
+#endif
@@ -2,6 +2,79 @@
 
 #include <string.h>
 
+#if defined(RADIOLIB_AES128_HW_X86)
+#include <wmmintrin.h>
+#elif (RADIOLIB_AES128_BACKEND == RADIOLIB_AES128_BACKEND_TTABLE)
+// combined SubBytes and MixColumns for the first row of the state,
+// the other rows use the same table rotated by 8, 16 and 24 bits
+static const uint32_t aesTe0[] RADIOLIB_NONVOLATILE = {
+    0xc66363a5, 0xf87c7c84, 0xee777799, 0xf67b7b8d,
+    0xfff2f20d, 0xd66b6bbd, 0xde6f6fb1, 0x91c5c554,
+    0x60303050, 0x02010103, 0xce6767a9, 0x562b2b7d,
+    0xe7fefe19, 0xb5d7d762, 0x4dababe6, 0xec76769a,
+    0x8fcaca45, 0x1f82829d, 0x89c9c940, 0xfa7d7d87,
+    0xeffafa15, 0xb25959eb, 0x8e4747c9, 0xfbf0f00b,
+    0x41adadec, 0xb3d4d467, 0x5fa2a2fd, 0x45afafea,
+    0x239c9cbf, 0x53a4a4f7, 0xe4727296, 0x9bc0c05b,
+    0x75b7b7c2, 0xe1fdfd1c, 0x3d9393ae, 0x4c26266a,
+    0x6c36365a, 0x7e3f3f41, 0xf5f7f702, 0x83cccc4f,
+    0x6834345c, 0x51a5a5f4, 0xd1e5e534, 0xf9f1f108,
+    0xe2717193, 0xabd8d873, 0x62313153, 0x2a15153f,
+    0x0804040c, 0x95c7c752, 0x46232365, 0x9dc3c35e,
+    0x30181828, 0x379696a1, 0x0a05050f, 0x2f9a9ab5,
+    0x0e070709, 0x24121236, 0x1b80809b, 0xdfe2e23d,
+    0xcdebeb26, 0x4e272769, 0x7fb2b2cd, 0xea75759f,
+    0x1209091b, 0x1d83839e, 0x582c2c74, 0x341a1a2e,
+    0x361b1b2d, 0xdc6e6eb2, 0xb45a5aee, 0x5ba0a0fb,
+    0xa45252f6, 0x763b3b4d, 0xb7d6d661, 0x7db3b3ce,
+    0x5229297b, 0xdde3e33e, 0x5e2f2f71, 0x13848497,
+    0xa65353f5, 0xb9d1d168, 0x00000000, 0xc1eded2c,
+    0x40202060, 0xe3fcfc1f, 0x79b1b1c8, 0xb65b5bed,
+    0xd46a6abe, 0x8dcbcb46, 0x67bebed9, 0x7239394b,
+    0x944a4ade, 0x984c4cd4, 0xb05858e8, 0x85cfcf4a,
+    0xbbd0d06b, 0xc5efef2a, 0x4faaaae5, 0xedfbfb16,
+    0x864343c5, 0x9a4d4dd7, 0x66333355, 0x11858594,
+    0x8a4545cf, 0xe9f9f910, 0x04020206, 0xfe7f7f81,
+    0xa05050f0, 0x783c3c44, 0x259f9fba, 0x4ba8a8e3,
+    0xa25151f3, 0x5da3a3fe, 0x804040c0, 0x058f8f8a,
+    0x3f9292ad, 0x219d9dbc, 0x70383848, 0xf1f5f504,
+    0x63bcbcdf, 0x77b6b6c1, 0xafdada75, 0x42212163,
+    0x20101030, 0xe5ffff1a, 0xfdf3f30e, 0xbfd2d26d,
+    0x81cdcd4c, 0x180c0c14, 0x26131335, 0xc3ecec2f,
+    0xbe5f5fe1, 0x359797a2, 0x884444cc, 0x2e171739,
+    0x93c4c457, 0x55a7a7f2, 0xfc7e7e82, 0x7a3d3d47,
+    0xc86464ac, 0xba5d5de7, 0x3219192b, 0xe6737395,
+    0xc06060a0, 0x19818198, 0x9e4f4fd1, 0xa3dcdc7f,
+    0x44222266, 0x542a2a7e, 0x3b9090ab, 0x0b888883,
+    0x8c4646ca, 0xc7eeee29, 0x6bb8b8d3, 0x2814143c,
+    0xa7dede79, 0xbc5e5ee2, 0x160b0b1d, 0xaddbdb76,
+    0xdbe0e03b, 0x64323256, 0x743a3a4e, 0x140a0a1e,
+    0x924949db, 0x0c06060a, 0x4824246c, 0xb85c5ce4,
+    0x9fc2c25d, 0xbdd3d36e, 0x43acacef, 0xc46262a6,
+    0x399191a8, 0x319595a4, 0xd3e4e437, 0xf279798b,
+    0xd5e7e732, 0x8bc8c843, 0x6e373759, 0xda6d6db7,
+    0x018d8d8c, 0xb1d5d564, 0x9c4e4ed2, 0x49a9a9e0,
+    0xd86c6cb4, 0xac5656fa, 0xf3f4f407, 0xcfeaea25,
+    0xca6565af, 0xf47a7a8e, 0x47aeaee9, 0x10080818,
+    0x6fbabad5, 0xf0787888, 0x4a25256f, 0x5c2e2e72,
+    0x381c1c24, 0x57a6a6f1, 0x73b4b4c7, 0x97c6c651,
+    0xcbe8e823, 0xa1dddd7c, 0xe874749c, 0x3e1f1f21,
+    0x964b4bdd, 0x61bdbddc, 0x0d8b8b86, 0x0f8a8a85,
+    0xe0707090, 0x7c3e3e42, 0x71b5b5c4, 0xcc6666aa,
+    0x904848d8, 0x06030305, 0xf7f6f601, 0x1c0e0e12,
+    0xc26161a3, 0x6a35355f, 0xae5757f9, 0x69b9b9d0,
+    0x17868691, 0x99c1c158, 0x3a1d1d27, 0x279e9eb9,
+    0xd9e1e138, 0xebf8f813, 0x2b9898b3, 0x22111133,
+    0xd26969bb, 0xa9d9d970, 0x078e8e89, 0x339494a7,
+    0x2d9b9bb6, 0x3c1e1e22, 0x15878792, 0xc9e9e920,
+    0x87cece49, 0xaa5555ff, 0x50282878, 0xa5dfdf7a,
+    0x038c8c8f, 0x59a1a1f8, 0x09898980, 0x1a0d0d17,
+    0x65bfbfda, 0xd7e6e631, 0x844242c6, 0xd06868b8,
+    0x824141c3, 0x299999b0, 0x5a2d2d77, 0x1e0f0f11,
+    0x7bb0b0cb, 0xa85454fc, 0x6dbbbbd6, 0x2c16163a
+};
+#endif
+
 RadioLibAES128::RadioLibAES128() {
 
 }
@@ -43,54 +116,82 @@ size_t RadioLibAES128::decryptECB(uint8_t* in, size_t len, uint8_t* out) {
   return(num_blocks*RADIOLIB_AES128_BLOCK_SIZE);
 }
 
-void RadioLibAES128::generateCMAC(uint8_t* in, size_t len, uint8_t* cmac) {
+void RadioLibAES128::generateCMAC(const uint8_t* in, size_t len, uint8_t* cmac) {
+  this->initCMAC();
+  this->updateCMAC(in, len);
+  this->finishCMAC(cmac);
+}
+
+bool RadioLibAES128::verifyCMAC(const uint8_t* in, size_t len, const uint8_t* cmac) {
+  uint8_t cmacReal[RADIOLIB_AES128_BLOCK_SIZE];
+  this->generateCMAC(in, len, cmacReal);
+  return(rlb_memeq_ct(cmacReal, cmac, RADIOLIB_AES128_BLOCK_SIZE));
+}
+
+void RadioLibAES128::initCMAC() {
+  memset(this->cmacChain, 0x00, RADIOLIB_AES128_BLOCK_SIZE);
+  this->cmacBuffLen = 0;
+}
+
+void RadioLibAES128::updateCMAC(const uint8_t* in, size_t len) {
+  while(len > 0) {
+    // the buffered block is only processed once it is known not to be the last one
+    if(this->cmacBuffLen == RADIOLIB_AES128_BLOCK_SIZE) {
+      this->blockXor(this->cmacChain, this->cmacChain, this->cmacBuff);
+      this->cipher((state_t*)this->cmacChain, this->roundKey);
+      this->cmacBuffLen = 0;
+    }
+
+    size_t chunk = RADIOLIB_AES128_BLOCK_SIZE - this->cmacBuffLen;
+    if(chunk > len) {
+      chunk = len;
+    }
+    memcpy(&this->cmacBuff[this->cmacBuffLen], in, chunk);
+    this->cmacBuffLen += chunk;
+    in += chunk;
+    len -= chunk;
+  }
+}
+
+void RadioLibAES128::finishCMAC(uint8_t* cmac) {
   uint8_t key1[RADIOLIB_AES128_BLOCK_SIZE];
   uint8_t key2[RADIOLIB_AES128_BLOCK_SIZE];
   this->generateSubkeys(key1, key2);
 
-  size_t num_blocks = len / RADIOLIB_AES128_BLOCK_SIZE;
-  bool flag = true;
-  if(len % RADIOLIB_AES128_BLOCK_SIZE) {
-    num_blocks++;
-    flag = false;
-  }
-
-  uint8_t* buff = new uint8_t[num_blocks * RADIOLIB_AES128_BLOCK_SIZE];
-  memset(buff, 0, num_blocks * RADIOLIB_AES128_BLOCK_SIZE);
-  memcpy(buff, in, len);
-  if (flag) {
-    this->blockXor(&buff[(num_blocks - 1)*RADIOLIB_AES128_BLOCK_SIZE], &buff[(num_blocks - 1)*RADIOLIB_AES128_BLOCK_SIZE], key1);
+  // complete last block is masked by the first subkey, incomplete one is padded and masked by the second
+  if(this->cmacBuffLen == RADIOLIB_AES128_BLOCK_SIZE) {
+    this->blockXor(this->cmacBuff, this->cmacBuff, key1);
   } else {
-    buff[len] = 0x80;
-    this->blockXor(&buff[(num_blocks - 1)*RADIOLIB_AES128_BLOCK_SIZE], &buff[(num_blocks - 1)*RADIOLIB_AES128_BLOCK_SIZE], key2);
+    memset(&this->cmacBuff[this->cmacBuffLen], 0x00, RADIOLIB_AES128_BLOCK_SIZE - this->cmacBuffLen);
+    this->cmacBuff[this->cmacBuffLen] = 0x80;
+    this->blockXor(this->cmacBuff, this->cmacBuff, key2);
   }
 
-  uint8_t X[] = {
-    0x00, 0x00, 0x00, 0x00,
-    0x00, 0x00, 0x00, 0x00,
-    0x00, 0x00, 0x00, 0x00,
-    0x00, 0x00, 0x00, 0x00
-  };
-  uint8_t Y[RADIOLIB_AES128_BLOCK_SIZE];
+  this->blockXor(cmac, this->cmacChain, this->cmacBuff);
+  this->cipher((state_t*)cmac, this->roundKey);
+  this->cmacBuffLen = 0;
+}
 
-  for(size_t i = 0; i < num_blocks - 1; i++) {
-    this->blockXor(Y, &buff[i*RADIOLIB_AES128_BLOCK_SIZE], X);
-    this->encryptECB(Y, RADIOLIB_AES128_BLOCK_SIZE, X);
-  }
-  this->blockXor(Y, &buff[(num_blocks - 1)*RADIOLIB_AES128_BLOCK_SIZE], X);
-  this->encryptECB(Y, RADIOLIB_AES128_BLOCK_SIZE, cmac);
-  delete[] buff;
+void RadioLibAES128::initCTR(const uint8_t* ctr) {
+  memcpy(this->ctrBlock, ctr, RADIOLIB_AES128_BLOCK_SIZE);
+  this->ctrPos = RADIOLIB_AES128_BLOCK_SIZE;
 }
 
-bool RadioLibAES128::verifyCMAC(uint8_t* in, size_t len, const uint8_t* cmac) {
-  uint8_t cmacReal[RADIOLIB_AES128_BLOCK_SIZE];
-  this->generateCMAC(in, len, cmacReal);
-  for(size_t i = 0; i < RADIOLIB_AES128_BLOCK_SIZE; i++) {
-    if((cmacReal[i] != cmac[i])) {
-      return(false);
+void RadioLibAES128::updateCTR(const uint8_t* in, size_t len, uint8_t* out) {
+  for(size_t i = 0; i < len; i++) {
+    // generate the next keystream block when the current one is used up
+    if(this->ctrPos == RADIOLIB_AES128_BLOCK_SIZE) {
+      memcpy(this->ctrStream, this->ctrBlock, RADIOLIB_AES128_BLOCK_SIZE);
+      this->cipher((state_t*)this->ctrStream, this->roundKey);
+      for(int8_t j = RADIOLIB_AES128_BLOCK_SIZE - 1; j >= 0; j--) {
+        if(++this->ctrBlock[j] != 0) {
+          break;
+        }
+      }
+      this->ctrPos = 0;
     }
+    out[i] = in[i] ^ this->ctrStream[this->ctrPos++];
   }
-  return(true);
 }
 
 void RadioLibAES128::keyExpansion(uint8_t* roundKey, const uint8_t* key) {
@@ -125,6 +226,11 @@ void RadioLibAES128::keyExpansion(uint8_t* roundKey, const uint8_t* key) {
 }
 
 void RadioLibAES128::cipher(state_t* state, uint8_t* roundKey) {
+#if defined(RADIOLIB_AES128_HW_X86)
+  this->cipherHw(state, roundKey);
+#elif (RADIOLIB_AES128_BACKEND == RADIOLIB_AES128_BACKEND_TTABLE)
+  this->cipherTable(state, roundKey);
+#else
   this->addRoundKey(0, state, roundKey);
   for(uint8_t round = 1; round < RADIOLIB_AES128_N_R; round++) {
     this->subBytes(state, aesSbox);
@@ -136,7 +242,69 @@ void RadioLibAES128::cipher(state_t* state, uint8_t* roundKey) {
   this->subBytes(state, aesSbox);
   this->shiftRows(state, false);
   this->addRoundKey(RADIOLIB_AES128_N_R, state, roundKey);
+#endif
+}
+
+#if defined(RADIOLIB_AES128_HW_X86)
+void RadioLibAES128::cipherHw(state_t* state, const uint8_t* roundKey) {
+  __m128i s = _mm_loadu_si128((const __m128i*)state);
+  s = _mm_xor_si128(s, _mm_loadu_si128((const __m128i*)roundKey));
+  for(uint8_t round = 1; round < RADIOLIB_AES128_N_R; round++) {
+    s = _mm_aesenc_si128(s, _mm_loadu_si128((const __m128i*)&roundKey[round * RADIOLIB_AES128_BLOCK_SIZE]));
+  }
+  s = _mm_aesenclast_si128(s, _mm_loadu_si128((const __m128i*)&roundKey[RADIOLIB_AES128_N_R * RADIOLIB_AES128_BLOCK_SIZE]));
+  _mm_storeu_si128((__m128i*)state, s);
+}
+
+#elif (RADIOLIB_AES128_BACKEND == RADIOLIB_AES128_BACKEND_TTABLE)
+static inline uint32_t aesLoadWord(const uint8_t* buff) {
+  return(((uint32_t)buff[0] << 24) | ((uint32_t)buff[1] << 16) | ((uint32_t)buff[2] << 8) | (uint32_t)buff[3]);
+}
+
+static inline uint32_t aesTe(uint8_t idx, uint8_t rot) {
+  uint32_t t = RADIOLIB_NONVOLATILE_READ_DWORD(&aesTe0[idx]);
+  return(rot ? ((t >> rot) | (t << (32 - rot))) : t);
+}
+
+static inline uint32_t aesSubWord(uint32_t a, uint32_t b, uint32_t c, uint32_t d) {
+  return(((uint32_t)RADIOLIB_NONVOLATILE_READ_BYTE(&aesSbox[(a >> 24) & 0xFF]) << 24) |
+         ((uint32_t)RADIOLIB_NONVOLATILE_READ_BYTE(&aesSbox[(b >> 16) & 0xFF]) << 16) |
+         ((uint32_t)RADIOLIB_NONVOLATILE_READ_BYTE(&aesSbox[(c >> 8) & 0xFF]) << 8) |
+         (uint32_t)RADIOLIB_NONVOLATILE_READ_BYTE(&aesSbox[d & 0xFF]));
+}
+
+void RadioLibAES128::cipherTable(state_t* state, const uint8_t* roundKey) {
+  // each column of the state is kept as a single big-endian word
+  uint8_t* buff = (uint8_t*)state;
+  uint32_t s[4];
+  uint32_t t[4];
+  for(uint8_t i = 0; i < 4; i++) {
+    s[i] = aesLoadWord(&buff[4*i]) ^ aesLoadWord(&roundKey[4*i]);
+  }
+
+  for(uint8_t round = 1; round < RADIOLIB_AES128_N_R; round++) {
+    const uint8_t* rk = &roundKey[round * RADIOLIB_AES128_BLOCK_SIZE];
+    for(uint8_t i = 0; i < 4; i++) {
+      t[i] = aesTe(s[i] >> 24, 0) ^
+             aesTe((s[(i + 1) % 4] >> 16) & 0xFF, 8) ^
+             aesTe((s[(i + 2) % 4] >> 8) & 0xFF, 16) ^
+             aesTe(s[(i + 3) % 4] & 0xFF, 24) ^
+             aesLoadWord(&rk[4*i]);
+    }
+    memcpy(s, t, sizeof(s));
+  }
+
+  // the last round has no MixColumns
+  const uint8_t* rk = &roundKey[RADIOLIB_AES128_N_R * RADIOLIB_AES128_BLOCK_SIZE];
+  for(uint8_t i = 0; i < 4; i++) {
+    t[i] = aesSubWord(s[i], s[(i + 1) % 4], s[(i + 2) % 4], s[(i + 3) % 4]) ^ aesLoadWord(&rk[4*i]);
+    buff[4*i] = (t[i] >> 24) & 0xFF;
+    buff[4*i + 1] = (t[i] >> 16) & 0xFF;
+    buff[4*i + 2] = (t[i] >> 8) & 0xFF;
+    buff[4*i + 3] = t[i] & 0xFF;
+  }
 }
+#endif
 
 
 void RadioLibAES128::decipher(state_t* state, uint8_t* roundKey) {
@@ -12,6 +12,13 @@
 #define RADIOLIB_AES128_N_R                                     (10)
 #define RADIOLIB_AES128_KEY_EXP_SIZE                            (176)
 
+// CPU AES instructions are only used when the compiler targets a CPU that has them
+#if (RADIOLIB_AES128_BACKEND == RADIOLIB_AES128_BACKEND_HW)
+  #if defined(__AES__) && (defined(__x86_64__) || defined(__i386__))
+    #define RADIOLIB_AES128_HW_X86  (1)
+  #endif
+#endif
+
 // helper type
 typedef uint8_t state_t[4][4];
 
@@ -133,23 +140,76 @@ class RadioLibAES128 {
       \param len Length of the input data.
       \param cmac Buffer to save the output MAC into. The buffer must be at least 16 bytes long!
     */
-    void generateCMAC(uint8_t* in, size_t len, uint8_t* cmac);
+    void generateCMAC(const uint8_t* in, size_t len, uint8_t* cmac);
 
     /*!
-      \brief Verify the received CMAC. This just calculates the CMAC again and compares the results.
+      \brief Verify the received CMAC. This calculates the CMAC again and compares the results
+      in constant time.
       \param in Input data (unpadded).
       \param len Length of the input data.
       \param cmac CMAC to verify.
       \returns True if valid, false otherwise.
     */
-    bool verifyCMAC(uint8_t* in, size_t len, const uint8_t* cmac);
+    bool verifyCMAC(const uint8_t* in, size_t len, const uint8_t* cmac);
+
+    /*!
+      \brief Start calculating CMAC incrementally, using the key set by init.
+      The data is then passed in any number of parts by updateCMAC, and the result is obtained by finishCMAC.
+      The key must not be changed until the calculation is finished.
+    */
+    void initCMAC();
+
+    /*!
+      \brief Pass the next part of the data to incremental CMAC calculation.
+      \param in Next part of the input data.
+      \param len Length of the input data.
+    */
+    void updateCMAC(const uint8_t* in, size_t len);
+
+    /*!
+      \brief Finish incremental CMAC calculation.
+      \param cmac Buffer to save the output MAC into. The buffer must be at least 16 bytes long!
+    */
+    void finishCMAC(uint8_t* cmac);
+
+    /*!
+      \brief Start CTR-type AES encryption or decryption, using the key set by init.
+      The data is then processed in any number of parts by updateCTR.
+      \param ctr Initial counter block, incremented as a 128-bit big-endian number after each block.
+    */
+    void initCTR(const uint8_t* ctr);
+
+    /*!
+      \brief Encrypt or decrypt the next part of the data in CTR mode.
+      \param in Input data, does not have to be a multiple of the block size.
+      \param len Length of the input data.
+      \param out Buffer to save the output into, must be at least len bytes long. May be the same as the input.
+    */
+    void updateCTR(const uint8_t* in, size_t len, uint8_t* out);
   
+#if !RADIOLIB_GODMODE
   private:
+#endif
     uint8_t* keyPtr = nullptr;
     uint8_t roundKey[RADIOLIB_AES128_KEY_EXP_SIZE] = { 0 };
 
+    // incremental CMAC state - the chaining value and the last block, which is only processed once more data arrive
+    uint8_t cmacChain[RADIOLIB_AES128_BLOCK_SIZE] = { 0 };
+    uint8_t cmacBuff[RADIOLIB_AES128_BLOCK_SIZE] = { 0 };
+    uint8_t cmacBuffLen = 0;
+
+    // CTR state - the counter block, the current keystream block and position within it
+    uint8_t ctrBlock[RADIOLIB_AES128_BLOCK_SIZE] = { 0 };
+    uint8_t ctrStream[RADIOLIB_AES128_BLOCK_SIZE] = { 0 };
+    uint8_t ctrPos = RADIOLIB_AES128_BLOCK_SIZE;
+
     void keyExpansion(uint8_t* roundKey, const uint8_t* key);
     void cipher(state_t* state, uint8_t* roundKey);
+#if defined(RADIOLIB_AES128_HW_X86)
+    void cipherHw(state_t* state, const uint8_t* roundKey);
+#elif (RADIOLIB_AES128_BACKEND == RADIOLIB_AES128_BACKEND_TTABLE)
+    void cipherTable(state_t* state, const uint8_t* roundKey);
+#endif
     void decipher(state_t* state, uint8_t* roundKey);
 
     void subWord(uint8_t* word);
@@ -190,120 +190,127 @@ void RadioLibBCH::begin(uint8_t n, uint8_t k, uint32_t poly) {
   #if !RADIOLIB_STATIC_ONLY
   delete[] zeros;
   #endif
-}
 
-/*
-  BCH Encoder based on https://www.codeproject.com/articles/13189/pocsag-encoder
+  // pack the generator polynomial and generate the lookup table for encoding
+  this->genPoly = 0;
+  for(ii = 0; ii <= rdncy; ii++) {
+    if(this->generator[ii]) {
+      this->genPoly |= (uint32_t)1 << ii;
+    }
+  }
+
+  this->remTableValid = false;
+  if((this->n - this->k) >= 4) {
+    for(uint8_t i = 0; i < 16; i++) {
+      this->remTable[i] = this->divide(i, 4);
+    }
+    this->remTableValid = true;
+  }
+}
 
-  Significantly cleaned up and slightly fixed.
-*/
 uint32_t RadioLibBCH::encode(uint32_t dataword) {
   // we only use the "k" most significant bits
-  #if RADIOLIB_STATIC_ONLY
-    int32_t data[RADIOLIB_BCH_MAX_K] = { 0 };
-  #else
-    int32_t* data = new int32_t[this->k];
-    memset(data, 0, this->k*sizeof(int32_t));
-  #endif
-	int32_t j1 = 0;
-	for(int32_t i = this->n; i > (this->n - this->k); i--) {
-		if(dataword & ((uint32_t)1<<i)) {
-      data[j1++]=1;
-    } else {
-      data[j1++]=0;
-    }
-	}
+  uint8_t r = this->n - this->k;
+  uint32_t data = (dataword >> (r + 1)) & ((uint32_t)0xFFFFFFFF >> (32 - this->k));
 
-  // reset the M(x)+r array elements
-  #if RADIOLIB_STATIC_ONLY
-    int32_t Mr[RADIOLIB_BCH_MAX_N] = { 0 };
-  #else
-    int32_t* Mr = new int32_t[this->n];
-    memset(Mr, 0x00, this->n*sizeof(int32_t));
-  #endif
+  // check bits are the remainder of data*x^r divided by the generator polynomial
+  uint32_t rem = this->divide(data, this->k);
+  uint32_t res = (data << (r + 1)) | (rem << 1);
 
-  // copy the contents of data into Mr and add the zeros
-  memcpy(Mr, data, this->k*sizeof(int32_t));
-
-  int32_t j = 0;
-  int32_t start = 0;
-  int32_t end = this->n - this->k;
-  while(end < this->n) {
-    for(int32_t i = end; i > start-2; --i) {
-      if(Mr[start]) {
-        Mr[i] ^= this->generator[j];
-        ++j;
-      } else {
-        ++start;
-        j = 0;
-        end = start + this->n - this->k;
-        break;
-      }
+  // add even parity
+  if(rlb_popcount(res) & 0x01) {
+    res |= 0x01;
+  }
+
+  return(res);
+}
+
+uint32_t RadioLibBCH::divide(uint32_t data, uint8_t bits) {
+  uint8_t r = this->n - this->k;
+  uint32_t mask = ((uint32_t)1 << r) - 1;
+  uint32_t rem = 0;
+
+  // 4 bits at a time using the lookup table, as long as it exists
+  if(this->remTableValid) {
+    for(; bits >= 4; bits -= 4) {
+      uint8_t idx = ((rem >> (r - 4)) ^ (data >> (bits - 4))) & 0x0F;
+      rem = ((rem << 4) & mask) ^ this->remTable[idx];
     }
   }
 
-  #if RADIOLIB_STATIC_ONLY
-    int32_t bb[RADIOLIB_BCH_MAX_N - RADIOLIB_BCH_MAX_K + 1] = { 0 };
-  #else
-    int32_t* bb = new int32_t[this->n - this->k + 1];
-    memset(bb, 0, (this->n - this->k + 1)*sizeof(int32_t));
-  #endif
-  j = 0;
-  for(int32_t i = start; i < end; ++i) {
-    bb[j] = Mr[i];
-    ++j;
+  // the remaining bits one by one
+  for(; bits > 0; bits--) {
+    uint32_t feedback = ((rem >> (r - 1)) ^ (data >> (bits - 1))) & 0x01;
+    rem = (rem << 1) & mask;
+    if(feedback) {
+      rem ^= this->genPoly & mask;
+    }
   }
 
-  #if !RADIOLIB_STATIC_ONLY
-  delete[] Mr;
-  #endif
+  return(rem);
+}
 
-	int32_t iEvenParity = 0;
-  #if RADIOLIB_STATIC_ONLY
-    int32_t recd[RADIOLIB_BCH_MAX_N + 1];
-  #else
-    int32_t* recd = new int32_t[this->n + 1];
-  #endif
-	for(uint8_t i = 0; i < this->k; i++) {
-		recd[this->n - i] = data[i];
-		if(data[i] == 1) {
-      iEvenParity++;
+int8_t RadioLibBCH::decode(uint32_t* codeword) {
+  uint32_t cw = *codeword;
+
+  // the lowest bit is parity, coefficient of x^i is at bit i + 1
+  // calculate syndromes S1 = r(alpha) and S3 = r(alpha^3)
+  int32_t s1 = 0;
+  int32_t s3 = 0;
+  for(uint8_t i = 0; i < this->n; i++) {
+    if(cw & ((uint32_t)1 << (i + 1))) {
+      s1 ^= this->alphaTo[i];
+      s3 ^= this->alphaTo[(3*i) % this->n];
     }
-	}
-  
-  #if !RADIOLIB_STATIC_ONLY
-  delete[] data;
-  #endif
+  }
 
-	for(uint8_t i = 0; i < this->n - this->k + 1; i++) {
-		recd[this->n - this->k - i] = bb[i];
-		if(bb[i] == 1) {
-      iEvenParity++;
+  int8_t numErrors = 0;
+  if(s1 || s3) {
+    if(!s1) {
+      // at least 3 errors
+      return(-1);
     }
-	}
-  
-  #if !RADIOLIB_STATIC_ONLY
-  delete[] bb;
-  #endif
 
-	if((iEvenParity % 2) == 0) {
-    recd[0] = 0;
-  } else {
-    recd[0] = 1;
+    // a single error at position i results in S1 = alpha^i and S3 = S1^3
+    int32_t s1Log = this->indexOf[s1];
+    int32_t s1Cubed = this->alphaTo[(3*s1Log) % this->n];
+    if(s3 == s1Cubed) {
+      cw ^= (uint32_t)1 << (s1Log + 1);
+      numErrors = 1;
+
+    } else {
+      // two errors, error locator polynomial is 1 + S1*x + ((S3 + S1^3)/S1)*x^2
+      // Chien search - error at position i if alpha^-i is its root
+      int32_t s2Log = (this->indexOf[s3 ^ s1Cubed] - s1Log + this->n) % this->n;
+      for(uint8_t i = 0; i < this->n; i++) {
+        int32_t val = 1 ^ this->alphaTo[(s1Log + this->n - i) % this->n] ^ this->alphaTo[(s2Log + 2*(this->n - i)) % this->n];
+        if(val == 0) {
+          cw ^= (uint32_t)1 << (i + 1);
+          numErrors++;
+        }
+      }
+
+      // the locator must have exactly 2 distinct roots, otherwise there are more errors
+      if(numErrors != 2) {
+        return(-1);
+      }
+    }
   }
 
-  int32_t res = 0;
-	for(int32_t i = 0; i < this->n + 1; i++) {
-		if(recd[i]) {
-      res |= ((uint32_t)1<<i);
+  // check parity, which covers the whole code word including the parity bit itself
+  if(rlb_popcount(cw) & 0x01) {
+    if(numErrors == 2) {
+      // 3 or more errors
+      return(-1);
     }
-	}
 
-  #if !RADIOLIB_STATIC_ONLY
-  delete[] recd;
-  #endif
+    // the parity bit itself is wrong
+    cw ^= 0x01;
+    numErrors++;
+  }
 
-	return(res);
+  *codeword = cw;
+  return(numErrors);
 }
 
 RadioLibBCH RadioLibBCHInstance;
@@ -329,11 +336,7 @@ int16_t RadioLibConvCode::encode(const uint8_t* in, size_t in_bits, uint8_t* out
   // iterate over the provided bits
   for(ind_bit = 0; ind_bit < in_bits; ind_bit++) {
     uint8_t cur_bit = GET_BIT_IN_ARRAY_LSB(in, ind_bit);
-    const uint32_t* lut_ptr = (this->rate == 2) ? ConvCodeTable1_2 : ConvCodeTable1_3;
-    uint8_t word_pos = this->enc_state / 4;
-    uint8_t byte_pos = (3 - (this->enc_state % 4)) * 8;
-    uint8_t nibble_pos = (1 - cur_bit) * 4;
-    uint8_t g1g0 = (lut_ptr[word_pos] >> (byte_pos + nibble_pos)) & 0x0F;
+    uint8_t g1g0 = this->getSymbol(this->enc_state, cur_bit);
 
     uint8_t mod = this->rate == 2 ? 16 : 64;
     this->enc_state = (this->enc_state * 2 + cur_bit) % mod;
@@ -362,4 +365,414 @@ int16_t RadioLibConvCode::encode(const uint8_t* in, size_t in_bits, uint8_t* out
   return(RADIOLIB_ERR_NONE);
 }
 
+int16_t RadioLibConvCode::decode(const uint8_t* in, size_t in_bits, uint8_t* out, size_t* out_bits) {
+  return(this->decodeCommon(in, NULL, in_bits, out, out_bits));
+}
+
+int16_t RadioLibConvCode::decodeSoft(const int8_t* in, size_t in_len, uint8_t* out, size_t* out_bits) {
+  return(this->decodeCommon(NULL, in, in_len, out, out_bits));
+}
+
+uint8_t RadioLibConvCode::getSymbol(uint8_t state, uint8_t bit) {
+  const uint32_t* lut_ptr = (this->rate == 2) ? ConvCodeTable1_2 : ConvCodeTable1_3;
+  uint8_t word_pos = state / 4;
+  uint8_t byte_pos = (3 - (state % 4)) * 8;
+  uint8_t nibble_pos = (1 - bit) * 4;
+  return((lut_ptr[word_pos] >> (byte_pos + nibble_pos)) & 0x0F);
+}
+
+int16_t RadioLibConvCode::decodeCommon(const uint8_t* hard, const int8_t* soft, size_t in_bits, uint8_t* out, size_t* out_bits) {
+  if((!hard && !soft) || !out || ((this->rate != 2) && (this->rate != 3))) {
+    return(RADIOLIB_ERR_UNKNOWN);
+  }
+
+  // the encoder shift register holds the last 4 (rate 1/2) or 6 (rate 1/3) input bits
+  const uint8_t numStates = (this->rate == 2) ? 16 : 64;
+  const uint8_t half = numStates / 2;
+  size_t numSteps = in_bits / this->rate;
+  memset(out, 0x00, (numSteps + 7) / 8);
+
+  // path metrics, only the initial state is valid at the start
+  // metrics are normalized in every step, so they can never get anywhere close to overflowing
+  uint16_t metric[64];
+  uint16_t metricNext[64];
+  for(uint8_t i = 0; i < numStates; i++) {
+    metric[i] = (i == 0) ? 0 : 0x4000;
+  }
+
+  // survivor paths, one bit per state, set if the path came from the upper of the two predecessors
+  uint64_t surv[RADIOLIB_CONV_CODE_TRACEBACK_LEN];
+  uint8_t best = 0;
+
+  for(size_t step = 0; step < numSteps; step++) {
+    // branch metrics for all possible symbols, the first encoded bit is the most significant one
+    uint16_t branch[8];
+    for(uint8_t sym = 0; sym < (1 << this->rate); sym++) {
+      branch[sym] = 0;
+      for(uint8_t j = 0; j < this->rate; j++) {
+        size_t pos = step*this->rate + j;
+        int16_t val = soft ? RADIOLIB_MAX(soft[pos], -127) : (GET_BIT_IN_ARRAY_LSB(hard, pos) ? 127 : -127);
+        branch[sym] += ((sym >> (this->rate - 1 - j)) & 0x01) ? (127 - val) : (127 + val);
+      }
+    }
+
+    // add-compare-select, each state can be reached from states (s >> 1) and (s >> 1) + half with input bit (s & 1)
+    uint64_t decisions = 0;
+    uint16_t metricMin = 0xFFFF;
+    for(uint8_t s = 0; s < numStates; s++) {
+      uint8_t bit = s & 0x01;
+      uint8_t pred = s >> 1;
+      uint16_t m0 = metric[pred] + branch[this->getSymbol(pred, bit)];
+      uint16_t m1 = metric[pred + half] + branch[this->getSymbol(pred + half, bit)];
+      if(m1 < m0) {
+        m0 = m1;
+        decisions |= (uint64_t)1 << s;
+      }
+      metricNext[s] = m0;
+      if(m0 < metricMin) {
+        metricMin = m0;
+        best = s;
+      }
+    }
+
+    for(uint8_t s = 0; s < numStates; s++) {
+      metric[s] = metricNext[s] - metricMin;
+    }
+    surv[step % RADIOLIB_CONV_CODE_TRACEBACK_LEN] = decisions;
+
+    // once the traceback buffer is full, decide the oldest bit by tracing back from the best state
+    if(step >= RADIOLIB_CONV_CODE_TRACEBACK_LEN - 1) {
+      uint8_t state = best;
+      size_t oldest = step + 1 - RADIOLIB_CONV_CODE_TRACEBACK_LEN;
+      for(size_t i = step; i > oldest; i--) {
+        state = (state >> 1) + (((surv[i % RADIOLIB_CONV_CODE_TRACEBACK_LEN] >> state) & 0x01) ? half : 0);
+      }
+      if(state & 0x01) {
+        SET_BIT_IN_ARRAY_LSB(out, oldest);
+      }
+    }
+  }
+
+  // decide the remaining bits
+  if(numSteps > 0) {
+    size_t first = (numSteps >= RADIOLIB_CONV_CODE_TRACEBACK_LEN) ? (numSteps + 1 - RADIOLIB_CONV_CODE_TRACEBACK_LEN) : 0;
+    uint8_t state = best;
+    for(size_t i = numSteps; i > first; i--) {
+      if(state & 0x01) {
+        SET_BIT_IN_ARRAY_LSB(out, i - 1);
+      }
+      state = (state >> 1) + (((surv[(i - 1) % RADIOLIB_CONV_CODE_TRACEBACK_LEN] >> state) & 0x01) ? half : 0);
+    }
+  }
+
+  if(out_bits) { *out_bits = numSteps; }
+
+  return(RADIOLIB_ERR_NONE);
+}
+
 RadioLibConvCode RadioLibConvCodeInstance;
+
+RadioLibGolay::RadioLibGolay() {
+
+}
+
+void RadioLibGolay::begin(bool ext) {
+  this->extended = ext;
+}
+
+uint32_t RadioLibGolay::encode(uint16_t dataword) {
+  // check bits are the remainder of data*x^11 divided by the generator polynomial, 4 bits at a time
+  uint32_t data = dataword & 0x0FFF;
+  uint16_t rem = 0;
+  for(int8_t shift = RADIOLIB_GOLAY_K - 4; shift >= 0; shift -= 4) {
+    uint8_t idx = ((rem >> 7) ^ (data >> shift)) & 0x0F;
+    rem = ((rem << 4) & 0x07FF) ^ GolayTable[idx];
+  }
+
+  uint32_t res = (data << (RADIOLIB_GOLAY_N - RADIOLIB_GOLAY_K)) | rem;
+  if(this->extended && (rlb_popcount(res) & 0x01)) {
+    res |= (uint32_t)1 << RADIOLIB_GOLAY_N;
+  }
+  return(res);
+}
+
+int8_t RadioLibGolay::decode(uint32_t* codeword) {
+  uint32_t cw = *codeword & 0x7FFFFF;
+  uint16_t syn = this->syndrome(cw);
+  int8_t numErrors = 0;
+  if(syn) {
+    numErrors = this->trap(&cw, syn, 3);
+
+    // errors which do not fit into 11 consecutive bits - try to remove one of them first
+    for(uint8_t i = 0; (i < RADIOLIB_GOLAY_N) && (numErrors < 0); i++) {
+      uint32_t trial = cw ^ ((uint32_t)1 << i);
+      numErrors = this->trap(&trial, syn ^ this->syndrome((uint32_t)1 << i), 2);
+      if(numErrors >= 0) {
+        cw = trial;
+        numErrors++;
+      }
+    }
+
+    // the code is perfect so this should never happen
+    if(numErrors < 0) {
+      return(-1);
+    }
+  }
+
+  if(this->extended) {
+    // the parity bit corrects itself, or detects a fourth error
+    cw |= *codeword & ((uint32_t)1 << RADIOLIB_GOLAY_N);
+    if(rlb_popcount(cw) & 0x01) {
+      if(numErrors == 3) {
+        return(-1);
+      }
+      cw ^= (uint32_t)1 << RADIOLIB_GOLAY_N;
+      numErrors++;
+    }
+  }
+
+  *codeword = cw;
+  return(numErrors);
+}
+
+uint16_t RadioLibGolay::syndrome(uint32_t codeword) {
+  // remainder is linear, so the syndrome is the received check bits XOR the check bits of the received data
+  uint32_t data = (codeword >> (RADIOLIB_GOLAY_N - RADIOLIB_GOLAY_K)) & 0x0FFF;
+  return((codeword ^ this->encode(data)) & 0x07FF);
+}
+
+int8_t RadioLibGolay::trap(uint32_t* codeword, uint16_t syn, uint8_t maxWeight) {
+  // syndrome of the code word rotated left by i bits is syndrome multiplied by x^i
+  for(uint8_t i = 0; i < RADIOLIB_GOLAY_N; i++) {
+    uint8_t weight = rlb_popcount(syn);
+    if(weight <= maxWeight) {
+      // all errors are in the check bits of the rotated code word, rotate them back
+      uint32_t err = syn;
+      if(i > 0) {
+        err = ((err << (RADIOLIB_GOLAY_N - i)) | (err >> i)) & 0x7FFFFF;
+      }
+      *codeword ^= err;
+      return(weight);
+    }
+
+    syn <<= 1;
+    if(syn & 0x0800) {
+      syn ^= RADIOLIB_GOLAY_POLY;
+    }
+  }
+  return(-1);
+}
+
+RadioLibGolay RadioLibGolayInstance;
+
+RadioLibReedSolomon::RadioLibReedSolomon() {
+
+}
+
+int16_t RadioLibReedSolomon::begin(uint8_t nsym, uint8_t fcr) {
+  if((nsym == 0) || (nsym > RADIOLIB_RS_MAX_PARITY)) {
+    return(RADIOLIB_ERR_INVALID_ENCODING);
+  }
+  this->nsym = nsym;
+  this->fcr = fcr;
+
+  // generator polynomial is the product of (x - alpha^(fcr + i)) for all parity bytes
+  memset(this->generator, 0x00, sizeof(this->generator));
+  this->generator[0] = 1;
+  for(uint8_t i = 0; i < nsym; i++) {
+    uint8_t root = this->gfExp(fcr + i);
+    for(uint8_t j = i + 1; j > 0; j--) {
+      this->generator[j] ^= this->gfMul(this->generator[j - 1], root);
+    }
+  }
+  return(RADIOLIB_ERR_NONE);
+}
+
+int16_t RadioLibReedSolomon::encode(const uint8_t* data, size_t len, uint8_t* parity) {
+  if(!data || !parity || (this->nsym == 0)) {
+    return(RADIOLIB_ERR_UNKNOWN);
+  }
+  if(len + this->nsym > RADIOLIB_RS_MAX_N) {
+    return(RADIOLIB_ERR_PACKET_TOO_LONG);
+  }
+
+  // parity is the remainder of data*x^nsym divided by the generator polynomial
+  memset(parity, 0x00, this->nsym);
+  for(size_t i = 0; i < len; i++) {
+    uint8_t feedback = data[i] ^ parity[0];
+    memmove(&parity[0], &parity[1], this->nsym - 1);
+    parity[this->nsym - 1] = 0;
+    if(feedback) {
+      for(uint8_t j = 0; j < this->nsym; j++) {
+        parity[j] ^= this->gfMul(this->generator[j + 1], feedback);
+      }
+    }
+  }
+  return(RADIOLIB_ERR_NONE);
+}
+
+int16_t RadioLibReedSolomon::decode(uint8_t* block, size_t len, uint8_t* numErrors) {
+  if(!block || (this->nsym == 0) || (len <= this->nsym)) {
+    return(RADIOLIB_ERR_UNKNOWN);
+  }
+  if(len > RADIOLIB_RS_MAX_N) {
+    return(RADIOLIB_ERR_PACKET_TOO_LONG);
+  }
+  if(numErrors) {
+    *numErrors = 0;
+  }
+
+  // syndromes are the received polynomial evaluated at the roots of the generator
+  // the first byte of the block is the coefficient of the highest power
+  uint8_t synd[RADIOLIB_RS_MAX_PARITY] = { 0 };
+  bool valid = true;
+  for(uint8_t i = 0; i < this->nsym; i++) {
+    uint8_t root = this->gfExp(this->fcr + i);
+    uint8_t val = 0;
+    for(size_t j = 0; j < len; j++) {
+      val = this->gfMul(val, root) ^ block[j];
+    }
+    synd[i] = val;
+    if(val) {
+      valid = false;
+    }
+  }
+  if(valid) {
+    return(RADIOLIB_ERR_NONE);
+  }
+
+  // Berlekamp-Massey algorithm to find the error locator polynomial, lowest power first
+  uint8_t loc[RADIOLIB_RS_MAX_PARITY + 1] = { 1 };
+  uint8_t prev[RADIOLIB_RS_MAX_PARITY + 1] = { 1 };
+  uint8_t tmp[RADIOLIB_RS_MAX_PARITY + 1];
+  uint8_t numLoc = 0;
+  uint8_t shift = 1;
+  uint8_t prevDiscr = 1;
+  for(uint8_t n = 0; n < this->nsym; n++) {
+    uint8_t discr = synd[n];
+    for(uint8_t i = 1; i <= numLoc; i++) {
+      discr ^= this->gfMul(loc[i], synd[n - i]);
+    }
+
+    if(discr == 0) {
+      shift++;
+      continue;
+    }
+
+    uint8_t coeff = this->gfDiv(discr, prevDiscr);
+    if(2*numLoc <= n) {
+      memcpy(tmp, loc, sizeof(loc));
+      for(uint8_t i = 0; i + shift <= this->nsym; i++) {
+        loc[i + shift] ^= this->gfMul(coeff, prev[i]);
+      }
+      numLoc = n + 1 - numLoc;
+      memcpy(prev, tmp, sizeof(prev));
+      prevDiscr = discr;
+      shift = 1;
+    } else {
+      for(uint8_t i = 0; i + shift <= this->nsym; i++) {
+        loc[i + shift] ^= this->gfMul(coeff, prev[i]);
+      }
+      shift++;
+    }
+  }
+
+  if(2*numLoc > this->nsym) {
+    return(RADIOLIB_ERR_CRC_MISMATCH);
+  }
+
+  // error evaluator polynomial, syndromes multiplied by the locator modulo x^nsym
+  uint8_t eval[RADIOLIB_RS_MAX_PARITY] = { 0 };
+  for(uint8_t i = 0; i < this->nsym; i++) {
+    for(uint8_t j = 0; (j <= numLoc) && (j <= i); j++) {
+      eval[i] ^= this->gfMul(loc[j], synd[i - j]);
+    }
+  }
+
+  // Chien search - byte at index j is wrong if the locator has a root at alpha^-(len - 1 - j)
+  // Forney algorithm then gives the error value
+  uint8_t numFound = 0;
+  uint8_t pos[RADIOLIB_RS_MAX_PARITY / 2];
+  uint8_t val[RADIOLIB_RS_MAX_PARITY / 2];
+  for(size_t j = 0; j < len; j++) {
+    int32_t power = len - 1 - j;
+    uint8_t xInv = this->gfExp(-power);
+    uint8_t sum = 0;
+    uint8_t deriv = 0;
+    uint8_t xPow = 1;
+    for(uint8_t i = 0; i <= numLoc; i++) {
+      sum ^= this->gfMul(loc[i], xPow);
+
+      // formal derivative only keeps the odd powers
+      if(i & 0x01) {
+        deriv ^= this->gfMul(loc[i], this->gfDiv(xPow, xInv));
+      }
+      xPow = this->gfMul(xPow, xInv);
+    }
+    if(sum != 0) {
+      continue;
+    }
+
+    if((numFound >= numLoc) || (deriv == 0)) {
+      return(RADIOLIB_ERR_CRC_MISMATCH);
+    }
+
+    uint8_t evalSum = 0;
+    xPow = 1;
+    for(uint8_t i = 0; i < this->nsym; i++) {
+      evalSum ^= this->gfMul(eval[i], xPow);
+      xPow = this->gfMul(xPow, xInv);
+    }
+    pos[numFound] = j;
+    val[numFound] = this->gfMul(this->gfExp(power*(1 - this->fcr)), this->gfDiv(evalSum, deriv));
+    numFound++;
+  }
+
+  // the number of roots must match the degree of the locator, otherwise there were too many errors
+  if(numFound != numLoc) {
+    return(RADIOLIB_ERR_CRC_MISMATCH);
+  }
+
+  for(uint8_t i = 0; i < numFound; i++) {
+    block[pos[i]] ^= val[i];
+  }
+  if(numErrors) {
+    *numErrors = numFound;
+  }
+  return(RADIOLIB_ERR_NONE);
+}
+
+uint8_t RadioLibReedSolomon::gfExp(int32_t power) {
+  power %= 255;
+  if(power < 0) {
+    power += 255;
+  }
+  return(RADIOLIB_NONVOLATILE_READ_BYTE(&RSExpTable[power]));
+}
+
+uint8_t RadioLibReedSolomon::gfMul(uint8_t a, uint8_t b) {
+  if((a == 0) || (b == 0)) {
+    return(0);
+  }
+  return(this->gfExp((int32_t)RADIOLIB_NONVOLATILE_READ_BYTE(&RSLogTable[a]) + RADIOLIB_NONVOLATILE_READ_BYTE(&RSLogTable[b])));
+}
+
+uint8_t RadioLibReedSolomon::gfDiv(uint8_t a, uint8_t b) {
+  if((a == 0) || (b == 0)) {
+    return(0);
+  }
+  return(this->gfExp((int32_t)RADIOLIB_NONVOLATILE_READ_BYTE(&RSLogTable[a]) - RADIOLIB_NONVOLATILE_READ_BYTE(&RSLogTable[b])));
+}
+
+RadioLibReedSolomon RadioLibReedSolomonInstance;
+
+void rlb_interleave(const uint8_t* in, uint8_t* out, size_t len, uint32_t mult, bool deinterleave) {
+  size_t numBits = len*8;
+  memset(out, 0x00, len);
+  for(size_t i = 0; i < numBits; i++) {
+    size_t j = ((uint64_t)i * mult) % numBits;
+    size_t src = deinterleave ? j : i;
+    size_t dst = deinterleave ? i : j;
+    out[dst / 8] |= ((in[src / 8] >> (src % 8)) & 0x01) << (dst % 8);
+  }
+}
@@ -9,6 +9,10 @@
 #define RADIOLIB_PAGER_BCH_K                                    (21)
 #define RADIOLIB_PAGER_BCH_PRIMITIVE_POLY                       (0x25)
 
+// number of trellis steps kept by the Viterbi decoder before a decision is made
+// should be at least 5 times the constraint length of the code
+#define RADIOLIB_CONV_CODE_TRACEBACK_LEN                        (48)
+
 #if RADIOLIB_STATIC_ONLY
 #define RADIOLIB_BCH_MAX_N                                      (63)
 #define RADIOLIB_BCH_MAX_K                                      (31)
@@ -48,11 +52,28 @@ class RadioLibBCH {
     */
     uint32_t encode(uint32_t dataword);
 
+    /*!
+      \brief Decoding method - corrects errors in a code word produced by encode. Up to 2 bit errors
+      are corrected using syndromes calculated from the Galois field tables, followed by the parity check.
+      Only codes which can correct 2 errors (such as BCH(31, 21)) are supported.
+      \param codeword Pointer to the code word (with check bits and parity bit), will be corrected in place.
+      It is left unchanged if the errors could not be corrected.
+      \returns Number of corrected bit errors, or -1 if the code word contains more errors than can be corrected.
+    */
+    int8_t decode(uint32_t* codeword);
+
+#if !RADIOLIB_GODMODE
   private:
+#endif
     uint8_t n = 0;
     uint8_t k = 0;
     uint32_t poly = 0;
     uint8_t m = 0;
+
+    // generator polynomial with one bit per coefficient, and remainders of each nibble multiplied by x^(n - k)
+    uint32_t genPoly = 0;
+    uint32_t remTable[16] = { 0 };
+    bool remTableValid = false;
     
     #if RADIOLIB_STATIC_ONLY
       int32_t alphaTo[RADIOLIB_BCH_MAX_N + 1] = { 0 };
@@ -63,6 +84,9 @@ class RadioLibBCH {
       int32_t* indexOf = nullptr;
       int32_t* generator = nullptr;
     #endif
+
+    // polynomial division of data*x^(n - k) by the generator, returns the remainder
+    uint32_t divide(uint32_t data, uint8_t bits);
 };
 
 // the global singleton
@@ -132,9 +156,43 @@ class RadioLibConvCode {
     */
     int16_t encode(const uint8_t* in, size_t in_bits, uint8_t* out, size_t* out_bits = NULL);
 
+    /*!
+      \brief Hard-decision Viterbi decoding method. Assumes the encoder started from the initial state,
+      i.e. the data were encoded by a single call to encode after begin.
+      \param in Input buffer with the encoded bits, in the same format as produced by encode.
+      \param in_bits Input length in bits, should be a multiple of the encoding rate.
+      \param out Output buffer (a byte array). It is up to the caller
+      to ensure the buffer is large enough to fit the decoded data!
+      \param out_bits Pointer to a variable to save the number of decoded bits.
+      Ignored if set to NULL.
+      \returns \ref status_codes 
+    */
+    int16_t decode(const uint8_t* in, size_t in_bits, uint8_t* out, size_t* out_bits = NULL);
+
+    /*!
+      \brief Soft-decision Viterbi decoding method. Assumes the encoder started from the initial state,
+      i.e. the data were encoded by a single call to encode after begin.
+      \param in Input buffer with one value per encoded bit, ranging from -127 (certainly 0) to 127 (certainly 1).
+      \param in_len Number of values in the input buffer, should be a multiple of the encoding rate.
+      \param out Output buffer (a byte array). It is up to the caller
+      to ensure the buffer is large enough to fit the decoded data!
+      \param out_bits Pointer to a variable to save the number of decoded bits.
+      Ignored if set to NULL.
+      \returns \ref status_codes 
+    */
+    int16_t decodeSoft(const int8_t* in, size_t in_len, uint8_t* out, size_t* out_bits = NULL);
+
+#if !RADIOLIB_GODMODE
   private:
+#endif
     uint8_t enc_state = 0;
     uint8_t rate = 0;
+
+    // get the encoded symbol for the given encoder state and input bit
+    uint8_t getSymbol(uint8_t state, uint8_t bit);
+
+    // Viterbi decoder, uses the soft values when provided, otherwise the hard bits
+    int16_t decodeCommon(const uint8_t* hard, const int8_t* soft, size_t in_bits, uint8_t* out, size_t* out_bits);
 };
 
 // each 32-bit word stores 8 values, one per each nibble
@@ -151,4 +209,178 @@ static const uint32_t ConvCodeTable1_2[4] = {
 
 extern RadioLibConvCode RadioLibConvCodeInstance;
 
+// Golay(23, 12) code constants
+#define RADIOLIB_GOLAY_N                                        (23)
+#define RADIOLIB_GOLAY_K                                        (12)
+#define RADIOLIB_GOLAY_POLY                                     (0xC75)
+
+// remainders of each nibble multiplied by x^11 divided by the Golay generator polynomial
+static const uint16_t GolayTable[16] = {
+  0x000, 0x475, 0x49F, 0x0EA, 0x54B, 0x13E, 0x1D4, 0x5A1,
+  0x6E3, 0x296, 0x27C, 0x609, 0x3A8, 0x7DD, 0x737, 0x342,
+};
+
+/*!
+  \class RadioLibGolay
+  \brief Class to perform Golay(23, 12) and extended Golay(24, 12) forward error correction.
+  Code words are systematic, with the 12 data bits above the 11 check bits,
+  and in the extended code, the overall parity bit on top of that.
+*/
+class RadioLibGolay {
+  public:
+    /*!
+      \brief Default constructor.
+    */
+    RadioLibGolay();
+
+    /*!
+      \brief Initialization method.
+      \param ext Whether to use the extended Golay(24, 12) code, which adds an overall parity bit.
+    */
+    void begin(bool ext = false);
+
+    /*!
+      \brief Encoding method - encodes one data word into a code word.
+      \param dataword Data word, only the lowest 12 bits are used.
+      \returns Code word with error check bits.
+    */
+    uint32_t encode(uint16_t dataword);
+
+    /*!
+      \brief Decoding method - corrects up to 3 bit errors in a code word. In the extended code,
+      4 bit errors are detected as well.
+      \param codeword Pointer to the code word, will be corrected in place.
+      It is left unchanged if the errors could not be corrected.
+      \returns Number of corrected bit errors, or -1 if the code word contains more errors than can be corrected.
+    */
+    int8_t decode(uint32_t* codeword);
+
+#if !RADIOLIB_GODMODE
+  private:
+#endif
+    bool extended = false;
+
+    // calculate the 11-bit syndrome of a 23-bit code word
+    uint16_t syndrome(uint32_t codeword);
+
+    // error trapping - search cyclic shifts of the code word for a syndrome of at most maxWeight
+    // returns the number of corrected errors, or -1 if the errors could not be trapped
+    int8_t trap(uint32_t* codeword, uint16_t syn, uint8_t maxWeight);
+};
+
+// the global singleton
+extern RadioLibGolay RadioLibGolayInstance;
+
+// Reed-Solomon code constants
+#define RADIOLIB_RS_MAX_N                                       (255)
+#define RADIOLIB_RS_MAX_PARITY                                  (64)
+
+// GF(2^8) antilogarithm and logarithm tables for the primitive polynomial x^8 + x^4 + x^3 + x^2 + 1 (0x11D)
+static const uint8_t RSExpTable[] RADIOLIB_NONVOLATILE = {
+  0x01, 0x02, 0x04, 0x08, 0x10, 0x20, 0x40, 0x80, 0x1d, 0x3a, 0x74, 0xe8, 0xcd, 0x87, 0x13, 0x26,
+  0x4c, 0x98, 0x2d, 0x5a, 0xb4, 0x75, 0xea, 0xc9, 0x8f, 0x03, 0x06, 0x0c, 0x18, 0x30, 0x60, 0xc0,
+  0x9d, 0x27, 0x4e, 0x9c, 0x25, 0x4a, 0x94, 0x35, 0x6a, 0xd4, 0xb5, 0x77, 0xee, 0xc1, 0x9f, 0x23,
+  0x46, 0x8c, 0x05, 0x0a, 0x14, 0x28, 0x50, 0xa0, 0x5d, 0xba, 0x69, 0xd2, 0xb9, 0x6f, 0xde, 0xa1,
+  0x5f, 0xbe, 0x61, 0xc2, 0x99, 0x2f, 0x5e, 0xbc, 0x65, 0xca, 0x89, 0x0f, 0x1e, 0x3c, 0x78, 0xf0,
+  0xfd, 0xe7, 0xd3, 0xbb, 0x6b, 0xd6, 0xb1, 0x7f, 0xfe, 0xe1, 0xdf, 0xa3, 0x5b, 0xb6, 0x71, 0xe2,
+  0xd9, 0xaf, 0x43, 0x86, 0x11, 0x22, 0x44, 0x88, 0x0d, 0x1a, 0x34, 0x68, 0xd0, 0xbd, 0x67, 0xce,
+  0x81, 0x1f, 0x3e, 0x7c, 0xf8, 0xed, 0xc7, 0x93, 0x3b, 0x76, 0xec, 0xc5, 0x97, 0x33, 0x66, 0xcc,
+  0x85, 0x17, 0x2e, 0x5c, 0xb8, 0x6d, 0xda, 0xa9, 0x4f, 0x9e, 0x21, 0x42, 0x84, 0x15, 0x2a, 0x54,
+  0xa8, 0x4d, 0x9a, 0x29, 0x52, 0xa4, 0x55, 0xaa, 0x49, 0x92, 0x39, 0x72, 0xe4, 0xd5, 0xb7, 0x73,
+  0xe6, 0xd1, 0xbf, 0x63, 0xc6, 0x91, 0x3f, 0x7e, 0xfc, 0xe5, 0xd7, 0xb3, 0x7b, 0xf6, 0xf1, 0xff,
+  0xe3, 0xdb, 0xab, 0x4b, 0x96, 0x31, 0x62, 0xc4, 0x95, 0x37, 0x6e, 0xdc, 0xa5, 0x57, 0xae, 0x41,
+  0x82, 0x19, 0x32, 0x64, 0xc8, 0x8d, 0x07, 0x0e, 0x1c, 0x38, 0x70, 0xe0, 0xdd, 0xa7, 0x53, 0xa6,
+  0x51, 0xa2, 0x59, 0xb2, 0x79, 0xf2, 0xf9, 0xef, 0xc3, 0x9b, 0x2b, 0x56, 0xac, 0x45, 0x8a, 0x09,
+  0x12, 0x24, 0x48, 0x90, 0x3d, 0x7a, 0xf4, 0xf5, 0xf7, 0xf3, 0xfb, 0xeb, 0xcb, 0x8b, 0x0b, 0x16,
+  0x2c, 0x58, 0xb0, 0x7d, 0xfa, 0xe9, 0xcf, 0x83, 0x1b, 0x36, 0x6c, 0xd8, 0xad, 0x47, 0x8e, 0x01
+};
+
+static const uint8_t RSLogTable[] RADIOLIB_NONVOLATILE = {
+  0x00, 0x00, 0x01, 0x19, 0x02, 0x32, 0x1a, 0xc6, 0x03, 0xdf, 0x33, 0xee, 0x1b, 0x68, 0xc7, 0x4b,
+  0x04, 0x64, 0xe0, 0x0e, 0x34, 0x8d, 0xef, 0x81, 0x1c, 0xc1, 0x69, 0xf8, 0xc8, 0x08, 0x4c, 0x71,
+  0x05, 0x8a, 0x65, 0x2f, 0xe1, 0x24, 0x0f, 0x21, 0x35, 0x93, 0x8e, 0xda, 0xf0, 0x12, 0x82, 0x45,
+  0x1d, 0xb5, 0xc2, 0x7d, 0x6a, 0x27, 0xf9, 0xb9, 0xc9, 0x9a, 0x09, 0x78, 0x4d, 0xe4, 0x72, 0xa6,
+  0x06, 0xbf, 0x8b, 0x62, 0x66, 0xdd, 0x30, 0xfd, 0xe2, 0x98, 0x25, 0xb3, 0x10, 0x91, 0x22, 0x88,
+  0x36, 0xd0, 0x94, 0xce, 0x8f, 0x96, 0xdb, 0xbd, 0xf1, 0xd2, 0x13, 0x5c, 0x83, 0x38, 0x46, 0x40,
+  0x1e, 0x42, 0xb6, 0xa3, 0xc3, 0x48, 0x7e, 0x6e, 0x6b, 0x3a, 0x28, 0x54, 0xfa, 0x85, 0xba, 0x3d,
+  0xca, 0x5e, 0x9b, 0x9f, 0x0a, 0x15, 0x79, 0x2b, 0x4e, 0xd4, 0xe5, 0xac, 0x73, 0xf3, 0xa7, 0x57,
+  0x07, 0x70, 0xc0, 0xf7, 0x8c, 0x80, 0x63, 0x0d, 0x67, 0x4a, 0xde, 0xed, 0x31, 0xc5, 0xfe, 0x18,
+  0xe3, 0xa5, 0x99, 0x77, 0x26, 0xb8, 0xb4, 0x7c, 0x11, 0x44, 0x92, 0xd9, 0x23, 0x20, 0x89, 0x2e,
+  0x37, 0x3f, 0xd1, 0x5b, 0x95, 0xbc, 0xcf, 0xcd, 0x90, 0x87, 0x97, 0xb2, 0xdc, 0xfc, 0xbe, 0x61,
+  0xf2, 0x56, 0xd3, 0xab, 0x14, 0x2a, 0x5d, 0x9e, 0x84, 0x3c, 0x39, 0x53, 0x47, 0x6d, 0x41, 0xa2,
+  0x1f, 0x2d, 0x43, 0xd8, 0xb7, 0x7b, 0xa4, 0x76, 0xc4, 0x17, 0x49, 0xec, 0x7f, 0x0c, 0x6f, 0xf6,
+  0x6c, 0xa1, 0x3b, 0x52, 0x29, 0x9d, 0x55, 0xaa, 0xfb, 0x60, 0x86, 0xb1, 0xbb, 0xcc, 0x3e, 0x5a,
+  0xcb, 0x59, 0x5f, 0xb0, 0x9c, 0xa9, 0xa0, 0x51, 0x0b, 0xf5, 0x16, 0xeb, 0x7a, 0x75, 0x2c, 0xd7,
+  0x4f, 0xae, 0xd5, 0xe9, 0xe6, 0xe7, 0xad, 0xe8, 0x74, 0xd6, 0xf4, 0xea, 0xa8, 0x50, 0x58, 0xaf
+};
+
+/*!
+  \class RadioLibReedSolomon
+  \brief Class to perform Reed-Solomon forward error correction over GF(2^8), such as RS(255, 223).
+  Shortened codes are supported by passing shorter blocks, the code word is always the data followed by parity bytes.
+  Blocks longer than 255 bytes have to be split by the caller.
+*/
+class RadioLibReedSolomon {
+  public:
+    /*!
+      \brief Default constructor.
+    */
+    RadioLibReedSolomon();
+
+    /*!
+      \brief Initialization method.
+      \param nsym Number of parity bytes, up to RADIOLIB_RS_MAX_PARITY. Up to nsym/2 corrupted bytes can be corrected,
+      e.g. 32 parity bytes for RS(255, 223).
+      \param fcr First consecutive root of the generator polynomial, as power of the primitive element.
+      \returns \ref status_codes
+    */
+    int16_t begin(uint8_t nsym, uint8_t fcr = 0);
+
+    /*!
+      \brief Encoding method - calculates parity bytes for a block of data.
+      \param data Data to encode.
+      \param len Length of the data, at most 255 bytes minus the number of parity bytes.
+      \param parity Buffer to save the parity bytes into, must be at least nsym bytes long.
+      \returns \ref status_codes
+    */
+    int16_t encode(const uint8_t* data, size_t len, uint8_t* parity);
+
+    /*!
+      \brief Decoding method - corrects errors in a code word in place.
+      \param block Code word, data followed by the parity bytes.
+      \param len Length of the code word, including the parity bytes.
+      \param numErrors Pointer to a variable to save the number of corrected bytes. Ignored if set to NULL.
+      \returns \ref status_codes, RADIOLIB_ERR_CRC_MISMATCH if there were more errors than could be corrected.
+    */
+    int16_t decode(uint8_t* block, size_t len, uint8_t* numErrors = NULL);
+
+#if !RADIOLIB_GODMODE
+  private:
+#endif
+    uint8_t nsym = 0;
+    uint8_t fcr = 0;
+
+    // generator polynomial, highest power first
+    uint8_t generator[RADIOLIB_RS_MAX_PARITY + 1] = { 0 };
+
+    // Galois field arithmetic
+    uint8_t gfExp(int32_t power);
+    uint8_t gfMul(uint8_t a, uint8_t b);
+    uint8_t gfDiv(uint8_t a, uint8_t b);
+};
+
+// the global singleton
+extern RadioLibReedSolomon RadioLibReedSolomonInstance;
+
+/*!
+  \brief Function to interleave bits of a buffer - bit at index i is moved to index (i * mult) modulo number of bits,
+  bits are indexed from the least significant bit of the first byte.
+  \param in Input buffer.
+  \param out Output buffer, must be at least len bytes long and different from the input buffer.
+  \param len Length of both buffers in bytes.
+  \param mult Interleaver multiplier, must not have any common divisor with the number of bits (e.g. a prime).
+  \param deinterleave Set to true to perform the inverse operation.
+*/
+void rlb_interleave(const uint8_t* in, uint8_t* out, size_t len, uint32_t mult, bool deinterleave = false);
+
 #endif
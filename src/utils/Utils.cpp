@@ -5,12 +5,55 @@
 #include <string.h>
 #include <inttypes.h>
 
+// bit-reversed nibbles
+static const uint8_t reflectNibble[] RADIOLIB_NONVOLATILE = {
+  0x00, 0x08, 0x04, 0x0C, 0x02, 0x0A, 0x06, 0x0E,
+  0x01, 0x09, 0x05, 0x0D, 0x03, 0x0B, 0x07, 0x0F,
+};
+
+uint8_t rlb_reflect8(uint8_t in) {
+  return((RADIOLIB_NONVOLATILE_READ_BYTE(&reflectNibble[in & 0x0F]) << 4) | RADIOLIB_NONVOLATILE_READ_BYTE(&reflectNibble[in >> 4]));
+}
+
 uint32_t rlb_reflect(uint32_t in, uint8_t bits) {
+  if(bits == 0) {
+    return(0);
+  }
+
+  // reflect whole bytes, then drop the bits that were not requested
+  uint8_t numBytes = (bits + 7) / 8;
   uint32_t res = 0;
-  for(uint8_t i = 0; i < bits; i++) {
-    res |= (((in & ((uint32_t)1 << i)) >> i) << (bits - i - 1));
+  for(uint8_t i = 0; i < numBytes; i++) {
+    res = (res << 8) | rlb_reflect8(in & 0xFF);
+    in >>= 8;
+  }
+  return(res >> (8*numBytes - bits));
+}
+
+uint8_t rlb_popcount(uint32_t in) {
+  // count bits in parallel, pairs first, then nibbles and finally sum up the bytes
+  in = in - ((in >> 1) & 0x55555555UL);
+  in = (in & 0x33333333UL) + ((in >> 2) & 0x33333333UL);
+  in = (in + (in >> 4)) & 0x0F0F0F0FUL;
+  return((uint8_t)((in * 0x01010101UL) >> 24));
+}
+
+uint8_t rlb_ctz(uint32_t in) {
+  if(in == 0) {
+    return(32);
+  }
+
+  // isolate the lowest set bit, then the bits below it are counted
+  return(rlb_popcount((in & (~in + 1)) - 1));
+}
+
+bool rlb_memeq_ct(const uint8_t* a, const uint8_t* b, size_t len) {
+  // no early exit, so the time taken does not reveal the position of the first mismatch
+  uint8_t diff = 0;
+  for(size_t i = 0; i < len; i++) {
+    diff |= a[i] ^ b[i];
   }
-  return(res);
+  return(diff == 0);
 }
 
 void rlb_hexdump(const char* level, const uint8_t* data, size_t len, uint32_t offset, uint8_t width, bool be) {
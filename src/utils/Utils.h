@@ -18,12 +18,42 @@
 
 /*!
   \brief Function to reflect bits within a byte.
+  \param in The byte to reflect.
+  \return The reflected byte.
+*/
+uint8_t rlb_reflect8(uint8_t in);
+
+/*!
+  \brief Function to reflect bits within a value.
   \param in The input to reflect.
   \param bits Number of bits to reflect.
   \return The reflected input.
 */
 uint32_t rlb_reflect(uint32_t in, uint8_t bits);
 
+/*!
+  \brief Function to count the bits set in a value.
+  \param in The input value.
+  \return Number of bits set.
+*/
+uint8_t rlb_popcount(uint32_t in);
+
+/*!
+  \brief Function to find the lowest bit set in a value.
+  \param in The input value.
+  \return Position of the lowest set bit, or 32 if no bit is set.
+*/
+uint8_t rlb_ctz(uint32_t in);
+
+/*!
+  \brief Function to compare two buffers in constant time, e.g. for message integrity codes.
+  \param a The first buffer.
+  \param b The second buffer.
+  \param len Number of bytes to compare.
+  \return True if the buffers are equal, false otherwise.
+*/
+bool rlb_memeq_ct(const uint8_t* a, const uint8_t* b, size_t len);
+
 /*!
   \brief Function to dump data as hex into the debug port.
   \param level RadioLib debug level, set to NULL to not print.